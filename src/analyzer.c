@@ -0,0 +1,255 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the analysis of the PIDs of the transponder
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Analysis of the PIDs of the transponder (option pid_analyzer)
+ *
+ * The table of the 8192 PIDs is written by the main thread (see analyzer_packet in analyzer.h)
+ * and read by the monitor thread, each field has one writer. The maximums of the PCR intervals
+ * are taken by the monitor thread every second, a maximum found at the same moment can be lost.
+ *
+ * The PCR jitter is the difference between the interval of two PCRs and the interval of their
+ * processing by MuMuDVB. It includes the jitter of the network upstream and the reading of the
+ * card by blocks (dvr_buffer_size), it is not the PCR accuracy of ETR 290 (500ns) but shows the
+ * streams which arrive in bursts.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "analyzer.h"
+#include "stats_shm.h"
+#include "unicast_http.h"
+#include "mumudvb.h"
+#include "errors.h"
+#include "log.h"
+
+static char *log_module="Analyzer: ";
+
+analyzer_pid_t *analyzer_pids=NULL;
+analyzer_pid_monitor_t *analyzer_monitor=NULL;
+analyzer_ts_t analyzer_ts;
+
+/** @brief Allocate the tables of the PIDs
+ * @return 0 if ok, -1 on error
+ */
+int analyzer_init(void)
+{
+	int pid;
+
+	analyzer_monitor=calloc(ANALYZER_PIDS, sizeof(analyzer_pid_monitor_t));
+	if(analyzer_monitor==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		return -1;
+	}
+	analyzer_pids=calloc(ANALYZER_PIDS, sizeof(analyzer_pid_t));
+	if(analyzer_pids==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		free(analyzer_monitor);
+		analyzer_monitor=NULL;
+		return -1;
+	}
+	for(pid=0;pid<ANALYZER_PIDS;pid++)
+		analyzer_pids[pid].last_cc=-1;
+	memset(&analyzer_ts, 0, sizeof(analyzer_ts));
+	log_message( log_module, MSG_INFO,"The PIDs of the transponder are analyzed, see /monitor/pids.json\n");
+	return 0;
+}
+
+void analyzer_free(void)
+{
+	if(analyzer_pids)
+		free(analyzer_pids);
+	analyzer_pids=NULL;
+	if(analyzer_monitor)
+		free(analyzer_monitor);
+	analyzer_monitor=NULL;
+}
+
+/** @brief Keep the biggest value, only one thread writes it */
+static inline void analyzer_max(uint32_t *max, uint32_t value)
+{
+	if(value>__atomic_load_n(max, __ATOMIC_RELAXED))
+		__atomic_store_n(max, value, __ATOMIC_RELAXED);
+}
+
+/** @brief A PCR, called by the main thread
+ * The repetition is checked with the values of the PCR, the jitter with the time of processing
+ */
+void analyzer_pcr(analyzer_pid_t *a, const unsigned char *ts_packet)
+{
+	uint64_t pcr,now,pcr_interval,interval;
+	int64_t jitter;
+
+	pcr=(((uint64_t)ts_packet[6])<<25) | (ts_packet[7]<<17) | (ts_packet[8]<<9) | (ts_packet[9]<<1) | (ts_packet[10]>>7);
+	pcr=pcr*300+(((ts_packet[10] & 0x01)<<8) | ts_packet[11]);
+	now=get_time();
+	analyzer_add(&a->pcr_count, 1);
+	if(a->last_pcr_time)
+	{
+		//The PCR wraps after 2^33*300
+		pcr_interval=((pcr+(300ULL<<33)-a->last_pcr)%(300ULL<<33))/27; //us
+		interval=now-a->last_pcr_time;
+		if(pcr_interval>ANALYZER_PCR_DISCONTINUITY*1000ULL)
+			analyzer_add(&a->pcr_discontinuities, 1);
+		else
+		{
+			if(pcr_interval>ANALYZER_PCR_REPETITION*1000ULL)
+				analyzer_add(&a->pcr_repetition_errors, 1);
+			analyzer_max(&a->pcr_interval_max, pcr_interval);
+			jitter=(int64_t)interval-(int64_t)pcr_interval;
+			analyzer_max(&a->pcr_jitter_max, (jitter<0)?-jitter:jitter);
+		}
+	}
+	a->last_pcr=pcr;
+	a->last_pcr_time=now;
+}
+
+/** @brief The start of a PAT, called by the main thread */
+void analyzer_pat(void)
+{
+	uint64_t now,interval;
+
+	now=get_time();
+	if(analyzer_ts.last_pat_time)
+	{
+		interval=(now-analyzer_ts.last_pat_time)/1000;
+		if(interval>ANALYZER_PAT_INTERVAL)
+			analyzer_add(&analyzer_ts.pat_errors, 1);
+		analyzer_max(&analyzer_ts.pat_interval_max, interval);
+	}
+	analyzer_ts.last_pat_time=now;
+}
+
+/** @brief Compute the bitrates and take the maximums, called by the monitor thread every second
+ * The PIDs are also written in the statistics segment if it exists
+ */
+void analyzer_update(void)
+{
+	analyzer_pid_t *a;
+	analyzer_pid_monitor_t *m;
+	uint64_t now,packets;
+	double elapsed,bitrate;
+	int pid;
+
+	if(analyzer_pids==NULL)
+		return;
+	now=get_time();
+	elapsed=analyzer_ts.last_update?(now-analyzer_ts.last_update)/1e6:0;
+	analyzer_ts.last_update=now;
+	analyzer_ts.pat_interval_shown=__atomic_exchange_n(&analyzer_ts.pat_interval_max, 0, __ATOMIC_RELAXED);
+	for(pid=0;pid<ANALYZER_PIDS;pid++)
+	{
+		a=&analyzer_pids[pid];
+		m=&analyzer_monitor[pid];
+		packets=__atomic_load_n(&a->packets, __ATOMIC_RELAXED);
+		if(packets==m->last_packets)
+		{
+			if(m->bitrate && elapsed>0)
+				m->bitrate=m->bitrate*(100-ANALYZER_BITRATE_WEIGHT)/100;
+			if(m->bitrate<1)
+				m->bitrate=0;
+			continue;
+		}
+		if(elapsed>0)
+		{
+			bitrate=(packets-m->last_packets)*TS_PACKET_SIZE*8/elapsed;
+			//The first measure is taken as it is
+			if(m->bitrate)
+				m->bitrate+=(bitrate-m->bitrate)*ANALYZER_BITRATE_WEIGHT/100;
+			else
+				m->bitrate=bitrate;
+		}
+		m->last_packets=packets;
+		m->last_seen=now;
+		m->pcr_interval_shown=__atomic_exchange_n(&a->pcr_interval_max, 0, __ATOMIC_RELAXED);
+		m->pcr_jitter_shown=__atomic_exchange_n(&a->pcr_jitter_max, 0, __ATOMIC_RELAXED);
+	}
+	stats_shm_analyzer(analyzer_pids, analyzer_monitor, &analyzer_ts);
+}
+
+/** @brief Write the table of the PIDs seen, json
+ * Called by the monitor thread for the snapshot, or by the main thread if there is none yet
+ *
+ * @param reply the reply to fill
+ * @param number_of_channels the number of channels
+ * @param channels the channels array
+ */
+void analyzer_render_json(struct unicast_reply *reply, int number_of_channels, mumudvb_channel_t **channels)
+{
+	static const char *scrambling[]={"clear", "reserved", "even", "odd"};
+	int16_t pid_channel[ANALYZER_PIDS];
+	analyzer_pid_t *a;
+	analyzer_pid_monitor_t *m;
+	uint64_t now,packets;
+	int pid,ichan,i,first=1;
+
+	if(analyzer_pids==NULL)
+	{
+		unicast_reply_write(reply, "{\"enabled\":false}\n");
+		return;
+	}
+	//The first channel of each PID
+	memset(pid_channel, 0xff, sizeof(pid_channel));
+	for(ichan=number_of_channels-1;ichan>=0;ichan--)
+		for(i=0;i<channels[ichan]->num_pids;i++)
+			if(channels[ichan]->pids[i]>=0 && channels[ichan]->pids[i]<ANALYZER_PIDS)
+				pid_channel[channels[ichan]->pids[i]]=ichan;
+
+	now=get_time();
+	unicast_reply_write(reply, "{\"enabled\":true, \"sync_errors\":%llu, \"pat_errors\":%llu, \"pat_interval_max_ms\":%u,\n\"pids\":[",
+			(unsigned long long)__atomic_load_n(&analyzer_ts.sync_errors, __ATOMIC_RELAXED),
+			(unsigned long long)__atomic_load_n(&analyzer_ts.pat_errors, __ATOMIC_RELAXED),
+			analyzer_ts.pat_interval_shown);
+	for(pid=0;pid<ANALYZER_PIDS;pid++)
+	{
+		a=&analyzer_pids[pid];
+		m=&analyzer_monitor[pid];
+		packets=__atomic_load_n(&a->packets, __ATOMIC_RELAXED);
+		if(!packets)
+			continue;
+		unicast_reply_write(reply, "%s\n{\"pid\":%d, \"packets\":%llu, \"bitrate\":%.0f, \"last_seen_s\":%llu, \"cc_errors\":%llu, \"tei_errors\":%llu, \"scrambled\":%llu, \"scrambling\":\"%s\"",
+				first?"":",", pid, (unsigned long long)packets, m->bitrate,
+				(unsigned long long)(m->last_seen?(now-m->last_seen)/1000000:0),
+				(unsigned long long)__atomic_load_n(&a->cc_errors, __ATOMIC_RELAXED),
+				(unsigned long long)__atomic_load_n(&a->tei_errors, __ATOMIC_RELAXED),
+				(unsigned long long)__atomic_load_n(&a->scrambled, __ATOMIC_RELAXED),
+				scrambling[__atomic_load_n(&a->scrambling, __ATOMIC_RELAXED) & 0x03]);
+		if(__atomic_load_n(&a->pcr_count, __ATOMIC_RELAXED))
+			unicast_reply_write(reply, ", \"pcr\":{\"count\":%llu, \"interval_max_us\":%u, \"jitter_max_us\":%u, \"repetition_errors\":%llu, \"discontinuities\":%llu}",
+					(unsigned long long)__atomic_load_n(&a->pcr_count, __ATOMIC_RELAXED),
+					m->pcr_interval_shown, m->pcr_jitter_shown,
+					(unsigned long long)__atomic_load_n(&a->pcr_repetition_errors, __ATOMIC_RELAXED),
+					(unsigned long long)__atomic_load_n(&a->pcr_discontinuities, __ATOMIC_RELAXED));
+		if(pid_channel[pid]>=0)
+			unicast_reply_write(reply, ", \"channel\":{\"number\":%d, \"name\":\"%s\"}", pid_channel[pid]+1, channels[pid_channel[pid]]->name);
+		unicast_reply_write(reply, "}");
+		first=0;
+	}
+	unicast_reply_write(reply, "]}\n");
+}
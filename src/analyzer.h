@@ -0,0 +1,186 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the analysis of the PIDs of the transponder
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Header file for the analysis of the PIDs of the transponder (option pid_analyzer)
+ *
+ * Every packet read from the card is counted on its PID by the main thread : packets,
+ * continuity errors, transport errors, scrambling. The PCR and PAT intervals are checked in the
+ * spirit of ETR 290. The monitor thread computes the bitrates every second and publishes the
+ * table on /monitor/pids.json and in the statistics segment.
+ *
+ * This table is the only per PID counting : check_cc, the metrics and the statistics segment
+ * use it, they enable it without pid_analyzer.
+ */
+
+#ifndef _ANALYZER_H
+#define _ANALYZER_H
+
+#include <stdint.h>
+#include "mumudvb.h"
+
+/** Number of PIDs (the PIDs 0 to 8191) */
+#define ANALYZER_PIDS 8192
+/** PCR repetition error above this interval, ETR 290 2.3a (ms) */
+#define ANALYZER_PCR_REPETITION 40
+/** PCR discontinuity above this interval, ETR 290 2.3b (ms) */
+#define ANALYZER_PCR_DISCONTINUITY 100
+/** PAT error above this interval, ETR 290 1.3a (ms) */
+#define ANALYZER_PAT_INTERVAL 500
+/** Weight of the last second in the bitrate (percent) */
+#define ANALYZER_BITRATE_WEIGHT 30
+
+/** @brief A PID
+ * The counters are written by the main thread only, the monitor thread reads them.
+ * The fields used by every packet come first, in the same cache line
+ */
+typedef struct analyzer_pid_t{
+	uint64_t packets;
+	uint64_t cc_errors;
+	/** Packets with the transport error indicator */
+	uint64_t tei_errors;
+	uint64_t scrambled;
+	/** Last continuity counter (-1 : none), the last packet was a duplicate */
+	int8_t last_cc;
+	uint8_t last_duplicate;
+	/** Last scrambling control */
+	uint8_t scrambling;
+
+	/** Only for the packets with a PCR */
+	uint64_t pcr_count;
+	/** PCR intervals above ANALYZER_PCR_REPETITION ms */
+	uint64_t pcr_repetition_errors;
+	/** PCR intervals above ANALYZER_PCR_DISCONTINUITY ms without discontinuity indicator */
+	uint64_t pcr_discontinuities;
+	/** Longest PCR interval and biggest PCR jitter since the last update by the monitor thread (us) */
+	uint32_t pcr_interval_max;
+	uint32_t pcr_jitter_max;
+	/** Last PCR (27MHz) and its arrival (us, see get_time) */
+	uint64_t last_pcr;
+	uint64_t last_pcr_time;
+}analyzer_pid_t;
+
+/** @brief The values of a PID computed by the monitor thread, out of the table used by the main thread */
+typedef struct analyzer_pid_monitor_t{
+	uint64_t last_packets;
+	/** Bitrate (bit/s), moving average */
+	double bitrate;
+	uint32_t pcr_interval_shown;
+	uint32_t pcr_jitter_shown;
+	/** Last second with packets (s, get_time) */
+	uint64_t last_seen;
+}analyzer_pid_monitor_t;
+
+/** @brief The checks on the whole transport stream */
+typedef struct analyzer_ts_t{
+	/** Packets without the sync byte, ETR 290 1.2 */
+	uint64_t sync_errors;
+	/** PAT intervals above ANALYZER_PAT_INTERVAL ms, ETR 290 1.3a */
+	uint64_t pat_errors;
+	uint64_t last_pat_time;
+	uint32_t pat_interval_max;
+	uint32_t pat_interval_shown;
+	/** Last update by the monitor thread (us) */
+	uint64_t last_update;
+}analyzer_ts_t;
+
+extern analyzer_pid_t *analyzer_pids;
+extern analyzer_pid_monitor_t *analyzer_monitor;
+extern analyzer_ts_t analyzer_ts;
+
+/** @brief Add to a counter which has only one writer, the monitor thread can read it at any time */
+static inline void analyzer_add(uint64_t *counter, uint64_t value)
+{
+	__atomic_store_n(counter, *counter+value, __ATOMIC_RELAXED);
+}
+
+void analyzer_pcr(analyzer_pid_t *a, const unsigned char *ts_packet);
+void analyzer_pat(void);
+
+/** @brief Analyze a packet read from the card, called by the main thread
+ * The usual packet costs a few tests, the PCR and the PAT are handled out of line
+ * @return 1 if the packet is a continuity error
+ */
+static inline int analyzer_packet(int pid, const unsigned char *ts_packet)
+{
+	analyzer_pid_t *a;
+	int afc,cc,expected,cc_error=0;
+
+	if(analyzer_pids==NULL)
+		return 0;
+	if(ts_packet[0]!=0x47)
+	{
+		analyzer_add(&analyzer_ts.sync_errors, 1);
+		return 0;
+	}
+	a=&analyzer_pids[pid];
+	analyzer_add(&a->packets, 1);
+	if(ts_packet[1] & 0x80)
+		analyzer_add(&a->tei_errors, 1);
+	a->scrambling=ts_packet[3]>>6;
+	if(a->scrambling)
+		analyzer_add(&a->scrambled, 1);
+	if(pid==8191) //Null packets, no continuity
+		return 0;
+
+	afc=(ts_packet[3]>>4) & 0x03;
+	//Adaptation field with the discontinuity indicator : no continuity error, new PCR time base
+	if((afc & 0x02) && ts_packet[4] && (ts_packet[5] & 0x80))
+	{
+		a->last_cc=-1;
+		a->last_pcr_time=0;
+	}
+	//The continuity counter increases only with a payload, a packet can be repeated once
+	if(afc & 0x01)
+	{
+		cc=ts_packet[3] & 0x0f;
+		expected=(a->last_cc+1) & 0x0f;
+		if(a->last_cc>=0 && cc!=expected)
+		{
+			if(cc!=a->last_cc || a->last_duplicate)
+			{
+				analyzer_add(&a->cc_errors, 1);
+				cc_error=1;
+			}
+			a->last_duplicate=(cc==a->last_cc);
+		}
+		else
+			a->last_duplicate=0;
+		a->last_cc=cc;
+	}
+	if((afc & 0x02) && ts_packet[4]>=7 && (ts_packet[5] & 0x10))
+		analyzer_pcr(a, ts_packet);
+	if(!pid && (ts_packet[1] & 0x40))
+		analyzer_pat();
+	return cc_error;
+}
+
+struct unicast_reply;
+int analyzer_init(void);
+void analyzer_free(void);
+void analyzer_update(void);
+void analyzer_render_json(struct unicast_reply *reply, int number_of_channels, mumudvb_channel_t **channels);
+
+#endif
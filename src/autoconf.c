@@ -76,6 +76,7 @@
 #include "autoconf.h"
 #include "rtp.h"
 #include "log.h"
+#include "probes.h"
 #ifdef ENABLE_SCAM_SUPPORT
 #include "scam_common.h"
 #endif
@@ -83,14 +84,8 @@
 static char *log_module="Autoconf: ";
 
 
-mumudvb_service_t *autoconf_find_service_for_add(mumudvb_service_t *services,int service_id);
-mumudvb_service_t *autoconf_find_service_for_modify(mumudvb_service_t *services,int service_id);
-void autoconf_free_services(mumudvb_service_t *services);
-int autoconf_read_sdt(unsigned char *buf,int len, mumudvb_service_t *services);
-int autoconf_read_psip(auto_p_t *parameters);
 int autoconf_read_pmt(mumudvb_ts_packet_t *pmt, mumudvb_channel_t *channel, char *card_base_path, int tuner, uint8_t *asked_pid, uint8_t *number_chan_asked_pid,fds_t *fds);
-void autoconf_sort_services(mumudvb_service_t *services);
-int autoconf_read_nit(auto_p_t *parameters, mumudvb_channel_t *channels, int number_of_channels);
+int autoconf_read_nit(auto_p_t *parameters, mumudvb_channel_t **channels, int number_of_channels);
 
 
 
@@ -113,8 +108,18 @@ void init_aconf_v(auto_p_t *aconf_p)
 		.services=NULL,
 		.autoconf_unicast_port="\0",
 		.autoconf_multicast_port="\0",
+		.service_id_list=NULL,
 		.num_service_id=0,
 		.name_template="\0",
+		.original_network_id=-1,
+		.autoconf_cache=0,
+		.autoconf_cache_file=AUTOCONF_CACHE_PATH,
+		.cache_verify=0,
+		.cache_verify_timeout=0,
+		.cache_pat_pmt_pids=NULL,
+		.cache_entries=NULL,
+		.cache_num_entries=0,
+		.cache_services=NULL,
 	};
 }
 
@@ -227,13 +232,14 @@ int read_autoconfiguration_configuration(auto_p_t *auto_p, char *substring)
 	{
 		while ((substring = strtok (NULL, delimiteurs)) != NULL)
 		{
-			if (auto_p->num_service_id >= MAX_CHANNELS)
+			int *service_id_list;
+			service_id_list=realloc(auto_p->service_id_list,(auto_p->num_service_id+1)*sizeof(int));
+			if (service_id_list==NULL)
 			{
-				log_message( log_module,  MSG_ERROR,
-						"Autoconfiguration : Too many ts id : %d\n",
-						auto_p->num_service_id);
+				log_message( log_module, MSG_ERROR,"Problem with realloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
 				return -1;
 			}
+			auto_p->service_id_list=service_id_list;
 			auto_p->service_id_list[auto_p->num_service_id] = atoi (substring);
 			auto_p->num_service_id++;
 		}
@@ -247,6 +253,22 @@ int read_autoconfiguration_configuration(auto_p_t *auto_p, char *substring)
 		if (strlen (substring) >= MAX_NAME_LEN - 1)
 			log_message( log_module,  MSG_WARN,"Autoconfiguration: Channel name template too long\n");
 	}
+	else if (!strcmp (substring, "autoconf_cache"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		auto_p->autoconf_cache = atoi (substring);
+	}
+	else if (!strcmp (substring, "autoconf_cache_file"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		if(strlen(substring)>=DEFAULT_PATH_LEN)
+		{
+			log_message( log_module,  MSG_ERROR,
+					"The autoconf_cache_file is too long\n");
+			return -1;
+		}
+		sscanf (substring, "%s\n", auto_p->autoconf_cache_file);
+	}
 	else
 		return 0; //Nothing concerning autoconfiguration, we return 0 to explore the other possibilities
 
@@ -254,53 +276,63 @@ int read_autoconfiguration_configuration(auto_p_t *auto_p, char *substring)
 }
 
 
+/** @brief alloc the memory needed to read the PAT, SDT and PSIP
+ * Used by full autoconfiguration and by the verification of the autoconfiguration cache
+ */
+int autoconf_full_alloc(auto_p_t *auto_p)
+{
+	auto_p->autoconf_temp_pat=malloc(sizeof(mumudvb_ts_packet_t));
+	if(auto_p->autoconf_temp_pat==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		set_interrupted(ERROR_MEMORY<<8);
+		return -1;
+	}
+	memset (auto_p->autoconf_temp_pat, 0, sizeof( mumudvb_ts_packet_t));//we clear it
+	pthread_mutex_init(&auto_p->autoconf_temp_pat->packetmutex,NULL);
+	auto_p->autoconf_temp_sdt=malloc(sizeof(mumudvb_ts_packet_t));
+	if(auto_p->autoconf_temp_sdt==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		set_interrupted(ERROR_MEMORY<<8);
+		return -1;
+	}
+	memset (auto_p->autoconf_temp_sdt, 0, sizeof( mumudvb_ts_packet_t));//we clear it
+	pthread_mutex_init(&auto_p->autoconf_temp_sdt->packetmutex,NULL);
+
+	auto_p->autoconf_temp_psip=malloc(sizeof(mumudvb_ts_packet_t));
+	if(auto_p->autoconf_temp_psip==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		set_interrupted(ERROR_MEMORY<<8);
+		return -1;
+	}
+	memset (auto_p->autoconf_temp_psip, 0, sizeof( mumudvb_ts_packet_t));//we clear it
+	pthread_mutex_init(&auto_p->autoconf_temp_psip->packetmutex,NULL);
+
+	auto_p->services=malloc(sizeof(mumudvb_service_t));
+	if(auto_p->services==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		set_interrupted(ERROR_MEMORY<<8);
+		return -1;
+	}
+	memset (auto_p->services, 0, sizeof( mumudvb_service_t));//we clear it
+	return 0;
+}
+
 /** @brief initialize the autoconfiguration : alloc the memory etc...
  *
  */
-int autoconf_init(auto_p_t *auto_p, mumudvb_channel_t *channels,int number_of_channels)
+int autoconf_init(auto_p_t *auto_p, mumudvb_channel_t **channels,int number_of_channels)
 {
 	int ichan;
 
+	auto_p->start_time=get_time();
 	if(auto_p->autoconfiguration==AUTOCONF_MODE_FULL)
 	{
-		auto_p->autoconf_temp_pat=malloc(sizeof(mumudvb_ts_packet_t));
-		if(auto_p->autoconf_temp_pat==NULL)
-		{
-			log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
-			set_interrupted(ERROR_MEMORY<<8);
-			return -1;
-		}
-		memset (auto_p->autoconf_temp_pat, 0, sizeof( mumudvb_ts_packet_t));//we clear it
-		pthread_mutex_init(&auto_p->autoconf_temp_pat->packetmutex,NULL);
-		auto_p->autoconf_temp_sdt=malloc(sizeof(mumudvb_ts_packet_t));
-		if(auto_p->autoconf_temp_sdt==NULL)
-		{
-			log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
-			set_interrupted(ERROR_MEMORY<<8);
-			return -1;
-		}
-		memset (auto_p->autoconf_temp_sdt, 0, sizeof( mumudvb_ts_packet_t));//we clear it
-		pthread_mutex_init(&auto_p->autoconf_temp_sdt->packetmutex,NULL);
-
-		auto_p->autoconf_temp_psip=malloc(sizeof(mumudvb_ts_packet_t));
-		if(auto_p->autoconf_temp_psip==NULL)
-		{
-			log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
-			set_interrupted(ERROR_MEMORY<<8);
+		if(autoconf_full_alloc(auto_p))
 			return -1;
-		}
-		memset (auto_p->autoconf_temp_psip, 0, sizeof( mumudvb_ts_packet_t));//we clear it
-		pthread_mutex_init(&auto_p->autoconf_temp_psip->packetmutex,NULL);
-
-		auto_p->services=malloc(sizeof(mumudvb_service_t));
-		if(auto_p->services==NULL)
-		{
-			log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
-			set_interrupted(ERROR_MEMORY<<8);
-			return -1;
-		}
-		memset (auto_p->services, 0, sizeof( mumudvb_service_t));//we clear it
-
 	}
 
 	if (auto_p->autoconfiguration==AUTOCONF_MODE_PIDS)
@@ -308,17 +340,18 @@ int autoconf_init(auto_p_t *auto_p, mumudvb_channel_t *channels,int number_of_ch
 		{
 			//If there is more than one pid in one channel we mark it
 			//For no autoconfiguration
-			if(channels[ichan].num_pids>1)
+			if(channels[ichan]->num_pids>1)
 			{
-				log_message( log_module,  MSG_DETAIL, "Autoconfiguration deactivated for channel \"%s\" \n", channels[ichan].name);
-				channels[ichan].autoconfigurated=1;
+				log_message( log_module,  MSG_DETAIL, "Autoconfiguration deactivated for channel \"%s\" \n", channels[ichan]->name);
+				channels[ichan]->autoconfigurated=1;
 			}
-			else if (channels[ichan].num_pids==1)
+			else if (channels[ichan]->num_pids==1)
 			{
 				//Only one pid with autoconfiguration=partial, it's the PMT pid
-				channels[ichan].pmt_pid=channels[ichan].pids[0];
-				channels[ichan].pids_type[0]=PID_PMT;
-				snprintf(channels[ichan].pids_language[0],4,"%s","---");
+				channels[ichan]->pmt_pid=channels[ichan]->pids[0];
+				channels[ichan]->desc->pids_type[0]=PID_PMT;
+				snprintf(channels[ichan]->desc->pids_language[0],4,"%s","---");
+				autoconf_channel_wait_pmt(channels[ichan], auto_p->start_time);
 			}
 		}
 	if (auto_p->autoconfiguration)
@@ -598,18 +631,22 @@ void autoconf_sort_services(mumudvb_service_t *services)
  *
  * This function is called when We've got all the services, we now fill the channels structure
  * After that we go in AUTOCONF_MODE_PIDS to get audio and video pids
+ * The services which already have a channel are skipped, this allows to add new services later
  * @param parameters The autoconf parameters
- * @param channels Chained list of channels
+ * @param channels The channels table
+ * @param max_channels The number of channels allocated
+ * @param first_channel The number of channels already existing, the new ones are added after
  * @param port The mulicast port
  * @param card The card number for the ip address
  * @param unicast_vars The unicast parameters
  * @param fds The file descriptors (for filters and unicast)
  */
-int autoconf_services_to_channels(const auto_p_t *parameters, mumudvb_channel_t *channels, int port, int card, int tuner, unicast_parameters_t *unicast_vars, multi_p_t *multi_p, int server_id, void *scam_vars_v)
+int autoconf_services_to_channels(const auto_p_t *parameters, mumudvb_channel_t **channels, int max_channels, int first_channel, int port, int card, int tuner, unicast_parameters_t *unicast_vars, multi_p_t *multi_p, int server_id, void *scam_vars_v)
 {
 	mumudvb_service_t *service;
-	int iChan=0;
+	int iChan=first_channel;
 	int found_in_service_id_list;
+	int already_channel;
 	int unicast_port_per_channel;
 	char tempstring[256];
 	service=parameters->services;
@@ -643,7 +680,14 @@ int autoconf_services_to_channels(const auto_p_t *parameters, mumudvb_channel_t
 		else //No ts id list so it is found
 			found_in_service_id_list=1;
 
-		if(!parameters->autoconf_scrambled && service->free_ca_mode)
+		already_channel=0;
+		for(int ichan=0;ichan<first_channel && !already_channel;ichan++)
+			if(channels[ichan]->service_id==service->id)
+				already_channel=1;
+
+		if(already_channel || !service->id)
+			log_message( log_module, MSG_FLOOD,"Service already streamed or empty, we skip. Name \"%s\"\n", service->name);
+		else if(!parameters->autoconf_scrambled && service->free_ca_mode)
 			log_message( log_module, MSG_DETAIL,"Service scrambled, no CAM support and no autoconf_scrambled, we skip. Name \"%s\"\n", service->name);
 		else if(!service->pmt_pid)
 			log_message( log_module, MSG_DETAIL,"Service without a PMT pid, we skip. Name \"%s\"\n", service->name);
@@ -663,69 +707,71 @@ int autoconf_services_to_channels(const auto_p_t *parameters, mumudvb_channel_t
 				log_message( log_module, MSG_DETAIL,"We convert a new service into a channel, sid %d pmt_pid %d name \"%s\" \n",
 						service->id, service->pmt_pid, service->name);
 				display_service_type(service->type, MSG_DETAIL, log_module);
-				channels[iChan].channel_type=service->type;
-				channels[iChan].num_packet = 0;
-				channels[iChan].num_scrambled_packets = 0;
-				channels[iChan].scrambled_channel = 0;
-				channels[iChan].streamed_channel = 1;
-				channels[iChan].nb_bytes=0;
-				channels[iChan].pids[0]=service->pmt_pid;
-				channels[iChan].pids_type[0]=PID_PMT;
-				channels[iChan].num_pids=1;
-				snprintf(channels[iChan].pids_language[0],4,"%s","---");
+				channels[iChan]->channel_type=service->type;
+				channels[iChan]->num_packet = 0;
+				channels[iChan]->num_scrambled_packets = 0;
+				channels[iChan]->scrambled_channel = 0;
+				//The channel is streamed when its PMT is found
+				autoconf_channel_wait_pmt(channels[iChan], parameters->start_time);
+				channels[iChan]->nb_bytes=0;
+				channels[iChan]->iovcnt=0;
+				channels[iChan]->pids[0]=service->pmt_pid;
+				channels[iChan]->desc->pids_type[0]=PID_PMT;
+				channels[iChan]->num_pids=1;
+				snprintf(channels[iChan]->desc->pids_language[0],4,"%s","---");
 				if(strlen(parameters->name_template))
 				{
-					strcpy(channels[iChan].name,parameters->name_template);
+					strcpy(channels[iChan]->name,parameters->name_template);
 					int len=MAX_NAME_LEN;
-					char number[10];
-					mumu_string_replace(channels[iChan].name,&len,0,"%name",service->name);
-					sprintf(number,"%d",iChan+1);
-					mumu_string_replace(channels[iChan].name,&len,0,"%number",number);
+					char number[12];
+					mumu_string_replace(channels[iChan]->name,&len,0,"%name",service->name);
+					snprintf(number,sizeof(number),"%d",iChan+1);
+					mumu_string_replace(channels[iChan]->name,&len,0,"%number",number);
 					//put LCN here
 				}
 				else
-					strcpy(channels[iChan].name,service->name);
+					strcpy(channels[iChan]->name,service->name);
 				if(multi_p->multicast)
 				{
-					char number[10];
+					char number[12];
 					char ip[80];
 					int len=80;
 
 					if(strlen(parameters->autoconf_multicast_port))
 					{
 						strcpy(tempstring,parameters->autoconf_multicast_port);
-						sprintf(number,"%d",iChan);
+						snprintf(number,sizeof(number),"%d",iChan);
 						mumu_string_replace(tempstring,&len,0,"%number",number);
-						sprintf(number,"%d",card);
+						snprintf(number,sizeof(number),"%d",card);
 						mumu_string_replace(tempstring,&len,0,"%card",number);
-						sprintf(number,"%d",tuner);
+						snprintf(number,sizeof(number),"%d",tuner);
 						mumu_string_replace(tempstring,&len,0,"%tuner",number);
-						sprintf(number,"%d",server_id);
+						snprintf(number,sizeof(number),"%d",server_id);
 						mumu_string_replace(tempstring,&len,0,"%server",number);
 						//SID
-						sprintf(number,"%d",service->id);
+						snprintf(number,sizeof(number),"%d",service->id);
 						mumu_string_replace(tempstring,&len,0,"%sid",number);
-						channels[iChan].portOut=string_comput(tempstring);
+						channels[iChan]->portOut=string_comput(tempstring);
 					}
 					else
 					{
-						channels[iChan].portOut=port;//do here the job for evaluating the string
+						channels[iChan]->portOut=port;//do here the job for evaluating the string
 					}
 					if(multi_p->multicast_ipv4)
 					{
 						strcpy(ip,parameters->autoconf_ip4);
-						sprintf(number,"%d",iChan);
+						snprintf(number,sizeof(number),"%d",iChan);
 						mumu_string_replace(ip,&len,0,"%number",number);
-						sprintf(number,"%d",card);
+						snprintf(number,sizeof(number),"%d",card);
 						mumu_string_replace(ip,&len,0,"%card",number);
-						sprintf(number,"%d",tuner);
+						snprintf(number,sizeof(number),"%d",tuner);
 						mumu_string_replace(ip,&len,0,"%tuner",number);
-						sprintf(number,"%d",server_id);
+						snprintf(number,sizeof(number),"%d",server_id);
 						mumu_string_replace(ip,&len,0,"%server",number);
 						//SID
-						sprintf(number,"%d",(service->id&0xFF00)>>8);
+						snprintf(number,sizeof(number),"%d",(service->id&0xFF00)>>8);
 						mumu_string_replace(ip,&len,0,"%sid_hi",number);
-						sprintf(number,"%d",service->id&0x00FF);
+						snprintf(number,sizeof(number),"%d",service->id&0x00FF);
 						mumu_string_replace(ip,&len,0,"%sid_lo",number);
 						// Compute the string, ex: 239.255.130+0*10+2.1
 						log_message( log_module, MSG_DEBUG,"Computing expressions in string \"%s\"\n",ip);
@@ -736,63 +782,62 @@ int autoconf_services_to_channels(const auto_p_t *parameters, mumudvb_channel_t
 						tn[1]=string_comput(strtok_r (NULL,".",&sptr));
 						tn[2]=string_comput(strtok_r (NULL,".",&sptr));
 						tn[3]=string_comput(strtok_r (NULL,".",&sptr));
-						sprintf(channels[iChan].ip4Out,"%d.%d.%d.%d",tn[0],tn[1],tn[2],tn[3]); // In C the evalutation order of arguments in a fct  is undefined, no more easy factoring
-						log_message( log_module, MSG_DEBUG,"Channel IPv4 : \"%s\" port : %d\n",channels[iChan].ip4Out,channels[iChan].portOut);
+						sprintf(channels[iChan]->desc->ip4Out,"%d.%d.%d.%d",tn[0],tn[1],tn[2],tn[3]); // In C the evalutation order of arguments in a fct  is undefined, no more easy factoring
+						log_message( log_module, MSG_DEBUG,"Channel IPv4 : \"%s\" port : %d\n",channels[iChan]->desc->ip4Out,channels[iChan]->portOut);
 					}
 					if(multi_p->multicast_ipv6)
 					{
 						strcpy(ip,parameters->autoconf_ip6);
-						sprintf(number,"%d",iChan);
+						snprintf(number,sizeof(number),"%d",iChan);
 						mumu_string_replace(ip,&len,0,"%number",number);
-						sprintf(number,"%d",card);
+						snprintf(number,sizeof(number),"%d",card);
 						mumu_string_replace(ip,&len,0,"%card",number);
-						sprintf(number,"%d",tuner);
+						snprintf(number,sizeof(number),"%d",tuner);
 						mumu_string_replace(ip,&len,0,"%tuner",number);
-						sprintf(number,"%d",server_id);
+						snprintf(number,sizeof(number),"%d",server_id);
 						mumu_string_replace(ip,&len,0,"%server",number);
 						//SID
-						sprintf(number,"%04x",service->id);
+						snprintf(number,sizeof(number),"%04x",service->id);
 						mumu_string_replace(ip,&len,0,"%sid",number);
-						strncpy(channels[iChan].ip6Out,ip,IPV6_CHAR_LEN);
-						channels[iChan].ip6Out[IPV6_CHAR_LEN-1]='\0';
-						log_message( log_module, MSG_DEBUG,"Channel IPv6 : \"%s\" port : %d\n",channels[iChan].ip6Out,channels[iChan].portOut);
+						snprintf(channels[iChan]->desc->ip6Out,sizeof(channels[iChan]->desc->ip6Out),"%s",ip);
+						log_message( log_module, MSG_DEBUG,"Channel IPv6 : \"%s\" port : %d\n",channels[iChan]->desc->ip6Out,channels[iChan]->portOut);
 					}
 				}
 
 				//This is a scrambled channel, we will have to ask the cam for descrambling it
 				if(parameters->autoconf_scrambled && service->free_ca_mode)
-					channels[iChan].need_cam_ask=CAM_NEED_ASK;
+					channels[iChan]->need_cam_ask=CAM_NEED_ASK;
 
 				//We store the PMT and the service id in the channel
-				channels[iChan].pmt_pid=service->pmt_pid;
-				channels[iChan].service_id=service->id;
-				init_rtp_header(&channels[iChan]); //We init the rtp header in all cases
+				channels[iChan]->pmt_pid=service->pmt_pid;
+				channels[iChan]->service_id=service->id;
+				init_rtp_header(channels[iChan]); //We init the rtp header in all cases
 
-				if(channels[iChan].pmt_packet==NULL)
+				if(channels[iChan]->pmt_packet==NULL)
 				{
-					channels[iChan].pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
-					if(channels[iChan].pmt_packet==NULL)
+					channels[iChan]->pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
+					if(channels[iChan]->pmt_packet==NULL)
 					{
 						log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
 						set_interrupted(ERROR_MEMORY<<8);
 						return -1;
 					}
-					memset (channels[iChan].pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
-					pthread_mutex_init(&channels[iChan].pmt_packet->packetmutex,NULL);
+					memset (channels[iChan]->pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
+					pthread_mutex_init(&channels[iChan]->pmt_packet->packetmutex,NULL);
 				}
 #ifdef ENABLE_CAM_SUPPORT
 				//We allocate the packet for storing the PMT for CAM purposes
-				if(channels[iChan].cam_pmt_packet==NULL)
+				if(channels[iChan]->cam_pmt_packet==NULL)
 				{
-					channels[iChan].cam_pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
-					if(channels[iChan].cam_pmt_packet==NULL)
+					channels[iChan]->cam_pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
+					if(channels[iChan]->cam_pmt_packet==NULL)
 					{
 						log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
 						set_interrupted(ERROR_MEMORY<<8);
 						return -1;
 					}
-					memset (channels[iChan].cam_pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
-					pthread_mutex_init(&channels[iChan].cam_pmt_packet->packetmutex,NULL);
+					memset (channels[iChan]->cam_pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
+					pthread_mutex_init(&channels[iChan]->cam_pmt_packet->packetmutex,NULL);
 				}
 #endif
 				//We update the unicast port, the connection will be created in autoconf_finish_full
@@ -800,42 +845,42 @@ int autoconf_services_to_channels(const auto_p_t *parameters, mumudvb_channel_t
 				{
 					strcpy(tempstring,parameters->autoconf_unicast_port);
 					int len;len=256;
-					char number[10];
-					sprintf(number,"%d",iChan);
+					char number[12];
+					snprintf(number,sizeof(number),"%d",iChan);
 					mumu_string_replace(tempstring,&len,0,"%number",number);
-					sprintf(number,"%d",card);
+					snprintf(number,sizeof(number),"%d",card);
 					mumu_string_replace(tempstring,&len,0,"%card",number);
-					sprintf(number,"%d",tuner);
+					snprintf(number,sizeof(number),"%d",tuner);
 					mumu_string_replace(tempstring,&len,0,"%tuner",number);
-					sprintf(number,"%d",server_id);
+					snprintf(number,sizeof(number),"%d",server_id);
 					mumu_string_replace(tempstring,&len,0,"%server",number);
 					//SID
-					sprintf(number,"%d",service->id);
+					snprintf(number,sizeof(number),"%d",service->id);
 					mumu_string_replace(tempstring,&len,0,"%sid",number);
-					channels[iChan].unicast_port=string_comput(tempstring);
-					log_message( log_module, MSG_DEBUG,"Channel (direct) unicast port  %d\n",channels[iChan].unicast_port);
+					channels[iChan]->unicast_port=string_comput(tempstring);
+					log_message( log_module, MSG_DEBUG,"Channel (direct) unicast port  %d\n",channels[iChan]->unicast_port);
 				}
 #ifdef ENABLE_SCAM_SUPPORT
-                                if(channels[iChan].scam_pmt_packet==NULL && scam_vars->scam_support)
+                                if(channels[iChan]->scam_pmt_packet==NULL && scam_vars->scam_support)
                                 {
-                                        channels[iChan].scam_pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
-                                        if(channels[iChan].scam_pmt_packet==NULL)
+                                        channels[iChan]->scam_pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
+                                        if(channels[iChan]->scam_pmt_packet==NULL)
                                         {
                                                 log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
                                                 set_interrupted(ERROR_MEMORY<<8);
                                                 return -1;
                                         }
-                                        memset (channels[iChan].scam_pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
-                                        pthread_mutex_init(&channels[iChan].scam_pmt_packet->packetmutex,NULL);
+                                        memset (channels[iChan]->scam_pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
+                                        pthread_mutex_init(&channels[iChan]->scam_pmt_packet->packetmutex,NULL);
                                 }
 
 				if (service->free_ca_mode && scam_vars->scam_support) {
-					channels[iChan].scam_support=1;
-					channels[iChan].need_scam_ask=CAM_NEED_ASK;
+					channels[iChan]->scam_support=1;
+					channels[iChan]->need_scam_ask=CAM_NEED_ASK;
 #ifdef ENABLE_SCAM_DESCRAMBLER_SUPPORT
-					channels[iChan].ring_buffer_size=scam_vars->ring_buffer_default_size;
-					channels[iChan].decsa_delay=scam_vars->decsa_default_delay;
-					channels[iChan].send_delay=scam_vars->send_default_delay;
+					channels[iChan]->ring_buffer_size=scam_vars->ring_buffer_default_size;
+					channels[iChan]->decsa_delay=scam_vars->decsa_default_delay;
+					channels[iChan]->send_delay=scam_vars->send_default_delay;
 #endif
 				}
 #endif
@@ -851,14 +896,76 @@ int autoconf_services_to_channels(const auto_p_t *parameters, mumudvb_channel_t
 		}
 		service=service->next;
 	}
-	while(service && iChan<MAX_CHANNELS);
+	while(service && iChan<max_channels);
 
-	if(iChan==MAX_CHANNELS)
-		log_message( log_module, MSG_WARN,"Warning : We reached the maximum channel number, we drop other possible channels !\n");
+	if(service && iChan==max_channels)
+		log_message( log_module, MSG_WARN,"Warning : No room for more channels, we drop other possible channels !\n");
 
 	return iChan;
 }
 
+/** @brief Open the network sockets of an autoconfigured channel (multicast and unicast per channel port)
+ *
+ * @param channel the channel
+ * @param ichan the channel number
+ */
+void autoconf_channel_open_sockets(mumudvb_channel_t *channel, int ichan, multi_p_t *multi_p, unicast_parameters_t *unicast_vars, fds_t *fds)
+{
+	/** open the unicast listening connections for the channels */
+	if(channel->unicast_port && unicast_vars->unicast)
+	{
+		log_message( log_module, MSG_INFO,"Unicast : We open the channel %d http socket address %s:%d\n",
+				ichan,
+				unicast_vars->ipOut,
+				channel->unicast_port);
+		unicast_create_listening_socket(UNICAST_LISTEN_CHANNEL,
+				ichan,
+				unicast_vars->ipOut,
+				channel->unicast_port,
+				&channel->sIn,
+				&channel->socketIn,
+				fds,
+				unicast_vars);
+	}
+
+	//Open the multicast socket for the new channel
+	if(multi_p->multicast_ipv4)
+	{
+		if(multi_p->multicast && multi_p->auto_join) //See the README for the reason of this option
+			channel->socketOut4 =
+					makeclientsocket (channel->desc->ip4Out,
+							channel->portOut,
+							multi_p->ttl,
+							multi_p->iface4,
+							&channel->sOut4);
+		else if(multi_p->multicast)
+			channel->socketOut4 =
+					makesocket (channel->desc->ip4Out,
+							channel->portOut,
+							multi_p->ttl,
+							multi_p->iface4,
+							&channel->sOut4);
+	}
+	if(multi_p->multicast_ipv6)
+	{
+		if(multi_p->multicast && multi_p->auto_join) //See the README for the reason of this option
+			channel->socketOut6 =
+					makeclientsocket6 (channel->desc->ip6Out,
+							channel->portOut,
+							multi_p->ttl,
+							multi_p->iface6,
+							&channel->sOut6);
+		else if(multi_p->multicast)
+			channel->socketOut6 =
+					makesocket6 (channel->desc->ip6Out,
+							channel->portOut,
+							multi_p->ttl,
+							multi_p->iface6,
+							&channel->sOut6);
+	}
+	channel_init_packing(channel, multi_p);
+}
+
 /** @brief Finish full autoconfiguration (set everything needed to go to partial autoconf)
  * This function is called when FULL autoconfiguration is finished
  * It fill the asked pid array
@@ -874,18 +981,28 @@ int autoconf_services_to_channels(const auto_p_t *parameters, mumudvb_channel_t
 int autoconf_finish_full(mumu_chan_p_t *chan_p, auto_p_t *auto_p, multi_p_t *multi_p, tune_p_t *tune_p, fds_t *fds, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars)
 {
 	pthread_mutex_lock(&chan_p->lock);
-	int ichan,ipid;
+	int ichan,ipid,num_services;
+	mumudvb_service_t *service;
 	//We sort the services
 	autoconf_sort_services(auto_p->services);
-	chan_p->number_of_channels=autoconf_services_to_channels(auto_p, chan_p->channels, multi_p->common_port, tune_p->card, tune_p->tuner, unicast_vars, multi_p, server_id, scam_vars); //Convert the list of services into channels
+	//Room for the channels
+	num_services=0;
+	for(service=auto_p->services;service!=NULL;service=service->next)
+		num_services++;
+	if(mumu_chan_reserve(chan_p, num_services))
+	{
+		pthread_mutex_unlock(&chan_p->lock);
+		return -1;
+	}
+	chan_p->number_of_channels=autoconf_services_to_channels(auto_p, chan_p->channels, chan_p->max_channels, 0, multi_p->common_port, tune_p->card, tune_p->tuner, unicast_vars, multi_p, server_id, scam_vars); //Convert the list of services into channels
 	//we got the pmt pids for the channels, we open the filters
 	for (ichan = 0; ichan < chan_p->number_of_channels; ichan++)
 	{
-		for (ipid = 0; ipid < chan_p->channels[ichan].num_pids; ipid++)
+		for (ipid = 0; ipid < chan_p->channels[ichan]->num_pids; ipid++)
 		{
-			if(chan_p->asked_pid[chan_p->channels[ichan].pids[ipid]]==PID_NOT_ASKED)
-				chan_p->asked_pid[chan_p->channels[ichan].pids[ipid]]=PID_ASKED;
-			chan_p->number_chan_asked_pid[chan_p->channels[ichan].pids[ipid]]++;
+			if(chan_p->asked_pid[chan_p->channels[ichan]->pids[ipid]]==PID_NOT_ASKED)
+				chan_p->asked_pid[chan_p->channels[ichan]->pids[ipid]]=PID_ASKED;
+			chan_p->number_chan_asked_pid[chan_p->channels[ichan]->pids[ipid]]++;
 		}
 	}
 
@@ -900,118 +1017,156 @@ int autoconf_finish_full(mumu_chan_p_t *chan_p, auto_p_t *auto_p, multi_p_t *mul
 
 	//Networking
 	for (ichan = 0; ichan < chan_p->number_of_channels; ichan++)
-	{
-
-		/** open the unicast listening connections for the channels */
-		if(chan_p->channels[ichan].unicast_port && unicast_vars->unicast)
-		{
-			log_message( log_module, MSG_INFO,"Unicast : We open the channel %d http socket address %s:%d\n",
-					ichan,
-					unicast_vars->ipOut,
-					chan_p->channels[ichan].unicast_port);
-			unicast_create_listening_socket(UNICAST_LISTEN_CHANNEL,
-					ichan,
-					unicast_vars->ipOut,
-					chan_p->channels[ichan].unicast_port,
-					&chan_p->channels[ichan].sIn,
-					&chan_p->channels[ichan].socketIn,
-					fds,
-					unicast_vars);
-		}
-
-		//Open the multicast socket for the new channel
-		if(multi_p->multicast_ipv4)
-		{
-			if(multi_p->multicast && multi_p->auto_join) //See the README for the reason of this option
-				chan_p->channels[ichan].socketOut4 =
-						makeclientsocket (chan_p->channels[ichan].ip4Out,
-								chan_p->channels[ichan].portOut,
-								multi_p->ttl,
-								multi_p->iface4,
-								&chan_p->channels[ichan].sOut4);
-			else if(multi_p->multicast)
-				chan_p->channels[ichan].socketOut4 =
-						makesocket (chan_p->channels[ichan].ip4Out,
-								chan_p->channels[ichan].portOut,
-								multi_p->ttl,
-								multi_p->iface4,
-								&chan_p->channels[ichan].sOut4);
-		}
-		if(multi_p->multicast_ipv6)
-		{
-			if(multi_p->multicast && multi_p->auto_join) //See the README for the reason of this option
-				chan_p->channels[ichan].socketOut6 =
-						makeclientsocket6 (chan_p->channels[ichan].ip6Out,
-								chan_p->channels[ichan].portOut,
-								multi_p->ttl,
-								multi_p->iface6,
-								&chan_p->channels[ichan].sOut6);
-			else if(multi_p->multicast)
-				chan_p->channels[ichan].socketOut6 =
-						makesocket6 (chan_p->channels[ichan].ip6Out,
-								chan_p->channels[ichan].portOut,
-								multi_p->ttl,
-								multi_p->iface6,
-								&chan_p->channels[ichan].sOut6);
-		}
-	}
+		autoconf_channel_open_sockets(chan_p->channels[ichan], ichan, multi_p, unicast_vars, fds);
 
 	log_message( log_module, MSG_DEBUG,"Step TWO, we get the video and audio PIDs\n");
+	//We keep the services to write the autoconfiguration cache once the pids are known
+	if(auto_p->autoconf_cache)
+	{
+		auto_p->cache_services=auto_p->services;
+		auto_p->services=NULL;
+	}
 	//We free autoconf memory
 	autoconf_freeing(auto_p);
 
 	auto_p->autoconfiguration=AUTOCONF_MODE_PIDS; //Next step add video and audio pids
+	MUMUDVB_PROBE1(autoconf_phase, AUTOCONF_MODE_PIDS);
 	pthread_mutex_unlock(&chan_p->lock);
 
 	return 0;
 }
 
-/** @brief Finish autoconf
- * This function is called when autoconfiguration is finished
- * It opens what is needed to stream the new channels
- * It creates the file descriptors for the filters, set the filters
- * It also generates a config file with the data obtained during autoconfiguration
+/** @brief Add the filters for the pids of a channel
+ * The PMT pid (first pid) is already filtered since we waited for the PMT on it
+ * chan_p->lock must be held
  *
- * @param card the card number
- * @param number_of_channels the number of channels
- * @param channels the array of channels
- * @param asked_pid the array containing the pids already asked
- * @param number_chan_asked_pid the number of channels who want this pid
+ * @param chan_p the channels
+ * @param channel the channel whose pids were found
+ * @param card_base_path the path of the card devices
+ * @param tuner the tuner number
  * @param fds the file descriptors
  */
-void autoconf_set_channel_filt(char *card_base_path, int tuner, mumu_chan_p_t *chan_p, fds_t *fds)
+void autoconf_channel_add_filters(mumu_chan_p_t *chan_p, mumudvb_channel_t *channel, char *card_base_path, int tuner, fds_t *fds)
 {
-	int ichan;
 	int ipid;
 
-
-	log_message( log_module, MSG_DETAIL,"Autoconfiguration almost done\n");
-	log_message( log_module, MSG_DETAIL,"We open the new file descriptors\n");
-	for (ichan = 0; ichan < chan_p->number_of_channels; ichan++)
+	for (ipid = 1; ipid < channel->num_pids; ipid++)
 	{
-		for (ipid = 0; ipid < chan_p->channels[ichan].num_pids; ipid++)
-		{
-			if(chan_p->asked_pid[chan_p->channels[ichan].pids[ipid]]==PID_NOT_ASKED)
-				chan_p->asked_pid[chan_p->channels[ichan].pids[ipid]]=PID_ASKED;
-			chan_p->number_chan_asked_pid[chan_p->channels[ichan].pids[ipid]]++;
-		}
+		if(chan_p->asked_pid[channel->pids[ipid]]==PID_NOT_ASKED)
+			chan_p->asked_pid[channel->pids[ipid]]=PID_ASKED;
+		chan_p->number_chan_asked_pid[channel->pids[ipid]]++;
 	}
 	// we open the file descriptors
 	if (create_card_fd (card_base_path, tuner, chan_p->asked_pid, fds) < 0)
 	{
 		log_message( log_module, MSG_ERROR,"ERROR : CANNOT open the new descriptors. Some channels will probably not work\n");
 	}
-
-	log_message( log_module, MSG_DETAIL,"Add the new filters\n");
 	set_filters(chan_p->asked_pid, fds);
 }
 
-void autoconf_definite_end(mumu_chan_p_t *chan_p, multi_p_t *multi_p, unicast_parameters_t *unicast_vars)
+/** @brief The channel waits for its PMT
+ * It is not streamed (nor announced) until autoconf_channel_ready is called
+ *
+ * @param channel the channel
+ * @param start_time when we started to search this channel (usec, see get_time)
+ */
+void autoconf_channel_wait_pmt(mumudvb_channel_t *channel, uint64_t start_time)
 {
+	channel->autoconf_wait_pmt=1;
+	channel->desc->autoconf_wait_start=start_time;
+	channel->desc->autoconf_latency=-1;
+	channel->streamed_channel=0;
+}
+
+/** @brief The PMT of the channel was read, we start streaming it
+ * This is done channel by channel so a missing PMT doesn't delay the other channels
+ * chan_p->lock must be held
+ *
+ * @param chan_p the channels
+ * @param ichan the number of the channel
+ * @param card_base_path the path of the card devices
+ * @param tuner the tuner number
+ * @param fds the file descriptors
+ */
+void autoconf_channel_ready(mumu_chan_p_t *chan_p, int ichan, char *card_base_path, int tuner, fds_t *fds)
+{
+	mumudvb_channel_t *channel=chan_p->channels[ichan];
+
+	log_pids(log_module,channel,ichan);
+	autoconf_channel_add_filters(chan_p, channel, card_base_path, tuner, fds);
+	if(!channel->autoconf_wait_pmt)
+		return;
+	channel->desc->autoconf_latency=(int)((get_time()-channel->desc->autoconf_wait_start)/1000);
+	channel->autoconf_wait_pmt=0;
+	channel->streamed_channel=1;
+	channel->sap_need_update=1;
+	log_message( log_module, MSG_DETAIL,"Channel \"%s\" found in %d ms, we start streaming it\n",channel->name,channel->desc->autoconf_latency);
+	MUMUDVB_PROBE3(autoconf_channel, channel->name, channel->service_id, channel->desc->autoconf_latency);
+}
+
+/** @brief Replace the %lcn and %2lcn templates in the channel name */
+void autoconf_name_lcn(mumudvb_channel_t *channel)
+{
+	char lcn[4];
+	int len=MAX_NAME_LEN;
+	if(channel->logical_channel_number)
+	{
+		sprintf(lcn,"%03d",channel->logical_channel_number);
+		mumu_string_replace(channel->name,&len,0,"%lcn",lcn);
+		sprintf(lcn,"%02d",channel->logical_channel_number);
+		mumu_string_replace(channel->name,&len,0,"%2lcn",lcn);
+	}
+	else
+	{
+		mumu_string_replace(channel->name,&len,0,"%lcn","");
+		mumu_string_replace(channel->name,&len,0,"%2lcn","");
+	}
+}
+
+void autoconf_definite_end(auto_p_t *auto_p, mumu_chan_p_t *chan_p, multi_p_t *multi_p, tune_p_t *tune_p, unicast_parameters_t *unicast_vars)
+{
+	int ichan,num_found=0,num_waiting=0;
+	int latency_min=0,latency_max=0;
+	long latency_total=0;
+
 	log_message( log_module, MSG_INFO,"Autoconfiguration done\n");
+	MUMUDVB_PROBE1(autoconf_phase, AUTOCONF_MODE_NONE);
+
+	//Time needed to find each channel
+	pthread_mutex_lock(&chan_p->lock);
+	for(ichan=0;ichan<chan_p->number_of_channels;ichan++)
+	{
+		mumudvb_channel_t *channel=chan_p->channels[ichan];
+		if(channel->autoconf_wait_pmt)
+			num_waiting++;
+		else if(channel->desc->autoconf_latency>=0 && channel->desc->autoconf_wait_start)
+		{
+			if(!num_found || channel->desc->autoconf_latency<latency_min)
+				latency_min=channel->desc->autoconf_latency;
+			if(channel->desc->autoconf_latency>latency_max)
+				latency_max=channel->desc->autoconf_latency;
+			latency_total+=channel->desc->autoconf_latency;
+			num_found++;
+		}
+	}
+	pthread_mutex_unlock(&chan_p->lock);
+	if(num_found)
+		log_message( log_module, MSG_INFO,"%d channels found, time to find a channel : min %d ms, average %ld ms, max %d ms\n",
+				num_found, latency_min, latency_total/num_found, latency_max);
+	if(num_waiting)
+		log_message( log_module, MSG_INFO,"%d channels are still waiting for their PMT\n",num_waiting);
 
 	log_streamed_channels(log_module,chan_p->number_of_channels, chan_p->channels, multi_p->multicast_ipv4, multi_p->multicast_ipv6, unicast_vars->unicast, unicast_vars->portOut, unicast_vars->ipOut);
 
+	//We store what we found for the next start
+	if(auto_p->autoconf_cache && auto_p->cache_services)
+	{
+		pthread_mutex_lock(&chan_p->lock);
+		autoconf_cache_save(auto_p, chan_p, tune_p->freq, auto_p->cache_services);
+		pthread_mutex_unlock(&chan_p->lock);
+		autoconf_free_services(auto_p->cache_services);
+		auto_p->cache_services=NULL;
+	}
 }
 
 /********************************************************************
@@ -1041,6 +1196,8 @@ int autoconf_new_packet(int pid, unsigned char *ts_packet, auto_p_t *auto_p, fds
 			while(get_ts_packet(ts_packet,auto_p->autoconf_temp_sdt))
 			{
 				ts_packet=NULL; // next call we only POP packets from the stack
+				if(auto_p->autoconf_temp_sdt->data_full[0]==0x42) //SDT actual, we store the original network id for the cache
+					auto_p->original_network_id=GetSDTOriginalNetworkId(auto_p->autoconf_temp_sdt->data_full);
 				autoconf_read_sdt(auto_p->autoconf_temp_sdt->data_full,auto_p->autoconf_temp_sdt->len_full,auto_p->services);
 			}
 		}
@@ -1055,37 +1212,44 @@ int autoconf_new_packet(int pid, unsigned char *ts_packet, auto_p_t *auto_p, fds
 	}
 	else if(auto_p->autoconfiguration==AUTOCONF_MODE_PIDS) //We have the channels and their PMT, we search the other pids
 	{
-		int ichan;
-		for(ichan=0;ichan<MAX_CHANNELS;ichan++)
+		int ichan,iRet;
+		for(ichan=0;ichan<chan_p->number_of_channels;ichan++)
 		{
-			if((!chan_p->channels[ichan].autoconfigurated) &&(chan_p->channels[ichan].pmt_pid==pid)&& pid)
+			if((!chan_p->channels[ichan]->autoconfigurated) &&(chan_p->channels[ichan]->pmt_pid==pid)&& pid)
 			{
-				while((auto_p->autoconfiguration==AUTOCONF_MODE_PIDS)&&(chan_p->channels[ichan].pmt_packet)&&(get_ts_packet(ts_packet,chan_p->channels[ichan].pmt_packet)))
+				while((auto_p->autoconfiguration==AUTOCONF_MODE_PIDS)&&(chan_p->channels[ichan]->pmt_packet)&&(get_ts_packet(ts_packet,chan_p->channels[ichan]->pmt_packet)))
 				{
 					ts_packet=NULL; // next call we only POP packets from the stack
 					//Now we have the PMT, we parse it
-					if(autoconf_read_pmt(chan_p->channels[ichan].pmt_packet, &chan_p->channels[ichan], tune_p->card_dev_path, tune_p->tuner, chan_p->asked_pid, chan_p->number_chan_asked_pid, fds)==0)
+					pthread_mutex_lock(&chan_p->lock);
+					iRet=autoconf_read_pmt(chan_p->channels[ichan]->pmt_packet, chan_p->channels[ichan], tune_p->card_dev_path, tune_p->tuner, chan_p->asked_pid, chan_p->number_chan_asked_pid, fds);
+					if(iRet==0)
+					{
+						chan_p->channels[ichan]->autoconfigurated=1;
+						//We don't wait for the other channels, we stream this one now
+						autoconf_channel_ready(chan_p, ichan, tune_p->card_dev_path, tune_p->tuner, fds);
+					}
+					pthread_mutex_unlock(&chan_p->lock);
+					if(iRet==0)
 					{
-						log_pids(log_module,&chan_p->channels[ichan],ichan);
-
-						chan_p->channels[ichan].autoconfigurated=1;
-
 						//We parse the NIT before finishing autoconfiguration
 						auto_p->autoconfiguration=AUTOCONF_MODE_NIT;
 						for (ichan = 0; ichan < chan_p->number_of_channels; ichan++)
-							if(!chan_p->channels[ichan].autoconfigurated)
+							if(!chan_p->channels[ichan]->autoconfigurated)
 								auto_p->autoconfiguration=AUTOCONF_MODE_PIDS;  //not finished we continue
 
-						//if it's finished, we open the new descriptors and add the new filters
+						//if it's finished, the filters are already set
 						if(auto_p->autoconfiguration!=AUTOCONF_MODE_PIDS)
 						{
-							autoconf_set_channel_filt(tune_p->card_dev_path, tune_p->tuner, chan_p, fds);
 							//We free autoconf memory
 							autoconf_freeing(auto_p);
 							if(auto_p->autoconfiguration==AUTOCONF_MODE_NIT)
+							{
 								log_message( log_module, MSG_DETAIL,"We search for the NIT\n");
+								MUMUDVB_PROBE1(autoconf_phase, AUTOCONF_MODE_NIT);
+							}
 							else
-								autoconf_definite_end(chan_p, multi_p, unicast_vars);
+								autoconf_definite_end(auto_p, chan_p, multi_p, tune_p, unicast_vars);
 						}
 					}
 				}
@@ -1104,26 +1268,17 @@ int autoconf_new_packet(int pid, unsigned char *ts_packet, auto_p_t *auto_p, fds
 				{
 					auto_p->autoconfiguration=0;
 					int ichan;
-					char lcn[4];
-					int len=MAX_NAME_LEN;
-					for(ichan=0;ichan<MAX_CHANNELS;ichan++)
+					pthread_mutex_lock(&chan_p->lock);
+					for(ichan=0;ichan<chan_p->number_of_channels;ichan++)
 					{
-						if(chan_p->channels[ichan].logical_channel_number)
-						{
-							sprintf(lcn,"%03d",chan_p->channels[ichan].logical_channel_number);
-							mumu_string_replace(chan_p->channels[ichan].name,&len,0,"%lcn",lcn);
-							sprintf(lcn,"%02d",chan_p->channels[ichan].logical_channel_number);
-							mumu_string_replace(chan_p->channels[ichan].name,&len,0,"%2lcn",lcn);
-						}
-						else
-						{
-							mumu_string_replace(chan_p->channels[ichan].name,&len,0,"%lcn","");
-							mumu_string_replace(chan_p->channels[ichan].name,&len,0,"%2lcn","");
-						}
+						autoconf_name_lcn(chan_p->channels[ichan]);
+						//The channels are already announced, the name can have changed
+						chan_p->channels[ichan]->sap_need_update=1;
 					}
+					pthread_mutex_unlock(&chan_p->lock);
 					free(auto_p->autoconf_temp_nit);
 					auto_p->autoconf_temp_nit=NULL;
-					autoconf_definite_end(chan_p, multi_p, unicast_vars);
+					autoconf_definite_end(auto_p, chan_p, multi_p, tune_p, unicast_vars);
 				}
 			}
 		}
@@ -1140,14 +1295,36 @@ int autoconf_new_packet(int pid, unsigned char *ts_packet, auto_p_t *auto_p, fds
 int autoconf_poll(long now, auto_p_t *auto_p, mumu_chan_p_t *chan_p, tune_p_t *tune_p, multi_p_t *multi_p, fds_t *fds, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars)
 {
 	int iRet=0;
+	int ichan;
 	if(!auto_p->time_start_autoconfiguration)
 		auto_p->time_start_autoconfiguration=now;
 	else if (now-auto_p->time_start_autoconfiguration>AUTOCONFIGURE_TIME)
 	{
+		if(auto_p->cache_verify && !auto_p->cache_verify_timeout)
+		{
+			log_message( log_module, MSG_DETAIL,"Not all the services were seen before timeout, we check the cache with the partial list\n");
+			//The sockets of the channels are handled by the main thread, it ends the verification
+			auto_p->cache_verify_timeout=1;
+		}
 		if(auto_p->autoconfiguration==AUTOCONF_MODE_PIDS)
 		{
 			log_message( log_module, MSG_WARN,"Not all the channels were configured before timeout\n");
-			autoconf_set_channel_filt(tune_p->card_dev_path, tune_p->tuner, chan_p, fds);
+			pthread_mutex_lock(&chan_p->lock);
+			for (ichan = 0; ichan < chan_p->number_of_channels; ichan++)
+			{
+				if(chan_p->channels[ichan]->autoconfigurated || !chan_p->channels[ichan]->autoconf_wait_pmt)
+					continue;
+				if(auto_p->autoconf_pid_update)
+				{
+					//The PMT follow will start the channel when its PMT is found
+					log_message( log_module, MSG_DETAIL,"No PMT for channel \"%s\" yet, it will be added when found\n",chan_p->channels[ichan]->name);
+					chan_p->channels[ichan]->autoconfigurated=1;
+					chan_p->channels[ichan]->pmt_version=-1;
+				}
+				else
+					log_message( log_module, MSG_WARN,"No PMT for channel \"%s\", it will not be streamed\n",chan_p->channels[ichan]->name);
+			}
+			pthread_mutex_unlock(&chan_p->lock);
 			//We free autoconf memory
 			autoconf_freeing(auto_p);
 			auto_p->autoconfiguration=AUTOCONF_MODE_NIT;
@@ -1164,7 +1341,7 @@ int autoconf_poll(long now, auto_p_t *auto_p, mumu_chan_p_t *chan_p, tune_p_t *t
 		else if(auto_p->autoconfiguration==AUTOCONF_MODE_NIT)
 		{
 			log_message( log_module, MSG_WARN,"Warning : No NIT found before timeout\n");
-			autoconf_definite_end(chan_p, multi_p, unicast_vars);
+			autoconf_definite_end(auto_p, chan_p, multi_p, tune_p, unicast_vars);
 			if(auto_p->autoconf_temp_nit)
 			{
 				free(auto_p->autoconf_temp_nit);
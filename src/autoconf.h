@@ -48,6 +48,11 @@
 //timeout for autoconfiguration
 #define AUTOCONFIGURE_TIME 10
 
+/**The default path for the autoconfiguration cache*/
+#define AUTOCONF_CACHE_PATH "/var/lib/mumudvb/autoconf_cache_adapter%card_tuner%tuner"
+/**The version of the autoconfiguration cache file format*/
+#define AUTOCONF_CACHE_VERSION 1
+
 /**@brief chained list of services for autoconfiguration
  *
  */
@@ -68,6 +73,21 @@ typedef struct mumudvb_service_t{
 	struct mumudvb_service_t *next;
 }mumudvb_service_t;
 
+/**@brief A channel read from the autoconfiguration cache
+ *
+ */
+typedef struct autoconf_cache_entry_t{
+	/**The service (name, type, PMT pid, service id)*/
+	mumudvb_service_t service;
+	/**The logical channel number*/
+	int lcn;
+	/**The pids of the channel, as they were found by autoconfiguration*/
+	int pids[MAX_PIDS];
+	int pids_type[MAX_PIDS];
+	char pids_language[MAX_PIDS][4];
+	int num_pids;
+}autoconf_cache_entry_t;
+
 /**@brief The different parameters used for autoconfiguration*/
 typedef struct auto_p_t{
 	pthread_mutex_t lock;
@@ -88,6 +108,8 @@ Possible values for this variable
 	char autoconf_ip6[80];
 	/**When did we started autoconfiguration ?*/
 	long time_start_autoconfiguration;
+	/**When did MuMuDVB started autoconfiguration (usec, see get_time), used for the discovery latency*/
+	uint64_t start_time;
 	/**The transport stream id (used to read ATSC PSIP tables)*/
 	int transport_stream_id;
 	/** Do we autoconfigure scrambled channels ? */
@@ -108,21 +130,65 @@ Possible values for this variable
 	char autoconf_multicast_port[256];
 
 	/**the list of SID for full autoconfiguration*/
-	int service_id_list[MAX_CHANNELS];
+	int *service_id_list;
 	/**number of SID*/
 	int num_service_id;
 	/** the template for the channel name*/
 	char name_template[MAX_NAME_LEN];
 
+	/**The original network id (read in the SDT)*/
+	int original_network_id;
+	/** Do we use the autoconfiguration cache ?*/
+	int autoconf_cache;
+	/** The path of the autoconfiguration cache (with %card %tuner %server)*/
+	char autoconf_cache_file[DEFAULT_PATH_LEN];
+	/** Are we checking the channels started from the cache against the live tables ?*/
+	int cache_verify;
+	/** The verification reached its timeout, it is ended by the main thread with the next packet*/
+	int cache_verify_timeout;
+	/** The PMT pid of each program seen in the PAT during the verification (indexed by program number, 0 : not seen)*/
+	uint16_t *cache_pat_pmt_pids;
+	/** The channels read from the cache (kept during the verification)*/
+	autoconf_cache_entry_t *cache_entries;
+	int cache_num_entries;
+	/** The transport stream id and original network id stored in the cache*/
+	int cache_transport_stream_id;
+	int cache_original_network_id;
+	/** The services found by full autoconfiguration, kept to write the cache*/
+	mumudvb_service_t   *cache_services;
+
 }auto_p_t;
 
 
 void init_aconf_v(auto_p_t *aconf_p);
-int autoconf_init(auto_p_t *auto_p, mumudvb_channel_t *channels,int number_of_channels);
+int autoconf_init(auto_p_t *auto_p, mumudvb_channel_t **channels,int number_of_channels);
 void autoconf_freeing(auto_p_t *);
 int read_autoconfiguration_configuration(auto_p_t *auto_p, char *substring);
 int autoconf_new_packet(int pid, unsigned char *ts_packet, auto_p_t *auto_p, fds_t *fds, mumu_chan_p_t *chan_p, tune_p_t *tune_p, multi_p_t *multi_p,  unicast_parameters_t *unicast_vars, int server_id, void *scam_vars);
 int autoconf_poll(long now, auto_p_t *auto_p, mumu_chan_p_t *chan_p, tune_p_t *tune_p, multi_p_t *multi_p, fds_t *fds, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars);
 void autoconf_pmt_follow( unsigned char *ts_packet, fds_t *fds, mumudvb_channel_t *actual_channel, char *card_base_path, int tuner, mumu_chan_p_t *chan_p );
 
+//Used by the autoconfiguration cache
+int autoconf_full_alloc(auto_p_t *auto_p);
+int autoconf_read_pat(auto_p_t *auto_p);
+int autoconf_read_sdt(unsigned char *buf,int len, mumudvb_service_t *services);
+int autoconf_read_psip(auto_p_t *parameters);
+mumudvb_service_t *autoconf_find_service_for_add(mumudvb_service_t *services,int service_id);
+mumudvb_service_t *autoconf_find_service_for_modify(mumudvb_service_t *services,int service_id);
+void autoconf_free_services(mumudvb_service_t *services);
+void autoconf_sort_services(mumudvb_service_t *services);
+int autoconf_services_to_channels(const auto_p_t *parameters, mumudvb_channel_t **channels, int max_channels, int first_channel, int port, int card, int tuner, unicast_parameters_t *unicast_vars, multi_p_t *multi_p, int server_id, void *scam_vars_v);
+int autoconf_finish_full(mumu_chan_p_t *chan_p, auto_p_t *auto_p, multi_p_t *multi_p, tune_p_t *tune_p, fds_t *fds, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars);
+void autoconf_channel_open_sockets(mumudvb_channel_t *channel, int ichan, multi_p_t *multi_p, unicast_parameters_t *unicast_vars, fds_t *fds);
+void autoconf_channel_add_filters(mumu_chan_p_t *chan_p, mumudvb_channel_t *channel, char *card_base_path, int tuner, fds_t *fds);
+void autoconf_channel_wait_pmt(mumudvb_channel_t *channel, uint64_t start_time);
+void autoconf_channel_ready(mumu_chan_p_t *chan_p, int ichan, char *card_base_path, int tuner, fds_t *fds);
+void autoconf_name_lcn(mumudvb_channel_t *channel);
+
+int autoconf_cache_start(auto_p_t *auto_p, mumu_chan_p_t *chan_p, tune_p_t *tune_p, multi_p_t *multi_p, fds_t *fds, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars);
+int autoconf_cache_save(auto_p_t *auto_p, mumu_chan_p_t *chan_p, uint32_t freq, mumudvb_service_t *services);
+void autoconf_cache_new_packet(int pid, unsigned char *ts_packet, auto_p_t *auto_p, fds_t *fds, mumu_chan_p_t *chan_p, tune_p_t *tune_p, multi_p_t *multi_p, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars);
+void autoconf_cache_verify_end(auto_p_t *auto_p, mumu_chan_p_t *chan_p, tune_p_t *tune_p, multi_p_t *multi_p, fds_t *fds, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars);
+void autoconf_cache_freeing(auto_p_t *auto_p);
+
 #endif
@@ -0,0 +1,663 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for Autoconfiguration
+ *
+ * (C) 2008-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ *  @brief This file contain the code related to the autoconfiguration cache
+ *
+ * When full autoconfiguration is finished, the channels found (service, PMT pid and pids)
+ * are written in the cache file with the frequency, the transport stream id and the original network id.
+ *
+ * At the next start on the same frequency, the channels are created from the cache and streamed immediately.
+ * The PAT and SDT are then read in the background (like during full autoconfiguration) and compared to the cache :
+ *  - the channels whose service disappeared from the PAT are not streamed anymore
+ *  - the PMT pid changes are applied
+ *  - the new services are added as new channels
+ * The pids of each channel are checked with the first PMT received (PMT follow, see autoconf_pmt_follow).
+ * If something changed, the cache is written again.
+ *
+ * The cache is a text file :
+ *   version 1
+ *   key <frequency> <transport stream id> <original network id>
+ *   service <service id> <pmt pid> <service type> <free ca mode> <lcn> <name>
+ *   pid <pid> <pid type> <language>
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "errors.h"
+#include "mumudvb.h"
+#include "dvb.h"
+#include "autoconf.h"
+#include "log.h"
+
+static char *log_module="Autoconf: ";
+
+void autoconf_definite_end(auto_p_t *auto_p, mumu_chan_p_t *chan_p, multi_p_t *multi_p, tune_p_t *tune_p, unicast_parameters_t *unicast_vars);
+void unicast_close_connection(unicast_parameters_t *unicast_vars, fds_t *fds, int Socket);
+
+
+/** @brief Find a channel of the cache using its service id */
+static autoconf_cache_entry_t *autoconf_cache_find_entry(auto_p_t *auto_p, int service_id)
+{
+	int i;
+	for(i=0;i<auto_p->cache_num_entries;i++)
+		if(auto_p->cache_entries[i].service.id==service_id)
+			return &auto_p->cache_entries[i];
+	return NULL;
+}
+
+/** @brief Ask a pid for a channel (the filters are set later)*/
+static void autoconf_cache_ask_pid(mumu_chan_p_t *chan_p, int pid)
+{
+	if(chan_p->asked_pid[pid]==PID_NOT_ASKED)
+		chan_p->asked_pid[pid]=PID_ASKED;
+	chan_p->number_chan_asked_pid[pid]++;
+}
+
+/** @brief Remove a pid from a channel, if no channel need this pid anymore we close the filter*/
+static void autoconf_cache_release_pid(mumu_chan_p_t *chan_p, fds_t *fds, int pid)
+{
+	if((pid>MAX_MANDATORY_PID_NUMBER) && (chan_p->number_chan_asked_pid[pid]))
+	{
+		chan_p->number_chan_asked_pid[pid]--;
+		if(chan_p->number_chan_asked_pid[pid]==0)
+		{
+			log_message( log_module,  MSG_DEBUG, "Cache : pid %d does not belong to any channel anymore, we close the filter \n",pid);
+			close(fds->fd_demuxer[pid]);
+			fds->fd_demuxer[pid]=0;
+			chan_p->asked_pid[pid]=PID_NOT_ASKED;
+		}
+	}
+}
+
+/** @brief Keep the PMT pids of the programs of a complete PAT section
+ * All the sections seen during the verification are kept, the channels are checked against all of them
+ *
+ * @param auto_p the autoconfiguration parameters
+ * @param buf the PAT section
+ */
+static void autoconf_cache_pat_collect(auto_p_t *auto_p, unsigned char *buf)
+{
+	pat_t       *pat=(pat_t*)(buf);
+	pat_prog_t  *prog;
+	int delta=PAT_LEN;
+	int section_length=HILO(pat->section_length);
+
+	if(pat->current_next_indicator == 0)
+		return;
+	while((delta+PAT_PROG_LEN)<(section_length))
+	{
+		prog=(pat_prog_t*)((char*)buf+delta);
+		if(HILO(prog->program_number)!=0)
+			auto_p->cache_pat_pmt_pids[HILO(prog->program_number)]=HILO(prog->network_pid);
+		delta+=PAT_PROG_LEN;
+	}
+}
+
+/** @brief The service of a channel started from the cache is not in the PAT anymore, we stop streaming it
+ * The pids are released, the channel is not announced anymore, its sockets are closed and its HTTP clients disconnected.
+ * Called by the main thread, chan_p->lock must be held
+ */
+static void autoconf_cache_remove_channel(mumu_chan_p_t *chan_p, int ichan, fds_t *fds, unicast_parameters_t *unicast_vars)
+{
+	mumudvb_channel_t *channel=chan_p->channels[ichan];
+	int ipid;
+
+	for(ipid=0;ipid<channel->num_pids;ipid++)
+		autoconf_cache_release_pid(chan_p,fds,channel->pids[ipid]);
+	channel->num_pids=0;
+	channel->pmt_pid=0;
+	//The SAP announce is removed by sap_update (the messages of a channel not streamed are not sent, even without sockets)
+	//and the streamed channels list is written by the monitor thread
+	channel->streamed_channel=0;
+	channel->sap_need_update=1;
+	//The partial datagram is not sent
+	channel->nb_bytes=0;
+	channel->iovcnt=0;
+	if(channel->socketOut4>0)
+		close(channel->socketOut4);
+	channel->socketOut4=0;
+	if(channel->socketOut6>0)
+		close(channel->socketOut6);
+	channel->socketOut6=0;
+	while(channel->clients!=NULL)
+		unicast_close_connection(unicast_vars,fds,channel->clients->Socket);
+	if(channel->socketIn>0)
+	{
+		log_message( log_module, MSG_DEBUG,"We close the http socket of the channel %d\n",ichan);
+		unicast_close_connection(unicast_vars,fds,channel->socketIn);
+	}
+	channel->socketIn=0;
+}
+
+
+/** @brief Read the cache file
+ * return 0 if the cache is usable, -1 otherwise
+ *
+ * @param auto_p the autoconfiguration parameters, filled with the cache entries
+ * @param freq the frequency we are tuned on
+ */
+static int autoconf_cache_read(auto_p_t *auto_p, uint32_t freq)
+{
+	FILE *cache_file;
+	char line[MAX_NAME_LEN+128];
+	char keyword[16];
+	int version=0;
+	int key_ok=0;
+	unsigned int cache_freq;
+	int line_num=0;
+	int max_entries=0;
+	autoconf_cache_entry_t *entry=NULL;
+
+	cache_file=fopen(auto_p->autoconf_cache_file,"r");
+	if(cache_file==NULL)
+	{
+		log_message( log_module, MSG_INFO,"No autoconfiguration cache (%s : %s), full autoconfiguration\n",auto_p->autoconf_cache_file,strerror(errno));
+		return -1;
+	}
+
+	auto_p->cache_entries=NULL;
+	auto_p->cache_num_entries=0;
+
+	while(fgets(line,sizeof(line),cache_file)!=NULL)
+	{
+		line_num++;
+		line[strcspn(line,"\r\n")]='\0';
+		if(line[0]=='#' || line[0]=='\0')
+			continue;
+		if(sscanf(line,"%15s",keyword)!=1)
+			continue;
+		if(!strcmp(keyword,"version"))
+		{
+			sscanf(line,"%*s %d",&version);
+		}
+		else if(!strcmp(keyword,"key"))
+		{
+			if(sscanf(line,"%*s %u %d %d",&cache_freq,&auto_p->cache_transport_stream_id,&auto_p->cache_original_network_id)!=3)
+				break;
+			if(cache_freq!=freq)
+			{
+				log_message( log_module, MSG_INFO,"The autoconfiguration cache is for another frequency (%u), full autoconfiguration\n",cache_freq);
+				break;
+			}
+			key_ok=1;
+		}
+		else if(!strcmp(keyword,"service") && key_ok)
+		{
+			int name_pos=0;
+			if(auto_p->cache_num_entries>=max_entries)
+			{
+				autoconf_cache_entry_t *entries;
+				entries=realloc(auto_p->cache_entries,sizeof(autoconf_cache_entry_t)*(max_entries+CHANNELS_ALLOC_STEP));
+				if(entries==NULL)
+				{
+					log_message( log_module, MSG_ERROR,"Problem with realloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+					break;
+				}
+				auto_p->cache_entries=entries;
+				max_entries+=CHANNELS_ALLOC_STEP;
+			}
+			entry=&auto_p->cache_entries[auto_p->cache_num_entries];
+			memset(entry,0,sizeof(autoconf_cache_entry_t));
+			if(sscanf(line,"%*s %d %d %d %d %d %n",
+					&entry->service.id,
+					&entry->service.pmt_pid,
+					&entry->service.type,
+					&entry->service.free_ca_mode,
+					&entry->lcn,
+					&name_pos)<5 || !name_pos)
+			{
+				log_message( log_module, MSG_WARN,"Autoconfiguration cache : bad service line %d\n",line_num);
+				entry=NULL;
+				continue;
+			}
+			strncpy(entry->service.name,line+name_pos,MAX_NAME_LEN-1);
+			entry->service.name[MAX_NAME_LEN-1]='\0';
+			auto_p->cache_num_entries++;
+		}
+		else if(!strcmp(keyword,"pid") && entry!=NULL)
+		{
+			char language[4]="";
+			if(entry->num_pids>=MAX_PIDS)
+				continue;
+			if(sscanf(line,"%*s %d %d %3s",
+					&entry->pids[entry->num_pids],
+					&entry->pids_type[entry->num_pids],
+					language)<2)
+			{
+				log_message( log_module, MSG_WARN,"Autoconfiguration cache : bad pid line %d\n",line_num);
+				continue;
+			}
+			if(entry->pids[entry->num_pids]<0 || entry->pids[entry->num_pids]>8191)
+				continue;
+			if(!strcmp(language,"-"))
+				language[0]='\0';
+			snprintf(entry->pids_language[entry->num_pids],4,"%s",language);
+			entry->num_pids++;
+		}
+	}
+	fclose(cache_file);
+
+	if(version!=AUTOCONF_CACHE_VERSION || !key_ok || !auto_p->cache_num_entries)
+	{
+		if(key_ok)
+			log_message( log_module, MSG_INFO,"The autoconfiguration cache is not usable (version %d, %d channels), full autoconfiguration\n",version,auto_p->cache_num_entries);
+		if(auto_p->cache_entries)
+			free(auto_p->cache_entries);
+		auto_p->cache_entries=NULL;
+		auto_p->cache_num_entries=0;
+		return -1;
+	}
+	return 0;
+}
+
+
+/** @brief Write the autoconfiguration cache
+ * The file is written in a temporary file which is then renamed
+ * chan_p->lock must be held
+ *
+ * @param auto_p the autoconfiguration parameters
+ * @param chan_p the channels
+ * @param freq the frequency (cache key)
+ * @param services the services list, to store the names before the templates were applied
+ */
+int autoconf_cache_save(auto_p_t *auto_p, mumu_chan_p_t *chan_p, uint32_t freq, mumudvb_service_t *services)
+{
+	FILE *cache_file;
+	char tmp_filename[DEFAULT_PATH_LEN+5];
+	mumudvb_channel_t *channel;
+	mumudvb_service_t *service;
+	autoconf_cache_entry_t *entry;
+	int ichan,ipid;
+
+	snprintf(tmp_filename,sizeof(tmp_filename),"%s.tmp",auto_p->autoconf_cache_file);
+	cache_file=fopen(tmp_filename,"w");
+	if(cache_file==NULL)
+	{
+		log_message( log_module, MSG_WARN,"Cannot write the autoconfiguration cache %s : %s\n",tmp_filename,strerror(errno));
+		return -1;
+	}
+	fprintf(cache_file,"# MuMuDVB autoconfiguration cache, generated automatically\n");
+	fprintf(cache_file,"version %d\n",AUTOCONF_CACHE_VERSION);
+	fprintf(cache_file,"key %u %d %d\n",freq,auto_p->transport_stream_id,auto_p->original_network_id);
+
+	for(ichan=0;ichan<chan_p->number_of_channels;ichan++)
+	{
+		channel=chan_p->channels[ichan];
+		//Channels not found by autoconfiguration or not streamed anymore
+		if(!channel->service_id || !channel->pmt_pid || !channel->num_pids)
+			continue;
+		//We store the service name, not the channel name, so the templates can be applied again
+		service=services?autoconf_find_service_for_modify(services,channel->service_id):NULL;
+		entry=autoconf_cache_find_entry(auto_p,channel->service_id);
+		fprintf(cache_file,"service %d %d %d %d %d %s\n",
+				channel->service_id,
+				channel->pmt_pid,
+				channel->channel_type,
+				service?service->free_ca_mode:(entry?entry->service.free_ca_mode:0),
+				channel->logical_channel_number,
+				service?service->name:(entry?entry->service.name:channel->name));
+		for(ipid=0;ipid<channel->num_pids;ipid++)
+		{
+			const char *language=channel->desc->pids_language[ipid];
+			if(!isalpha((unsigned char)language[0]))
+				language="-";
+			fprintf(cache_file,"pid %d %d %s\n",channel->pids[ipid],channel->desc->pids_type[ipid],language);
+		}
+	}
+	if(fclose(cache_file) || rename(tmp_filename,auto_p->autoconf_cache_file))
+	{
+		log_message( log_module, MSG_WARN,"Cannot write the autoconfiguration cache %s : %s\n",auto_p->autoconf_cache_file,strerror(errno));
+		unlink(tmp_filename);
+		return -1;
+	}
+	log_message( log_module, MSG_DETAIL,"Autoconfiguration cache written : %s\n",auto_p->autoconf_cache_file);
+	return 0;
+}
+
+
+/** @brief Start the channels from the autoconfiguration cache
+ * Called before the main loop when full autoconfiguration is asked.
+ * If the cache is usable, the channels are created, the autoconfiguration is finished
+ * and the verification against the live tables starts.
+ *
+ * return 0 if ok (even if the cache is not usable), -1 in case of error
+ */
+int autoconf_cache_start(auto_p_t *auto_p, mumu_chan_p_t *chan_p, tune_p_t *tune_p, multi_p_t *multi_p, fds_t *fds, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars)
+{
+	mumudvb_service_t *service;
+	autoconf_cache_entry_t *entry;
+	mumudvb_channel_t *channel;
+	char number[12];
+	int len=DEFAULT_PATH_LEN;
+	int ichan,i,iRet;
+
+	if(!auto_p->autoconf_cache || auto_p->autoconfiguration!=AUTOCONF_MODE_FULL)
+		return 0;
+
+	//Templates for the path
+	snprintf(number,sizeof(number),"%d",tune_p->card);
+	mumu_string_replace(auto_p->autoconf_cache_file,&len,0,"%card",number);
+	snprintf(number,sizeof(number),"%d",tune_p->tuner);
+	mumu_string_replace(auto_p->autoconf_cache_file,&len,0,"%tuner",number);
+	snprintf(number,sizeof(number),"%d",server_id);
+	mumu_string_replace(auto_p->autoconf_cache_file,&len,0,"%server",number);
+
+	if(autoconf_cache_read(auto_p, tune_p->freq))
+		return 0;
+
+	log_message( log_module, MSG_INFO,"Autoconfiguration cache found (%d channels, TSID %d), we start streaming immediately\n",
+			auto_p->cache_num_entries,
+			auto_p->cache_transport_stream_id);
+
+	//The cache is checked by the PMT follow
+	if(!auto_p->autoconf_pid_update)
+	{
+		log_message( log_module, MSG_INFO,"The autoconfiguration cache needs autoconf_pid_update, we enable it\n");
+		auto_p->autoconf_pid_update=1;
+	}
+
+	//Room for the channels of the cache, the table grows later if new services are found
+	pthread_mutex_lock(&chan_p->lock);
+	iRet=mumu_chan_reserve(chan_p, auto_p->cache_num_entries);
+	pthread_mutex_unlock(&chan_p->lock);
+	if(iRet)
+		return -1;
+
+	pthread_mutex_lock(&auto_p->lock);
+	//We create the services list from the cache and we convert it into channels like full autoconfiguration
+	for(i=0;i<auto_p->cache_num_entries;i++)
+	{
+		service=autoconf_find_service_for_add(auto_p->services,auto_p->cache_entries[i].service.id);
+		if(service==NULL)
+			continue;
+		memcpy(service,&auto_p->cache_entries[i].service,sizeof(mumudvb_service_t));
+		service->next=NULL;
+	}
+	auto_p->transport_stream_id=auto_p->cache_transport_stream_id;
+	auto_p->original_network_id=auto_p->cache_original_network_id;
+	if(autoconf_finish_full(chan_p, auto_p, multi_p, tune_p, fds, unicast_vars, server_id, scam_vars))
+	{
+		pthread_mutex_unlock(&auto_p->lock);
+		return -1;
+	}
+	if(auto_p->cache_services)
+	{
+		autoconf_free_services(auto_p->cache_services);
+		auto_p->cache_services=NULL;
+	}
+
+	//We set the pids stored in the cache
+	pthread_mutex_lock(&chan_p->lock);
+	for(ichan=0;ichan<chan_p->number_of_channels;ichan++)
+	{
+		channel=chan_p->channels[ichan];
+		entry=autoconf_cache_find_entry(auto_p,channel->service_id);
+		if(entry!=NULL && entry->num_pids)
+		{
+			memcpy(channel->pids,entry->pids,sizeof(int)*entry->num_pids);
+			memcpy(channel->desc->pids_type,entry->pids_type,sizeof(int)*entry->num_pids);
+			memcpy(channel->desc->pids_language,entry->pids_language,4*entry->num_pids);
+			channel->num_pids=entry->num_pids;
+			for(i=0;i<channel->num_pids;i++)
+				if(channel->desc->pids_type[i]==PID_PCR)
+					channel->pcr_pid=channel->pids[i];
+		}
+		if(entry!=NULL)
+			channel->logical_channel_number=entry->lcn;
+		autoconf_name_lcn(channel);
+		//The first PMT received will be read to check the pids
+		channel->pmt_version=-1;
+		channel->autoconfigurated=1;
+		//Without pids in the cache, the channel waits for its PMT (PMT follow)
+		if(channel->num_pids>1)
+			autoconf_channel_ready(chan_p, ichan, tune_p->card_dev_path, tune_p->tuner, fds);
+	}
+	pthread_mutex_unlock(&chan_p->lock);
+
+	if(auto_p->autoconf_temp_nit)
+	{
+		free(auto_p->autoconf_temp_nit);
+		auto_p->autoconf_temp_nit=NULL;
+	}
+	auto_p->autoconfiguration=0;
+	autoconf_definite_end(auto_p, chan_p, multi_p, tune_p, unicast_vars);
+
+	//We read the PAT and the SDT in the background to check the cache
+	if(autoconf_full_alloc(auto_p))
+	{
+		pthread_mutex_unlock(&auto_p->lock);
+		return -1;
+	}
+	auto_p->cache_pat_pmt_pids=calloc(65536, sizeof(uint16_t));
+	if(auto_p->cache_pat_pmt_pids==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		pthread_mutex_unlock(&auto_p->lock);
+		return -1;
+	}
+	auto_p->transport_stream_id=-1;
+	auto_p->original_network_id=-1;
+	auto_p->time_start_autoconfiguration=0;
+	auto_p->cache_verify=1;
+	pthread_mutex_unlock(&auto_p->lock);
+	return 0;
+}
+
+
+/** @brief This function is called when a new packet is there and the cache is being verified
+ * It reads the PAT, SDT and PSIP like full autoconfiguration
+ */
+void autoconf_cache_new_packet(int pid, unsigned char *ts_packet, auto_p_t *auto_p, fds_t *fds, mumu_chan_p_t *chan_p, tune_p_t *tune_p, multi_p_t *multi_p, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars)
+{
+	pthread_mutex_lock(&auto_p->lock);
+	if(!auto_p->cache_verify)
+	{
+		pthread_mutex_unlock(&auto_p->lock);
+		return;
+	}
+	//Timeout reached (see autoconf_poll), we check with the PAT sections seen
+	if(auto_p->cache_verify_timeout)
+	{
+		autoconf_cache_verify_end(auto_p, chan_p, tune_p, multi_p, fds, unicast_vars, server_id, scam_vars);
+		pthread_mutex_unlock(&auto_p->lock);
+		return;
+	}
+	if(pid==0) //PAT
+	{
+		while(auto_p->cache_verify && get_ts_packet(ts_packet,auto_p->autoconf_temp_pat))
+		{
+			ts_packet=NULL; // next call we only POP packets from the stack
+			autoconf_cache_pat_collect(auto_p, auto_p->autoconf_temp_pat->data_full);
+			//All the services of the PAT are known, we can check
+			if(autoconf_read_pat(auto_p))
+				autoconf_cache_verify_end(auto_p, chan_p, tune_p, multi_p, fds, unicast_vars, server_id, scam_vars);
+		}
+	}
+	else if(pid==17) //SDT
+	{
+		while(get_ts_packet(ts_packet,auto_p->autoconf_temp_sdt))
+		{
+			ts_packet=NULL; // next call we only POP packets from the stack
+			if(auto_p->autoconf_temp_sdt->data_full[0]==0x42) //SDT actual
+				auto_p->original_network_id=GetSDTOriginalNetworkId(auto_p->autoconf_temp_sdt->data_full);
+			autoconf_read_sdt(auto_p->autoconf_temp_sdt->data_full,auto_p->autoconf_temp_sdt->len_full,auto_p->services);
+		}
+	}
+	else if(pid==PSIP_PID && tune_p->fe_type==FE_ATSC) //PSIP
+	{
+		while(get_ts_packet(ts_packet,auto_p->autoconf_temp_psip))
+		{
+			ts_packet=NULL; // next call we only POP packets from the stack
+			autoconf_read_psip(auto_p);
+		}
+	}
+	pthread_mutex_unlock(&auto_p->lock);
+}
+
+
+/** @brief Compare the channels started from the cache with the live tables and correct them
+ * Called by the main thread when all the services of the PAT were seen or after the timeout,
+ * auto_p->lock must be held
+ */
+void autoconf_cache_verify_end(auto_p_t *auto_p, mumu_chan_p_t *chan_p, tune_p_t *tune_p, multi_p_t *multi_p, fds_t *fds, unicast_parameters_t *unicast_vars, int server_id, void *scam_vars)
+{
+	mumudvb_channel_t *channel;
+	mumudvb_service_t *service;
+	autoconf_cache_entry_t *entry;
+	int pmt_pid;
+	int changed=0;
+	int ichan,ipid,old_number,num_services;
+
+	//No PAT seen, we cannot say anything
+	if(auto_p->transport_stream_id==-1)
+	{
+		log_message( log_module, MSG_WARN,"No PAT seen, the channels started from the autoconfiguration cache were not checked\n");
+		goto verify_done;
+	}
+
+	if(auto_p->transport_stream_id!=auto_p->cache_transport_stream_id ||
+			(auto_p->original_network_id!=-1 && auto_p->original_network_id!=auto_p->cache_original_network_id))
+	{
+		log_message( log_module, MSG_WARN,"The transport stream (TSID %d ONID %d) is not the one of the cache (TSID %d ONID %d), we correct the channels\n",
+				auto_p->transport_stream_id,
+				auto_p->original_network_id,
+				auto_p->cache_transport_stream_id,
+				auto_p->cache_original_network_id);
+		changed=1;
+	}
+
+	pthread_mutex_lock(&chan_p->lock);
+	for(ichan=0;ichan<chan_p->number_of_channels;ichan++)
+	{
+		channel=chan_p->channels[ichan];
+		//Only the channels of the cache are checked, with or without pids cached
+		entry=channel->service_id?autoconf_cache_find_entry(auto_p,channel->service_id):NULL;
+		if(entry==NULL)
+			continue;
+		pmt_pid=(channel->service_id>0 && channel->service_id<65536)?auto_p->cache_pat_pmt_pids[channel->service_id]:0;
+		if(!pmt_pid)
+		{
+			log_message( log_module, MSG_WARN,"Service %d \"%s\" is not in the PAT anymore, we stop streaming it\n",channel->service_id,channel->name);
+			autoconf_cache_remove_channel(chan_p, ichan, fds, unicast_vars);
+			changed=1;
+			continue;
+		}
+		if(pmt_pid!=channel->pmt_pid)
+		{
+			log_message( log_module, MSG_INFO,"The PMT pid of \"%s\" changed (%d -> %d)\n",channel->name,channel->pmt_pid,pmt_pid);
+			for(ipid=0;ipid<channel->num_pids;ipid++)
+				if(channel->pids[ipid]==channel->pmt_pid)
+				{
+					autoconf_cache_release_pid(chan_p,fds,channel->pmt_pid);
+					channel->pids[ipid]=pmt_pid;
+					autoconf_cache_ask_pid(chan_p,pmt_pid);
+				}
+			channel->pmt_pid=pmt_pid;
+			//The new PMT will be read by the PMT follow
+			channel->pmt_version=-1;
+			channel->pmt_needs_update=0;
+			changed=1;
+		}
+		service=autoconf_find_service_for_modify(auto_p->services,channel->service_id);
+		if(service!=NULL && strcmp(service->name,entry->service.name))
+		{
+			log_message( log_module, MSG_INFO,"The service %d was renamed \"%s\" (cache \"%s\")\n",channel->service_id,service->name,entry->service.name);
+			//Without template, we can rename the channel, otherwise it will be done at the next start
+			if(!strlen(auto_p->name_template))
+			{
+				snprintf(channel->name,MAX_NAME_LEN,"%s",service->name);
+				channel->sap_need_update=1;
+			}
+			changed=1;
+		}
+	}
+
+	//The services which are not in the cache become new channels, the channels don't move when the table grows
+	old_number=chan_p->number_of_channels;
+	num_services=0;
+	for(service=auto_p->services;service!=NULL;service=service->next)
+		num_services++;
+	if(num_services && !mumu_chan_reserve(chan_p, old_number+num_services))
+	{
+		autoconf_sort_services(auto_p->services);
+		chan_p->number_of_channels=autoconf_services_to_channels(auto_p, chan_p->channels, chan_p->max_channels, old_number, multi_p->common_port, tune_p->card, tune_p->tuner, unicast_vars, multi_p, server_id, scam_vars);
+	}
+	for(ichan=old_number;ichan<chan_p->number_of_channels;ichan++)
+	{
+		channel=chan_p->channels[ichan];
+		log_message( log_module, MSG_INFO,"New service not in the autoconfiguration cache : \"%s\" (sid %d), we add it\n",channel->name,channel->service_id);
+		autoconf_name_lcn(channel);
+		autoconf_cache_ask_pid(chan_p,channel->pmt_pid);
+		autoconf_channel_open_sockets(channel, ichan, multi_p, unicast_vars, fds);
+		//The other pids will be found by the PMT follow, which starts the channel
+		autoconf_channel_wait_pmt(channel, get_time());
+		channel->pmt_version=-1;
+		channel->autoconfigurated=1;
+		changed=1;
+	}
+	if(changed)
+	{
+		if (create_card_fd (tune_p->card_dev_path, tune_p->tuner, chan_p->asked_pid, fds) < 0)
+			log_message( log_module, MSG_ERROR,"CANNOT open the new descriptors. Some channels will probably not work\n");
+		set_filters(chan_p->asked_pid, fds);
+		autoconf_cache_save(auto_p, chan_p, tune_p->freq, auto_p->services);
+	}
+	else
+		log_message( log_module, MSG_INFO,"The autoconfiguration cache is up to date\n");
+	pthread_mutex_unlock(&chan_p->lock);
+
+	verify_done:
+	auto_p->cache_verify=0;
+	auto_p->cache_verify_timeout=0;
+	autoconf_freeing(auto_p);
+	autoconf_cache_freeing(auto_p);
+}
+
+/** @brief Free the memory used by the autoconfiguration cache */
+void autoconf_cache_freeing(auto_p_t *auto_p)
+{
+	if(auto_p->cache_services)
+	{
+		autoconf_free_services(auto_p->cache_services);
+		auto_p->cache_services=NULL;
+	}
+	if(auto_p->cache_entries)
+	{
+		free(auto_p->cache_entries);
+		auto_p->cache_entries=NULL;
+		auto_p->cache_num_entries=0;
+	}
+	if(auto_p->cache_pat_pmt_pids)
+	{
+		free(auto_p->cache_pat_pmt_pids);
+		auto_p->cache_pat_pmt_pids=NULL;
+	}
+}
@@ -44,13 +44,13 @@
 
 static char *log_module="Autoconf: ";
 
-void parse_nit_ts_descriptor(unsigned char *buf,int ts_descriptors_loop_len, mumudvb_channel_t *channels, int number_of_channels);
-void parse_lcn_descriptor(unsigned char *buf, mumudvb_channel_t *channels, int number_of_channels);
+void parse_nit_ts_descriptor(unsigned char *buf,int ts_descriptors_loop_len, mumudvb_channel_t **channels, int number_of_channels);
+void parse_lcn_descriptor(unsigned char *buf, mumudvb_channel_t **channels, int number_of_channels);
 
 /** @brief Read the network information table (cf EN 300 468)
  *
  */
-int autoconf_read_nit(auto_p_t *parameters, mumudvb_channel_t *channels, int number_of_channels)
+int autoconf_read_nit(auto_p_t *parameters, mumudvb_channel_t **channels, int number_of_channels)
 {
 	mumudvb_ts_packet_t *nit_mumu;
 	unsigned char *buf=NULL;
@@ -96,7 +96,7 @@ int autoconf_read_nit(auto_p_t *parameters, mumudvb_channel_t *channels, int num
 }
 
 
-void parse_nit_ts_descriptor(unsigned char* buf, int ts_descriptors_loop_len, mumudvb_channel_t* channels, int number_of_channels)
+void parse_nit_ts_descriptor(unsigned char* buf, int ts_descriptors_loop_len, mumudvb_channel_t** channels, int number_of_channels)
 {
 	int descriptors_loop_len;
 	nit_ts_t *descr_header;
@@ -147,7 +147,7 @@ void parse_nit_ts_descriptor(unsigned char* buf, int ts_descriptors_loop_len, mu
  * It's used to get the logical channel number
  * @param buf the buffer containing the descriptor
  */
-void parse_lcn_descriptor(unsigned char* buf, mumudvb_channel_t* channels, int number_of_channels)
+void parse_lcn_descriptor(unsigned char* buf, mumudvb_channel_t** channels, int number_of_channels)
 {
 	/* Service descriptor :
      descriptor_tag			8
@@ -173,10 +173,10 @@ void parse_lcn_descriptor(unsigned char* buf, mumudvb_channel_t* channels, int n
 		i_lcn=HILO(lcn->logical_channel_number);
 		for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
 		{
-			if(channels[curr_channel].service_id==service_id)
+			if(channels[curr_channel]->service_id==service_id)
 			{
-				log_message( log_module, MSG_DETAIL, "NIT LCN channel FOUND id %d, LCN %d name \"%s\"\n",service_id,i_lcn, channels[curr_channel].name);
-				channels[curr_channel].logical_channel_number=i_lcn;
+				log_message( log_module, MSG_DETAIL, "NIT LCN channel FOUND id %d, LCN %d name \"%s\"\n",service_id,i_lcn, channels[curr_channel]->name);
+				channels[curr_channel]->logical_channel_number=i_lcn;
 			}
 		}
 		descriptor_len -= NIT_LCN_LEN;
@@ -119,7 +119,7 @@ int autoconf_read_pmt(mumudvb_ts_packet_t *pmt, mumudvb_channel_t *channel, char
 #ifdef ENABLE_CAM_SUPPORT
 		// Reset of the CA SYS saved for the chanel
 		for (i=0; i<32; i++)
-			channel->ca_sys_id[i]=0;
+			channel->desc->ca_sys_id[i]=0;
 #endif
 	}
 
@@ -325,11 +325,11 @@ int autoconf_read_pmt(mumudvb_ts_packet_t *pmt, mumudvb_channel_t *channel, char
 				descr_ca_t *ca_descriptor;
 				ca_descriptor=(descr_ca_t *)(pmt->data_full+i+PMT_INFO_LEN+pos);
 				casysid=0;
-				while(casysid<32 && channel->ca_sys_id[casysid] && channel->ca_sys_id[casysid]!=HILO(ca_descriptor->CA_type) )
+				while(casysid<32 && channel->desc->ca_sys_id[casysid] && channel->desc->ca_sys_id[casysid]!=HILO(ca_descriptor->CA_type) )
 					casysid++;
-				if(casysid<32 && !channel->ca_sys_id[casysid])
+				if(casysid<32 && !channel->desc->ca_sys_id[casysid])
 				{
-					channel->ca_sys_id[casysid]=HILO(ca_descriptor->CA_type);
+					channel->desc->ca_sys_id[casysid]=HILO(ca_descriptor->CA_type);
 					log_message( log_module,  MSG_DETAIL,"Ca system id 0x%04x : %s\n", HILO(ca_descriptor->CA_type), ca_sys_id_to_str(HILO(ca_descriptor->CA_type)));//we display it with the description
 				}
 				if(casysid==32)
@@ -355,8 +355,8 @@ int autoconf_read_pmt(mumudvb_ts_packet_t *pmt, mumudvb_channel_t *channel, char
 		else
 		{
 			channel->pids[channel->num_pids]=pid;
-			channel->pids_type[channel->num_pids]=pid_type;
-			snprintf(channel->pids_language[channel->num_pids],4,"%s",language);
+			channel->desc->pids_type[channel->num_pids]=pid_type;
+			snprintf(channel->desc->pids_language[channel->num_pids],4,"%s",language);
 			channel->num_pids++;
 		}
 	}
@@ -385,8 +385,8 @@ int autoconf_read_pmt(mumudvb_ts_packet_t *pmt, mumudvb_channel_t *channel, char
 		else
 		{
 			channel->pids[channel->num_pids]=channel->pcr_pid;
-			channel->pids_type[channel->num_pids]=PID_PCR;
-			snprintf(channel->pids_language[channel->num_pids],4,"%s","---");
+			channel->desc->pids_type[channel->num_pids]=PID_PCR;
+			snprintf(channel->desc->pids_language[channel->num_pids],4,"%s","---");
 			channel->num_pids++;
 		}
 	}
@@ -424,8 +424,8 @@ int autoconf_read_pmt(mumudvb_ts_packet_t *pmt, mumudvb_channel_t *channel, char
 
 				number_chan_asked_pid[temp_pids[i]]++;
 				channel->pids[channel->num_pids]=temp_pids[i];
-				channel->pids_type[channel->num_pids]=temp_pids_type[i];
-				snprintf(channel->pids_language[channel->num_pids],4,"%s",temp_pids_language[i]);
+				channel->desc->pids_type[channel->num_pids]=temp_pids_type[i];
+				snprintf(channel->desc->pids_language[channel->num_pids],4,"%s",temp_pids_language[i]);
 				channel->num_pids++;
 
 				log_message( log_module, MSG_DETAIL,"Add the new filters\n");
@@ -479,7 +479,7 @@ int autoconf_read_pmt(mumudvb_ts_packet_t *pmt, mumudvb_channel_t *channel, char
 		log_message( log_module,  MSG_DETAIL, "        pids : \n");/**@todo Generate a strind and call log_message after, in syslog it generates one line per pid : use the toolbox unicast*/
 		int ipid;
 		for (ipid = 0; ipid < channel->num_pids; ipid++)
-			log_message( log_module,  MSG_DETAIL, "              %d (%s) \n", channel->pids[ipid], pid_type_to_str(channel->pids_type[ipid]));
+			log_message( log_module,  MSG_DETAIL, "              %d (%s) \n", channel->pids[ipid], pid_type_to_str(channel->desc->pids_type[ipid]));
 
 	}
 	/** @todo : update generated conf file*/
@@ -493,16 +493,16 @@ int autoconf_read_pmt(mumudvb_ts_packet_t *pmt, mumudvb_channel_t *channel, char
 	int len=MAX_NAME_LEN;
 	for(i=0;i<channel->num_pids && !found;i++)
 	{
-		if(channel->pids_language[i][0]!='-')
+		if(channel->desc->pids_language[i][0]!='-')
 		{
-			log_message( log_module,  MSG_FLOOD, "Primary language for channel: %s",channel->pids_language[i]);
-			mumu_string_replace(channel->name,&len,0,"%lang",channel->pids_language[i]);
+			log_message( log_module,  MSG_FLOOD, "Primary language for channel: %s",channel->desc->pids_language[i]);
+			mumu_string_replace(channel->name,&len,0,"%lang",channel->desc->pids_language[i]);
 			found=1; //we exit the loop
 		}
 	}
 	//If we don't find a lang we replace by our "usual" ---
 	if(!found)
-		mumu_string_replace(channel->name,&len,0,"%lang",channel->pids_language[0]);
+		mumu_string_replace(channel->name,&len,0,"%lang",channel->desc->pids_language[0]);
 	/*************************
 	 * Language template END
 	 **************************/
@@ -637,10 +637,20 @@ void autoconf_pmt_follow(unsigned char *ts_packet, fds_t *fds, mumudvb_channel_t
 			ts_packet=NULL; // next call we only POP packets from the stack
 			if(pmt_need_update(channel,channel->pmt_packet->data_full))
 			{
+				int first_read;
+				//If the channel has only its PMT pid (PMT found late or channel added while streaming), autoconf_read_pmt doesn't set the filters
+				first_read=channel->num_pids<=1;
 				log_message( log_module, MSG_DETAIL,"PMT packet updated, we have now to check if there is new things\n");
 				/*We've got the FULL PMT packet*/
 				if(autoconf_read_pmt(channel->pmt_packet, channel, card_base_path, tuner, chan_p->asked_pid, chan_p->number_chan_asked_pid, fds)==0)
 				{
+					if(first_read)
+					{
+						int ichan;
+						for(ichan=0;ichan<chan_p->number_of_channels && chan_p->channels[ichan]!=channel;ichan++);
+						if(ichan<chan_p->number_of_channels)
+							autoconf_channel_ready(chan_p, ichan, card_base_path, tuner, fds);
+					}
 					if(channel->need_cam_ask==CAM_ASKED)
 						channel->need_cam_ask=CAM_NEED_UPDATE; //We we resend this packet to the CAM
 					update_pmt_version(channel);
@@ -470,15 +470,15 @@ static void *camthread_func(void* arg)
 				for (int curr_channel = 0; curr_channel < chan_p->number_of_channels; curr_channel++)
 				{
 					// Check if new asking (ie sending a CAM PMT UPDATE) is needed. IE channel highly/partially scrambled or down and asked a while ago
-					if((chan_p->channels[curr_channel].scrambled_channel == HIGHLY_SCRAMBLED || chan_p->channels[curr_channel].scrambled_channel == PARTIALLY_UNSCRAMBLED || chan_p->channels[curr_channel].streamed_channel == 0)&&
-							(chan_p->channels[curr_channel].need_cam_ask==CAM_ASKED)&&
-							((tv.tv_sec-chan_p->channels[curr_channel].cam_asking_time)>cam_p->cam_reask_interval))
+					if((chan_p->channels[curr_channel]->scrambled_channel == HIGHLY_SCRAMBLED || chan_p->channels[curr_channel]->scrambled_channel == PARTIALLY_UNSCRAMBLED || chan_p->channels[curr_channel]->streamed_channel == 0)&&
+							(chan_p->channels[curr_channel]->need_cam_ask==CAM_ASKED)&&
+							((tv.tv_sec-chan_p->channels[curr_channel]->cam_asking_time)>cam_p->cam_reask_interval))
 					{
-						chan_p->channels[curr_channel].need_cam_ask=CAM_NEED_UPDATE; //No race condition because need_cam_ask is not changed when it is at the value CAM_ASKED
+						chan_p->channels[curr_channel]->need_cam_ask=CAM_NEED_UPDATE; //No race condition because need_cam_ask is not changed when it is at the value CAM_ASKED
 						log_message( log_module,  MSG_DETAIL,
 								"Channel \"%s\" highly scrambled for more than %ds. We ask the CAM to update.\n",
-								chan_p->channels[curr_channel].name,cam_p->cam_reask_interval);
-						chan_p->channels[curr_channel].cam_asking_time=tv.tv_sec;
+								chan_p->channels[curr_channel]->name,cam_p->cam_reask_interval);
+						chan_p->channels[curr_channel]->cam_asking_time=tv.tv_sec;
 					}
 				}
 			}
@@ -24,10 +24,27 @@
 
 /** @file
  * @brief File for CRC32 calculation
- * it contains the precomputed table
+ * it contains the precomputed table and the CRC32 kernels
+ *
+ * Three kernels are available, the best one is selected at runtime by crc32_init
+ *  - byte : the classical one byte at a time table lookup
+ *  - slice8 : slicing by 8, eight tables, eight bytes per iteration
+ *  - pclmul : folding using the carry-less multiply instruction (x86 with PCLMULQDQ),
+ *     the remainder is finished with the slicing by 8 kernel
  */
 
+#include "config.h"
+
 #include <stdint.h>
+#include <stddef.h>
+
+#include "crc32.h"
+
+#ifdef HAVE_PCLMUL_INTRINSICS
+#include <cpuid.h>
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+#endif
 
 /**CRC table for PAT rebuilding, cam support and autoconfiguration*/
 uint32_t crc32_table[256] =
@@ -98,3 +115,232 @@ uint32_t crc32_table[256] =
 	0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
 
+
+
+/** The slicing by 8 tables, crc32_slice8[k][i] is the CRC32 of the byte i followed by k zero bytes
+ * crc32_slice8[0] is crc32_table. Filled by crc32_init
+ */
+static uint32_t crc32_slice8[8][256];
+
+typedef uint32_t (*crc32_update_func_t)(uint32_t crc, const unsigned char *data, size_t len);
+
+/** The kernel in use, the byte one is always valid, even if crc32_init was not called */
+static crc32_update_func_t crc32_update_func=crc32_mpeg2_update_byte;
+static crc32_impl_t crc32_impl=CRC32_IMPL_BYTE;
+static int crc32_initialised=0;
+
+
+/** @brief Update a CRC32 one byte at a time (the reference kernel)
+ *
+ * @param crc the current value of the CRC register (CRC32_MPEG2_INIT for a new buffer)
+ * @param data the data to add
+ * @param len the length of the data
+ */
+uint32_t crc32_mpeg2_update_byte(uint32_t crc, const unsigned char *data, size_t len)
+{
+	while(len--)
+		crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ *data++)&0xff];
+	return crc;
+}
+
+/** @brief Update a CRC32 with the slicing by 8 algorithm */
+static uint32_t crc32_mpeg2_update_slice8(uint32_t crc, const unsigned char *data, size_t len)
+{
+	uint32_t hi;
+	while(len >= 8)
+	{
+		hi = crc ^ (((uint32_t)data[0]<<24) | ((uint32_t)data[1]<<16) | ((uint32_t)data[2]<<8) | data[3]);
+		crc = crc32_slice8[7][hi>>24] ^
+				crc32_slice8[6][(hi>>16)&0xff] ^
+				crc32_slice8[5][(hi>>8)&0xff] ^
+				crc32_slice8[4][hi&0xff] ^
+				crc32_slice8[3][data[4]] ^
+				crc32_slice8[2][data[5]] ^
+				crc32_slice8[1][data[6]] ^
+				crc32_slice8[0][data[7]];
+		data+=8;
+		len-=8;
+	}
+	return crc32_mpeg2_update_byte(crc, data, len);
+}
+
+#ifdef HAVE_PCLMUL_INTRINSICS
+/** Under this length, the setup of the folding costs more than it brings */
+#define CRC32_PCLMUL_MIN_LEN 64
+
+/** Folding constants : high quadword x^(n+64) mod P, low quadword x^n mod P */
+static long long crc32_k128[2];
+static long long crc32_k512[2];
+
+/** @brief Compute x^n modulo the CRC32 polynomial */
+static uint32_t crc32_xpow_mod(unsigned int n)
+{
+	uint32_t r=1;
+	while(n--)
+		r = (r & 0x80000000) ? ((r << 1) ^ 0x04c11db7) : (r << 1);
+	return r;
+}
+
+static int crc32_cpu_has_pclmul(void)
+{
+	unsigned int eax,ebx,ecx,edx;
+	if(!__get_cpuid(1,&eax,&ebx,&ecx,&edx))
+		return 0;
+	return (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+}
+
+/** @brief Load 16 bytes, most significant byte first, so bit i of the register is the coefficient of x^i */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crc32_load_be(const unsigned char *data)
+{
+	const __m128i bswap=_mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), bswap);
+}
+
+/** @brief Fold a 128 bits block forward by the distance the constant was computed for */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crc32_fold(__m128i x, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11), _mm_clmulepi64_si128(x, k, 0x00));
+}
+
+/** @brief Update a CRC32 using the carry-less multiply instruction
+ *
+ * The CRC register is xored into the first bytes of the data, then the data is folded,
+ * 4 blocks of 16 bytes in parallel, down to a 16 bytes block congruent to the data modulo the polynomial.
+ * This block and the tail are finished with the slicing by 8 kernel.
+ */
+__attribute__((target("pclmul,ssse3")))
+static uint32_t crc32_mpeg2_update_pclmul(uint32_t crc, const unsigned char *data, size_t len)
+{
+	const __m128i bswap=_mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+	__m128i k,x0,x1,x2,x3;
+	unsigned char folded[16];
+
+	if(len < CRC32_PCLMUL_MIN_LEN)
+		return crc32_mpeg2_update_slice8(crc, data, len);
+
+	x0=_mm_xor_si128(crc32_load_be(data), _mm_set_epi32((int)crc,0,0,0));
+	x1=crc32_load_be(data+16);
+	x2=crc32_load_be(data+32);
+	x3=crc32_load_be(data+48);
+	data+=64;
+	len-=64;
+
+	k=_mm_set_epi64x(crc32_k512[1], crc32_k512[0]);
+	while(len >= 64)
+	{
+		x0=_mm_xor_si128(crc32_fold(x0,k), crc32_load_be(data));
+		x1=_mm_xor_si128(crc32_fold(x1,k), crc32_load_be(data+16));
+		x2=_mm_xor_si128(crc32_fold(x2,k), crc32_load_be(data+32));
+		x3=_mm_xor_si128(crc32_fold(x3,k), crc32_load_be(data+48));
+		data+=64;
+		len-=64;
+	}
+
+	k=_mm_set_epi64x(crc32_k128[1], crc32_k128[0]);
+	x1=_mm_xor_si128(crc32_fold(x0,k), x1);
+	x2=_mm_xor_si128(crc32_fold(x1,k), x2);
+	x3=_mm_xor_si128(crc32_fold(x2,k), x3);
+	while(len >= 16)
+	{
+		x3=_mm_xor_si128(crc32_fold(x3,k), crc32_load_be(data));
+		data+=16;
+		len-=16;
+	}
+
+	_mm_storeu_si128((__m128i *)folded, _mm_shuffle_epi8(x3, bswap));
+	crc=crc32_mpeg2_update_slice8(0, folded, 16);
+	return crc32_mpeg2_update_slice8(crc, data, len);
+}
+#endif
+
+/** @brief Build the tables and select the fastest CRC32 kernel available on this CPU
+ * Must be called before starting the threads
+ */
+void crc32_init(void)
+{
+	int i,k;
+
+	if(crc32_initialised)
+		return;
+	for(i=0;i<256;i++)
+	{
+		crc32_slice8[0][i]=crc32_table[i];
+		for(k=1;k<8;k++)
+			crc32_slice8[k][i]=(crc32_slice8[k-1][i] << 8) ^ crc32_table[crc32_slice8[k-1][i] >> 24];
+	}
+	crc32_initialised=1;
+#ifdef HAVE_PCLMUL_INTRINSICS
+	crc32_k128[0]=crc32_xpow_mod(128);
+	crc32_k128[1]=crc32_xpow_mod(128+64);
+	crc32_k512[0]=crc32_xpow_mod(512);
+	crc32_k512[1]=crc32_xpow_mod(512+64);
+	if(crc32_set_impl(CRC32_IMPL_PCLMUL)==0)
+		return;
+#endif
+	crc32_set_impl(CRC32_IMPL_SLICE8);
+}
+
+/** @brief Force a CRC32 kernel (used by the benchmark)
+ * return 0 if ok, -1 if the kernel is not available
+ */
+int crc32_set_impl(crc32_impl_t impl)
+{
+	switch(impl)
+	{
+	case CRC32_IMPL_BYTE:
+		crc32_update_func=crc32_mpeg2_update_byte;
+		break;
+	case CRC32_IMPL_SLICE8:
+		if(!crc32_initialised)
+			return -1;
+		crc32_update_func=crc32_mpeg2_update_slice8;
+		break;
+	case CRC32_IMPL_PCLMUL:
+#ifdef HAVE_PCLMUL_INTRINSICS
+		if(!crc32_initialised || !crc32_cpu_has_pclmul())
+			return -1;
+		crc32_update_func=crc32_mpeg2_update_pclmul;
+		break;
+#else
+		return -1;
+#endif
+	default:
+		return -1;
+	}
+	crc32_impl=impl;
+	return 0;
+}
+
+crc32_impl_t crc32_get_impl(void)
+{
+	return crc32_impl;
+}
+
+const char *crc32_impl_to_str(crc32_impl_t impl)
+{
+	switch(impl)
+	{
+	case CRC32_IMPL_BYTE:
+		return "byte";
+	case CRC32_IMPL_SLICE8:
+		return "slice8";
+	case CRC32_IMPL_PCLMUL:
+		return "pclmul";
+	default:
+		return "unknown";
+	}
+}
+
+/** @brief Update a CRC32 with the kernel selected by crc32_init
+ * Can be called several times on consecutive parts of a buffer (streaming)
+ *
+ * @param crc the current value of the CRC register (CRC32_MPEG2_INIT for a new buffer)
+ * @param data the data to add
+ * @param len the length of the data
+ */
+uint32_t crc32_mpeg2_update(uint32_t crc, const unsigned char *data, size_t len)
+{
+	return crc32_update_func(crc, data, len);
+}
@@ -0,0 +1,61 @@
+/*
+ * MuMuDVB - UDP-ize a DVB transport stream.
+ *
+ * (C) 2004-2009 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+
+/** @file
+ * This file contains the headers concerning the CRC32 (MPEG-2 flavour) computation
+ */
+
+#ifndef _CRC32_H
+#define _CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** The initial value of the CRC32 register for MPEG-2 sections */
+#define CRC32_MPEG2_INIT 0xffffffff
+
+/** The implementations of the CRC32 kernel */
+typedef enum crc32_impl_t {
+	CRC32_IMPL_BYTE,
+	CRC32_IMPL_SLICE8,
+	CRC32_IMPL_PCLMUL,
+} crc32_impl_t;
+
+extern uint32_t crc32_table[256];
+
+void crc32_init(void);
+crc32_impl_t crc32_get_impl(void);
+int crc32_set_impl(crc32_impl_t impl);
+const char *crc32_impl_to_str(crc32_impl_t impl);
+uint32_t crc32_mpeg2_update(uint32_t crc, const unsigned char *data, size_t len);
+uint32_t crc32_mpeg2_update_byte(uint32_t crc, const unsigned char *data, size_t len);
+
+/** @brief Compute the CRC32 of a full buffer (MPEG-2 sections, SAP hashes) */
+static inline uint32_t crc32_mpeg2(const unsigned char *data, size_t len)
+{
+	return crc32_mpeg2_update(CRC32_MPEG2_INIT, data, len);
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * MuMuDVB - UDP-ize a DVB transport stream.
+ *
+ * (C) 2004-2009 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Micro benchmark of the CRC32 kernels
+ *
+ * Checks that every kernel available on this CPU gives the same result as the byte
+ * at a time one (also when the data is given in several parts), then measures the
+ * throughput for typical section sizes.
+ *
+ * Build with "make crc32_bench" in the src directory, usage : crc32_bench [megabytes per test]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "crc32.h"
+
+#define BENCH_BUF_SIZE 4096
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+/** @brief Compare a kernel with the byte at a time one, return the number of errors */
+static int check_impl(const unsigned char *buf)
+{
+	int errors=0;
+	size_t len,split;
+	uint32_t ref,crc;
+
+	for(len=0;len<=BENCH_BUF_SIZE;len+=(len<300)?1:97)
+	{
+		ref=crc32_mpeg2_update_byte(CRC32_MPEG2_INIT,buf,len);
+		if(crc32_mpeg2(buf,len)!=ref)
+			errors++;
+		//streaming : the same buffer given in two parts
+		for(split=0;split<=len;split+=(split<200)?7:331)
+		{
+			crc=crc32_mpeg2_update(CRC32_MPEG2_INIT,buf,split);
+			crc=crc32_mpeg2_update(crc,buf+split,len-split);
+			if(crc!=ref)
+				errors++;
+		}
+	}
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t sizes[]={16, 188, 1024, 4096};
+	static const crc32_impl_t impls[]={CRC32_IMPL_BYTE, CRC32_IMPL_SLICE8, CRC32_IMPL_PCLMUL};
+	unsigned char buf[BENCH_BUF_SIZE];
+	double mbytes=256;
+	double byte_rate[sizeof(sizes)/sizeof(sizes[0])];
+	double t,rate;
+	long iter,n;
+	uint32_t sink=0;
+	unsigned int is,ii;
+	int ret=0;
+
+	if(argc>1)
+		mbytes=atof(argv[1]);
+	if(mbytes<=0)
+		mbytes=256;
+
+	srand(42);
+	for(is=0;is<BENCH_BUF_SIZE;is++)
+		buf[is]=rand()&0xff;
+
+	crc32_init();
+	printf("Default CRC32 kernel on this CPU : %s\n\n",crc32_impl_to_str(crc32_get_impl()));
+	printf("%-8s %8s %12s %10s\n","kernel","size","MB/s","speedup");
+
+	for(ii=0;ii<sizeof(impls)/sizeof(impls[0]);ii++)
+	{
+		if(crc32_set_impl(impls[ii]))
+		{
+			printf("%-8s not available\n",crc32_impl_to_str(impls[ii]));
+			continue;
+		}
+		if(check_impl(buf))
+		{
+			printf("%-8s WRONG RESULTS\n",crc32_impl_to_str(impls[ii]));
+			ret=1;
+			continue;
+		}
+		for(is=0;is<sizeof(sizes)/sizeof(sizes[0]);is++)
+		{
+			n=(long)(mbytes*1024*1024/sizes[is]);
+			t=now_seconds();
+			for(iter=0;iter<n;iter++)
+			{
+				buf[0]=iter&0xff; //avoid the compiler to hoist the computation
+				sink^=crc32_mpeg2(buf,sizes[is]);
+			}
+			t=now_seconds()-t;
+			rate=(double)n*sizes[is]/(1024*1024)/t;
+			if(impls[ii]==CRC32_IMPL_BYTE)
+				byte_rate[is]=rate;
+			printf("%-8s %8zu %12.1f %9.2fx\n",crc32_impl_to_str(impls[ii]),sizes[is],rate,rate/byte_rate[is]);
+		}
+	}
+	printf("\n(checksum %08x)\n",sink);
+	return ret;
+}
@@ -38,6 +38,9 @@
 #include <dirent.h>
 #include <sys/types.h>
 #include "log.h"
+#include "metrics.h"
+#include "stats_shm.h"
+#include "probes.h"
 #include <unistd.h>
 
 static char *log_module="DVB: ";
@@ -317,6 +320,7 @@ void *read_card_thread_func(void* arg)
 	threadparams->card_buffer->bytes_in_write_buffer=0;
 	pthread_mutex_unlock(&threadparams->carddatamutex);
 	int throwing_packets=0;
+	int bytes_read;
 	//File descriptor for polling the DVB card
 	pfds[0].fd = threadparams->fds->fd_dvr;
 	//POLLIN : data available for read
@@ -357,7 +361,9 @@ void *read_card_thread_func(void* arg)
 			/**@todo : use a dynamic buffer ?*/
 			if(!throwing_packets)
 			{
-				throwing_packets=1; /** @todo count them*/
+				throwing_packets=1;
+				metrics_dvr_thread_full();
+				stats_shm_dvr_thread_full();
 				log_message( log_module,  MSG_INFO, "Thread trowing dvb packets\n");
 			}
 			if(threadparams->main_waiting)
@@ -368,9 +374,13 @@ void *read_card_thread_func(void* arg)
 		}
 		throwing_packets=0;
 		pthread_mutex_lock(&threadparams->carddatamutex);
-		threadparams->card_buffer->bytes_in_write_buffer+=card_read(threadparams->fds->fd_dvr,
+		bytes_read=card_read(threadparams->fds->fd_dvr,
 				threadparams->card_buffer->writing_buffer+threadparams->card_buffer->bytes_in_write_buffer,
 				threadparams->card_buffer);
+		//The latency of the datagrams is measured from the first read of the buffer
+		if(bytes_read && !threadparams->card_buffer->bytes_in_write_buffer && metrics_enabled())
+			threadparams->card_buffer->write_buffer_time=get_time();
+		threadparams->card_buffer->bytes_in_write_buffer+=bytes_read;
 
 		if(threadparams->main_waiting)
 		{
@@ -409,10 +419,16 @@ int card_read(int fd_dvr, unsigned char *dest_buffer, card_buffer_t *card_buffer
 		{
 			log_message( log_module,  MSG_WARN,"Error : DVR buffer overrun \n");
 			card_buffer->overflow_number++;
+			metrics_dvr_overflow();
+			stats_shm_dvr_overflow();
+			MUMUDVB_PROBE0(dvr_overflow);
 		} else if(errno!=EAGAIN)
 			log_message( log_module,  MSG_WARN,"Error : DVR Read error : %s \n",strerror(errno));
 		return 0;
 	}
+	metrics_dvr_read(bytes_read);
+	stats_shm_dvr_read(bytes_read);
+	MUMUDVB_PROBE1(dvr_read, bytes_read);
 	return bytes_read;
 }
 
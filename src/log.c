@@ -40,6 +40,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 
 #include "mumudvb.h"
@@ -65,10 +67,14 @@ log_params_t log_params={
 		.log_header=NULL,
 		.log_file=NULL,
 		.log_flush_interval = -1,
+		.log_async = 1,
+		.log_rate_limit = DEFAULT_LOG_RATE_LIMIT,
 };
 
 static char *log_module="Logs: ";
 
+static void log_header_compile(void);
+
 /** Initialize Rewrite variables*/
 void init_stats_v(stats_infos_t *stats_p)
 {
@@ -171,12 +177,23 @@ int read_logging_configuration(stats_infos_t *stats_infos, char *substring)
 			return -1;
 		}
 		sprintf(log_params.log_header,"%s",substring);
+		log_header_compile();
 	}
 	else if (!strcmp (substring, "log_flush_interval"))
 	{
 		substring = strtok (NULL, delimiteurs);
 		log_params.log_flush_interval = atof (substring);
 	}
+	else if (!strcmp (substring, "log_async"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		log_params.log_async = atoi (substring);
+	}
+	else if (!strcmp (substring, "log_rate_limit"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		log_params.log_rate_limit = atoi (substring);
+	}
 	else
 		return 0;
 	return 1;
@@ -207,22 +224,480 @@ char *priorities(int type)
 }
 
 
+/** @brief Flush and reopen the log file */
+static void log_reopen_file(void)
+{
+	if (((log_params.log_type & LOGGING_FILE) == LOGGING_FILE) && log_params.log_file)
+	{
+		fflush(log_params.log_file);
+		log_params.log_file=freopen(log_params.log_file_path,"a",log_params.log_file);
+	}
+}
+
+
+/* ================= ASYNCHRONOUS LOGGING ======================*/
+/* log_message is called by the threads which stream, for example for the warnings about the
+ * DVR which come in bursts. It formats the message in a buffer of the thread with the header
+ * compiled once (no allocation), and puts it in a lock-free queue. The writer thread writes
+ * it to the console, the file or syslog.
+ * Without the writer (before log_thread_start, with log_async=0), for the messages too long for
+ * the queue or if the queue is full, the message is written directly.
+ *
+ * The warnings and errors of a same call site (same format string) are limited to
+ * log_rate_limit per second, the writer reports the number of messages suppressed.
+ */
+
+/** Maximum length of a message going through the queue (header included) */
+#define LOG_MESSAGE_LEN 512
+/** Number of messages in the queue, power of 2 */
+#define LOG_QUEUE_SIZE 1024
+/** Maximum length of the header template and number of its parts */
+#define LOG_HEADER_LEN 256
+#define LOG_HEADER_TOKENS 32
+/** Number of call sites followed by the rate limitation, power of 2 */
+#define LOG_SITES 512
+
+enum
+{
+	LOG_TOKEN_TEXT,
+	LOG_TOKEN_PRIORITY,
+	LOG_TOKEN_MODULE,
+	LOG_TOKEN_TIMEEPOCH,
+	LOG_TOKEN_DATE,
+	LOG_TOKEN_PID,
+};
+
+/** @brief A part of the header : a template or some text */
+typedef struct log_token_t{
+	int type;
+	const char *text;
+	int len;
+}log_token_t;
+
+/** @brief A message in the queue, the sequence tells if it is free or written */
+typedef struct log_slot_t{
+	uint64_t seq;
+	int type;
+	char text[LOG_MESSAGE_LEN];
+}log_slot_t;
+
+/** @brief A call site for the rate limitation */
+typedef struct log_site_t{
+	const char *format;
+	char *module;
+	int type;
+	/** Second of the current window, messages in it and suppressed since the last report */
+	time_t window;
+	int count;
+	int suppressed;
+}log_site_t;
+
+static char log_header_text[LOG_HEADER_LEN];
+static log_token_t log_header_tokens[LOG_HEADER_TOKENS];
+static int log_header_num_tokens=-1;
+static int log_pid;
+
+static log_slot_t log_queue[LOG_QUEUE_SIZE];
+static uint64_t log_queue_head=0;
+static uint64_t log_queue_tail=0;
+static int log_queue_initialised=0;
+static log_site_t log_sites[LOG_SITES];
+
+static pthread_t log_thread;
+static sem_t log_sem;
+static int log_thread_running=0;
+static int log_thread_shutdown=0;
+/** The log file has to be reopened (SIGHUP), done by the writer when it runs */
+static int log_reopen=0;
+
+/** The buffer of each thread for the formatting */
+static __thread char log_buffer[LOG_MESSAGE_LEN];
+static __thread time_t log_date_time=0;
+static __thread char log_date_string[40];
+
+/** @brief Compile the header template in a list of tokens
+ * Called when the header is set, before the threads are started
+ */
+static void log_header_compile(void)
+{
+	static const struct { const char *name; int type; } templates[]={
+			{"%priority", LOG_TOKEN_PRIORITY},
+			{"%module", LOG_TOKEN_MODULE},
+			{"%timeepoch", LOG_TOKEN_TIMEEPOCH},
+			{"%date", LOG_TOKEN_DATE},
+			{"%pid", LOG_TOKEN_PID},
+	};
+	const char *pos;
+	int i,num=0,len;
+
+	snprintf(log_header_text, LOG_HEADER_LEN, "%s", log_params.log_header?log_params.log_header:DEFAULT_LOG_HEADER);
+	log_pid=getpid();
+	pos=log_header_text;
+	while(*pos && num<LOG_HEADER_TOKENS)
+	{
+		for(i=0;i<(int)(sizeof(templates)/sizeof(templates[0]));i++)
+		{
+			len=strlen(templates[i].name);
+			if(!strncmp(pos, templates[i].name, len))
+				break;
+		}
+		if(i<(int)(sizeof(templates)/sizeof(templates[0])))
+		{
+			log_header_tokens[num++]=(log_token_t){.type=templates[i].type, .text=NULL, .len=0};
+			pos+=len;
+			continue;
+		}
+		//Some text until the next template
+		len=1;
+		while(pos[len] && pos[len]!='%')
+			len++;
+		if(num && log_header_tokens[num-1].type==LOG_TOKEN_TEXT && log_header_tokens[num-1].text+log_header_tokens[num-1].len==pos)
+			log_header_tokens[num-1].len+=len;
+		else
+			log_header_tokens[num++]=(log_token_t){.type=LOG_TOKEN_TEXT, .text=pos, .len=len};
+		pos+=len;
+	}
+	log_header_num_tokens=num;
+}
+
+/** @brief Append to the buffer, what doesn't fit is counted but not written */
+static void log_append(char *buf, int size, int *pos, const char *text, int len)
+{
+	if(*pos<size-1)
+		memcpy(buf+*pos, text, (*pos+len<size-1)?len:size-1-*pos);
+	*pos+=len;
+}
+
+/** @brief Format a message with its header
+ * @return the length of the message, if it is bigger than size-1 the message is truncated
+ */
+static int log_format(char *buf, int size, char *module, int type, const char *psz_format, va_list args)
+{
+	char number[24];
+	const char *text;
+	time_t actual_time;
+	int i,pos=0,len;
+
+	if(log_header_num_tokens<0)
+		log_header_compile();
+	for(i=0;i<log_header_num_tokens;i++)
+	{
+		text=number;
+		switch(log_header_tokens[i].type)
+		{
+		case LOG_TOKEN_TEXT:
+			text=log_header_tokens[i].text;
+			len=log_header_tokens[i].len;
+			break;
+		case LOG_TOKEN_PRIORITY:
+			text=priorities(type);
+			len=strlen(text);
+			break;
+		case LOG_TOKEN_MODULE:
+			text=module?module:"";
+			len=strlen(text);
+			break;
+		case LOG_TOKEN_TIMEEPOCH:
+			len=sprintf(number, "%jd", (intmax_t)time(NULL));
+			break;
+		case LOG_TOKEN_DATE:
+			//The date is computed once per second and per thread
+			actual_time=time(NULL);
+			if(actual_time!=log_date_time)
+			{
+				struct tm tm;
+				asctime_r(localtime_r(&actual_time, &tm), log_date_string);
+				log_date_string[strlen(log_date_string)-1]='\0'; //In order to remove the final '\n' but by asctime
+				log_date_time=actual_time;
+			}
+			text=log_date_string;
+			len=strlen(text);
+			break;
+		case LOG_TOKEN_PID:
+			len=sprintf(number, "%d", log_pid);
+			break;
+		default:
+			len=0;
+			break;
+		}
+		log_append(buf, size, &pos, text, len);
+	}
+	len=vsnprintf(pos<size?buf+pos:NULL, pos<size?size-pos:0, psz_format, args);
+	if(len<0)
+		len=0;
+	pos+=len;
+	//If there is no \n at the end of the message we add it (if the message is truncated, we count it)
+	if(pos>=size || !len || buf[pos-1]!='\n')
+		log_append(buf, size, &pos, "\n", 1);
+	buf[(pos<size)?pos:size-1]='\0';
+	return pos;
+}
+
+/** @brief Write a formatted message to the log destinations */
+static void log_write(int type, const char *text)
+{
+	int priority=0;
+
+	if ( log_params.log_type & LOGGING_FILE)
+		fprintf(log_params.log_file,"%s",text);
+	if((log_params.log_type & LOGGING_SYSLOG) && (log_params.syslog_initialised))
+	{
+		//what is the priority ?
+		switch(type)
+		{
+		case MSG_ERROR:
+			priority|=LOG_ERR;
+			break;
+		case MSG_WARN:
+			priority|=LOG_WARNING;
+			break;
+		case MSG_INFO:
+			priority|=LOG_INFO;
+			break;
+		case MSG_DETAIL:
+			priority|=LOG_NOTICE;
+			break;
+		case MSG_DEBUG:
+		case MSG_FLOOD:
+			priority|=LOG_DEBUG;
+			break;
+		default:
+			priority=LOG_USER;
+			break;
+		}
+		syslog (priority,"%s",text);
+	}
+	if((log_params.log_type == LOGGING_UNDEFINED) ||
+			(log_params.log_type & LOGGING_CONSOLE) ||
+			((log_params.log_type & LOGGING_SYSLOG) && (log_params.syslog_initialised==0)))
+		fprintf(stderr,"%s",text);
+}
+
+static void log_queue_init(void)
+{
+	int i;
+	for(i=0;i<LOG_QUEUE_SIZE;i++)
+		log_queue[i].seq=i;
+	log_queue_head=log_queue_tail=0;
+	log_queue_initialised=1;
+}
+
+/** @brief Put a message in the queue, any thread can call it
+ * The slot is reserved by moving the tail, the message is copied and the slot is given to
+ * the writer with its sequence.
+ * @return 0 if ok, -1 if the queue is full
+ */
+static int log_queue_push(int type, const char *text, int len)
+{
+	log_slot_t *slot;
+	uint64_t pos,seq;
+
+	pos=__atomic_load_n(&log_queue_tail, __ATOMIC_RELAXED);
+	while(1)
+	{
+		slot=&log_queue[pos&(LOG_QUEUE_SIZE-1)];
+		seq=__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if(seq==pos)
+		{
+			if(__atomic_compare_exchange_n(&log_queue_tail, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if((int64_t)(seq-pos)<0)
+			return -1;
+		else
+			pos=__atomic_load_n(&log_queue_tail, __ATOMIC_RELAXED);
+	}
+	slot->type=type;
+	memcpy(slot->text, text, len+1);
+	__atomic_store_n(&slot->seq, pos+1, __ATOMIC_RELEASE);
+	sem_post(&log_sem);
+	return 0;
+}
+
+/** @brief Write the messages of the queue, only one thread at once
+ * @return the number of messages written
+ */
+static int log_queue_drain(void)
+{
+	log_slot_t *slot;
+	int num=0;
+
+	while(1)
+	{
+		slot=&log_queue[log_queue_head&(LOG_QUEUE_SIZE-1)];
+		if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE)!=log_queue_head+1)
+			break;
+		log_write(slot->type, slot->text);
+		__atomic_store_n(&slot->seq, log_queue_head+LOG_QUEUE_SIZE, __ATOMIC_RELEASE);
+		log_queue_head++;
+		num++;
+	}
+	return num;
+}
+
+/** @brief Count a message of a call site
+ * The counters are approximate if several threads log from the same call site at once
+ * @return 1 if the message has to be suppressed
+ */
+static int log_rate_limited(char *module, int type, const char *psz_format)
+{
+	log_site_t *site;
+	const char *expected;
+	time_t now;
+	int i,h;
+
+	h=(int)(((uintptr_t)psz_format>>3)&(LOG_SITES-1));
+	for(i=0;i<LOG_SITES;i++)
+	{
+		site=&log_sites[(h+i)&(LOG_SITES-1)];
+		expected=__atomic_load_n(&site->format, __ATOMIC_ACQUIRE);
+		if(expected==psz_format)
+			break;
+		if(expected==NULL)
+		{
+			site->module=module;
+			site->type=type;
+			if(__atomic_compare_exchange_n(&site->format, &expected, psz_format, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE) ||
+					expected==psz_format)
+				break;
+		}
+	}
+	if(i==LOG_SITES)
+		return 0; //Too many call sites, this one is not limited
+	now=time(NULL);
+	if(__atomic_load_n(&site->window, __ATOMIC_RELAXED)!=now)
+	{
+		__atomic_store_n(&site->window, now, __ATOMIC_RELAXED);
+		__atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+	}
+	if(__atomic_add_fetch(&site->count, 1, __ATOMIC_RELAXED)<=log_params.log_rate_limit)
+		return 0;
+	__atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+/** @brief Write a message built by the logging itself, in the thread which calls it */
+static void log_internal(char *module, int type, const char *psz_format, ...)
+{
+	char buf[LOG_MESSAGE_LEN];
+	va_list args;
+
+	va_start(args, psz_format);
+	log_format(buf, LOG_MESSAGE_LEN, module, type, psz_format, args);
+	va_end(args);
+	log_write(type, buf);
+}
+
+/** @brief Report the messages suppressed by the rate limitation */
+static void log_report_suppressed(void)
+{
+	char format[64];
+	int i,num,len;
+
+	for(i=0;i<LOG_SITES;i++)
+	{
+		if(__atomic_load_n(&log_sites[i].format, __ATOMIC_ACQUIRE)==NULL ||
+				!__atomic_load_n(&log_sites[i].suppressed, __ATOMIC_RELAXED))
+			continue;
+		num=__atomic_exchange_n(&log_sites[i].suppressed, 0, __ATOMIC_RELAXED);
+		snprintf(format, sizeof(format), "%s", log_sites[i].format);
+		len=strlen(format);
+		while(len && format[len-1]=='\n')
+			format[--len]='\0';
+		log_internal(log_sites[i].module, log_sites[i].type, "%d messages like \"%s\" suppressed\n", num, format);
+	}
+}
+
+/** @brief The writer thread */
+static void *log_thread_func(void *arg)
+{
+	struct timespec ts;
+	time_t last_report=0;
+	(void) arg;
+
+	while(1)
+	{
+		log_queue_drain();
+		if(__atomic_exchange_n(&log_reopen, 0, __ATOMIC_ACQUIRE))
+			log_reopen_file();
+		if(time(NULL)!=last_report)
+		{
+			last_report=time(NULL);
+			log_report_suppressed();
+		}
+		if(__atomic_load_n(&log_thread_shutdown, __ATOMIC_ACQUIRE))
+			break;
+		//Woken by the messages, or every second for the reports
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec+=1;
+		sem_timedwait(&log_sem, &ts);
+	}
+	log_queue_drain();
+	log_report_suppressed();
+	return NULL;
+}
+
+/** @brief Start the writer thread
+ * Called after the configuration is read and MuMuDVB is daemonized
+ */
+int log_thread_start(void)
+{
+	//The pid changes when we daemonize
+	log_header_compile();
+	if(!log_params.log_async || log_thread_running)
+		return 0;
+	if(!log_queue_initialised)
+		log_queue_init();
+	if(sem_init(&log_sem, 0, 0))
+	{
+		log_message( log_module, MSG_WARN,"Cannot create the semaphore of the log writer : %s\n", strerror(errno));
+		return -1;
+	}
+	log_thread_shutdown=0;
+	if(pthread_create(&log_thread, NULL, log_thread_func, NULL))
+	{
+		log_message( log_module, MSG_WARN,"Cannot start the log writer : %s\n", strerror(errno));
+		sem_destroy(&log_sem);
+		return -1;
+	}
+	__atomic_store_n(&log_thread_running, 1, __ATOMIC_RELEASE);
+	atexit(log_thread_stop);
+	log_message( log_module, MSG_DEBUG,"Log writer started\n");
+	return 0;
+}
+
+/** @brief Stop the writer thread, the messages in the queue are written
+ * The next messages are written directly
+ */
+void log_thread_stop(void)
+{
+	if(!__atomic_exchange_n(&log_thread_running, 0, __ATOMIC_ACQ_REL))
+		return;
+	__atomic_store_n(&log_thread_shutdown, 1, __ATOMIC_RELEASE);
+	sem_post(&log_sem);
+	pthread_join(log_thread, NULL);
+	//Messages put just before the stop
+	log_queue_drain();
+	sem_destroy(&log_sem);
+}
+
 /**
  * @brief Sync_log for logrotate
  * This function is called when a sighup is received. This function flushes the log and reopen the logfile
- *
+ * When the writer thread runs, it does it
  *
  */
 void sync_logs()
 {
-	if (((log_params.log_type & LOGGING_FILE) == LOGGING_FILE) && log_params.log_file)
+	if(__atomic_load_n(&log_thread_running, __ATOMIC_ACQUIRE))
 	{
-		fflush(log_params.log_file);
-		log_params.log_file=freopen(log_params.log_file_path,"a",log_params.log_file);
+		__atomic_store_n(&log_reopen, 1, __ATOMIC_RELEASE);
+		sem_post(&log_sem);
 	}
+	else
+		log_reopen_file();
 }
 
-
 /**
  * @brief Print a log message
  *
@@ -234,26 +709,25 @@ void log_message( char* log_module, int type,
 		const char *psz_format, ... )
 {
 	va_list args;
-	int priority=0;
-	char *tempchar;
+	char *text=log_buffer;
 	int message_size;
-	mumu_string_t log_string;
 
 	if(type>=log_params.verbosity)
 		return;
-
-	log_string.string=NULL;
-	log_string.length=0;
+	if(type<=MSG_WARN && log_params.log_rate_limit>0 && log_rate_limited(log_module, type, psz_format))
+		return;
 
 	/*****************************************/
-	//if the log header is not initialised
-	// we do it
+	//We format the message in the buffer of the thread
 	/*****************************************/
-
-	if(log_params.log_header==NULL)
+	va_start( args, psz_format );
+	message_size=log_format(log_buffer, LOG_MESSAGE_LEN, log_module, type, psz_format, args);
+	va_end( args );
+	if(message_size>=LOG_MESSAGE_LEN)
 	{
-		log_params.log_header=malloc((strlen(DEFAULT_LOG_HEADER)+1)*sizeof(char));
-		if(log_params.log_header==NULL)
+		//Too long for the queue, we write it directly
+		text=malloc((message_size+1)*sizeof(char));
+		if(text==NULL)
 		{
 			if (log_params.log_type == LOGGING_FILE)
 				fprintf( log_params.log_file,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
@@ -261,111 +735,23 @@ void log_message( char* log_module, int type,
 				syslog (MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
 			else
 				fprintf( stderr,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
-			va_end( args );
 			set_interrupted(ERROR_MEMORY<<8);
 			return;
 		}
-		sprintf(log_params.log_header,"%s",DEFAULT_LOG_HEADER);
-
-	}
-	/*****************************************/
-	//We apply the templates to the header
-	/*****************************************/
-	mumu_string_append(&log_string, "%s",log_params.log_header);
-	log_string.string=mumu_string_replace(log_string.string,&log_string.length,1,"%priority",priorities(type));
-	if(log_module!=NULL)
-		log_string.string=mumu_string_replace(log_string.string,&log_string.length,1,"%module",log_module);
-	else
-		log_string.string=mumu_string_replace(log_string.string,&log_string.length,1,"%module","");
-
-	char timestring[40];
-	time_t actual_time;
-	actual_time=time(NULL);
-	sprintf(timestring,"%jd", (intmax_t)actual_time);
-	log_string.string=mumu_string_replace(log_string.string,&log_string.length,1,"%timeepoch",timestring);
-	asctime_r(localtime(&actual_time),timestring);
-	timestring[strlen(timestring)-1]='\0'; //In order to remove the final '\n' but by asctime
-	log_string.string=mumu_string_replace(log_string.string,&log_string.length,1,"%date",timestring);
-
-	char pidstring[10];
-	sprintf (pidstring, "%d", getpid ());
-	log_string.string=mumu_string_replace(log_string.string,&log_string.length,1,"%pid",pidstring);
-
-
-	/*****************************************/
-	//We append the log message
-	/*****************************************/
-	//The length returned by mumu_string_replace is the allocated length not the string length
-	//If we want mumu_string_append to work we need to update the length to the string length
-	log_string.length=strlen(log_string.string);
-	va_start( args, psz_format );
-	message_size=vsnprintf(NULL, 0, psz_format, args);
-	va_end( args );
-	tempchar=calloc((message_size+1),sizeof(char));
-	if(tempchar==NULL)
-	{
-		if (log_params.log_type == LOGGING_FILE)
-			fprintf( log_params.log_file,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
-		else if (log_params.log_type == LOGGING_SYSLOG)
-			syslog (MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
-		else
-			fprintf( stderr,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		va_start( args, psz_format );
+		log_format(text, message_size+1, log_module, type, psz_format, args);
 		va_end( args );
-		set_interrupted(ERROR_MEMORY<<8);
-		return;
 	}
 
-	va_start( args, psz_format );
-	vsprintf(tempchar, psz_format, args );
-	va_end( args );
-	//If there is no \n at the end of the message we add it
-	char terminator='\0';
-	if(tempchar[strlen(tempchar)-1] != '\n')
-		terminator='\n';
-	mumu_string_append(&log_string,"%s%c",tempchar,terminator);
-	free(tempchar);
-
 	/*****************************************/
-	//We "display" the log message
+	//We give the message to the writer, or "display" it
 	/*****************************************/
-	if(type<log_params.verbosity)
-	{
-		if ( log_params.log_type & LOGGING_FILE)
-			fprintf(log_params.log_file,"%s",log_string.string);
-		if((log_params.log_type & LOGGING_SYSLOG) && (log_params.syslog_initialised))
-		{
-			//what is the priority ?
-			switch(type)
-			{
-			case MSG_ERROR:
-				priority|=LOG_ERR;
-				break;
-			case MSG_WARN:
-				priority|=LOG_WARNING;
-				break;
-			case MSG_INFO:
-				priority|=LOG_INFO;
-				break;
-			case MSG_DETAIL:
-				priority|=LOG_NOTICE;
-				break;
-			case MSG_DEBUG:
-			case MSG_FLOOD:
-				priority|=LOG_DEBUG;
-				break;
-			default:
-				priority=LOG_USER;
-				break;
-			}
-			syslog (priority,"%s",log_string.string);
-		}
-		if((log_params.log_type == LOGGING_UNDEFINED) ||
-				(log_params.log_type & LOGGING_CONSOLE) ||
-				((log_params.log_type & LOGGING_SYSLOG) && (log_params.syslog_initialised==0)))
-			fprintf(stderr,"%s",log_string.string);
-	}
-	mumu_free_string(&log_string);
-
+	if(text==log_buffer && __atomic_load_n(&log_thread_running, __ATOMIC_ACQUIRE) &&
+			!log_queue_push(type, text, message_size))
+		return;
+	log_write(type, text);
+	if(text!=log_buffer)
+		free(text);
 }
 
 /**
@@ -374,7 +760,7 @@ void log_message( char* log_module, int type,
  * @param number_of_channels the number of channels
  * @param channels : the channels array
  */
-void log_streamed_channels(char *log_module,int number_of_channels, mumudvb_channel_t *channels, int multicast_ipv4,int multicast_ipv6, int unicast, int unicast_master_port, char *unicastipOut)
+void log_streamed_channels(char *log_module,int number_of_channels, mumudvb_channel_t **channels, int multicast_ipv4,int multicast_ipv6, int unicast, int unicast_master_port, char *unicastipOut)
 {
 	int curr_channel;
 	int curr_pid;
@@ -383,29 +769,29 @@ void log_streamed_channels(char *log_module,int number_of_channels, mumudvb_chan
 			(number_of_channels <= 1 ? "" : "s"));
 	for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
 	{
-		log_message( log_module,  MSG_INFO, "Channel number : %3d, name : \"%s\"  service id %d \n", curr_channel, channels[curr_channel].name, channels[curr_channel].service_id);
+		log_message( log_module,  MSG_INFO, "Channel number : %3d, name : \"%s\"  service id %d \n", curr_channel, channels[curr_channel]->name, channels[curr_channel]->service_id);
 		if(multicast_ipv4)
 		{
-			log_message( log_module,  MSG_INFO, "\tMulticast4 ip : %s:%d\n", channels[curr_channel].ip4Out, channels[curr_channel].portOut);
+			log_message( log_module,  MSG_INFO, "\tMulticast4 ip : %s:%d\n", channels[curr_channel]->desc->ip4Out, channels[curr_channel]->portOut);
 		}
 		if(multicast_ipv6)
 		{
-			log_message( log_module,  MSG_INFO, "\tMulticast6 ip : [%s]:%d\n", channels[curr_channel].ip6Out, channels[curr_channel].portOut);
+			log_message( log_module,  MSG_INFO, "\tMulticast6 ip : [%s]:%d\n", channels[curr_channel]->desc->ip6Out, channels[curr_channel]->portOut);
 		}
 		if(unicast)
 		{
 			log_message( log_module,  MSG_INFO, "\tUnicast : Channel accessible via the master connection, %s:%d\n",unicastipOut, unicast_master_port);
-			if(channels[curr_channel].unicast_port)
-				log_message( log_module,  MSG_INFO, "\tUnicast : Channel accessible directly via %s:%d\n",unicastipOut, channels[curr_channel].unicast_port);
+			if(channels[curr_channel]->unicast_port)
+				log_message( log_module,  MSG_INFO, "\tUnicast : Channel accessible directly via %s:%d\n",unicastipOut, channels[curr_channel]->unicast_port);
 		}
 		mumu_string_t string=EMPTY_STRING;
 		char lang[5];
 		if(set_interrupted(mumu_string_append(&string, "        pids : ")))return;
-		for (curr_pid = 0; curr_pid < channels[curr_channel].num_pids; curr_pid++)
+		for (curr_pid = 0; curr_pid < channels[curr_channel]->num_pids; curr_pid++)
 		{
-			strncpy(lang+1,channels[curr_channel].pids_language[curr_pid],4);
+			strncpy(lang+1,channels[curr_channel]->desc->pids_language[curr_pid],4);
 			lang[0]=(lang[1]=='-') ? '\0': ' ';
-			if(set_interrupted(mumu_string_append(&string, "%d (%s%s), ", channels[curr_channel].pids[curr_pid], pid_type_to_str(channels[curr_channel].pids_type[curr_pid]), lang)))
+			if(set_interrupted(mumu_string_append(&string, "%d (%s%s), ", channels[curr_channel]->pids[curr_pid], pid_type_to_str(channels[curr_channel]->desc->pids_type[curr_pid]), lang)))
 				return;
 		}
 		log_message( log_module, MSG_DETAIL,"%s\n",string.string);
@@ -446,7 +832,7 @@ void log_pids(char *log_module, mumudvb_channel_t *channel, int curr_channel)
  */
 void
 gen_file_streamed_channels (char *file_streamed_channels_filename, char *file_not_streamed_channels_filename,
-		int number_of_channels, mumudvb_channel_t *channels)
+		int number_of_channels, mumudvb_channel_t **channels)
 {
 	/**todo : adapt it for unicast (json ?) */
 	FILE *file_streamed_channels;
@@ -474,18 +860,18 @@ gen_file_streamed_channels (char *file_streamed_channels_filename, char *file_no
 
 	for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
 		//We store the old to be sure that we store only channels over the minimum packets limit
-		if (channels[curr_channel].streamed_channel)
+		if (channels[curr_channel]->streamed_channel)
 		{
-			fprintf (file_streamed_channels, "%s:%d:%s", channels[curr_channel].ip4Out, channels[curr_channel].portOut, channels[curr_channel].name);
-			if (channels[curr_channel].scrambled_channel == FULLY_UNSCRAMBLED)
+			fprintf (file_streamed_channels, "%s:%d:%s", channels[curr_channel]->desc->ip4Out, channels[curr_channel]->portOut, channels[curr_channel]->name);
+			if (channels[curr_channel]->scrambled_channel == FULLY_UNSCRAMBLED)
 				fprintf (file_streamed_channels, ":FullyUnscrambled\n");
-			else if (channels[curr_channel].scrambled_channel == PARTIALLY_UNSCRAMBLED)
+			else if (channels[curr_channel]->scrambled_channel == PARTIALLY_UNSCRAMBLED)
 				fprintf (file_streamed_channels, ":PartiallyUnscrambled\n");
 			else //HIGHLY_SCRAMBLED
 				fprintf (file_streamed_channels, ":HighlyScrambled\n");
 		}
 		else
-			fprintf (file_not_streamed_channels, "%s:%d:%s\n", channels[curr_channel].ip4Out, channels[curr_channel].portOut, channels[curr_channel].name);
+			fprintf (file_not_streamed_channels, "%s:%d:%s\n", channels[curr_channel]->desc->ip4Out, channels[curr_channel]->portOut, channels[curr_channel]->name);
 	fclose (file_streamed_channels);
 	fclose (file_not_streamed_channels);
 
@@ -958,8 +1344,8 @@ void show_traffic( char *log_module, double now, int show_traffic_interval, mumu
 		for (int curr_channel = 0; curr_channel < chan_p->number_of_channels; curr_channel++)
 		{
 			log_message( log_module,  MSG_INFO, "Traffic :  %.2f kb/s \t  for channel \"%s\"\n",
-					chan_p->channels[curr_channel].traffic*8,
-					chan_p->channels[curr_channel].name);
+					chan_p->channels[curr_channel]->traffic*8,
+					chan_p->channels[curr_channel]->name);
 		}
 	}
 }
@@ -76,6 +76,8 @@ typedef struct stats_infos_t{
 #define LOGGING_FILE            4
 
 #define DEFAULT_LOG_HEADER "%priority:  %module "
+/** Warnings and errors per second and per call site, the next ones are suppressed */
+#define DEFAULT_LOG_RATE_LIMIT 20
 
 typedef struct log_params_t{
   /** the verbosity level for log messages */
@@ -94,6 +96,10 @@ typedef struct log_params_t{
   char *log_header;
   /**  Flushing interval */
   float log_flush_interval;
+  /** Are the messages written by the writer thread ? */
+  int log_async;
+  /** Maximum number of warnings and errors per second from a call site, 0 : no limit */
+  int log_rate_limit;
 }log_params_t;
 
 typedef struct flag_descr_t
@@ -108,8 +114,8 @@ void init_stats_v(stats_infos_t *stats_p);
 void print_info ();
 void usage (char *name);
 void log_message( char* log_module, int , const char *, ... ) __attribute__ ((format (printf, 3, 4)));
-void gen_file_streamed_channels (char *nom_fich_chaines_diff, char *nom_fich_chaines_non_diff, int nb_flux, mumudvb_channel_t *channels);
-void log_streamed_channels(char *log_module,int number_of_channels, mumudvb_channel_t *channels, int multicast_ipv4, int multicast_ipv6, int unicast, int unicast_master_port, char *unicastipOut);
+void gen_file_streamed_channels (char *nom_fich_chaines_diff, char *nom_fich_chaines_non_diff, int nb_flux, mumudvb_channel_t **channels);
+void log_streamed_channels(char *log_module,int number_of_channels, mumudvb_channel_t **channels, int multicast_ipv4, int multicast_ipv6, int unicast, int unicast_master_port, char *unicastipOut);
 char *ca_sys_id_to_str(int id);
 void display_service_type(int type, int loglevel,char *log_module);
 char *pid_type_to_str(int type);
@@ -121,6 +127,8 @@ char *liben50221_error_to_str_descr(int error);
 void log_pids(char *log_module, mumudvb_channel_t *channel, int curr_channel);
 int read_logging_configuration(stats_infos_t *stats_infos, char *substring);
 void sync_logs();
+int log_thread_start(void);
+void log_thread_stop(void);
 char *running_status_to_str(int running_status);
 int convert_en300468_string(char *string, int max_len);
 void show_CA_identifier_descriptor(unsigned char *buf);
@@ -0,0 +1,433 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the performance metrics
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Performance metrics, served on /metrics in the Prometheus text format
+ *
+ * The counters of the channels and of the clients are the ones already kept for the monitoring.
+ * The histograms (size of the DVR reads, time between the DVR read and the sending of a datagram,
+ * time spent in each stage) are kept per thread : each thread gets its buckets with its first measure,
+ * and it is the only one writing them. The page adds the buckets of all the threads.
+ *
+ * The time of the read goes with the data : with the buffer of the thread reading the card, then
+ * with the datagram of the channel (datagram_start, for its first packet). The histogram of a channel
+ * is in the channel, written by the thread sending it. The descrambled channels are measured from the
+ * entry of the packets in the descrambler ring.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#include "metrics.h"
+#include "analyzer.h"
+#include "unicast_http.h"
+#include "errors.h"
+#include "log.h"
+#ifdef ENABLE_SCAM_DESCRAMBLER_SUPPORT
+#include <dvbcsa/dvbcsa.h>
+#endif
+
+static char *log_module="Metrics: ";
+
+/** Bounds of the latency buckets (us) */
+static const uint64_t metrics_latency_bounds[METRICS_LATENCY_BUCKETS]={100,250,500,1000,2500,5000,10000,25000,50000,100000,250000,500000,1000000};
+/** Bounds of the DVR read size buckets (packets) */
+static const uint64_t metrics_read_bounds[METRICS_READ_BUCKETS]={1,2,4,8,16,32,64,128,256,512,1024};
+
+static int metrics_on=0;
+/** The buckets of the threads, the list only grows : the buckets of a thread stopped are kept, they are
+ * not freed since the thread reading the card is not joined when MuMuDVB stops */
+static metrics_thread_t *metrics_threads=NULL;
+static pthread_mutex_t metrics_threads_lock=PTHREAD_MUTEX_INITIALIZER;
+static __thread metrics_thread_t *metrics_self=NULL;
+/** Time of the DVR read processed by the main thread, and when it started to process it (us, get_time clock) */
+static uint64_t metrics_last_read=0;
+static uint64_t metrics_last_process=0;
+/** Counters written by one thread : the DVR errors by the thread reading the card, the CC errors by the main thread */
+static uint64_t metrics_overflows=0;
+static uint64_t metrics_thread_full=0;
+
+
+/** @brief Enable the measures, done when the HTTP unicast is used */
+void metrics_enable(int enabled)
+{
+	metrics_on=enabled;
+}
+
+int metrics_enabled(void)
+{
+	return metrics_on;
+}
+
+/** @brief The buckets of the calling thread, allocated with its first measure */
+static metrics_thread_t *metrics_thread(void)
+{
+	if(metrics_self!=NULL)
+		return metrics_self;
+	metrics_self=calloc(1,sizeof(metrics_thread_t));
+	if(metrics_self==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		return NULL;
+	}
+	pthread_mutex_lock(&metrics_threads_lock);
+	metrics_self->next=metrics_threads;
+	metrics_threads=metrics_self;
+	pthread_mutex_unlock(&metrics_threads_lock);
+	return metrics_self;
+}
+
+/** @brief Add a value to a counter written only by this thread, it can be read by the others */
+static inline void metrics_add(uint64_t *counter, uint64_t value)
+{
+	__atomic_store_n(counter, *counter+value, __ATOMIC_RELAXED);
+}
+
+/** @brief Add a measure in a histogram */
+static void metrics_observe(uint64_t *buckets, uint64_t *sum, const uint64_t *bounds, int num_bounds, uint64_t value)
+{
+	int i;
+	for(i=0;i<num_bounds && value>bounds[i];i++);
+	metrics_add(&buckets[i], 1);
+	metrics_add(sum, value);
+}
+
+/** @brief A read from the DVR, with the thread reading the card */
+void metrics_dvr_read(int bytes_read)
+{
+	metrics_thread_t *self;
+	if(!metrics_on || bytes_read<=0 || (self=metrics_thread())==NULL)
+		return;
+	metrics_observe(self->read_size, &self->read_size_sum, metrics_read_bounds, METRICS_READ_BUCKETS, bytes_read/TS_PACKET_SIZE);
+}
+
+/** @brief The DVR buffer overflowed */
+void metrics_dvr_overflow(void)
+{
+	metrics_add(&metrics_overflows, 1);
+}
+
+/** @brief The buffer of the thread reading the card is full, the data waits in the DVR */
+void metrics_dvr_thread_full(void)
+{
+	metrics_add(&metrics_thread_full, 1);
+}
+
+/** @brief Tell the main thread when the data it processes was read, it processes it now */
+void metrics_set_read_time(uint64_t read_time)
+{
+	metrics_last_read=read_time;
+	metrics_last_process=read_time;
+}
+
+/** @brief The main thread takes the buffer of the thread reading the card
+ * @param read_time when the first data of the buffer was read, 0 if not measured
+ */
+void metrics_thread_buffer_taken(uint64_t read_time)
+{
+	uint64_t now;
+	metrics_last_read=metrics_last_process=read_time;
+	if(!metrics_on || !read_time)
+		return;
+	now=get_time();
+	metrics_last_process=now;
+	metrics_stage(METRICS_STAGE_THREAD_BUFFER, read_time, now);
+}
+
+/** @brief When the data processed by the main thread was read, 0 if the metrics are not enabled */
+uint64_t metrics_read_time(void)
+{
+	return metrics_last_read;
+}
+
+/** @brief When the main thread started to process its data */
+uint64_t metrics_process_time(void)
+{
+	return metrics_last_process;
+}
+
+/** @brief The data spent the time between start and end in a stage (METRICS_STAGE_*) */
+void metrics_stage(int stage, uint64_t start, uint64_t end)
+{
+	metrics_thread_t *self;
+	if(!metrics_on || (self=metrics_thread())==NULL)
+		return;
+	metrics_observe(self->stage[stage], &self->stage_sum[stage], metrics_latency_bounds, METRICS_LATENCY_BUCKETS, end>start?end-start:0);
+}
+
+/** @brief The datagram of a channel is sent, called by the thread sending the channel
+ *
+ * Nothing is measured if the read time of its first packet is unknown (datagram_start is 0).
+ */
+void metrics_datagram_sent(mumudvb_channel_t *channel)
+{
+	metrics_thread_t *self;
+	uint64_t now,latency;
+	if(!metrics_on || !channel->datagram_start || (self=metrics_thread())==NULL)
+		return;
+	now=get_time();
+	latency=now>channel->datagram_start?now-channel->datagram_start:0;
+	metrics_observe(self->latency, &self->latency_sum, metrics_latency_bounds, METRICS_LATENCY_BUCKETS, latency);
+	metrics_observe(channel->datagram->latency, &channel->datagram->latency_sum, metrics_latency_bounds, METRICS_LATENCY_BUCKETS, latency);
+	if(channel->datagram_process)
+		metrics_observe(self->stage[METRICS_STAGE_CHANNEL_BUFFER], &self->stage_sum[METRICS_STAGE_CHANNEL_BUFFER], metrics_latency_bounds, METRICS_LATENCY_BUCKETS,
+				now>channel->datagram_process?now-channel->datagram_process:0);
+}
+
+/** @brief Write the series of a histogram, the buckets are not cumulative
+ * @param labels the labels of the series, "" if none
+ * @param scale the value of one unit of the bounds in the unit of the metric
+ */
+static void metrics_render_series(struct unicast_reply *reply, const char *name, const char *labels, const uint64_t *bounds, int num_bounds, double scale, uint64_t *buckets, uint64_t sum)
+{
+	const char *sep=labels[0]?",":"";
+	uint64_t count=0;
+	int i;
+
+	for(i=0;i<num_bounds;i++)
+	{
+		count+=buckets[i];
+		unicast_reply_write(reply, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep, bounds[i]*scale, (unsigned long long)count);
+	}
+	count+=buckets[num_bounds];
+	unicast_reply_write(reply, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long)count);
+	if(labels[0])
+		unicast_reply_write(reply, "%s_sum{%s} %g\n%s_count{%s} %llu\n", name, labels, sum*scale, name, labels, (unsigned long long)count);
+	else
+		unicast_reply_write(reply, "%s_sum %g\n%s_count %llu\n", name, sum*scale, name, (unsigned long long)count);
+}
+
+/** @brief Write a histogram without labels */
+static void metrics_render_histogram(struct unicast_reply *reply, const char *name, const char *help, const uint64_t *bounds, int num_bounds, double scale, uint64_t *buckets, uint64_t sum)
+{
+	unicast_reply_write(reply, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+	metrics_render_series(reply, name, "", bounds, num_bounds, scale, buckets, sum);
+}
+
+/** @brief Escape a label value (backslash, double quote and new line) */
+static void metrics_label(char *dst, int dst_len, const char *src)
+{
+	int len=0;
+	for(;*src && len<dst_len-2;src++)
+	{
+		if(*src=='\\' || *src=='"' || *src=='\n')
+		{
+			dst[len++]='\\';
+			dst[len++]=(*src=='\n')?'n':*src;
+		}
+		else
+			dst[len++]=*src;
+	}
+	dst[len]='\0';
+}
+
+/** @brief Write a metric header */
+static void metrics_header(struct unicast_reply *reply, const char *name, const char *type, const char *help)
+{
+	unicast_reply_write(reply, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/** @brief The labels of a channel */
+static char *metrics_channel_labels(char *labels, int len, mumudvb_channel_t *channel)
+{
+	char name[MAX_NAME_LEN*2];
+	metrics_label(name, sizeof(name), channel->name);
+	snprintf(labels, len, "channel=\"%s\",sid=\"%d\"", name, channel->service_id);
+	return labels;
+}
+
+/** @brief Continuity errors of the PIDs of a channel, counted by the analyzer (it has to be running) */
+static uint64_t metrics_channel_cc_errors(mumudvb_channel_t *channel)
+{
+	uint64_t errors=0;
+	int i,pid;
+	for(i=0;i<channel->num_pids;i++)
+	{
+		if(channel->pids[i]==8192)
+		{
+			errors=0;
+			for(pid=0;pid<8192;pid++)
+				errors+=__atomic_load_n(&analyzer_pids[pid].cc_errors, __ATOMIC_RELAXED);
+			return errors;
+		}
+		if(channel->pids[i]>=0 && channel->pids[i]<8192)
+			errors+=__atomic_load_n(&analyzer_pids[channel->pids[i]].cc_errors, __ATOMIC_RELAXED);
+	}
+	return errors;
+}
+
+/** @brief Write the metrics
+ *
+ * Called by the monitor thread for the snapshot, or by the main thread if there is none yet.
+ */
+void metrics_render(struct unicast_reply *reply, unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels)
+{
+	static const char *stage_names[METRICS_STAGES]={"thread_buffer","channel_buffer","descrambler","unicast_queue"};
+	uint64_t latency[METRICS_LATENCY_BUCKETS+1],read_size[METRICS_READ_BUCKETS+1];
+	uint64_t stage[METRICS_STAGES][METRICS_LATENCY_BUCKETS+1],stage_sum[METRICS_STAGES];
+	uint64_t latency_sum=0,read_size_sum=0;
+	char labels[MAX_NAME_LEN*2+32];
+	char name[MAX_NAME_LEN*2];
+	char ip[INET_ADDRSTRLEN];
+	metrics_thread_t *thread;
+	unicast_client_t *client;
+	int curr_channel,i,s;
+
+	metrics_header(reply, "mumudvb_channel_streamed", "gauge", "The channel is streamed (1) or down (0)");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		unicast_reply_write(reply, "mumudvb_channel_streamed{%s} %d\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), channels[curr_channel]->streamed_channel?1:0);
+	metrics_header(reply, "mumudvb_channel_packets_total", "counter", "TS packets sent");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+	{
+		pthread_mutex_lock(&channels[curr_channel]->stats_lock);
+		unicast_reply_write(reply, "mumudvb_channel_packets_total{%s} %llu\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), (unsigned long long)channels[curr_channel]->sent_packets);
+		pthread_mutex_unlock(&channels[curr_channel]->stats_lock);
+	}
+	metrics_header(reply, "mumudvb_channel_bytes_total", "counter", "TS bytes sent");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+	{
+		pthread_mutex_lock(&channels[curr_channel]->stats_lock);
+		unicast_reply_write(reply, "mumudvb_channel_bytes_total{%s} %llu\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), (unsigned long long)channels[curr_channel]->sent_bytes);
+		pthread_mutex_unlock(&channels[curr_channel]->stats_lock);
+	}
+	metrics_header(reply, "mumudvb_channel_dropped_packets_total", "counter", "TS packets dropped by the queues of the HTTP clients");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		unicast_reply_write(reply, "mumudvb_channel_dropped_packets_total{%s} %llu\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), (unsigned long long)channels[curr_channel]->unicast_dropped_packets);
+	//Without the analyzer the continuity is not checked, a series always at 0 would be wrong
+	if(analyzer_pids!=NULL)
+	{
+		metrics_header(reply, "mumudvb_channel_cc_errors_total", "counter", "Continuity errors on the PIDs of the channel (with check_cc, pid_analyzer or stats_shm)");
+		for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+			unicast_reply_write(reply, "mumudvb_channel_cc_errors_total{%s} %llu\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), (unsigned long long)metrics_channel_cc_errors(channels[curr_channel]));
+	}
+	metrics_header(reply, "mumudvb_channel_scrambled_ratio", "gauge", "Ratio of scrambled packets");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		unicast_reply_write(reply, "mumudvb_channel_scrambled_ratio{%s} %g\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), channels[curr_channel]->ratio_scrambled/100.0);
+	metrics_header(reply, "mumudvb_channel_latency_seconds", "histogram", "Time between the DVR read and the sending of the datagrams of the channel");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+	{
+		for(i=0;i<=METRICS_LATENCY_BUCKETS;i++)
+			latency[i]=__atomic_load_n(&channels[curr_channel]->datagram->latency[i], __ATOMIC_RELAXED);
+		metrics_render_series(reply, "mumudvb_channel_latency_seconds", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]),
+				metrics_latency_bounds, METRICS_LATENCY_BUCKETS, 1e-6, latency, __atomic_load_n(&channels[curr_channel]->datagram->latency_sum, __ATOMIC_RELAXED));
+	}
+
+#ifdef ENABLE_SCAM_DESCRAMBLER_SUPPORT
+	unsigned int to_descramble[number_of_channels?number_of_channels:1],to_send[number_of_channels?number_of_channels:1];
+	uint64_t batches[number_of_channels?number_of_channels:1],batch_packets[number_of_channels?number_of_channels:1];
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		if(channels[curr_channel]->ring_buf)
+		{
+			pthread_mutex_lock(&channels[curr_channel]->ring_buf->lock);
+			to_descramble[curr_channel]=channels[curr_channel]->ring_buf->to_descramble;
+			to_send[curr_channel]=channels[curr_channel]->ring_buf->to_send;
+			batches[curr_channel]=channels[curr_channel]->ring_buf->batches;
+			batch_packets[curr_channel]=channels[curr_channel]->ring_buf->batch_packets;
+			pthread_mutex_unlock(&channels[curr_channel]->ring_buf->lock);
+		}
+	metrics_header(reply, "mumudvb_descrambler_ring_packets", "gauge", "Packets in the descrambler ring, waiting to be descrambled or sent");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		if(channels[curr_channel]->ring_buf)
+		{
+			unicast_reply_write(reply, "mumudvb_descrambler_ring_packets{%s,stage=\"descramble\"} %u\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), to_descramble[curr_channel]);
+			unicast_reply_write(reply, "mumudvb_descrambler_ring_packets{%s,stage=\"send\"} %u\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), to_send[curr_channel]);
+		}
+	metrics_header(reply, "mumudvb_descrambler_ring_size", "gauge", "Size of the descrambler ring (packets)");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		if(channels[curr_channel]->ring_buf)
+			unicast_reply_write(reply, "mumudvb_descrambler_ring_size{%s} %llu\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), (unsigned long long)channels[curr_channel]->ring_buffer_size);
+	metrics_header(reply, "mumudvb_descrambler_batches_total", "counter", "Descrambling batches");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		if(channels[curr_channel]->ring_buf)
+			unicast_reply_write(reply, "mumudvb_descrambler_batches_total{%s} %llu\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), (unsigned long long)batches[curr_channel]);
+	metrics_header(reply, "mumudvb_descrambler_batch_packets_total", "counter", "Scrambled packets in the descrambling batches");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		if(channels[curr_channel]->ring_buf)
+			unicast_reply_write(reply, "mumudvb_descrambler_batch_packets_total{%s} %llu\n", metrics_channel_labels(labels, sizeof(labels), channels[curr_channel]), (unsigned long long)batch_packets[curr_channel]);
+	metrics_header(reply, "mumudvb_descrambler_batch_size", "gauge", "Packets descrambled together by libdvbcsa");
+	unicast_reply_write(reply, "mumudvb_descrambler_batch_size %u\n", dvbcsa_bs_batch_size());
+#endif
+
+	//The list can be changed by the main thread when the monitor thread makes the snapshot
+	pthread_mutex_lock(&unicast_vars->clients_lock);
+	metrics_header(reply, "mumudvb_client_queue_bytes", "gauge", "Data waiting to be sent to the HTTP client");
+	for(client=unicast_vars->clients;client!=NULL;client=client->next)
+		if(client->chan_ptr)
+		{
+			metrics_label(name, sizeof(name), client->chan_ptr->name);
+			inet_ntop(AF_INET, &client->SocketAddr.sin_addr, ip, sizeof(ip));
+			unicast_reply_write(reply, "mumudvb_client_queue_bytes{client=\"%s:%d\",channel=\"%s\"} %d\n", ip, ntohs(client->SocketAddr.sin_port), name, client->queue.data_bytes_in_queue+client->pipe_bytes);
+		}
+	metrics_header(reply, "mumudvb_client_dropped_packets_total", "counter", "TS packets dropped by the queue of the HTTP client");
+	for(client=unicast_vars->clients;client!=NULL;client=client->next)
+		if(client->chan_ptr)
+		{
+			metrics_label(name, sizeof(name), client->chan_ptr->name);
+			inet_ntop(AF_INET, &client->SocketAddr.sin_addr, ip, sizeof(ip));
+			unicast_reply_write(reply, "mumudvb_client_dropped_packets_total{client=\"%s:%d\",channel=\"%s\"} %ld\n", ip, ntohs(client->SocketAddr.sin_port), name, client->queue.dropped_packets);
+		}
+	pthread_mutex_unlock(&unicast_vars->clients_lock);
+
+	metrics_header(reply, "mumudvb_dvr_overflows_total", "counter", "DVR buffer overflows, data lost by the kernel");
+	unicast_reply_write(reply, "mumudvb_dvr_overflows_total %llu\n", (unsigned long long)__atomic_load_n(&metrics_overflows, __ATOMIC_RELAXED));
+	metrics_header(reply, "mumudvb_dvr_thread_buffer_full_total", "counter", "Times the buffer of the thread reading the card was full");
+	unicast_reply_write(reply, "mumudvb_dvr_thread_buffer_full_total %llu\n", (unsigned long long)__atomic_load_n(&metrics_thread_full, __ATOMIC_RELAXED));
+
+	memset(latency, 0, sizeof(latency));
+	memset(read_size, 0, sizeof(read_size));
+	memset(stage, 0, sizeof(stage));
+	memset(stage_sum, 0, sizeof(stage_sum));
+	pthread_mutex_lock(&metrics_threads_lock);
+	for(thread=metrics_threads;thread!=NULL;thread=thread->next)
+	{
+		for(i=0;i<=METRICS_LATENCY_BUCKETS;i++)
+			latency[i]+=__atomic_load_n(&thread->latency[i], __ATOMIC_RELAXED);
+		latency_sum+=__atomic_load_n(&thread->latency_sum, __ATOMIC_RELAXED);
+		for(i=0;i<=METRICS_READ_BUCKETS;i++)
+			read_size[i]+=__atomic_load_n(&thread->read_size[i], __ATOMIC_RELAXED);
+		read_size_sum+=__atomic_load_n(&thread->read_size_sum, __ATOMIC_RELAXED);
+		for(s=0;s<METRICS_STAGES;s++)
+		{
+			for(i=0;i<=METRICS_LATENCY_BUCKETS;i++)
+				stage[s][i]+=__atomic_load_n(&thread->stage[s][i], __ATOMIC_RELAXED);
+			stage_sum[s]+=__atomic_load_n(&thread->stage_sum[s], __ATOMIC_RELAXED);
+		}
+	}
+	pthread_mutex_unlock(&metrics_threads_lock);
+	metrics_render_histogram(reply, "mumudvb_dvr_read_packets", "Size of the reads from the DVR (TS packets)",
+			metrics_read_bounds, METRICS_READ_BUCKETS, 1, read_size, read_size_sum);
+	metrics_render_histogram(reply, "mumudvb_datagram_latency_seconds", "Time between the DVR read and the sending of the datagram",
+			metrics_latency_bounds, METRICS_LATENCY_BUCKETS, 1e-6, latency, latency_sum);
+	metrics_header(reply, "mumudvb_stage_latency_seconds", "histogram", "Time spent by the data in each stage");
+	for(s=0;s<METRICS_STAGES;s++)
+	{
+		snprintf(labels, sizeof(labels), "stage=\"%s\"", stage_names[s]);
+		metrics_render_series(reply, "mumudvb_stage_latency_seconds", labels, metrics_latency_bounds, METRICS_LATENCY_BUCKETS, 1e-6, stage[s], stage_sum[s]);
+	}
+}
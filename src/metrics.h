@@ -0,0 +1,87 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the performance metrics
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Header file for the performance metrics
+ */
+
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <stdint.h>
+#include "mumudvb.h"
+
+/** Number of buckets of the DVR read size histogram (+Inf excluded) */
+#define METRICS_READ_BUCKETS 11
+
+/** @brief The stages of the latency histograms, the time spent by the data in each of them */
+enum
+{
+	/** In the buffer of the thread reading the card (dvr_thread) */
+	METRICS_STAGE_THREAD_BUFFER=0,
+	/** In the buffer of the channel, until the datagram is sent (first packet of the datagram) */
+	METRICS_STAGE_CHANNEL_BUFFER,
+	/** In the descrambler ring, send_delay included (first packet of the datagram) */
+	METRICS_STAGE_DESCRAMBLER,
+	/** In the queue of an HTTP client */
+	METRICS_STAGE_UNICAST_QUEUE,
+	METRICS_STAGES,
+};
+
+/** @brief The histograms of a thread
+ *
+ * Only the thread owning them writes the buckets, the page of the metrics reads the buckets of all the
+ * threads : there is no lock and no contention on the counters.
+ */
+typedef struct metrics_thread_t{
+	/** Time between the DVR read and the sending of the datagram (us) */
+	uint64_t latency[METRICS_LATENCY_BUCKETS+1];
+	uint64_t latency_sum;
+	/** Time spent in each stage (us) */
+	uint64_t stage[METRICS_STAGES][METRICS_LATENCY_BUCKETS+1];
+	uint64_t stage_sum[METRICS_STAGES];
+	/** Size of the DVR reads (packets) */
+	uint64_t read_size[METRICS_READ_BUCKETS+1];
+	uint64_t read_size_sum;
+	struct metrics_thread_t *next;
+}metrics_thread_t;
+
+struct unicast_reply;
+struct unicast_parameters_t;
+
+void metrics_enable(int enabled);
+int metrics_enabled(void);
+void metrics_dvr_read(int bytes_read);
+void metrics_dvr_overflow(void);
+void metrics_dvr_thread_full(void);
+void metrics_set_read_time(uint64_t read_time);
+void metrics_thread_buffer_taken(uint64_t read_time);
+uint64_t metrics_read_time(void);
+uint64_t metrics_process_time(void);
+void metrics_stage(int stage, uint64_t start, uint64_t end);
+void metrics_datagram_sent(mumudvb_channel_t *channel);
+void metrics_render(struct unicast_reply *reply, struct unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels);
+
+#endif
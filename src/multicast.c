@@ -42,7 +42,7 @@ static char *log_module="Multicast: ";
  * @param multi_p the multicast parameters
  * @param substring The currrent line
   */
-int read_multicast_configuration(multi_p_t *multi_p, mumudvb_channel_t *channels, int channel_start, int *curr_channel, char *substring)
+int read_multicast_configuration(multi_p_t *multi_p, mumudvb_channel_t **channels, int channel_start, int *curr_channel, char *substring)
 {
   char delimiteurs[] = CONFIG_FILE_SEPARATOR;
 
@@ -87,7 +87,7 @@ int read_multicast_configuration(multi_p_t *multi_p, mumudvb_channel_t *channels
                    "The Ip address %s is too long.\n", substring);
       return -1;
     }
-    sscanf (substring, "%s\n", channels[*curr_channel].ip4Out);
+    sscanf (substring, "%s\n", channels[*curr_channel]->desc->ip4Out);
   }
   else if (!strcmp (substring, "ip6"))
   {
@@ -98,7 +98,7 @@ int read_multicast_configuration(multi_p_t *multi_p, mumudvb_channel_t *channels
                    "The Ip v6 address %s is too long.\n", substring);
       return -1;
     }
-    sscanf (substring, "%s\n", channels[*curr_channel].ip6Out);
+    sscanf (substring, "%s\n", channels[*curr_channel]->desc->ip6Out);
   }
 
   else if (!strcmp (substring, "port"))
@@ -110,7 +110,7 @@ int read_multicast_configuration(multi_p_t *multi_p, mumudvb_channel_t *channels
       return -1;
     }
     substring = strtok (NULL, delimiteurs);
-    channels[*curr_channel].portOut = atoi (substring);
+    channels[*curr_channel]->portOut = atoi (substring);
   }
   else if (!strcmp (substring, "rtp_header"))
   {
@@ -141,6 +141,24 @@ int read_multicast_configuration(multi_p_t *multi_p, mumudvb_channel_t *channels
     }
     sscanf (substring, "%s\n", multi_p->iface6);
   }
+  else if (!strcmp (substring, "multicast_max_latency"))
+  {
+    substring = strtok (NULL, delimiteurs);
+    if ( channel_start )
+      channels[*curr_channel]->max_latency = atoi (substring);
+    else
+      multi_p->max_latency = atoi (substring);
+  }
+  else if (!strcmp (substring, "multicast_jumbo"))
+  {
+    substring = strtok (NULL, delimiteurs);
+    multi_p->jumbo = atoi (substring);
+  }
+  else if (!strcmp (substring, "io_uring"))
+  {
+    substring = strtok (NULL, delimiteurs);
+    multi_p->io_uring = atoi (substring);
+  }
   else
     return 0; //Nothing concerning multicast, we return 0 to explore the other possibilities
 
@@ -60,7 +60,7 @@
  *
  * cam.c cam.h : code related to the support of scrambled channels
  *
- * crc32.c : the crc32 table
+ * crc32.c crc32.h : the crc32 tables and kernels
  *
  * dvb.c dvb.h functions related to the DVB card : oppening filters, file descriptors etc
  *
@@ -129,10 +129,18 @@
 #include "errors.h"
 #include "autoconf.h"
 #include "sap.h"
+#include "pacing.h"
+#include "timeshift.h"
+#include "recorder.h"
+#include "metrics.h"
+#include "stats_shm.h"
+#include "analyzer.h"
+#include "uring.h"
 #include "rewrite.h"
 #include "unicast_http.h"
 #include "rtp.h"
 #include "log.h"
+#include "crc32.h"
 
 #if defined __UCLIBC__ || defined ANDROID
 #define program_invocation_short_name "mumudvb"
@@ -186,8 +194,17 @@ unicast_parameters_t unicast_vars={
 		.consecutive_errors_timeout=UNICAST_CONSECUTIVE_ERROR_TIMEOUT,
 		.max_clients=-1,
 		.queue_max_size=UNICAST_DEFAULT_QUEUE_MAX,
+		.queue_max_time=0,
 		.socket_sendbuf_size=0,
 		.flush_on_eagain=0,
+		.zerocopy=0,
+		.null_fd=-1,
+		.tcp_tuning=0,
+		.tcp_cork=0,
+		.fast_start=0,
+		.reply_timeout=UNICAST_DEFAULT_REPLY_TIMEOUT,
+		.events_interval=UNICAST_DEFAULT_EVENTS_INTERVAL,
+		.clients_lock=PTHREAD_MUTEX_INITIALIZER,
 };
 
 
@@ -199,7 +216,7 @@ extern log_params_t log_params;
 
 // prototypes
 static void SignalHandler (int signum);//below
-int read_multicast_configuration(multi_p_t *, mumudvb_channel_t *, int, int *, char *); //in multicast.c
+int read_multicast_configuration(multi_p_t *, mumudvb_channel_t **, int, int *, char *); //in multicast.c
 void *monitor_func(void* arg);
 int mumudvb_close(int no_daemon,
 		monitor_parameters_t *monitor_thread_params,
@@ -227,6 +244,8 @@ main (int argc, char **argv)
 			.number_of_channels=0,
 			.filter_transport_error=0,
 			.psi_tables_filtering=PSI_TABLES_FILTERING_NONE,
+			.drop_null_packets=0,
+			.num_full_ts=0,
 			.check_cc=0,
 	};
 
@@ -235,6 +254,16 @@ main (int argc, char **argv)
 	sap_p_t sap_p;
 	init_sap_v(&sap_p);
 
+	//Output pacing
+	pacing_p_t pacing_p;
+	init_pacing_v(&pacing_p);
+	//Timeshift of the HTTP unicast
+	timeshift_p_t timeshift_p;
+	init_timeshift_v(&timeshift_p);
+	//Recordings
+	record_p_t record_p;
+	init_record_v(&record_p);
+
 	//Statistics
 	stats_infos_t stats_infos;
 	init_stats_v(&stats_infos);
@@ -259,7 +288,7 @@ main (int argc, char **argv)
 			.scam_support = 0,
 			.getcwthread_shutdown=0,
 	};
-	scam_vars.epfd = epoll_create(MAX_CHANNELS);
+	scam_vars.epfd = epoll_create(SCAM_MAX_EVENTS);
 	scam_parameters_t *scam_vars_ptr=&scam_vars;
 	int scam_threads_started=0;
 #else
@@ -281,6 +310,8 @@ main (int argc, char **argv)
 	char filename_pid[DEFAULT_PATH_LEN]=PIDFILE_PATH;
 
 	int server_id = 0; /** The server id for the template %server */
+	char stats_shm_name[DEFAULT_PATH_LEN]=""; /** The statistics segment in shared memory */
+	int pid_analyzer=0; /** Analysis of all the PIDs of the transponder */
 
 	int iRet,cmdlinecard;
 	cmdlinecard=-1;
@@ -288,7 +319,6 @@ main (int argc, char **argv)
 	//MPEG2-TS reception and sort
 	int pid;			/** pid of the current mpeg2 packet */
 	int ScramblingControl;
-	int continuity_counter;
 
 	/** The buffer for the card */
 	card_buffer_t card_buffer;
@@ -310,13 +340,17 @@ main (int argc, char **argv)
 #endif
 	FILE *pidfile;
 	char *dump_filename = NULL;
-	FILE *dump_file;
 
 	// configuration file parsing
 	int ichan = 0;
 	int ipid = 0;
 	int send_packet=0;
+	//The packet sent to the current channel (a copy if it is rewritten)
+	unsigned char *channel_packet;
+	unsigned char rewritten_packet[TS_PACKET_SIZE];
 	int channel_start = 0;
+	//Some channels have a latency budget, their partial datagrams can be sent before being full
+	int flush_partial_datagrams = 0;
 	char current_line[CONF_LINELEN];
 	char *substring=NULL;
 	char delimiteurs[] = CONFIG_FILE_SEPARATOR;
@@ -445,17 +479,9 @@ main (int argc, char **argv)
 	//Display general information
 	print_info ();
 
-	//paranoya we clear all the content of all the channels
-	memset (&chan_p.channels, 0, sizeof (mumudvb_channel_t)*MAX_CHANNELS);
-	for (int i = 0; i < MAX_CHANNELS; ++i) {
-          pthread_mutex_init(&chan_p.channels[i].stats_lock, NULL);
-#ifdef ENABLE_SCAM_SUPPORT
-#ifdef ENABLE_SCAM_DESCRAMBLER_SUPPORT
-          pthread_mutex_init(&chan_p.channels[i].cw_lock, NULL);
-#endif
-          chan_p.channels[i].camd_socket = -1;
-#endif
-	}
+	//The channels table (cleared), it grows with the configuration and the autoconfiguration
+	if(mumu_chan_reserve(&chan_p, CHANNELS_ALLOC_STEP))
+		exit(ERROR_MEMORY);
 
 
 
@@ -508,6 +534,9 @@ main (int argc, char **argv)
 	int line_len;
 	while (fgets (current_line, CONF_LINELEN, conf_file))
 	{
+		//Room for the current channel and the next one (ip= and channel_next start a new channel)
+		if(mumu_chan_reserve(&chan_p, ichan+2))
+			exit(ERROR_MEMORY);
 		//We suppress the end of line (this can disturb atoi if there is spaces at the end of the line)
 		//Thanks to Pierre Gronlier pierre.gronlier at gmail.com for finding that bug
 		line_len=strlen(current_line);
@@ -553,26 +582,41 @@ main (int argc, char **argv)
 			if(iRet==-1)
 				exit(ERROR_CONF);
 		}
-		else if((iRet=read_sap_configuration(&sap_p, &chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the sap parameters
+		else if((iRet=read_sap_configuration(&sap_p, chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the sap parameters
 		{
 			if(iRet==-1)
 				exit(ERROR_CONF);
 		}
 #ifdef ENABLE_CAM_SUPPORT
-		else if((iRet=read_cam_configuration(&cam_p, &chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the cam parameters
+		else if((iRet=read_cam_configuration(&cam_p, chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the cam parameters
 		{
 			if(iRet==-1)
 				exit(ERROR_CONF);
 		}
 #endif
 #ifdef ENABLE_SCAM_SUPPORT
-		else if((iRet=read_scam_configuration(scam_vars_ptr, &chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the cam parameters
+		else if((iRet=read_scam_configuration(scam_vars_ptr, chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the cam parameters
 		{
 			if(iRet==-1)
 				exit(ERROR_CONF);
 		}
 #endif
-		else if((iRet=read_unicast_configuration(&unicast_vars, &chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the unicast parameters
+		else if((iRet=read_unicast_configuration(&unicast_vars, chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the unicast parameters
+		{
+			if(iRet==-1)
+				exit(ERROR_CONF);
+		}
+		else if((iRet=read_pacing_configuration(&pacing_p, chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the output pacing
+		{
+			if(iRet==-1)
+				exit(ERROR_CONF);
+		}
+		else if((iRet=read_timeshift_configuration(&timeshift_p, chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the timeshift
+		{
+			if(iRet==-1)
+				exit(ERROR_CONF);
+		}
+		else if((iRet=read_record_configuration(&record_p, chan_p.channels[ichan], channel_start, substring))) //Read the line concerning the recordings
 		{
 			if(iRet==-1)
 				exit(ERROR_CONF);
@@ -664,7 +708,7 @@ main (int argc, char **argv)
 				exit(ERROR_CONF);
 			}
 			substring = strtok (NULL, delimiteurs);
-			chan_p.channels[ichan].service_id = atoi (substring);
+			chan_p.channels[ichan]->service_id = atoi (substring);
 		}
 		else if (!strcmp (substring, "pids"))
 		{
@@ -675,17 +719,17 @@ main (int argc, char **argv)
 						"pids : You have to start a channel first (using ip= or channel_next)\n");
 				exit(ERROR_CONF);
 			}
-			if (multi_p.common_port!=0 && chan_p.channels[ichan].portOut == 0)
-				chan_p.channels[ichan].portOut = multi_p.common_port;
+			if (multi_p.common_port!=0 && chan_p.channels[ichan]->portOut == 0)
+				chan_p.channels[ichan]->portOut = multi_p.common_port;
 			while ((substring = strtok (NULL, delimiteurs)) != NULL)
 			{
-				chan_p.channels[ichan].pids[ipid] = atoi (substring);
+				chan_p.channels[ichan]->pids[ipid] = atoi (substring);
 				// we see if the given pid is good
-				if (chan_p.channels[ichan].pids[ipid] < 10 || chan_p.channels[ichan].pids[ipid] >= 8193)
+				if (chan_p.channels[ichan]->pids[ipid] < 10 || chan_p.channels[ichan]->pids[ipid] >= 8193)
 				{
 					log_message( log_module,  MSG_ERROR,
 							"Config issue : %s in pids, given pid : %d\n",
-							conf_filename, chan_p.channels[ichan].pids[ipid]);
+							conf_filename, chan_p.channels[ichan]->pids[ipid]);
 					exit(ERROR_CONF);
 				}
 				ipid++;
@@ -697,7 +741,7 @@ main (int argc, char **argv)
 					exit(ERROR_CONF);
 				}
 			}
-			chan_p.channels[ichan].num_pids = ipid;
+			chan_p.channels[ichan]->num_pids = ipid;
 		}
 		else if (!strcmp (substring, "name"))
 		{
@@ -709,8 +753,8 @@ main (int argc, char **argv)
 			}
 			// other substring extraction method in order to keep spaces
 			substring = strtok (NULL, "=");
-			strncpy(chan_p.channels[ichan].name,strtok(substring,"\n"),MAX_NAME_LEN-1);
-			chan_p.channels[ichan].name[MAX_NAME_LEN-1]='\0';
+			strncpy(chan_p.channels[ichan]->name,strtok(substring,"\n"),MAX_NAME_LEN-1);
+			chan_p.channels[ichan]->name[MAX_NAME_LEN-1]='\0';
 			if (strlen (substring) >= MAX_NAME_LEN - 1)
 				log_message( log_module,  MSG_WARN,"Channel name too long\n");
 		}
@@ -729,11 +773,31 @@ main (int argc, char **argv)
 			else
 				strcpy(filename_pid,substring);
 		}
+		else if (!strcmp (substring, "stats_shm"))
+		{
+			substring = strtok (NULL, delimiteurs);
+			if(strlen(substring)>=DEFAULT_PATH_LEN)
+			{
+				log_message(log_module,MSG_WARN,"stats_shm too long \n");
+			}
+			else
+				strcpy(stats_shm_name,substring);
+		}
+		else if (!strcmp (substring, "pid_analyzer"))
+		{
+			substring = strtok (NULL, delimiteurs);
+			pid_analyzer = atoi (substring);
+		}
 		else if (!strcmp (substring, "check_cc"))
 		{
 			substring = strtok (NULL, delimiteurs);
 			chan_p.check_cc = atoi (substring);
 		}
+		else if (!strcmp (substring, "drop_null_packets"))
+		{
+			substring = strtok (NULL, delimiteurs);
+			chan_p.drop_null_packets = atoi (substring);
+		}
 		else
 		{
 			if(strlen (current_line) > 1)
@@ -742,13 +806,6 @@ main (int argc, char **argv)
 			continue;
 		}
 
-		if (ichan > MAX_CHANNELS)
-		{
-			log_message( log_module,  MSG_ERROR, "Too many channels : %d limit : %d\n",
-					ichan, MAX_CHANNELS);
-			exit(ERROR_TOO_CHANNELS);
-		}
-
 		//A new channel have been defined
 		if(curr_channel_old != ichan)
 		{
@@ -832,9 +889,16 @@ main (int argc, char **argv)
 	//end of config file reading
 	/******************************************************/
 
+	//From now the messages are written by the log writer thread
+	log_thread_start();
+
 	// Show in log that we are starting
 	log_message( log_module,  MSG_INFO,"========== End of configuration, MuMuDVB version %s is starting ==========",VERSION);
 
+	//We select the CRC32 kernel before starting the threads
+	crc32_init();
+	log_message( log_module,  MSG_DEBUG, "CRC32 implementation : %s\n",crc32_impl_to_str(crc32_get_impl()));
+
 	// + 1 Because of the new syntax
 	pthread_mutex_lock(&chan_p.lock);
 	chan_p.number_of_channels = ichan+1;
@@ -1005,6 +1069,13 @@ main (int argc, char **argv)
 	log_message( log_module,  MSG_INFO, "Card %d, tuner %d tuned\n", tune_p.card, tune_p.tuner);
 	tune_p.card_tuned = 1;
 
+	//The counters are written in the statistics segment from now
+	if(strlen(stats_shm_name))
+		stats_shm_open(stats_shm_name, tune_p.card, tune_p.tuner, server_id);
+	//The table of the PIDs is also the per PID counters of check_cc, of the metrics and of the segment
+	if(pid_analyzer || chan_p.check_cc || strlen(stats_shm_name))
+		analyzer_init();
+
 	//Thread for showing the strength
 	strength_parameters_t strengthparams;
 	strengthparams.fds = &fds;
@@ -1072,6 +1143,8 @@ main (int argc, char **argv)
 #ifdef ENABLE_SCAM_SUPPORT
 			.scam_vars_v=scam_vars_ptr,
 #endif
+			.strengthparams=&strengthparams,
+			.cam_p_v=cam_p_ptr,
 			.server_id=server_id,
 			.filename_channels_not_streamed=filename_channels_not_streamed,
 			.filename_channels_streamed=filename_channels_streamed,
@@ -1118,17 +1191,17 @@ main (int argc, char **argv)
 		for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
 		{
 			//We allocate the packet for storing the PMT for CAM purposes
-			if(chan_p.channels[ichan].cam_pmt_packet==NULL)
+			if(chan_p.channels[ichan]->cam_pmt_packet==NULL)
 			{
-				chan_p.channels[ichan].cam_pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
-				if(chan_p.channels[ichan].cam_pmt_packet==NULL)
+				chan_p.channels[ichan]->cam_pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
+				if(chan_p.channels[ichan]->cam_pmt_packet==NULL)
 				{
 					log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
 					set_interrupted(ERROR_MEMORY<<8);
 					goto mumudvb_close_goto;
 				}
-				memset (chan_p.channels[ichan].cam_pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
-				pthread_mutex_init(&chan_p.channels[ichan].cam_pmt_packet->packetmutex,NULL);
+				memset (chan_p.channels[ichan]->cam_pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
+				pthread_mutex_init(&chan_p.channels[ichan]->cam_pmt_packet->packetmutex,NULL);
 			}
 		}
 	}
@@ -1169,9 +1242,6 @@ main (int argc, char **argv)
 
 	if(rewrite_vars.rewrite_pat == OPTION_ON)
 	{
-		for (ichan = 0; ichan < MAX_CHANNELS; ichan++)
-			chan_p.channels[ichan].generated_pat_version=-1;
-
 		rewrite_vars.full_pat=malloc(sizeof(mumudvb_ts_packet_t));
 		if(rewrite_vars.full_pat==NULL)
 		{
@@ -1191,9 +1261,6 @@ main (int argc, char **argv)
 
 	if(rewrite_vars.rewrite_sdt == OPTION_ON)
 	{
-		for (ichan = 0; ichan < MAX_CHANNELS; ichan++)
-			chan_p.channels[ichan].generated_sdt_version=-1;
-
 		rewrite_vars.full_sdt=malloc(sizeof(mumudvb_ts_packet_t));
 		if(rewrite_vars.full_sdt==NULL)
 		{
@@ -1235,44 +1302,65 @@ main (int argc, char **argv)
 	//Initialisation of the channels for RTP
 	if(multi_p.rtp_header)
 		for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
-			init_rtp_header(&chan_p.channels[ichan]);
+			init_rtp_header(chan_p.channels[ichan]);
+
+	//The whole transponder channels (without service to rewrite or descramble) use the fast path
+	for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
+	{
+		mumudvb_channel_t *channel = chan_p.channels[ichan];
+		channel->full_ts=0;
+		for (ipid = 0; ipid < channel->num_pids; ipid++)
+			if (channel->pids[ipid] == 8192)
+				channel->full_ts=1;
+		if(channel->service_id || channel->need_cam_ask)
+			channel->full_ts=0;
+#ifdef ENABLE_SCAM_SUPPORT
+		if(channel->scam_support)
+			channel->full_ts=0;
+#endif
+		if(channel->full_ts)
+		{
+			log_message( log_module,  MSG_DETAIL, "Channel %d \"%s\" : whole transponder, sent directly from the read buffer\n", ichan, channel->name);
+			chan_p.num_full_ts++;
+		}
+	}
 
 	// initialisation of active channels list
 	for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
 	{
-		chan_p.channels[ichan].num_packet = 0;
-		chan_p.channels[ichan].streamed_channel = 1;
-		chan_p.channels[ichan].num_scrambled_packets = 0;
-		chan_p.channels[ichan].scrambled_channel = 0;
+		chan_p.channels[ichan]->num_packet = 0;
+		chan_p.channels[ichan]->streamed_channel = !chan_p.channels[ichan]->autoconf_wait_pmt; //partial autoconfiguration : up when the PMT is found
+		chan_p.channels[ichan]->num_scrambled_packets = 0;
+		chan_p.channels[ichan]->scrambled_channel = 0;
 
 		//We alloc the channel pmt_packet (useful for autoconf and cam)
 		/** @todo : allocate only if autoconf */
-		if(chan_p.channels[ichan].pmt_packet==NULL)
+		if(chan_p.channels[ichan]->pmt_packet==NULL)
 		{
-			chan_p.channels[ichan].pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
-			if(chan_p.channels[ichan].pmt_packet==NULL)
+			chan_p.channels[ichan]->pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
+			if(chan_p.channels[ichan]->pmt_packet==NULL)
 			{
 				log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
 				set_interrupted(ERROR_MEMORY<<8);
 				goto mumudvb_close_goto;
 			}
-			memset (chan_p.channels[ichan].pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
-			pthread_mutex_init(&chan_p.channels[ichan].pmt_packet->packetmutex,NULL);
+			memset (chan_p.channels[ichan]->pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
+			pthread_mutex_init(&chan_p.channels[ichan]->pmt_packet->packetmutex,NULL);
 
 		}
 
 #ifdef ENABLE_SCAM_SUPPORT
-                if(chan_p.channels[ichan].scam_pmt_packet==NULL && scam_vars.scam_support)
+                if(chan_p.channels[ichan]->scam_pmt_packet==NULL && scam_vars.scam_support)
                 {
-                        chan_p.channels[ichan].scam_pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
-                        if(chan_p.channels[ichan].scam_pmt_packet==NULL)
+                        chan_p.channels[ichan]->scam_pmt_packet=malloc(sizeof(mumudvb_ts_packet_t));
+                        if(chan_p.channels[ichan]->scam_pmt_packet==NULL)
                         {
                                 log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
                                 set_interrupted(ERROR_MEMORY<<8);
                                 return -1;
                         }
-                        memset (chan_p.channels[ichan].scam_pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
-                        pthread_mutex_init(&chan_p.channels[ichan].scam_pmt_packet->packetmutex,NULL);
+                        memset (chan_p.channels[ichan]->scam_pmt_packet, 0, sizeof( mumudvb_ts_packet_t));//we clear it
+                        pthread_mutex_init(&chan_p.channels[ichan]->scam_pmt_packet->packetmutex,NULL);
                 }
 #endif
 
@@ -1282,10 +1370,6 @@ main (int argc, char **argv)
 	memset (chan_p.asked_pid, 0, sizeof( uint8_t)*8193);//we clear it
 	memset (chan_p.number_chan_asked_pid, 0, sizeof( uint8_t)*8193);//we clear it
 
-	// We initialize the table for checking the TS discontinuities
-	for (ipid = 0; ipid < 8193; ipid++)
-		chan_p.continuity_counter_pid[ipid]=-1;
-
 	//We initialise mandatory pid table
 	memset (mandatory_pid, 0, sizeof( uint8_t)*MAX_MANDATORY_PID_NUMBER);//we clear it
 
@@ -1324,11 +1408,11 @@ main (int argc, char **argv)
 	//We fill the asked_pid array
 	for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
 	{
-		for (ipid = 0; ipid < chan_p.channels[ichan].num_pids; ipid++)
+		for (ipid = 0; ipid < chan_p.channels[ichan]->num_pids; ipid++)
 		{
-			if(chan_p.asked_pid[chan_p.channels[ichan].pids[ipid]]==PID_NOT_ASKED)
-				chan_p.asked_pid[chan_p.channels[ichan].pids[ipid]]=PID_ASKED;
-			chan_p.number_chan_asked_pid[chan_p.channels[ichan].pids[ipid]]++;
+			if(chan_p.asked_pid[chan_p.channels[ichan]->pids[ipid]]==PID_NOT_ASKED)
+				chan_p.asked_pid[chan_p.channels[ichan]->pids[ipid]]=PID_ASKED;
+			chan_p.number_chan_asked_pid[chan_p.channels[ichan]->pids[ipid]]++;
 		}
 	}
 
@@ -1383,19 +1467,27 @@ main (int argc, char **argv)
 			{
 				//See the README for the reason of this option
 				if(multi_p.auto_join)
-					chan_p.channels[ichan].socketOut4 = makeclientsocket (chan_p.channels[ichan].ip4Out, chan_p.channels[ichan].portOut, multi_p.ttl, multi_p.iface4, &chan_p.channels[ichan].sOut4);
+					chan_p.channels[ichan]->socketOut4 = makeclientsocket (chan_p.channels[ichan]->desc->ip4Out, chan_p.channels[ichan]->portOut, multi_p.ttl, multi_p.iface4, &chan_p.channels[ichan]->sOut4);
 				else
-					chan_p.channels[ichan].socketOut4 = makesocket (chan_p.channels[ichan].ip4Out, chan_p.channels[ichan].portOut, multi_p.ttl, multi_p.iface4, &chan_p.channels[ichan].sOut4);
+					chan_p.channels[ichan]->socketOut4 = makesocket (chan_p.channels[ichan]->desc->ip4Out, chan_p.channels[ichan]->portOut, multi_p.ttl, multi_p.iface4, &chan_p.channels[ichan]->sOut4);
 			}
 			if(multi_p.multicast_ipv6)
 			{
 				//See the README for the reason of this option
 				if(multi_p.auto_join)
-					chan_p.channels[ichan].socketOut6 = makeclientsocket6 (chan_p.channels[ichan].ip6Out, chan_p.channels[ichan].portOut, multi_p.ttl, multi_p.iface6, &chan_p.channels[ichan].sOut6);
+					chan_p.channels[ichan]->socketOut6 = makeclientsocket6 (chan_p.channels[ichan]->desc->ip6Out, chan_p.channels[ichan]->portOut, multi_p.ttl, multi_p.iface6, &chan_p.channels[ichan]->sOut6);
 				else
-					chan_p.channels[ichan].socketOut6 = makesocket6 (chan_p.channels[ichan].ip6Out, chan_p.channels[ichan].portOut, multi_p.ttl, multi_p.iface6, &chan_p.channels[ichan].sOut6);
+					chan_p.channels[ichan]->socketOut6 = makesocket6 (chan_p.channels[ichan]->desc->ip6Out, chan_p.channels[ichan]->portOut, multi_p.ttl, multi_p.iface6, &chan_p.channels[ichan]->sOut6);
 			}
 		}
+	for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
+	{
+		channel_init_packing(chan_p.channels[ichan], &multi_p);
+		if(chan_p.channels[ichan]->max_latency)
+			flush_partial_datagrams = 1;
+	}
+	if(multi_p.max_latency)
+		flush_partial_datagrams = 1;
 
 
 	//We open the socket for the http unicast if needed and we update the poll structure
@@ -1405,10 +1497,10 @@ main (int argc, char **argv)
 		unicast_create_listening_socket(UNICAST_MASTER, -1, unicast_vars.ipOut, unicast_vars.portOut, &unicast_vars.sIn, &unicast_vars.socketIn, &fds, &unicast_vars);
 		/** open the unicast listening connections fo the channels */
 		for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
-			if(chan_p.channels[ichan].unicast_port)
+			if(chan_p.channels[ichan]->unicast_port)
 			{
-				log_message("Unicast: ", MSG_INFO,"We open the channel %d http socket address %s:%d\n",ichan, unicast_vars.ipOut, chan_p.channels[ichan].unicast_port);
-				unicast_create_listening_socket(UNICAST_LISTEN_CHANNEL, ichan, unicast_vars.ipOut,chan_p.channels[ichan].unicast_port , &chan_p.channels[ichan].sIn, &chan_p.channels[ichan].socketIn, &fds, &unicast_vars);
+				log_message("Unicast: ", MSG_INFO,"We open the channel %d http socket address %s:%d\n",ichan, unicast_vars.ipOut, chan_p.channels[ichan]->unicast_port);
+				unicast_create_listening_socket(UNICAST_LISTEN_CHANNEL, ichan, unicast_vars.ipOut,chan_p.channels[ichan]->unicast_port , &chan_p.channels[ichan]->sIn, &chan_p.channels[ichan]->socketIn, &fds, &unicast_vars);
 			}
 	}
 
@@ -1424,11 +1516,35 @@ main (int argc, char **argv)
 		goto mumudvb_close_goto;
 	}
 
+	iRet=pacing_start(&pacing_p, &multi_p, &chan_p);
+	if(iRet)
+	{
+		set_interrupted(ERROR_GENERIC<<8);
+		goto mumudvb_close_goto;
+	}
+	//If io_uring is not available the datagrams are sent directly
+	uring_init(&multi_p);
+	if(unicast_vars.unicast)
+		timeshift_start(&timeshift_p);
+	//The performance metrics are served with the monitoring pages
+	metrics_enable(unicast_vars.unicast);
+
+	/*****************************************************/
+	// Autoconfiguration cache : if the channels of this
+	// frequency are known, we start streaming them now
+	/*****************************************************/
+	iRet=autoconf_cache_start(&auto_p, &chan_p, &tune_p, &multi_p, &fds, &unicast_vars, server_id, scam_vars_ptr);
+	if(iRet)
+	{
+		set_interrupted(ERROR_MEMORY<<8);
+		goto mumudvb_close_goto;
+	}
+
 	/*****************************************************/
 	// Information about streamed channels
 	/*****************************************************/
 
-	if(auto_p.autoconfiguration!=AUTOCONF_MODE_FULL)
+	if(auto_p.autoconfiguration!=AUTOCONF_MODE_FULL && !auto_p.cache_verify) //already displayed when the channels come from the cache
 		log_streamed_channels(log_module,
 				chan_p.number_of_channels,
 				chan_p.channels,
@@ -1462,18 +1578,12 @@ main (int argc, char **argv)
 
 
 	/******************************************************/
-	//We open the dump file if any
+	//We start the recordings (and the dump file if any)
 	/******************************************************/
-	dump_file = NULL;
-	if(dump_filename)
+	if(record_start(&record_p, dump_filename))
 	{
-		dump_file = fopen (dump_filename, "w");
-		if (dump_file == NULL)
-		{
-			log_message( log_module,  MSG_ERROR, "%s: %s\n",
-					dump_filename, strerror (errno));
-			free(dump_filename);
-		}
+		set_interrupted(ERROR_GENERIC<<8);
+		goto mumudvb_close_goto;
 	}
 #ifndef ANDROID
 	mlockall(MCL_CURRENT | MCL_FUTURE);
@@ -1486,6 +1596,9 @@ main (int argc, char **argv)
 	unsigned char *actual_ts_packet;
 	while (!get_interrupted())
 	{
+		//The live events waiting for the HTTP clients
+		if(unicast_vars.unicast)
+			unicast_events_send(&unicast_vars);
 		if(card_buffer.threaded_read)
 		{
 			if(!card_buffer.bytes_in_write_buffer && !cardthreadparams.unicast_data)
@@ -1514,6 +1627,7 @@ main (int argc, char **argv)
 				}
 				card_buffer.bytes_read=card_buffer.bytes_in_write_buffer;
 				card_buffer.bytes_in_write_buffer=0;
+				metrics_thread_buffer_taken(card_buffer.write_buffer_time);
 			}
 			pthread_mutex_unlock(&cardthreadparams.carddatamutex);
 			if(cardthreadparams.unicast_data)
@@ -1556,6 +1670,8 @@ main (int argc, char **argv)
 
 			if((card_buffer.bytes_read=card_read(fds.fd_dvr,  card_buffer.reading_buffer, &card_buffer))==0)
 				continue;
+			if(metrics_enabled())
+				metrics_set_read_time(get_time());
 		}
 
 		if(card_buffer.dvr_buffer_size!=1 && stats_infos.show_buffer_stats)
@@ -1564,37 +1680,30 @@ main (int argc, char **argv)
 			stats_infos.stats_num_reads++;
 		}
 
+		//The recording thread writes the whole transponder
+		record_mux(&record_p, card_buffer.reading_buffer, (card_buffer.bytes_read/TS_PACKET_SIZE)*TS_PACKET_SIZE);
+
 		for(card_buffer.read_buff_pos=0;
 				(card_buffer.read_buff_pos+TS_PACKET_SIZE)<=card_buffer.bytes_read;
 				card_buffer.read_buff_pos+=TS_PACKET_SIZE)//we loop on the subpackets
 		{
 			actual_ts_packet=card_buffer.reading_buffer+card_buffer.read_buff_pos;
 
-			//If the user asked to dump the streams it's here tath it should be done
-			if(dump_file)
-				if(fwrite(actual_ts_packet,sizeof(unsigned char),TS_PACKET_SIZE,dump_file)<TS_PACKET_SIZE)
-					log_message( log_module,MSG_WARN,"Error while writing the dump : %s", strerror(errno));
+			// Get the PID of the received TS packet
+			pid = ((actual_ts_packet[1] & 0x1f) << 8) | (actual_ts_packet[2]);
+			//Analysis of the whole transponder, before any filtering, it checks the continuity
+			if(analyzer_packet(pid, actual_ts_packet) && chan_p.check_cc)
+				strengthparams.ts_discontinuities++;
 
 			// Test if the error bit is set in the TS packet received
 			if ((actual_ts_packet[1] & 0x80) == 0x80)
 			{
 				log_message( log_module, MSG_FLOOD,"Error bit set in TS packet!\n");
+				stats_shm_ts_error();
 				// Test if we discard the packets with error bit set
 				if (chan_p.filter_transport_error>0) continue;
 			}
 
-			// Get the PID of the received TS packet
-			pid = ((actual_ts_packet[1] & 0x1f) << 8) | (actual_ts_packet[2]);
-
-			// Check the continuity
-			if(chan_p.check_cc)
-			{
-				continuity_counter=actual_ts_packet[3] & 0x0f;
-				if (chan_p.continuity_counter_pid[pid]!=-1 && chan_p.continuity_counter_pid[pid]!=continuity_counter && ((chan_p.continuity_counter_pid[pid]+1) & 0x0f)!=continuity_counter)
-					strengthparams.ts_discontinuities++;
-				chan_p.continuity_counter_pid[pid]=continuity_counter;
-			}
-
 			//Software filtering in case the card doesn't have hardware filtering
 			if(chan_p.asked_pid[8192]==PID_NOT_ASKED && chan_p.asked_pid[pid]==PID_NOT_ASKED)
 				continue;
@@ -1614,8 +1723,17 @@ main (int argc, char **argv)
 				if(iRet)
 					set_interrupted(iRet);
 			}
-			if(auto_p.autoconfiguration)
+			//The channels are streamed as soon as their PMT is found, we only wait for the list of services
+			if(auto_p.autoconfiguration==AUTOCONF_MODE_FULL)
+				continue;
+#ifdef ENABLE_SCAM_SUPPORT
+			//SCAM starts the channels once, when all the PMTs are known
+			if(auto_p.autoconfiguration && scam_vars.scam_support)
 				continue;
+#endif
+			//Channels started from the cache, we check them with the live tables
+			if(!ScramblingControl && auto_p.cache_verify)
+				autoconf_cache_new_packet(pid, actual_ts_packet, &auto_p,  &fds, &chan_p, &tune_p, &multi_p, &unicast_vars, server_id, scam_vars_ptr);
 
 			/******************************************************/
 			//   AUTOCONFIGURATION PART FINISHED
@@ -1626,7 +1744,7 @@ main (int argc, char **argv)
 			/******************************************************/
 			if(!ScramblingControl &&  scam_vars.need_pmt_get)
 			{
-				scam_new_packet(pid, actual_ts_packet, &scam_vars, chan_p.channels);
+				scam_new_packet(pid, actual_ts_packet, &scam_vars, chan_p.channels, chan_p.number_of_channels);
 			}
 			if(scam_vars.need_pmt_get)
 				continue;
@@ -1636,8 +1754,8 @@ main (int argc, char **argv)
 			/******************************************************/
 			if(!scam_threads_started) {
 				for (ichan = 0; ichan < chan_p.number_of_channels; ichan++) {
-					if (chan_p.channels[ichan].scam_support && scam_vars.scam_support)
-						set_interrupted(scam_channel_start(&chan_p.channels[ichan]));
+					if (chan_p.channels[ichan]->scam_support && scam_vars.scam_support)
+						set_interrupted(scam_channel_start(chan_p.channels[ichan]));
 				}
 				scam_threads_started=1;
 			}
@@ -1661,7 +1779,7 @@ main (int argc, char **argv)
 				{
 					log_message( log_module, MSG_DETAIL,"The SDT version changed, we force the update of all the channels.\n");
 					for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
-						chan_p.channels[ichan].sdt_rewrite_skip=0; //no lock needed, accessed only by main thread
+						chan_p.channels[ichan]->sdt_rewrite_skip=0; //no lock needed, accessed only by main thread
 				}
 			}
 			/******************************************************/
@@ -1680,6 +1798,9 @@ main (int argc, char **argv)
 			pthread_mutex_lock(&chan_p.lock);
 			for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
 			{
+				//the whole transponder channels are sent once the read buffer is processed
+				if(chan_p.channels[ichan]->full_ts)
+					continue;
 				//we'll see if we must send this pid for this channel
 				send_packet=0;
 
@@ -1692,8 +1813,8 @@ main (int argc, char **argv)
 
 				//if it isn't mandatory wee see if it is in the channel list
 				if(!send_packet)
-					for (ipid = 0; (ipid < chan_p.channels[ichan].num_pids)&& !send_packet; ipid++)
-						if ((chan_p.channels[ichan].pids[ipid] == pid) || (chan_p.channels[ichan].pids[ipid] == 8192)) //We can stream whole transponder using 8192
+					for (ipid = 0; (ipid < chan_p.channels[ichan]->num_pids)&& !send_packet; ipid++)
+						if ((chan_p.channels[ichan]->pids[ipid] == pid) || (chan_p.channels[ichan]->pids[ipid] == 8192)) //We can stream whole transponder using 8192
 						{
 							send_packet=1;
 
@@ -1708,7 +1829,7 @@ main (int argc, char **argv)
 						cam_p.ca_resource_connected &&
 						((now-cam_p.cam_pmt_send_time)>=cam_p.cam_interval_pmt_send ))
 				{
-					if(cam_new_packet(pid, ichan, actual_ts_packet, &cam_p, &chan_p.channels[ichan]))
+					if(cam_new_packet(pid, ichan, actual_ts_packet, &cam_p, chan_p.channels[ichan]))
 						cam_p.cam_pmt_send_time=now; //A packet was sent to the CAM
 				}
 #endif
@@ -1718,11 +1839,11 @@ main (int argc, char **argv)
 				/******************************************************/
 				if( (auto_p.autoconf_pid_update) &&
 						(send_packet==1) && //no need to check paquets we don't send
-						(chan_p.channels[ichan].autoconfigurated) && //only channels whose pids where detected by autoconfiguration (we don't erase "manual" channels)
-						(chan_p.channels[ichan].pmt_pid==pid) &&     //And we see the PMT
+						(chan_p.channels[ichan]->autoconfigurated) && //only channels whose pids where detected by autoconfiguration (we don't erase "manual" channels)
+						(chan_p.channels[ichan]->pmt_pid==pid) &&     //And we see the PMT
 						pid)
 				{
-					autoconf_pmt_follow( actual_ts_packet, &fds, &chan_p.channels[ichan], tune_p.card_dev_path, tune_p.tuner, &chan_p );
+					autoconf_pmt_follow( actual_ts_packet, &fds, chan_p.channels[ichan], tune_p.card_dev_path, tune_p.tuner, &chan_p );
 				}
 				/******************************************************/
 				//PMT follow for the cam for  non autoconfigurated channels.
@@ -1730,22 +1851,39 @@ main (int argc, char **argv)
 				/******************************************************/
 #ifdef ENABLE_CAM_SUPPORT
 				if((cam_p.cam_pmt_follow) &&
-						(chan_p.channels[ichan].need_cam_ask==CAM_ASKED) &&
+						(chan_p.channels[ichan]->need_cam_ask==CAM_ASKED) &&
 						(send_packet==1) && //no need to check paquets we don't send
-						(!chan_p.channels[ichan].autoconfigurated) && //the check is for the non autoconfigurated channels
-						(chan_p.channels[ichan].pmt_pid==pid) &&     //And we see the PMT
+						(!chan_p.channels[ichan]->autoconfigurated) && //the check is for the non autoconfigurated channels
+						(chan_p.channels[ichan]->pmt_pid==pid) &&     //And we see the PMT
 						pid)
 				{
-					cam_pmt_follow( actual_ts_packet, &chan_p.channels[ichan] );
+					cam_pmt_follow( actual_ts_packet, chan_p.channels[ichan] );
 				}
 #endif
+				/******************************************************/
+				//Autoconfiguration : nothing to stream until the PMT is found
+				/******************************************************/
+				if(chan_p.channels[ichan]->autoconf_wait_pmt)
+					send_packet=0;
+				/******************************************************/
+				//The rewritten packets are different for each channel : they are made
+				// in a copy, the read buffer stays intact (it is referenced by the datagrams)
+				/******************************************************/
+				channel_packet=actual_ts_packet;
+				if((send_packet==1) &&
+						(((pid == 0) && rewrite_vars.rewrite_pat == OPTION_ON) ||
+						((pid == 17) && rewrite_vars.rewrite_sdt == OPTION_ON && !chan_p.channels[ichan]->sdt_rewrite_skip)))
+				{
+					memcpy(rewritten_packet, actual_ts_packet, TS_PACKET_SIZE);
+					channel_packet=rewritten_packet;
+				}
 				/******************************************************/
 				//Rewrite PAT
 				/******************************************************/
 				if((send_packet==1) && //no need to check paquets we don't send
 						(pid == 0) && //This is a PAT PID
 						rewrite_vars.rewrite_pat == OPTION_ON )  //AND we asked for rewrite
-					send_packet=pat_rewrite_new_channel_packet(actual_ts_packet, &rewrite_vars, &chan_p.channels[ichan], ichan);
+					send_packet=pat_rewrite_new_channel_packet(channel_packet, &rewrite_vars, chan_p.channels[ichan], ichan);
 
 				/******************************************************/
 				//Rewrite SDT
@@ -1753,18 +1891,18 @@ main (int argc, char **argv)
 				if((send_packet==1) && //no need to check paquets we don't send
 						(pid == 17) && //This is a SDT PID
 						rewrite_vars.rewrite_sdt == OPTION_ON &&  //AND we asked for rewrite
-						!chan_p.channels[ichan].sdt_rewrite_skip ) //AND the generation was successful
-					send_packet=sdt_rewrite_new_channel_packet(actual_ts_packet, &rewrite_vars, &chan_p.channels[ichan], ichan);
+						!chan_p.channels[ichan]->sdt_rewrite_skip ) //AND the generation was successful
+					send_packet=sdt_rewrite_new_channel_packet(channel_packet, &rewrite_vars, chan_p.channels[ichan], ichan);
 
 				/******************************************************/
 				//Rewrite EIT
 				/******************************************************/
 				if((send_packet==1) &&//no need to check paquets we don't send
 						(pid == 18) && //This is a EIT PID
-						(chan_p.channels[ichan].service_id) && //we have the service_id
+						(chan_p.channels[ichan]->service_id) && //we have the service_id
 						rewrite_vars.rewrite_eit == OPTION_ON) //AND we asked for EIT sorting
 				{
-					eit_rewrite_new_channel_packet(actual_ts_packet, &rewrite_vars, &chan_p.channels[ichan],
+					eit_rewrite_new_channel_packet(actual_ts_packet, &rewrite_vars, chan_p.channels[ichan],
 							&multi_p, &unicast_vars, scam_vars_ptr, &fds);
 					send_packet=0; //for EIT it is sent by the rewrite function itself
 				}
@@ -1779,25 +1917,58 @@ main (int argc, char **argv)
 					// Keep only PAT
 					if (chan_p.psi_tables_filtering==2 && pid>0) send_packet=0;
 				}
-				mumudvb_channel_t *channel = &chan_p.channels[ichan];
+				mumudvb_channel_t *channel = chan_p.channels[ichan];
 				/******************************************************/
 				//Ok we must send this packet,
 				// we add it to the channel buffer
 				/******************************************************/
 				if(send_packet==1)
 				{
-					buffer_func(channel, actual_ts_packet, &unicast_vars, &multi_p, scam_vars_ptr, &fds);
+					buffer_func(channel, channel_packet, channel_packet==actual_ts_packet, &unicast_vars, &multi_p, scam_vars_ptr, &fds);
 				}
 
 			}
 			pthread_mutex_unlock(&chan_p.lock);
 		}
+
+		/******************************************************/
+		//Whole transponder channels : slices of the read buffer are sent
+		/******************************************************/
+		pthread_mutex_lock(&chan_p.lock);
+		if(chan_p.num_full_ts && auto_p.autoconfiguration!=AUTOCONF_MODE_FULL
+#ifdef ENABLE_SCAM_SUPPORT
+				&& !scam_vars.need_pmt_get
+#endif
+				)
+		{
+			for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
+				if(chan_p.channels[ichan]->full_ts)
+					full_ts_send(chan_p.channels[ichan], card_buffer.reading_buffer, card_buffer.bytes_read, &chan_p, &unicast_vars, &multi_p, &fds);
+		}
+		//The partial datagrams which waited their latency budget are sent
+		if(flush_partial_datagrams)
+		{
+			uint64_t now_time=get_time();
+			for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
+				if(chan_p.channels[ichan]->nb_bytes && chan_p.channels[ichan]->max_latency && chan_p.channels[ichan]->datagram_deadline<=now_time
+#ifdef ENABLE_SCAM_DESCRAMBLER_SUPPORT
+						&& !(chan_p.channels[ichan]->scam_support && scam_vars.scam_support) //the buffer belongs to the scam send thread
+#endif
+						)
+					send_func(chan_p.channels[ichan], now_time, &unicast_vars, &multi_p, &fds);
+		}
+		//The datagrams queued in the io_uring ring reference the read buffer, they are sent now
+		if(multi_p.io_uring)
+			uring_flush();
+		//The read buffer will be reused : the packets waiting in the channels are copied
+		for (ichan = 0; ichan < chan_p.number_of_channels; ichan++)
+			if(chan_p.channels[ichan]->iovcnt)
+				channel_keep_data(chan_p.channels[ichan]);
+		pthread_mutex_unlock(&chan_p.lock);
 	}
 	/******************************************************/
 	//End of main loop
 	/******************************************************/
-	if(dump_file)
-		fclose(dump_file);
 	gettimeofday (&tv, (struct timezone *) NULL);
 	log_message( log_module,  MSG_INFO,
 			"End of streaming. We streamed during %ldd %ld:%02ld:%02ld\n",(tv.tv_sec - real_start_time )/86400,((tv.tv_sec - real_start_time) % 86400 )/3600,((tv.tv_sec - real_start_time) % 3600)/60,(tv.tv_sec - real_start_time) %60 );
@@ -1809,6 +1980,8 @@ main (int argc, char **argv)
 		log_message( log_module,  MSG_INFO,
 				"We have got %d overflow errors\n",card_buffer.overflow_number );
 	mumudvb_close_goto:
+	//The data waiting in the recordings is written
+	record_stop(&record_p);
 	//If the thread is not started, we don't send the unexisting address of monitor_thread_params
 	return mumudvb_close(no_daemon,
 			monitorthread == 0 ? NULL:&monitor_thread_params,
@@ -1907,28 +2080,33 @@ int mumudvb_close(int no_daemon,
 			log_message(log_module,MSG_WARN,"Monitor Thread badly closed: %s\n", strerror(iRet));
 	}
 
+	//The paced datagrams still waiting are sent before closing the sockets
+	pacing_stop(chan_p);
+	uring_stop();
+	timeshift_stop(chan_p);
+
 	for (curr_channel = 0; curr_channel < chan_p->number_of_channels; curr_channel++)
 	{
-		if(chan_p->channels[curr_channel].socketOut4>0)
-			close (chan_p->channels[curr_channel].socketOut4);
-		if(chan_p->channels[curr_channel].socketOut6>0)
-			close (chan_p->channels[curr_channel].socketOut6);
-		if(chan_p->channels[curr_channel].socketIn>0)
-			close (chan_p->channels[curr_channel].socketIn);
+		if(chan_p->channels[curr_channel]->socketOut4>0)
+			close (chan_p->channels[curr_channel]->socketOut4);
+		if(chan_p->channels[curr_channel]->socketOut6>0)
+			close (chan_p->channels[curr_channel]->socketOut6);
+		if(chan_p->channels[curr_channel]->socketIn>0)
+			close (chan_p->channels[curr_channel]->socketIn);
 		//Free the channel structures
-		if(chan_p->channels[curr_channel].pmt_packet)
-			free(chan_p->channels[curr_channel].pmt_packet);
-		chan_p->channels[curr_channel].pmt_packet=NULL;
+		if(chan_p->channels[curr_channel]->pmt_packet)
+			free(chan_p->channels[curr_channel]->pmt_packet);
+		chan_p->channels[curr_channel]->pmt_packet=NULL;
 
 
 #ifdef ENABLE_SCAM_SUPPORT
                 //Free the channel structures
-                if(chan_p->channels[curr_channel].scam_pmt_packet)
-                        free(chan_p->channels[curr_channel].scam_pmt_packet);
-                chan_p->channels[curr_channel].scam_pmt_packet=NULL;
+                if(chan_p->channels[curr_channel]->scam_pmt_packet)
+                        free(chan_p->channels[curr_channel]->scam_pmt_packet);
+                chan_p->channels[curr_channel]->scam_pmt_packet=NULL;
 
-		if (chan_p->channels[curr_channel].scam_support && scam_vars->scam_support) {
-			scam_channel_stop(&chan_p->channels[curr_channel]);
+		if (chan_p->channels[curr_channel]->scam_support && scam_vars->scam_support) {
+			scam_channel_stop(chan_p->channels[curr_channel]);
 		}
 #endif
 
@@ -1941,6 +2119,10 @@ int mumudvb_close(int no_daemon,
 
 	//We close the unicast connections and free the clients
 	unicast_freeing(unicast_vars);
+	unicast_snapshots_free();
+	unicast_events_free();
+	stats_shm_close();
+	analyzer_free();
 
 #ifdef ENABLE_CAM_SUPPORT
 	if(cam_p->cam_support)
@@ -1967,6 +2149,9 @@ int mumudvb_close(int no_daemon,
 
 	//autoconf variables freeing
 	autoconf_freeing(auto_p);
+	autoconf_cache_freeing(auto_p);
+	if(auto_p->service_id_list)
+		free(auto_p->service_id_list);
 
 	//sap variables freeing
 	if(monitor_thread_params && monitor_thread_params->sap_p->sap_messages4)
@@ -2010,6 +2195,9 @@ int mumudvb_close(int no_daemon,
 	}
 
 
+	//The channels table
+	mumu_chan_free(chan_p);
+
 	/*free the file descriptors*/
 	if(fds.pfds)
 		free(fds.pfds);
@@ -2029,6 +2217,7 @@ int mumudvb_close(int no_daemon,
 	log_message( log_module,  MSG_INFO,"========== MuMuDVB version %s is stopping with ExitCode %d ==========",VERSION,ExitCode);
 
 	// Freeing log ressources
+	log_thread_stop();
 	if(log_params.log_file)
 	{
 		fclose(log_params.log_file);
@@ -2092,6 +2281,10 @@ void *monitor_func(void* arg)
 	double time_no_diff=0;
 	int num_big_buffer_show=0;
 	int autoconf;
+	//Copy of the table of the channels, for rendering the snapshots without the channels lock
+	mumudvb_channel_t **snapshot_channels=NULL;
+	int snapshot_channels_size=0;
+	int snapshot_num_channels;//-1 if the snapshots are not made this time
 
 	gettimeofday (&tv, (struct timezone *) NULL);
 	monitor_start = tv.tv_sec + tv.tv_usec/1000000;
@@ -2133,7 +2326,7 @@ void *monitor_func(void* arg)
 		/*autoconfiguration*/
 		/*We check if we reached the autoconfiguration timeout*/
 		pthread_mutex_lock(&params->auto_p->lock);
-		if(params->auto_p->autoconfiguration)
+		if(params->auto_p->autoconfiguration || params->auto_p->cache_verify)
 		{
 			int iRet;
 			//autoconf_poll deals with the locks
@@ -2145,10 +2338,11 @@ void *monitor_func(void* arg)
 		autoconf=params->auto_p->autoconfiguration;//to reduce the lock range we store the status
 		//this value is not going from null values to non zero values due to the sequencial implementation of autoconfiguration
 		pthread_mutex_unlock(&params->auto_p->lock);
+		snapshot_num_channels=-1;
 		pthread_mutex_lock(&params->chan_p->lock);
-		if(!autoconf)
+		if(autoconf!=AUTOCONF_MODE_FULL)
 		{
-			/*we are not doing autoconfiguration we can do something else*/
+			/*the channels are known (they are streamed as soon as their PMT is found), we can do something else*/
 			/*sap announces*/
 			sap_poll(params->sap_p,params->chan_p->number_of_channels,params->chan_p->channels,*params->multi_p, (long)monitor_now);
 
@@ -2168,14 +2362,16 @@ void *monitor_func(void* arg)
 				for (curr_channel = 0; curr_channel < params->chan_p->number_of_channels; curr_channel++)
 				{
 					mumudvb_channel_t *current;
-					current=&params->chan_p->channels[curr_channel];
+					current=params->chan_p->channels[curr_channel];
 					pthread_mutex_lock(&current->stats_lock);
 					if (time_interval!=0)
-						params->chan_p->channels[curr_channel].traffic=((float)params->chan_p->channels[curr_channel].sent_data)/time_interval*1/1000;
+						params->chan_p->channels[curr_channel]->traffic=((float)params->chan_p->channels[curr_channel]->sent_data)/time_interval*1/1000;
 					else
-						params->chan_p->channels[curr_channel].traffic=0;
-					params->chan_p->channels[curr_channel].sent_data=0;
+						params->chan_p->channels[curr_channel]->traffic=0;
+					params->chan_p->channels[curr_channel]->sent_data=0;
 					pthread_mutex_unlock(&current->stats_lock);
+					//jumbo datagrams for the channels with enough bitrate
+					channel_update_packing(current);
 				}
 			}
 
@@ -2240,7 +2436,7 @@ void *monitor_func(void* arg)
 			for (curr_channel = 0; curr_channel < params->chan_p->number_of_channels; curr_channel++)
 			{
 				mumudvb_channel_t *current;
-				current=&params->chan_p->channels[curr_channel];
+				current=params->chan_p->channels[curr_channel];
 				pthread_mutex_lock(&current->stats_lock);
 				/* Calculation of the ratio (percentage) of scrambled packets received*/
 				if (current->num_packet >0 && current->num_scrambled_packets>10)
@@ -2277,9 +2473,9 @@ void *monitor_func(void* arg)
 				for (curr_pid = 0; curr_pid < current->num_pids; curr_pid++)
 				{
 					if (current->pids_num_scrambled_packets[curr_pid]>0)
-						current->pids_scrambled[curr_pid]=1;
+						current->desc->pids_scrambled[curr_pid]=1;
 					else
-						current->pids_scrambled[curr_pid]=0;
+						current->desc->pids_scrambled[curr_pid]=0;
 					current->pids_num_scrambled_packets[curr_pid]=0;
 				}
 				pthread_mutex_unlock(&current->stats_lock);
@@ -2301,7 +2497,7 @@ void *monitor_func(void* arg)
 				for (curr_channel = 0; curr_channel < params->chan_p->number_of_channels; curr_channel++)
 				{
 					mumudvb_channel_t *current;
-					current=&params->chan_p->channels[curr_channel];
+					current=params->chan_p->channels[curr_channel];
 					double packets_per_sec;
 					int num_scrambled;
 					pthread_mutex_lock(&current->stats_lock);
@@ -2328,7 +2524,7 @@ void *monitor_func(void* arg)
 								current->name, params->tune_p->card);
 						current->streamed_channel = 1;  // update
 						if(params->sap_p->sap == OPTION_ON)
-							sap_update(&params->chan_p->channels[curr_channel], params->sap_p, curr_channel, *params->multi_p); //Channel status changed, we update the sap announces
+							sap_update(params->chan_p->channels[curr_channel], params->sap_p, curr_channel, *params->multi_p); //Channel status changed, we update the sap announces
 					}
 					else if ((current->streamed_channel) && (packets_per_sec < params->stats_infos->down_threshold))
 					{
@@ -2337,7 +2533,7 @@ void *monitor_func(void* arg)
 								current->name, params->tune_p->card);
 						current->streamed_channel = 0;  // update
 						if(params->sap_p->sap == OPTION_ON)
-							sap_update(&params->chan_p->channels[curr_channel], params->sap_p, curr_channel, *params->multi_p); //Channel status changed, we update the sap announces
+							sap_update(params->chan_p->channels[curr_channel], params->sap_p, curr_channel, *params->multi_p); //Channel status changed, we update the sap announces
 					}
 				}
 			}
@@ -2345,10 +2541,10 @@ void *monitor_func(void* arg)
 			for (curr_channel = 0; curr_channel < params->chan_p->number_of_channels; curr_channel++)
 			{
 				mumudvb_channel_t *current;
-				current=&params->chan_p->channels[curr_channel];
+				current=params->chan_p->channels[curr_channel];
 				pthread_mutex_lock(&current->stats_lock);
-				params->chan_p->channels[curr_channel].num_packet = 0;
-				params->chan_p->channels[curr_channel].num_scrambled_packets = 0;
+				params->chan_p->channels[curr_channel]->num_packet = 0;
+				params->chan_p->channels[curr_channel]->num_scrambled_packets = 0;
 				pthread_mutex_unlock(&current->stats_lock);
 			}
 			last_updown_check=monitor_now;
@@ -2362,7 +2558,7 @@ void *monitor_func(void* arg)
 			/*******************************************/
 			int count_of_active_channels=0;
 			for (curr_channel = 0; curr_channel < params->chan_p->number_of_channels; curr_channel++)
-				if (params->chan_p->channels[curr_channel].streamed_channel)
+				if (params->chan_p->channels[curr_channel]->streamed_channel)
 					count_of_active_channels++;
 
 			/*Time no diff is the time when we got 0 active channels*/
@@ -2389,12 +2585,12 @@ void *monitor_func(void* arg)
 
 
 #ifdef ENABLE_SCAM_SUPPORT
-			if (scam_vars->scam_support) {
+			if (scam_vars->scam_support && !autoconf) {
 				/*******************************************/
 				/* we check num of packets in ring buffer                */
 				/*******************************************/
 				for (curr_channel = 0; curr_channel < params->chan_p->number_of_channels; curr_channel++) {
-					mumudvb_channel_t *channel = &params->chan_p->channels[curr_channel];
+					mumudvb_channel_t *channel = params->chan_p->channels[curr_channel];
 					if (channel->scam_support) {
 						//send capmt if needed
 						if (channel->need_scam_ask==CAM_NEED_ASK) {
@@ -2441,14 +2637,54 @@ void *monitor_func(void* arg)
 			if (write_streamed_channels)
 				gen_file_streamed_channels(params->filename_channels_streamed, params->filename_channels_not_streamed, params->chan_p->number_of_channels, params->chan_p->channels);
 
+			/*******************************************/
+			/* Live events sent to the HTTP clients    */
+			/*******************************************/
+			if(params->unicast_vars->unicast)
+			{
+				unicast_events_update(params->unicast_vars, params->chan_p->number_of_channels, params->chan_p->channels, params->strengthparams);
+				//The table can be reallocated by the main thread, the channels stay until the end
+				if(snapshot_channels_size<params->chan_p->number_of_channels)
+				{
+					mumudvb_channel_t **tmp;
+					tmp=realloc(snapshot_channels,params->chan_p->number_of_channels*sizeof(mumudvb_channel_t *));
+					if(tmp!=NULL)
+					{
+						snapshot_channels=tmp;
+						snapshot_channels_size=params->chan_p->number_of_channels;
+					}
+					else
+						log_message( log_module,  MSG_ERROR,"Problem with realloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+				}
+				if(snapshot_channels_size>=params->chan_p->number_of_channels)
+				{
+					snapshot_num_channels=params->chan_p->number_of_channels;
+					if(snapshot_num_channels)
+						memcpy(snapshot_channels,params->chan_p->channels,snapshot_num_channels*sizeof(mumudvb_channel_t *));
+				}
+			}
+			//Description of the channels in the statistics segment
+			stats_shm_update(params->chan_p->channels, params->chan_p->number_of_channels);
+
 
 		}
 		pthread_mutex_unlock(&params->chan_p->lock);
 
+		//Bitrates of the PIDs of the transponder, the channels are not needed
+		analyzer_update();
+
+		/*******************************************/
+		/* Snapshots of the monitoring pages,      */
+		/* rendered without the channels lock      */
+		/*******************************************/
+		if(snapshot_num_channels>=0)
+			unicast_snapshots_update(params->unicast_vars, snapshot_num_channels, snapshot_channels, params->strengthparams, params->auto_p, params->cam_p_v, params->scam_vars_v);
+
 		for(i=0;i<params->wait_time && !params->threadshutdown;i++)
 			usleep(100000);
 	}
 
+	free(snapshot_channels);
 	log_message(log_module,MSG_DEBUG, "Monitor thread stopping, it lasted %f seconds\n", monitor_now);
 	return 0;
 
@@ -67,8 +67,8 @@
 /**the number of pids by channel*/
 #define MAX_PIDS     128
 
-/**the maximum channel number*/
-#define MAX_CHANNELS		128
+/**the channels table grows by this number of channels*/
+#define CHANNELS_ALLOC_STEP	32
 
 /**Size of an MPEG2-TS packet*/
 #define TS_PACKET_SIZE 188
@@ -92,6 +92,15 @@ We cannot discover easily the MTU with unconnected UDP
 7*188 plus margin
  */
 #define MAX_UDP_SIZE 1320
+/** Maximum size of the jumbo datagrams (option multicast_jumbo) : 47*188, fits in a 9000 bytes MTU with the IPv6, UDP and RTP headers*/
+#define MAX_UDP_SIZE_JUMBO 8836
+/** Latency budget used to choose the size of the jumbo datagrams when no multicast_max_latency is set (ms)*/
+#define PACKING_DEFAULT_LATENCY 50
+/** Maximum number of parts of a datagram (RTP header + data in the channel buffer + one part per packet)*/
+#define CHANNEL_IOV_MAX (MAX_UDP_SIZE_JUMBO/TS_PACKET_SIZE+2)
+
+/** Metrics : number of buckets of the latency histograms (+Inf excluded), the bounds are in metrics.c*/
+#define METRICS_LATENCY_BUCKETS 13
 
 /**the max mandatory pid number*/
 #define MAX_MANDATORY_PID_NUMBER   32
@@ -205,6 +214,9 @@ typedef struct {
 	unsigned int to_send;
 	/** Read index of buffer for sending thread */
 	unsigned int read_send_idx;
+	/** Statistics : descrambling batches and scrambled packets in them */
+	uint64_t batches;
+	uint64_t batch_packets;
 }ring_buffer_t;  
 #endif
 
@@ -234,6 +246,8 @@ typedef struct card_buffer_t{
 	int overflow_number;
 	/**The maximum size of the thread buffer (in packets)*/
 	int max_thread_buffer_size;
+	/**Metrics : when the first data of the thread buffer was read (us, get_time clock)*/
+	uint64_t write_buffer_time;
 }card_buffer_t;
 
 
@@ -252,15 +266,138 @@ struct unicast_client_t;
  *    without the thread being shut down first)
  *  - the odd/even keys, since they have their own locking.
  */
+/**@brief The descriptive data of a channel, kept out of the per packet data
+ *
+ * Allocated with the channel by mumu_chan_reserve
+ */
+typedef struct mumudvb_channel_desc_t{
+	/**the channel pids type (PMT, audio, video etc)*/
+	int pids_type[MAX_PIDS];
+	/**the channel pids language (ISO639 - 3 characters)*/
+	char pids_language[MAX_PIDS][4];
+	/**tell if the PID is scrambled (1) or not (0)*/
+	char pids_scrambled[MAX_PIDS];
+	/**The ca system ids*/
+	int ca_sys_id[32];
+	/**Autoconfiguration : when we started to wait for the PMT (usec, see get_time)*/
+	uint64_t autoconf_wait_start;
+	/**Autoconfiguration : time needed to get the PMT, in ms (-1 if not found yet)*/
+	int autoconf_latency;
+	/**The multicast ip address*/
+	char ip4Out[20];
+	/**The ipv6 multicast ip address*/
+	char ip6Out[IPV6_CHAR_LEN];
+	/**The sap playlist group*/
+	char sap_group[SAP_GROUP_LENGTH];
+}mumudvb_channel_desc_t;
+
+/**@brief The datagram being built and the latency histogram of a channel, kept out of the per packet data
+ *
+ * Allocated with the channel by mumu_chan_reserve. Only the thread sending the channel writes it
+ */
+typedef struct mumudvb_channel_datagram_t{
+	/**the parts of the datagram : iov[0] for the RTP header, then the packets referenced in the read buffer or copied in buf*/
+	struct iovec iov[CHANNEL_IOV_MAX];
+	/**Metrics : histogram of the time between the DVR read and the sending of the datagrams*/
+	uint64_t latency[METRICS_LATENCY_BUCKETS+1];
+	uint64_t latency_sum;
+	/**the RTP header (just before the buffer so it can be sended together)*/
+	unsigned char buf_with_rtp_header[RTP_HEADER_LEN];
+	/**the buffer wich will be sent once it's full*/
+	unsigned char buf[MAX_UDP_SIZE_JUMBO];
+}mumudvb_channel_datagram_t;
+
 typedef struct mumudvb_channel_t{
+	/* The channels are scanned for each packet received : the data used per packet
+	 * is kept together at the beginning of the structure, the data used by the monitoring
+	 * and the autoconfiguration comes after. The datagram buffer is in datagram, the descriptive
+	 * tables and strings are in desc */
+
+	/**number of channel pids*/
+	int num_pids;
+	/**the channel pids*/
+	int pids[MAX_PIDS];
+	/**pmt pid number*/
+	int pmt_pid;
+	/**Transport stream ID*/
+	int service_id;
+	/**is the channel autoconfigurated ?*/
+	int autoconfigurated;
+	/**Autoconfiguration : the channel waits for its PMT, nothing is streamed yet*/
+	int autoconf_wait_pmt;
+	/** If there is no service id for the channel found, we skip sdt rewrite */
+	int sdt_rewrite_skip;
+	/**Whole transponder channel (pid 8192) sent directly from the read buffer, see full_ts_send*/
+	int full_ts;
+
 	/** Mutex for statistics counters. */
 	pthread_mutex_t stats_lock;
-	/** The logical channel number*/
-	int logical_channel_number;
 	/**Tell the total packet number (without pmt) for the scrambling ratio and up/down detection*/
 	int num_packet;
 	/**Tell the scrambled packet number (without pmt) for the scrambling ratio*/
 	int num_scrambled_packets;
+	/**The data sent to this channel*/
+	long sent_data;
+	/**Metrics : packets and bytes sent since the start, packets dropped by the queues of the clients*/
+	uint64_t sent_packets;
+	uint64_t sent_bytes;
+	uint64_t unicast_dropped_packets;
+
+	/**number of bytes actually in the buffer*/
+	int nb_bytes;
+	/**the datagram is sent when it cannot take another packet within this size (see channel_init_packing)*/
+	int udp_size;
+	/**Maximum time a packet waits in a partial datagram (ms, 0 : the datagram is sent when full)*/
+	int max_latency;
+	/**Time at which the partial datagram has to be sent (us, get_time clock)*/
+	uint64_t datagram_deadline;
+	/**Metrics : when the first packet of the datagram was read (us, 0 if not measured) and when it was put in the channel buffer*/
+	uint64_t datagram_start;
+	uint64_t datagram_process;
+	/**The counters of the channel in the statistics segment (NULL if none, see stats_shm.c)*/
+	struct stats_shm_channel_t *stats_shm;
+	/**number of parts of the datagram in datagram->iov (0 : the datagram is only in datagram->buf)*/
+	int iovcnt;
+	/**The datagram being built and the latency histogram, see mumudvb_channel_datagram_t*/
+	struct mumudvb_channel_datagram_t *datagram;
+	/** The packet number for rtp*/
+	int rtp_packet_num;
+	/**The multicast output socket*/
+	int socketOut4;
+	/**The multicast output socket*/
+	int socketOut6;
+	/**Unicast clients*/
+	struct unicast_client_t *clients;
+	/**Zero copy HTTP unicast : the data is written once in this pipe (see unicast_queue.c)*/
+	int unicast_pipe[2];
+	int unicast_pipe_open;
+	/**Fast channel start : the last PSI and the stream since the last random access point (see unicast_queue.c)*/
+	struct unicast_cache_t *unicast_cache;
+	/**Timeshift ring of the channel (see timeshift.c), allocated with the first datagram*/
+	int timeshift_mode;
+	struct channel_timeshift_t *timeshift;
+	/**Recording of the channel (see recorder.c), started with the first datagram*/
+	int record_mode;
+	struct recording_t *recording;
+	/**Output pacing of the multicast (see pacing.c), the pacer is allocated with the first datagram*/
+	int pacing_mode;
+	struct channel_pacer_t *pacer;
+	/**Index+1 of the sockets registered in the io_uring ring (0 : not registered), see uring.c*/
+	int uring_file4;
+	int uring_file6;
+	/**The multicast output socket*/
+	struct sockaddr_in sOut4;
+	/**The multicast output socket*/
+	struct sockaddr_in6 sOut6;
+
+	/* End of the per packet data */
+
+	/**Datagram sizes : standard one and the biggest allowed by the MTU (jumbo datagrams)*/
+	int udp_size_std;
+	int udp_size_max;
+
+	/** The logical channel number*/
+	int logical_channel_number;
 	/**tell if this channel is actually streamed*/
 	int streamed_channel;
 	/**Ratio of scrambled packet versus all packets*/
@@ -271,34 +408,22 @@ typedef struct mumudvb_channel_t{
 	int scrambled_channel;
 	/**the channel name*/
 	char name[MAX_NAME_LEN];
+	/**The descriptive data, see mumudvb_channel_desc_t*/
+	mumudvb_channel_desc_t *desc;
 
-	/**the channel pids*/
-	int pids[MAX_PIDS];
-	/**the channel pids type (PMT, audio, video etc)*/
-	int pids_type[MAX_PIDS];
-	/**the channel pids language (ISO639 - 3 characters)*/
-	char pids_language[MAX_PIDS][4];
 	/**count the number of scrambled packets for the PID*/
 	int pids_num_scrambled_packets[MAX_PIDS];
-	/**tell if the PID is scrambled (1) or not (0)*/
-	char pids_scrambled[MAX_PIDS];
-	/**number of channel pids*/
-	int num_pids;
 
 	/** Channel Type (Radio, TV, etc) / service type*/
 	int channel_type;
-	/**Transport stream ID*/
-	int service_id;
-	/**pmt pid number*/
-	int pmt_pid;
 	/**PCR PID number*/
 	int pcr_pid;
 	/**Say if we need to ask this channel to the cam*/
 	int need_cam_ask;
 	/** When did we asked the channel to the CAM */
 	long cam_asking_time;
-	/**The ca system ids*/
-	int ca_sys_id[32];
+	/**The kernel paces the multicast of this channel (SO_TXTIME)*/
+	int pacing_txtime;
 	/** The version of the pmt */
 	int pmt_version;
 	/** Do the pmt needs to be updated ? */
@@ -364,39 +489,11 @@ typedef struct mumudvb_channel_t{
 
 
 
-	/**the RTP header (just before the buffer so it can be sended together)*/
-	unsigned char buf_with_rtp_header[RTP_HEADER_LEN];
-	/**the buffer wich will be sent once it's full*/
-	unsigned char buf[MAX_UDP_SIZE];
-	/**number of bytes actually in the buffer*/
-	int nb_bytes;
-	/**The data sent to this channel*/
-	long sent_data;
-
-	/** The packet number for rtp*/
-	int rtp_packet_num;
-
-	/**is the channel autoconfigurated ?*/
-	int autoconfigurated;
 
-	/**The multicast ip address*/
-	char ip4Out[20];
 	/**The multicast port*/
 	int portOut;
-	/**The multicast output socket*/
-	struct sockaddr_in sOut4;
-	/**The multicast output socket*/
-	int socketOut4;
-	/**The ipv6 multicast ip address*/
-	char ip6Out[IPV6_CHAR_LEN];
-	/**The multicast output socket*/
-	struct sockaddr_in6 sOut6;
-	/**The multicast output socket*/
-	int socketOut6;
 
 
-	/**Unicast clients*/
-	struct unicast_client_t *clients;
 	/**Unicast port (listening socket per channel) */
 	int unicast_port;
 	/**Unicast listening socket*/
@@ -404,19 +501,17 @@ typedef struct mumudvb_channel_t{
 	/**Unicast listening socket*/
 	int socketIn;
 
-	/**The sap playlist group*/
-	char sap_group[SAP_GROUP_LENGTH];
+	/**Tell if the SAP announce has to be regenerated (channel added or renamed while streaming)*/
+	int sap_need_update;
 
-	/**The generated pat to be sent*/
-	unsigned char generated_pat[TS_PACKET_SIZE]; /**@todo: allocate dynamically*/
+	/**The generated pat to be sent (allocated when PAT rewrite is used)*/
+	unsigned char *generated_pat;
 	/** The version of the generated pat */
 	int generated_pat_version;
-	/**The generated sdt to be sent*/
-	unsigned char generated_sdt[TS_PACKET_SIZE]; /**@todo: allocate dynamically*/
+	/**The generated sdt to be sent (allocated when SDT rewrite is used)*/
+	unsigned char *generated_sdt;
 	/** The version of the generated sdt */
 	int generated_sdt_version;
-	/** If there is no service id for the channel found, we skip sdt rewrite */
-	int sdt_rewrite_skip;
 	/** The version of the generated EIT */
 	int eit_section_to_send;
 	/** The table we are currently sending */
@@ -453,6 +548,12 @@ typedef struct multi_p_t{
 	char iface6[IF_NAMESIZE+1];
 	/** num mpeg packets in one sent packet */
 	unsigned char num_pack;
+	/** Default maximum time a packet waits in a partial datagram (ms, 0 : disabled) */
+	int max_latency;
+	/** Allow datagrams bigger than the standard size if the MTU of the interface allows them */
+	int jumbo;
+	/** Send the datagrams with io_uring (one system call per read buffer) */
+	int io_uring;
 }multi_p_t;
 
 /** No PSI tables filtering */
@@ -474,15 +575,21 @@ typedef struct mumu_chan_p_t{
 	int filter_transport_error;
 	/** Do we do filtering to keep only PSI tables (without DVB tables) ? **/
 	int psi_tables_filtering;
-	/** The channels array */
-	mumudvb_channel_t channels[MAX_CHANNELS];  /**@todo use realloc*/
+	/** Do we drop the null packets (pid 8191) of the whole transponder channels ? */
+	int drop_null_packets;
+	/** The number of channels using the whole transponder fast path */
+	int num_full_ts;
+	/** The table of the channels, allocated by mumu_chan_reserve. Each channel is allocated
+	 * on its own and never moves, only this table moves when it grows */
+	mumudvb_channel_t **channels;
+	/** The number of channels allocated */
+	int max_channels;
 	//Asked pids //used for filtering
 	/** this array contains the pids we want to filter,*/
 	uint8_t asked_pid[8193];
 	/** the number of channels who want this pid (used by autoconfiguration update)*/
 	uint8_t number_chan_asked_pid[8193];
-	/** The number of TS discontinuities per PID **/
-	int16_t continuity_counter_pid[8193]; //on 16 bits for storing the initial -1
+	/** Do we check the continuity (counted by the PID analyzer) ? **/
 	uint8_t check_cc;
 }mumu_chan_p_t;
 
@@ -498,6 +605,9 @@ typedef struct monitor_parameters_t{
 	struct tune_p_t *tune_p;
 	struct stats_infos_t *stats_infos;
 	void *scam_vars_v;
+	/** For the snapshots of the monitoring pages */
+	struct strength_parameters_t *strengthparams;
+	void *cam_p_v;
 	int server_id;
 	char *filename_channels_not_streamed;
 	char *filename_channels_streamed;
@@ -519,11 +629,17 @@ void mumu_free_string(mumu_string_t *string);
 
 
 int mumudvb_poll(fds_t *fds);
+int mumu_chan_reserve(mumu_chan_p_t *chan_p, int number);
+void mumu_chan_free(mumu_chan_p_t *chan_p);
 char *mumu_string_replace(char *source, int *length, int can_realloc, char *toreplace, char *replacement);
 int string_comput(char *string);
 uint64_t get_time(void);
-void buffer_func (mumudvb_channel_t *channel, unsigned char *ts_packet, struct unicast_parameters_t *unicast_vars, multi_p_t *multi_p, void *scam_vars_v, fds_t *fds);
+void buffer_func (mumudvb_channel_t *channel, unsigned char *ts_packet, int in_read_buffer, struct unicast_parameters_t *unicast_vars, multi_p_t *multi_p, void *scam_vars_v, fds_t *fds);
+void channel_keep_data(mumudvb_channel_t *channel);
+void channel_init_packing(mumudvb_channel_t *channel, multi_p_t *multi_p);
+void channel_update_packing(mumudvb_channel_t *channel);
 void send_func(mumudvb_channel_t *channel, uint64_t now_time, struct unicast_parameters_t *unicast_vars, multi_p_t *multi_p, fds_t *fds);
+void full_ts_send(mumudvb_channel_t *channel, unsigned char *buffer, int len, mumu_chan_p_t *chan_p, struct unicast_parameters_t *unicast_vars, multi_p_t *multi_p, fds_t *fds);
 
 
 long int mumu_timing();
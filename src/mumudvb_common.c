@@ -35,6 +35,14 @@
 #include "errors.h"
 #include "rtp.h"
 #include "unicast_http.h"
+#include "network.h"
+#include "pacing.h"
+#include "uring.h"
+#include "timeshift.h"
+#include "recorder.h"
+#include "metrics.h"
+#include "stats_shm.h"
+#include "probes.h"
 
 #include <sys/poll.h>
 #include <sys/time.h>
@@ -42,6 +50,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <unistd.h>
 #include "scam_common.h"
 
 
@@ -299,9 +308,226 @@ uint64_t get_time(void) {
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	return (ts.tv_sec * 1000000ll + ts.tv_nsec / 1000);
 }
+/** @brief Make room for at least number channels in the channels table
+ * The table grows by CHANNELS_ALLOC_STEP channels, the new channels are allocated, cleared and initialised.
+ * Each channel is allocated on its own and never moves : threads and unicast clients can keep pointers to them.
+ * Only the table of pointers moves, chan_p->lock must be held if other threads are running.
+ *
+ * @param chan_p the channels
+ * @param number the number of channels needed
+ */
+int mumu_chan_reserve(mumu_chan_p_t *chan_p, int number)
+{
+	mumudvb_channel_t **channels;
+	mumudvb_channel_t *channel;
+	int new_max,ichan;
+
+	if(number<=chan_p->max_channels)
+		return 0;
+	new_max=((number+CHANNELS_ALLOC_STEP-1)/CHANNELS_ALLOC_STEP)*CHANNELS_ALLOC_STEP;
+	channels=realloc(chan_p->channels,sizeof(mumudvb_channel_t *)*new_max);
+	if(channels==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with realloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		set_interrupted(ERROR_MEMORY<<8);
+		return -1;
+	}
+	chan_p->channels=channels;
+	for (ichan = chan_p->max_channels; ichan < new_max; ichan++)
+	{
+		channel=calloc(1,sizeof(mumudvb_channel_t));
+		if(channel!=NULL)
+		{
+			channel->desc=calloc(1,sizeof(mumudvb_channel_desc_t));
+			channel->datagram=calloc(1,sizeof(mumudvb_channel_datagram_t));
+		}
+		if(channel==NULL || channel->desc==NULL || channel->datagram==NULL)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			set_interrupted(ERROR_MEMORY<<8);
+			if(channel!=NULL)
+			{
+				free(channel->desc);
+				free(channel->datagram);
+			}
+			free(channel);
+			chan_p->max_channels=ichan;
+			return -1;
+		}
+		pthread_mutex_init(&channel->stats_lock, NULL);
+#ifdef ENABLE_SCAM_SUPPORT
+#ifdef ENABLE_SCAM_DESCRAMBLER_SUPPORT
+		pthread_mutex_init(&channel->cw_lock, NULL);
+#endif
+		channel->camd_socket = -1;
+#endif
+		channel->generated_pat_version=-1;
+		channel->generated_sdt_version=-1;
+		channels[ichan]=channel;
+	}
+	log_message( log_module, MSG_DEBUG,"Channels table : room for %d channels\n",new_max);
+	chan_p->max_channels=new_max;
+	return 0;
+}
+
+/** @brief Free the channels table */
+void mumu_chan_free(mumu_chan_p_t *chan_p)
+{
+	int ichan;
+	for (ichan = 0; ichan < chan_p->max_channels; ichan++)
+	{
+		if(chan_p->channels[ichan]->generated_pat)
+			free(chan_p->channels[ichan]->generated_pat);
+		if(chan_p->channels[ichan]->generated_sdt)
+			free(chan_p->channels[ichan]->generated_sdt);
+		if(chan_p->channels[ichan]->unicast_pipe_open)
+		{
+			close(chan_p->channels[ichan]->unicast_pipe[0]);
+			close(chan_p->channels[ichan]->unicast_pipe[1]);
+		}
+		unicast_cache_free(chan_p->channels[ichan]);
+		free(chan_p->channels[ichan]->desc);
+		free(chan_p->channels[ichan]->datagram);
+		free(chan_p->channels[ichan]);
+	}
+	free(chan_p->channels);
+	chan_p->channels=NULL;
+	chan_p->max_channels=0;
+}
+
+/** @brief Compute the datagram sizes of a channel, once its sockets are open
+ * The standard datagrams take as many packets as MAX_UDP_SIZE allows. With the option
+ * multicast_jumbo the datagrams can grow up to what the MTU of the interface allows
+ * (see channel_update_packing).
+ */
+void channel_init_packing(mumudvb_channel_t *channel, multi_p_t *multi_p)
+{
+	int header_len,mtu,mtu6,size;
+
+	header_len=multi_p->rtp_header?RTP_HEADER_LEN:0;
+	channel->udp_size_std=(MAX_UDP_SIZE-header_len)/TS_PACKET_SIZE*TS_PACKET_SIZE;
+	channel->udp_size_max=channel->udp_size_std;
+	if(!channel->max_latency)
+		channel->max_latency=multi_p->max_latency;
+	if(multi_p->multicast && multi_p->jumbo)
+	{
+		mtu=mtu6=-1;
+		if(multi_p->multicast_ipv4)
+			mtu=get_path_mtu((struct sockaddr *)&channel->sOut4, sizeof(channel->sOut4), multi_p->iface4)-20-8; //IP and UDP headers
+		if(multi_p->multicast_ipv6)
+			mtu6=get_path_mtu((struct sockaddr *)&channel->sOut6, sizeof(channel->sOut6), multi_p->iface6)-40-8;
+		//both families are sent with the same datagrams
+		if(multi_p->multicast_ipv4 && multi_p->multicast_ipv6 && mtu6<mtu)
+			mtu=mtu6;
+		else if(!multi_p->multicast_ipv4)
+			mtu=mtu6;
+		size=mtu-header_len;
+		if(size>MAX_UDP_SIZE_JUMBO)
+			size=MAX_UDP_SIZE_JUMBO;
+		size-=size%TS_PACKET_SIZE;
+		if(size>channel->udp_size_std)
+		{
+			channel->udp_size_max=size;
+			log_message( log_module,  MSG_DEBUG,"Channel \"%s\" : jumbo datagrams allowed, up to %d bytes\n", channel->name, size);
+		}
+		else
+			log_message( log_module,  MSG_DETAIL,"Channel \"%s\" : the MTU doesn't allow jumbo datagrams\n", channel->name);
+	}
+	if(channel->udp_size<channel->udp_size_std || channel->udp_size>channel->udp_size_max)
+		channel->udp_size=channel->udp_size_std;
+}
+
+/** @brief Adapt the datagram size of a channel to its bitrate
+ * A channel uses datagrams as big as it fills within its latency budget, between the
+ * standard and the jumbo size. Called after the traffic computation.
+ */
+void channel_update_packing(mumudvb_channel_t *channel)
+{
+	int budget,size;
+	if(channel->udp_size_max<=channel->udp_size_std)
+		return;
+	budget=channel->max_latency?channel->max_latency:PACKING_DEFAULT_LATENCY;
+	size=(int)(channel->traffic*budget); //kB/s * ms = bytes
+	size-=size%TS_PACKET_SIZE;
+	if(size<channel->udp_size_std)
+		size=channel->udp_size_std;
+	if(size>channel->udp_size_max)
+		size=channel->udp_size_max;
+	if(size!=channel->udp_size)
+		log_message( log_module,  MSG_DEBUG,"Channel \"%s\" : datagram size %d bytes\n", channel->name, size);
+	channel->udp_size=size;
+}
+
+/** @brief Add a packet to the datagram of the channel
+ * If the packet is in the read buffer (and not modified later) it is only referenced, it will be
+ * sent from there (scatter/gather) or copied by channel_keep_data before the read buffer is reused.
+ * Otherwise it is copied to the channel buffer.
+ * The parts of the datagram are in channel->datagram->iov[1..iovcnt] (iov[0] is for the RTP header), when
+ * iovcnt is 0 the datagram is in one piece in the channel buffer.
+ */
+static void channel_add_packet(mumudvb_channel_t *channel, unsigned char *ts_packet, int in_read_buffer)
+{
+	struct iovec *last;
+	//First packet of the datagram : it will not wait more than the latency budget
+	if(!channel->nb_bytes && channel->max_latency)
+		channel->datagram_deadline=get_time()+(uint64_t)channel->max_latency*1000;
+	if(!channel->nb_bytes)
+	{
+		channel->datagram_start=metrics_read_time();
+		channel->datagram_process=metrics_process_time();
+	}
+	if(!in_read_buffer)
+	{
+		memcpy(channel->datagram->buf + channel->nb_bytes, ts_packet, TS_PACKET_SIZE);
+		if(!channel->iovcnt)
+		{
+			channel->nb_bytes += TS_PACKET_SIZE;
+			return;
+		}
+		ts_packet=channel->datagram->buf + channel->nb_bytes;
+	}
+	else if(!channel->iovcnt && channel->nb_bytes)
+	{
+		//The data already copied becomes the first part
+		channel->datagram->iov[1].iov_base=channel->datagram->buf;
+		channel->datagram->iov[1].iov_len=channel->nb_bytes;
+		channel->iovcnt=1;
+	}
+	last=&channel->datagram->iov[channel->iovcnt];
+	//The packet follows the previous part : the part grows
+	if(channel->iovcnt && (unsigned char *)last->iov_base+last->iov_len==ts_packet)
+		last->iov_len+=TS_PACKET_SIZE;
+	else
+	{
+		last++;
+		last->iov_base=ts_packet;
+		last->iov_len=TS_PACKET_SIZE;
+		channel->iovcnt++;
+	}
+	channel->nb_bytes += TS_PACKET_SIZE;
+}
+
+/** @brief Copy the packets referenced by the channel to the channel buffer
+ * This has to be done before the read buffer is reused, for the data not sent yet
+ * (and before giving the data to the unicast clients).
+ */
+void channel_keep_data(mumudvb_channel_t *channel)
+{
+	int i,len=0;
+	for(i=1;i<=channel->iovcnt;i++)
+	{
+		//the copied packets are already at their place
+		if(channel->datagram->iov[i].iov_base!=channel->datagram->buf+len)
+			memcpy(channel->datagram->buf+len, channel->datagram->iov[i].iov_base, channel->datagram->iov[i].iov_len);
+		len+=channel->datagram->iov[i].iov_len;
+	}
+	channel->iovcnt=0;
+}
+
 /** @brief function for buffering demultiplexed data.
+ * @param in_read_buffer the packet is in the read buffer and will not change until the end of its processing, it is not copied
  */
-void buffer_func (mumudvb_channel_t *channel, unsigned char *ts_packet, struct unicast_parameters_t *unicast_vars, multi_p_t *multi_p, void *scam_vars_v, fds_t *fds)
+void buffer_func (mumudvb_channel_t *channel, unsigned char *ts_packet, int in_read_buffer, struct unicast_parameters_t *unicast_vars, multi_p_t *multi_p, void *scam_vars_v, fds_t *fds)
 {
 	int pid;			/** pid of the current mpeg2 packet */
 	int ScramblingControl;
@@ -356,13 +582,13 @@ void buffer_func (mumudvb_channel_t *channel, unsigned char *ts_packet, struct u
 			send_packet=0;
 
 		if (send_packet) {
+			if(channel->pacer)
+				pacing_new_packet(channel, ts_packet);
 			// we fill the channel buffer
-			memcpy(channel->buf + channel->nb_bytes, ts_packet, TS_PACKET_SIZE);
-			channel->nb_bytes += TS_PACKET_SIZE;
+			channel_add_packet(channel, ts_packet, in_read_buffer);
 		}
 		//The buffer is full, we send it
-		if ((!multi_p->rtp_header && ((channel->nb_bytes + TS_PACKET_SIZE) > MAX_UDP_SIZE))
-				||(multi_p->rtp_header && ((channel->nb_bytes + RTP_HEADER_LEN + TS_PACKET_SIZE) > MAX_UDP_SIZE))) {
+		if ((channel->nb_bytes + TS_PACKET_SIZE) > channel->udp_size) {
 			now_time=get_time();
 			send_func(channel, now_time, unicast_vars, multi_p,  fds);
 		}
@@ -377,29 +603,65 @@ void buffer_func (mumudvb_channel_t *channel, unsigned char *ts_packet, struct u
  */
 void send_func (mumudvb_channel_t *channel, uint64_t now_time, struct unicast_parameters_t *unicast_vars, multi_p_t *multi_p, fds_t *fds)
 {
+	int queued=0;
 	//For bandwith measurement (traffic)
 	pthread_mutex_lock(&channel->stats_lock);
 	channel->sent_data+=channel->nb_bytes+20+8; // IP=20 bytes header and UDP=8 bytes header
 	if (multi_p->rtp_header) channel->sent_data+=RTP_HEADER_LEN;
+	channel->sent_packets+=channel->nb_bytes/TS_PACKET_SIZE;
+	channel->sent_bytes+=channel->nb_bytes;
 	pthread_mutex_unlock(&channel->stats_lock);
+	stats_shm_channel_sent(channel, channel->nb_bytes);
+	MUMUDVB_PROBE4(channel_send, channel->name, channel->service_id, channel->nb_bytes,
+			(channel->datagram_start && now_time>channel->datagram_start)?now_time-channel->datagram_start:0);
 
 
 		/********** MULTICAST *************/
+		//The paced datagrams are sent later by the pacer
+		if(multi_p->multicast && channel->pacing_mode!=PACING_OFF)
+			queued=pacing_send(channel, now_time);
+		if(multi_p->multicast && !queued && multi_p->rtp_header)
+		{
+			/****** RTP *******/
+			rtp_update_sequence_number(channel,now_time);
+		}
+		//The datagrams are queued in the io_uring ring and sent at the end of the read buffer
+		if(multi_p->multicast && !queued && multi_p->io_uring)
+			queued=uring_queue_send(channel, multi_p);
 		//if the multicast TTL is set to 0 we don't send the multicast packets
-		if(multi_p->multicast)
+		if(multi_p->multicast && !queued && channel->iovcnt)
+		{
+			//The datagram is made of several parts (packets referenced in the read buffer)
+			int first=1;
+			if(multi_p->rtp_header)
+			{
+				channel->datagram->iov[0].iov_base=channel->datagram->buf_with_rtp_header;
+				channel->datagram->iov[0].iov_len=RTP_HEADER_LEN;
+				first=0;
+			}
+			if(multi_p->multicast_ipv4)
+				sendudp_iov (channel->socketOut4,
+						&channel->sOut4,
+						channel->datagram->iov+first,
+						channel->iovcnt+1-first);
+			if(multi_p->multicast_ipv6)
+				sendudp6_iov (channel->socketOut6,
+						&channel->sOut6,
+						channel->datagram->iov+first,
+						channel->iovcnt+1-first);
+		}
+		else if(multi_p->multicast && !queued)
 		{
 			unsigned char *data;
 			int data_len;
 			if(multi_p->rtp_header)
 			{
-				/****** RTP *******/
-				rtp_update_sequence_number(channel,now_time);
-				data=channel->buf_with_rtp_header;
+				data=channel->datagram->buf_with_rtp_header;
 				data_len=channel->nb_bytes+RTP_HEADER_LEN;
 			}
 			else
 			{
-				data=channel->buf;
+				data=channel->datagram->buf;
 				data_len=channel->nb_bytes;
 			}
 			if(multi_p->multicast_ipv4)
@@ -414,10 +676,81 @@ void send_func (mumudvb_channel_t *channel, uint64_t now_time, struct unicast_pa
 						data_len);
 		}
 	/*********** UNICAST **************/
+	//The timeshift ring gets the datagram before the clients, the late ones send it from the ring
+	timeshift_add(channel);
+	record_channel(channel);
+	//The unicast clients (and their queues) and the fast start cache need the data in one piece
+	if((channel->clients || (unicast_vars->unicast && unicast_vars->fast_start)) && channel->iovcnt)
+		channel_keep_data(channel);
+	if(unicast_vars->unicast && unicast_vars->fast_start)
+		unicast_cache_add(channel);
 	unicast_data_send(channel, fds, unicast_vars);
 	/********* END of UNICAST **********/
+	metrics_datagram_sent(channel);
 	channel->nb_bytes = 0;
+	channel->iovcnt = 0;
+
+}
+
+/** @brief Whole transponder fast path
+ * The channels streaming the full transponder (pid 8192) don't need the per channel
+ * pid scan and rewrites : the packets of the read buffer are referenced in the datagrams
+ * (see channel_add_packet), consecutive packets make only one part.
+ *
+ * @param channel the channel
+ * @param buffer the packets read from the card
+ * @param len the number of bytes in the buffer
+ * @param chan_p the channels (for the filtering options)
+ */
+void full_ts_send(mumudvb_channel_t *channel, unsigned char *buffer, int len, mumu_chan_p_t *chan_p, struct unicast_parameters_t *unicast_vars, multi_p_t *multi_p, fds_t *fds)
+{
+	extern int dont_send_scrambled;
+	unsigned char *ts_packet;
+	int pos,pid,scrambled;
+	int num_packet=0,num_scrambled=0;
 
+	for(pos=0;(pos+TS_PACKET_SIZE)<=len;pos+=TS_PACKET_SIZE)
+	{
+		ts_packet=buffer+pos;
+		pid = ((ts_packet[1] & 0x1f) << 8) | (ts_packet[2]);
+		if (chan_p->filter_transport_error>0 && (ts_packet[1] & 0x80))
+			continue;
+		if (chan_p->drop_null_packets && pid==8191)
+			continue;
+		if (chan_p->psi_tables_filtering>0 && pid<32)
+		{
+			if (chan_p->psi_tables_filtering==PSI_TABLES_FILTERING_PAT_CAT_ONLY && pid>1) continue;
+			if (chan_p->psi_tables_filtering==PSI_TABLES_FILTERING_PAT_ONLY && pid>0) continue;
+		}
+		scrambled=(ts_packet[3] & 0xc0)?1:0;
+		//we don't count the PMT pid for up channels
+		if (pid != channel->pmt_pid)
+		{
+			num_packet++;
+			num_scrambled+=scrambled;
+		}
+		//avoid sending of scrambled channels if we asked to
+		if (dont_send_scrambled && scrambled && channel->pmt_pid)
+			continue;
+
+		if(channel->pacer)
+			pacing_new_packet(channel, ts_packet);
+		channel_add_packet(channel, ts_packet, 1);
+		//The datagram is full, we send it
+		if ((channel->nb_bytes + TS_PACKET_SIZE) > channel->udp_size)
+			send_func(channel, get_time(), unicast_vars, multi_p, fds);
+	}
+
+	pthread_mutex_lock(&channel->stats_lock);
+	channel->num_packet+=num_packet;
+	channel->num_scrambled_packets+=num_scrambled;
+	for (pos = 0; pos < channel->num_pids; pos++)
+		if (channel->pids[pos] == 8192)
+		{
+			channel->pids_num_scrambled_packets[pos]+=num_scrambled;
+			break;
+		}
+	pthread_mutex_unlock(&channel->stats_lock);
 }
 
 static int interrupted = 0;
@@ -0,0 +1,305 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * Reader of the statistics in shared memory
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Reader of the statistics segment written by MuMuDVB with the option stats_shm
+ *
+ * The segment is mapped read only, reading it doesn't disturb MuMuDVB. This program is also an
+ * example of the reading of the segment (see stats_shm.h for the layout).
+ *
+ * Usage : mumudvb_stats [-i interval_ms] [-n count] [-p] [-a] [-c] name
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "stats_shm.h"
+
+/** @brief Copy a group of values protected by a sequence lock
+ * @return 0 if ok, -1 if the writer kept it busy
+ */
+static int read_locked(const uint64_t *seq, void *dst, const void *src, size_t len)
+{
+	uint64_t before,after;
+	int tries;
+
+	for(tries=0;tries<1000;tries++)
+	{
+		before=__atomic_load_n(seq, __ATOMIC_ACQUIRE);
+		if(before&1)
+			continue;
+		memcpy(dst, src, len);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after=__atomic_load_n(seq, __ATOMIC_RELAXED);
+		if(before==after)
+			return 0;
+	}
+	return -1;
+}
+
+static uint64_t read_counter(const uint64_t *counter)
+{
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/** @brief Show the results of the analyzer for a PID, if any */
+static void show_analyzer(stats_shm_pid_t *pid)
+{
+	if(!read_counter(&pid->bitrate) && !read_counter(&pid->tei_errors))
+		return;
+	printf("                  %.1f kbit/s, %llu with error bit",
+			read_counter(&pid->bitrate)/1000.0, (unsigned long long)read_counter(&pid->tei_errors));
+	if(read_counter(&pid->pcr_count))
+		printf(", PCR : interval %uus jitter %uus, %llu repetition errors, %llu discontinuities",
+				__atomic_load_n(&pid->pcr_interval_max, __ATOMIC_RELAXED), __atomic_load_n(&pid->pcr_jitter_max, __ATOMIC_RELAXED),
+				(unsigned long long)read_counter(&pid->pcr_repetition_errors), (unsigned long long)read_counter(&pid->pcr_discontinuities));
+	printf("\n");
+}
+
+static double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "Usage : %s [-i interval_ms] [-n count] [-p] [-a] [-c] name\n"
+			"Show the statistics written by MuMuDVB in the shared memory segment name (option stats_shm)\n"
+			"  -i interval_ms : show the statistics every interval_ms, with the rates\n"
+			"  -n count : stop after count times (default : once without -i, forever with it)\n"
+			"  -p : show the PIDs of the channels\n"
+			"  -a : show all the PIDs of the transponder\n"
+			"  -c : show the HTTP clients\n", name);
+}
+
+/** @brief Map the segment and check its layout
+ * @return the segment, NULL on error
+ */
+static stats_shm_header_t *open_segment(char *name, size_t *size)
+{
+	char path[256];
+	struct stat st;
+	stats_shm_header_t *seg;
+	int fd;
+
+	if(!strncmp(name, "/dev/shm/", 9))
+		name+=8;
+	snprintf(path, sizeof(path), "%s%s", (name[0]=='/')?"":"/", name);
+	fd=shm_open(path, O_RDONLY, 0);
+	if(fd<0)
+	{
+		fprintf(stderr, "Cannot open the segment %s : %s\n", path, strerror(errno));
+		return NULL;
+	}
+	if(fstat(fd, &st) || (size_t)st.st_size<sizeof(stats_shm_header_t))
+	{
+		fprintf(stderr, "The segment %s is too small\n", path);
+		close(fd);
+		return NULL;
+	}
+	*size=st.st_size;
+	seg=mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(seg==MAP_FAILED)
+	{
+		fprintf(stderr, "Cannot map the segment %s : %s\n", path, strerror(errno));
+		return NULL;
+	}
+	if(__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE)!=STATS_SHM_MAGIC || seg->version!=STATS_SHM_VERSION ||
+			seg->header_size!=sizeof(stats_shm_header_t) || seg->channel_size!=sizeof(stats_shm_channel_t) ||
+			seg->client_size!=sizeof(stats_shm_client_t) || seg->size>*size)
+	{
+		fprintf(stderr, "The segment %s is not a MuMuDVB statistics segment of version %d\n", path, STATS_SHM_VERSION);
+		munmap(seg, *size);
+		return NULL;
+	}
+	return seg;
+}
+
+int main(int argc, char **argv)
+{
+	static stats_shm_channel_t channels[STATS_SHM_CHANNELS],previous[STATS_SHM_CHANNELS];
+	stats_shm_header_t *seg;
+	stats_shm_header_t description;
+	stats_shm_channel_t *shm_channels;
+	stats_shm_client_t *shm_clients,client;
+	stats_shm_pid_t *pids;
+	uint64_t seq;
+	size_t size;
+	double now,last=0,elapsed;
+	int interval=0,count=-1,show_pids=0,show_all_pids=0,show_clients=0;
+	int c,i,j,num_channels,pid;
+	uint64_t dvr_bytes,last_dvr_bytes=0;
+
+	while((c=getopt(argc, argv, "i:n:pach"))!=-1)
+	{
+		switch(c)
+		{
+		case 'i':
+			interval=atoi(optarg);
+			break;
+		case 'n':
+			count=atoi(optarg);
+			break;
+		case 'p':
+			show_pids=1;
+			break;
+		case 'a':
+			show_all_pids=1;
+			break;
+		case 'c':
+			show_clients=1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(optind!=argc-1)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	if(count<0)
+		count=interval?0:1;
+	seg=open_segment(argv[optind], &size);
+	if(seg==NULL)
+		return 2;
+	pids=(stats_shm_pid_t *)((char *)seg+seg->pids_offset);
+	shm_channels=(stats_shm_channel_t *)((char *)seg+seg->channels_offset);
+	shm_clients=(stats_shm_client_t *)((char *)seg+seg->clients_offset);
+	memset(previous, 0, sizeof(previous));
+
+	for(i=0;!count || i<count;i++)
+	{
+		if(i)
+			usleep(interval*1000);
+		now=now_seconds();
+		elapsed=last?now-last:0;
+		last=now;
+
+		//The descriptions of the channels, then the counters of each channel
+		if(read_locked(&seg->seq, &description, seg, sizeof(description)))
+			continue;
+		num_channels=description.num_channels;
+		if(num_channels>(int)seg->max_channels)
+			num_channels=seg->max_channels;
+		seq=description.seq;
+		memcpy(channels, shm_channels, num_channels*sizeof(stats_shm_channel_t));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(&seg->seq, __ATOMIC_RELAXED)!=seq)
+			continue;
+		for(j=0;j<num_channels;j++)
+			read_locked(&shm_channels[j].seq, &channels[j].seq, &shm_channels[j].seq,
+					sizeof(stats_shm_channel_t)-offsetof(stats_shm_channel_t, seq));
+
+		dvr_bytes=read_counter(&seg->dvr_bytes);
+		printf("MuMuDVB pid %d card %d tuner %d, up %llds, last update %llds ago\n",
+				description.process_id, description.card, description.tuner,
+				(long long)(time(NULL)-description.start_time), (long long)(time(NULL)-description.update_time));
+		printf("DVR : %llu reads, %llu bytes", (unsigned long long)read_counter(&seg->dvr_reads), (unsigned long long)dvr_bytes);
+		if(elapsed>0)
+			printf(" (%.1f kB/s)", (dvr_bytes-last_dvr_bytes)/elapsed/1000);
+		printf(", %llu overflows, %llu thread buffer full\n",
+				(unsigned long long)read_counter(&seg->dvr_overflows), (unsigned long long)read_counter(&seg->dvr_thread_full));
+		printf("TS : %llu packets, %llu with error bit, %llu continuity errors\n",
+				(unsigned long long)read_counter(&seg->ts_packets), (unsigned long long)read_counter(&seg->ts_errors),
+				(unsigned long long)read_counter(&seg->cc_errors));
+		if(read_counter(&seg->sync_errors) || read_counter(&seg->pat_errors))
+			printf("Analyzer : %llu sync errors, %llu PAT interval errors\n",
+					(unsigned long long)read_counter(&seg->sync_errors), (unsigned long long)read_counter(&seg->pat_errors));
+		last_dvr_bytes=dvr_bytes;
+
+		printf("%4s %6s %-24s %3s %5s %10s %14s %16s %10s\n", "num", "sid", "name", "up", "scr%", "kB/s", "packets", "bytes", "dropped");
+		for(j=0;j<num_channels;j++)
+		{
+			double rate=channels[j].traffic;
+			//With an interval the rate is measured here
+			if(elapsed>0 && previous[j].bytes<=channels[j].bytes)
+				rate=(channels[j].bytes-previous[j].bytes)/elapsed/1000;
+			printf("%4d %6d %-24.24s %3d %5d %10.1f %14llu %16llu %10llu\n", j+1, channels[j].service_id, channels[j].name,
+					channels[j].streamed, channels[j].scrambled_ratio, rate,
+					(unsigned long long)channels[j].packets, (unsigned long long)channels[j].bytes,
+					(unsigned long long)read_counter(&shm_channels[j].dropped));
+			if(show_pids)
+				for(c=0;c<channels[j].num_pids && c<STATS_SHM_CHANNEL_PIDS;c++)
+				{
+					pid=channels[j].pids[c];
+					if(pid<0 || pid>=STATS_SHM_PIDS)
+						continue;
+					printf("       pid %4d : %llu packets, %llu scrambled, %llu continuity errors\n", pid,
+							(unsigned long long)read_counter(&pids[pid].packets), (unsigned long long)read_counter(&pids[pid].scrambled),
+							(unsigned long long)read_counter(&pids[pid].cc_errors));
+					show_analyzer(&pids[pid]);
+				}
+		}
+		memcpy(previous, channels, num_channels*sizeof(stats_shm_channel_t));
+
+		if(show_all_pids)
+		{
+			printf("PIDs :\n");
+			for(pid=0;pid<STATS_SHM_PIDS-1;pid++)
+			{
+				if(!read_counter(&pids[pid].packets))
+					continue;
+				printf("       pid %4d : %llu packets, %llu scrambled, %llu continuity errors\n", pid,
+						(unsigned long long)read_counter(&pids[pid].packets), (unsigned long long)read_counter(&pids[pid].scrambled),
+						(unsigned long long)read_counter(&pids[pid].cc_errors));
+				show_analyzer(&pids[pid]);
+			}
+		}
+
+		if(show_clients)
+		{
+			printf("Clients :\n");
+			for(j=0;j<(int)seg->max_clients;j++)
+			{
+				if(read_locked(&shm_clients[j].seq, &client, &shm_clients[j], sizeof(client)) || !client.used)
+					continue;
+				client.ip[sizeof(client.ip)-1]='\0';
+				printf("  %s:%d channel %d (%s), %d bytes in queue, %llu packets dropped (%llu times), connected for %llds\n",
+						client.ip, client.port, client.channel+1,
+						(client.channel>=0 && client.channel<num_channels)?channels[client.channel].name:"?",
+						client.queue_bytes, (unsigned long long)client.dropped, (unsigned long long)client.drop_events,
+						(long long)(time(NULL)-client.start_time));
+			}
+		}
+		if(interval)
+			printf("\n");
+		fflush(stdout);
+	}
+	munmap(seg, size);
+	return 0;
+}
@@ -44,6 +44,7 @@ http://mumudvb.braice.net/mumudvb/test/
 #define NUM_FILES_TEST_AUTOCONF 5
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
@@ -53,23 +54,33 @@ http://mumudvb.braice.net/mumudvb/test/
 #include "log.h"
 #include "autoconf.h"
 #include "rewrite.h"
+#include "crc32.h"
+#include "unicast_http.h"
+#include "unicast_queue.h"
+#include "analyzer.h"
 
 //Prototypes
 void autoconf_free_services(mumudvb_service_t *services);
 int autoconf_read_sdt(unsigned char *buf,int len, mumudvb_service_t *services);
 void autoconf_sort_services(mumudvb_service_t *services);
+void unicast_client_queue_data(unicast_client_t *client, mumudvb_channel_t *channel, unicast_parameters_t *unicast_vars, unsigned char *data, int data_len);
 
 
 //Functions implemented here
 void autoconf_print_services(mumudvb_service_t *services);
 int autoconf_count_services(mumudvb_service_t *services);
+int test_request_parser(void);
+int test_crc32_kernels(void);
+int test_drop_policy(void);
+int test_analyzer_cc(void);
 
 
 
 
 int Interrupted;
 long real_start_time;
-multicast_parameters_t multicast_vars;
+int dont_send_scrambled=0;
+multi_p_t multi_p;
 extern log_params_t log_params;
 
 static char *log_module="======TEST======: ";
@@ -87,6 +98,7 @@ void press_enter_func(int press_enter)
 int main(void)
 {
   int press_enter = PRESS_ENTER;
+  int failures = 0;
 
   //We initalise the logging parameters
   log_params.verbosity = 999;
@@ -146,6 +158,12 @@ int main(void)
   n[3]=string_comput(strtok_r (NULL,".",&sptr));
   log_message( log_module, MSG_DEBUG,"%d.%d.%d.%d",n[0],n[1],n[2],n[3]);
 
+  /************************************* Unit tests, no test file needed ****************************/
+  failures += test_request_parser();
+  failures += test_crc32_kernels();
+  failures += test_drop_policy();
+  failures += test_analyzer_cc();
+
 
   /************************************* Testing the SDT parser *************************************/
   char *files_sdt[NUM_FILES_TEST_READ_SDT]={FILES_TEST_READ_SDT_TS};
@@ -272,13 +290,14 @@ int main(void)
     if(testfile!=NULL)
     {
       int iret;
-      mumudvb_chan_and_pids_t chan_and_pids;
-      memset(&chan_and_pids,0,sizeof(mumudvb_chan_and_pids_t));
+      mumu_chan_p_t chan_and_pids;
+      memset(&chan_and_pids,0,sizeof(mumu_chan_p_t));
+      pthread_mutex_init(&chan_and_pids.lock,NULL);
       chan_and_pids.number_of_channels=0;
 
       //autoconfiguration
-      autoconf_parameters_t autoconf_vars;
-      memset(&autoconf_vars,0,sizeof(autoconf_parameters_t));
+      auto_p_t autoconf_vars;
+      init_aconf_v(&autoconf_vars);
       autoconf_vars.autoconfiguration=AUTOCONF_MODE_FULL;
       autoconf_vars.autoconf_radios=1;
       autoconf_vars.autoconf_scrambled=1;
@@ -292,14 +311,14 @@ int main(void)
       unicast_vars.unicast=0;
 
       //multicast parameters
-      multicast_parameters_t multicast_vars;
-      memset(&multicast_vars,0,sizeof(multicast_parameters_t));
+      multi_p_t multicast_vars;
+      memset(&multicast_vars,0,sizeof(multi_p_t));
       multicast_vars.multicast=0;
 
       fds_t fds;
       memset(&fds,0,sizeof(fds_t));
-      tuning_parameters_t tuneparams;
-      memset(&tuneparams,0,sizeof(tuning_parameters_t));
+      tune_p_t tuneparams;
+      init_tune_v(&tuneparams);
 
       iret=autoconf_init(&autoconf_vars, chan_and_pids.channels,chan_and_pids.number_of_channels);
       if(iret)
@@ -318,7 +337,7 @@ int main(void)
         if(!(packet_count %100))
           log_message( log_module, MSG_DEBUG,"Packet count %d", packet_count);
 
-        iret = autoconf_new_packet(pid, actual_ts_packet, &autoconf_vars,  &fds, &chan_and_pids, &tuneparams, &multicast_vars, &unicast_vars, 0);
+        iret = autoconf_new_packet(pid, actual_ts_packet, &autoconf_vars,  &fds, &chan_and_pids, &tuneparams, &multicast_vars, &unicast_vars, 0, NULL);
 
       }
       log_message( log_module, MSG_INFO,"===================================================================\n");
@@ -326,7 +345,7 @@ int main(void)
       press_enter_func(press_enter);
       //if there is a partial service list, we force autoconf to go to the next step
       autoconf_vars.time_start_autoconfiguration=1;
-      autoconf_poll(100000, &autoconf_vars, &chan_and_pids, &tuneparams, &multicast_vars, &fds, &unicast_vars, 0);
+      autoconf_poll(100000, &autoconf_vars, &chan_and_pids, &tuneparams, &multicast_vars, &fds, &unicast_vars, 0, NULL);
       press_enter_func(press_enter);
       rewind(testfile);
       while(fread(actual_ts_packet,TS_PACKET_SIZE,1, testfile))
@@ -338,7 +357,7 @@ int main(void)
         if(!(packet_count %100))
           log_message( log_module, MSG_DEBUG,"Packet count %d", packet_count);
 
-        iret = autoconf_new_packet(pid, actual_ts_packet, &autoconf_vars,  &fds, &chan_and_pids, &tuneparams, &multicast_vars, &unicast_vars, 0);
+        iret = autoconf_new_packet(pid, actual_ts_packet, &autoconf_vars,  &fds, &chan_and_pids, &tuneparams, &multicast_vars, &unicast_vars, 0, NULL);
 
       }
       fclose(testfile);
@@ -378,10 +397,9 @@ int main(void)
             .sdt_needs_update=1,
             .full_sdt_ok=0,
             .sdt_continuity_counter=0,
-            .eit_sort=OPTION_OFF,
           };
-          for (int curr_channel = 0; curr_channel < MAX_CHANNELS; curr_channel++)
-            chan_and_pids.channels[curr_channel].generated_sdt_version=-1;
+          for (int curr_channel = 0; curr_channel < chan_and_pids.number_of_channels; curr_channel++)
+            chan_and_pids.channels[curr_channel]->generated_sdt_version=-1;
           rewrite_vars.full_sdt=malloc(sizeof(mumudvb_ts_packet_t));
           if(rewrite_vars.full_sdt==NULL)
           {
@@ -401,12 +419,12 @@ int main(void)
                 {
                   log_message( log_module, MSG_DETAIL,"The SDT version changed, we force the update of all the channels.\n");
                   for (int curr_channel = 0; curr_channel < chan_and_pids.number_of_channels; curr_channel++)
-                    chan_and_pids.channels[curr_channel].sdt_rewrite_skip=0;
+                    chan_and_pids.channels[curr_channel]->sdt_rewrite_skip=0;
                 }
                 for (int curr_channel = 0; curr_channel < chan_and_pids.number_of_channels; curr_channel++)
                 {
-                  if(!chan_and_pids.channels[curr_channel].sdt_rewrite_skip ) //AND the generation was successful
-                    sdt_rewrite_new_channel_packet(actual_ts_packet, &rewrite_vars, &chan_and_pids.channels[curr_channel], curr_channel);
+                  if(!chan_and_pids.channels[curr_channel]->sdt_rewrite_skip ) //AND the generation was successful
+                    sdt_rewrite_new_channel_packet(actual_ts_packet, &rewrite_vars, chan_and_pids.channels[curr_channel], curr_channel);
                 }
               }
 
@@ -437,7 +455,325 @@ int main(void)
 
   log_message( log_module, MSG_INFO,"===================================================================\n");
   log_message( log_module, MSG_INFO,"=========================== Testing done ==========================\n");
+  if(failures)
+    log_message( log_module, MSG_INFO,"%d unit tests FAILED\n", failures);
+  return failures ? 1 : 0;
+}
+
+/** @brief Log the result of a check, return 1 if it failed */
+static int test_check(const char *what, int ok)
+{
+  log_message( log_module, MSG_INFO,"%s  --  %s\n", what, ok ? "PASS" : "FAIL");
+  return !ok;
+}
+
+/** @brief Give data to the HTTP request parser, as if it was received */
+static int test_request_feed(unicast_request_t *request, const char *data, int len)
+{
+  memcpy(request->buffer+request->len, data, len);
+  request->len+=len;
+  request->buffer[request->len]='\0';
+  return unicast_request_parse(request);
+}
+
+/** @brief The incremental HTTP request parser : split data, URL decoding, malformed and oversize requests */
+int test_request_parser(void)
+{
+  static unicast_request_t request;
+  const char *part1="GET /bysid/100?name=Fran%C3%A7e+2&x=1 HTTP/1.1\r\nHo";
+  const char *part2="st: example.org\r\nIf-None-Match: \"abc\"\r\n\r\n";
+  const char *bytes="\r\nGET /channels_list.html HTTP/1.0\r\n\r\n";
+  char value[32];
+  int failures=0;
+  int i,ret;
+
+  log_message( log_module, MSG_INFO,"===================================================================\n");
+  log_message( log_module, MSG_INFO,"Testing the HTTP request parser\n");
+  log_message( log_module, MSG_INFO,"===================================================================\n");
+
+  //The headers arrive in two parts, the cut is in the middle of a header name
+  unicast_request_reset(&request);
+  ret=test_request_feed(&request, part1, strlen(part1));
+  failures+=test_check("Partial request waits for more data", ret==0);
+  ret=test_request_feed(&request, part2, strlen(part2));
+  failures+=test_check("Request complete with the second part", ret==1);
+  failures+=test_check("Method and path", request.method && !strcmp(request.method,"GET") && request.path && !strcmp(request.path,"/bysid/100"));
+  failures+=test_check("Host header split between the parts", request.host && !strcmp(request.host,"example.org"));
+  failures+=test_check("If-None-Match header", request.if_none_match && !strcmp(request.if_none_match,"\"abc\""));
+  failures+=test_check("URL decoding of a parameter (%xx and +)", unicast_request_param(&request,"name",value,sizeof(value)) && !strcmp(value,"Fran\xc3\xa7" "e 2"));
+  failures+=test_check("Second parameter", unicast_request_param(&request,"x",value,sizeof(value)) && !strcmp(value,"1"));
+  failures+=test_check("Missing parameter", !unicast_request_param(&request,"y",value,sizeof(value)));
+  failures+=test_check("Parameter too long for the value", !unicast_request_param(&request,"name",value,5));
+
+  //One byte at a time, with an empty line before the request line
+  unicast_request_reset(&request);
+  ret=0;
+  for(i=0;bytes[i] && ret==0;i++)
+    ret=test_request_feed(&request, bytes+i, 1);
+  failures+=test_check("Request received byte by byte", ret==1 && !bytes[i] && !strcmp(request.path,"/channels_list.html") && request.query==NULL && request.host==NULL);
+
+  //URL decoding : the incomplete or invalid escapes are kept
+  failures+=test_check("Incomplete escape kept", unicast_url_decode("a%4",3,value,sizeof(value))==3 && !strcmp(value,"a%4"));
+  failures+=test_check("Invalid escape kept", unicast_url_decode("%zz%41",6,value,sizeof(value))==4 && !strcmp(value,"%zzA"));
+
+  //Malformed requests
+  unicast_request_reset(&request);
+  failures+=test_check("Request line without path", test_request_feed(&request, "GARBAGE\r\n\r\n", 11)==-1);
+  unicast_request_reset(&request);
+  failures+=test_check("Path not starting with /", test_request_feed(&request, "GET index.html HTTP/1.0\r\n", 25)==-1);
+
+  //Oversize request : the headers never end
+  unicast_request_reset(&request);
+  ret=test_request_feed(&request, "GET / HTTP/1.0\r\nX: ", 19);
+  while(ret==0 && request.len<UNICAST_REQUEST_MAX)
+  {
+    memset(value,'a',sizeof(value));
+    i=UNICAST_REQUEST_MAX-request.len;
+    ret=test_request_feed(&request, value, (i<(int)sizeof(value))?i:(int)sizeof(value));
+  }
+  failures+=test_check("Oversize request refused", ret==-2 && request.len==UNICAST_REQUEST_MAX);
+
+  return failures;
+}
+
+/** @brief Bitwise CRC32 MPEG-2, the reference for the kernels */
+static uint32_t test_crc32_bitwise(uint32_t crc, const unsigned char *data, size_t len)
+{
+  size_t i;
+  int bit;
+  for(i=0;i<len;i++)
+  {
+    crc^=((uint32_t)data[i])<<24;
+    for(bit=0;bit<8;bit++)
+      crc=(crc & 0x80000000) ? (crc<<1)^0x04c11db7 : (crc<<1);
+  }
+  return crc;
+}
+
+/** @brief The CRC32 kernels (byte, slicing by 8, PCLMUL) against the bitwise reference */
+int test_crc32_kernels(void)
+{
+  static const crc32_impl_t impls[]={CRC32_IMPL_BYTE, CRC32_IMPL_SLICE8, CRC32_IMPL_PCLMUL};
+  unsigned char data[4096+16];
+  char what[128];
+  crc32_impl_t previous;
+  uint32_t crc,ref;
+  size_t len,offset,cut;
+  unsigned int i;
+  int failures=0;
+  int errors;
+
+  log_message( log_module, MSG_INFO,"===================================================================\n");
+  log_message( log_module, MSG_INFO,"Testing the CRC32 kernels\n");
+  log_message( log_module, MSG_INFO,"===================================================================\n");
+
+  crc32_init();
+  previous=crc32_get_impl();
+  srand(42);
+  for(i=0;i<sizeof(data);i++)
+    data[i]=rand() & 0xff;
+  failures+=test_check("Bitwise reference on \"123456789\"", test_crc32_bitwise(CRC32_MPEG2_INIT,(const unsigned char *)"123456789",9)==0x0376e6e7);
+
+  for(i=0;i<sizeof(impls)/sizeof(impls[0]);i++)
+  {
+    if(crc32_set_impl(impls[i]))
+    {
+      log_message( log_module, MSG_INFO,"CRC32 kernel %s not available on this CPU, skipped\n", crc32_impl_to_str(impls[i]));
+      continue;
+    }
+    errors=0;
+    //All the lengths around the block sizes of the kernels, with unaligned data
+    for(len=0;len<=1100;len++)
+      for(offset=0;offset<16;offset+=5)
+        if(crc32_mpeg2_update(CRC32_MPEG2_INIT,data+offset,len)!=test_crc32_bitwise(CRC32_MPEG2_INIT,data+offset,len))
+          errors++;
+    //Long buffers, and the update in two parts as the sections are received
+    for(len=1100;len<=4096;len+=331)
+    {
+      ref=test_crc32_bitwise(CRC32_MPEG2_INIT,data+1,len);
+      if(crc32_mpeg2_update(CRC32_MPEG2_INIT,data+1,len)!=ref)
+        errors++;
+      for(cut=0;cut<=len;cut+=len/7+1)
+      {
+        crc=crc32_mpeg2_update(CRC32_MPEG2_INIT,data+1,cut);
+        if(crc32_mpeg2_update(crc,data+1+cut,len-cut)!=ref)
+          errors++;
+      }
+    }
+    snprintf(what, sizeof(what), "CRC32 kernel %s against the bitwise reference", crc32_impl_to_str(impls[i]));
+    failures+=test_check(what, !errors);
+  }
+  crc32_set_impl(previous);
+  return failures;
+}
+
+/** @brief Build a TS packet, with an adaptation field (flags) if afc says so */
+static void test_ts_packet(unsigned char *packet, int pid, int afc, int cc, int af_flags)
+{
+  memset(packet, 0xff, TS_PACKET_SIZE);
+  packet[0]=0x47;
+  packet[1]=(pid>>8) & 0x1f;
+  packet[2]=pid & 0xff;
+  packet[3]=(afc<<4) | (cc & 0x0f);
+  if(afc & 0x02)
+  {
+    packet[4]=(afc==0x02) ? TS_PACKET_SIZE-5 : 1;
+    packet[5]=af_flags;
+  }
+}
+
+/** @brief The TS aligned drop policy of the queues of the HTTP clients and its states */
+int test_drop_policy(void)
+{
+  mumudvb_channel_t *channel;
+  unicast_client_t client;
+  unicast_parameters_t unicast_vars;
+  unsigned char data[40*TS_PACKET_SIZE];
+  unsigned char *long_data;
+  int failures=0;
+  int i;
+
+  log_message( log_module, MSG_INFO,"===================================================================\n");
+  log_message( log_module, MSG_INFO,"Testing the drop policy of the unicast queues\n");
+  log_message( log_module, MSG_INFO,"===================================================================\n");
+
+  channel=calloc(1, sizeof(mumudvb_channel_t));
+  if(channel)
+    channel->desc=calloc(1, sizeof(mumudvb_channel_desc_t));
+  if(channel==NULL || channel->desc==NULL)
+  {
+    log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+    free(channel);
+    return 1;
+  }
+  //Video, audio and teletext
+  channel->num_pids=4;
+  channel->pids[0]=50;  channel->desc->pids_type[0]=PID_PMT;
+  channel->pids[1]=100; channel->desc->pids_type[1]=PID_VIDEO_MPEG2;
+  channel->pids[2]=101; channel->desc->pids_type[2]=PID_AUDIO_MPEG1;
+  channel->pids[3]=102; channel->desc->pids_type[3]=PID_EXTRA_TELETEXT;
+  channel->pmt_pid=50;
+  channel->pcr_pid=100;
+  memset(&client, 0, sizeof(client));
+  memset(&unicast_vars, 0, sizeof(unicast_vars));
+  //Limit of 100 packets : everything is kept up to 75, the essential packets up to 100, resume at 50
+  unicast_vars.queue_max_size=100*TS_PACKET_SIZE;
+
+  for(i=0;i<40;i++)
+    test_ts_packet(data+i*TS_PACKET_SIZE, 100, 1, i, 0);
+  unicast_client_queue_data(&client, channel, &unicast_vars, data, 40*TS_PACKET_SIZE);
+  unicast_client_queue_data(&client, channel, &unicast_vars, data, 30*TS_PACKET_SIZE);
+  failures+=test_check("Below the soft limit, everything is queued",
+      client.queue.data_bytes_in_queue==70*TS_PACKET_SIZE && client.queue.drop_state==UNICAST_DROP_NONE && !client.queue.dropped_packets);
+
+  for(i=0;i<10;i++)
+    test_ts_packet(data+i*TS_PACKET_SIZE, 102, 1, i, 0);
+  unicast_client_queue_data(&client, channel, &unicast_vars, data, 10*TS_PACKET_SIZE);
+  failures+=test_check("Above the soft limit, the teletext is dropped",
+      client.queue.data_bytes_in_queue==75*TS_PACKET_SIZE && client.queue.drop_state==UNICAST_DROP_NONE && client.queue.dropped_packets==5);
+
+  for(i=0;i<30;i++)
+    test_ts_packet(data+i*TS_PACKET_SIZE, (i%2)?101:100, 1, i, 0);
+  unicast_client_queue_data(&client, channel, &unicast_vars, data, 30*TS_PACKET_SIZE);
+  failures+=test_check("Video and audio queued up to the limit, then the queue is full",
+      client.queue.data_bytes_in_queue==100*TS_PACKET_SIZE && client.queue.drop_state==UNICAST_DROP_FULL &&
+      client.queue.dropped_packets==10 && client.queue.drop_events==1 && channel->unicast_dropped_packets==10);
+
+  //The client reads its data, the queue is back under the resume level
+  for(i=0;i<10;i++)
+    test_ts_packet(data+i*TS_PACKET_SIZE, 100, 1, i, 0);
+  unicast_client_queue_data(&client, channel, &unicast_vars, data, 10*TS_PACKET_SIZE);
+  failures+=test_check("Full queue : everything is dropped", client.queue.drop_state==UNICAST_DROP_FULL && client.queue.dropped_packets==20);
+  unicast_queue_clear(&client.queue);
+  unicast_client_queue_data(&client, channel, &unicast_vars, data, 10*TS_PACKET_SIZE);
+  failures+=test_check("Back under the resume level, waiting for a random access point",
+      client.queue.drop_state==UNICAST_DROP_WAIT_RAP && client.queue.data_bytes_in_queue==0 && client.queue.dropped_packets==30);
+
+  //Audio, then the video with the random_access_indicator : the stream starts again at this packet
+  test_ts_packet(data, 101, 1, 0, 0);
+  test_ts_packet(data+TS_PACKET_SIZE, 100, 3, 0, 0x40);
+  test_ts_packet(data+2*TS_PACKET_SIZE, 101, 1, 1, 0);
+  unicast_client_queue_data(&client, channel, &unicast_vars, data, 3*TS_PACKET_SIZE);
+  failures+=test_check("The stream starts again at the random access point, aligned on the packets",
+      client.queue.drop_state==UNICAST_DROP_NONE && client.queue.data_bytes_in_queue==2*TS_PACKET_SIZE && client.queue.dropped_packets==31);
+  failures+=test_check("The first queued packet is the random access point", client.queue.first && client.queue.first->data[1]==0 && client.queue.first->data[2]==100 && (client.queue.first->data[5] & 0x40));
+
+  //The end of a packet partly written, then more packets than a datagram, above the soft limit
+  unicast_vars.queue_max_size=1000*TS_PACKET_SIZE;
+  long_data=malloc(100+800*TS_PACKET_SIZE);
+  if(long_data)
+  {
+    memset(long_data, 0xff, 100);
+    for(i=0;i<800;i++)
+      test_ts_packet(long_data+100+i*TS_PACKET_SIZE, 100, 1, i, 0);
+    unicast_client_queue_data(&client, channel, &unicast_vars, long_data, 100+800*TS_PACKET_SIZE);
+    failures+=test_check("Data longer than a datagram after the end of a partly written packet, everything is queued",
+        client.queue.data_bytes_in_queue==100+802*TS_PACKET_SIZE && client.queue.drop_state==UNICAST_DROP_NONE && client.queue.dropped_packets==31);
+    free(long_data);
+  }
+  else
+    failures++;
+
+  unicast_queue_clear(&client.queue);
+  free(channel->desc);
+  free(channel);
+  return failures;
+}
+
+/** @brief The continuity check of the PID analyzer : duplicates, discontinuity indicator, packets without payload */
+int test_analyzer_cc(void)
+{
+  //Continuity counter, adaptation field control, adaptation field flags, continuity error expected
+  static const int packets[][4]={
+    {0, 1, 0, 0},
+    {1, 1, 0, 0},
+    {1, 1, 0, 0},     //First duplicate : allowed
+    {1, 1, 0, 1},     //Second duplicate : error
+    {2, 1, 0, 0},
+    {4, 1, 0, 1},     //A packet lost
+    {9, 3, 0x80, 0},  //Discontinuity indicator : no error
+    {10, 1, 0, 0},
+    {10, 2, 0, 0},    //No payload : the counter doesn't increase
+    {11, 1, 0, 0},
+    {11, 3, 0, 0},    //Duplicate with an adaptation field
+    {13, 3, 0, 1},
+  };
+  unsigned char packet[TS_PACKET_SIZE];
+  unsigned int i;
+  int failures=0;
+  int errors=0;
+
+  log_message( log_module, MSG_INFO,"===================================================================\n");
+  log_message( log_module, MSG_INFO,"Testing the continuity check of the PID analyzer\n");
+  log_message( log_module, MSG_INFO,"===================================================================\n");
+
+  if(analyzer_init())
+    return 1;
+  for(i=0;i<sizeof(packets)/sizeof(packets[0]);i++)
+  {
+    test_ts_packet(packet, 200, packets[i][1], packets[i][0], packets[i][2]);
+    if(analyzer_packet(200, packet)!=packets[i][3])
+    {
+      log_message( log_module, MSG_INFO,"Packet %u (cc %d) : wrong continuity result\n", i, packets[i][0]);
+      errors++;
+    }
+  }
+  failures+=test_check("Continuity errors, duplicates and discontinuity indicator", !errors && analyzer_pids[200].cc_errors==3);
+  failures+=test_check("Packets counted", analyzer_pids[200].packets==sizeof(packets)/sizeof(packets[0]));
+
+  //Null packets have no continuity, a packet without the sync byte is not counted on its PID
+  errors=0;
+  for(i=0;i<16;i++)
+  {
+    test_ts_packet(packet, 8191, 1, i*7, 0);
+    errors+=analyzer_packet(8191, packet);
+  }
+  packet[0]=0;
+  errors+=analyzer_packet(8191, packet);
+  failures+=test_check("Null packets and sync errors", !errors && analyzer_pids[8191].cc_errors==0 && analyzer_pids[8191].packets==16 && analyzer_ts.sync_errors==1);
 
+  analyzer_free();
+  return failures;
 }
 
 
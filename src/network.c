@@ -36,6 +36,7 @@
 #include <fcntl.h>
 #include "log.h"
 #include <net/if.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 
 
@@ -67,6 +68,73 @@ sendudp6 (int fd, struct sockaddr_in6 *sSockAddr, unsigned char *data, int len)
 		log_message( log_module,  MSG_WARN,"sendto failed : %s\n", strerror(errno));
 }
 
+/**@brief Send data given in several parts (scatter/gather)
+ * The parts are sent as one datagram, without copying them together
+ */
+void
+sendudp_iov (int fd, struct sockaddr_in *sSockAddr, struct iovec *iov, int iovcnt)
+{
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name=sSockAddr;
+	msg.msg_namelen=sizeof (*sSockAddr);
+	msg.msg_iov=iov;
+	msg.msg_iovlen=iovcnt;
+	if(sendmsg (fd, &msg, 0)<0)
+		log_message( log_module,  MSG_WARN,"sendmsg failed : %s\n", strerror(errno));
+}
+
+/**@brief Send data given in several parts (scatter/gather)
+ * The parts are sent as one datagram, without copying them together
+ */
+void
+sendudp6_iov (int fd, struct sockaddr_in6 *sSockAddr, struct iovec *iov, int iovcnt)
+{
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name=sSockAddr;
+	msg.msg_namelen=sizeof (*sSockAddr);
+	msg.msg_iov=iov;
+	msg.msg_iovlen=iovcnt;
+	if(sendmsg (fd, &msg, 0)<0)
+		log_message( log_module,  MSG_WARN,"sendmsg failed : %s\n", strerror(errno));
+}
+
+
+
+/**@brief Get the MTU used to send to an address
+ * If an interface is given, its MTU, otherwise the MTU of the route to the address
+ * @return the MTU or -1 if it cannot be found
+ */
+int
+get_path_mtu (struct sockaddr *sAddr, socklen_t addrlen, char *iface)
+{
+	int fd,mtu=-1;
+	socklen_t len=sizeof(mtu);
+	fd=socket (sAddr->sa_family, SOCK_DGRAM, 0);
+	if(fd<0)
+		return -1;
+	if(iface && strlen(iface))
+	{
+		struct ifreq ifr;
+		memset(&ifr, 0, sizeof(ifr));
+		snprintf(ifr.ifr_name, IF_NAMESIZE, "%s", iface);
+		if(ioctl(fd, SIOCGIFMTU, &ifr)==0)
+			mtu=ifr.ifr_mtu;
+	}
+	else if(connect(fd, sAddr, addrlen)==0)
+	{
+		//The socket is not used to send, connect only looks for the route
+		if(sAddr->sa_family==AF_INET6)
+			getsockopt(fd, IPPROTO_IPV6, IPV6_MTU, &mtu, &len);
+		else
+			getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &len);
+	}
+	if(mtu<0)
+		log_message( log_module,  MSG_DEBUG,"Cannot get the MTU : %s\n", strerror(errno));
+	close(fd);
+	return mtu;
+}
 
 
 /** @brief create a sender socket.
@@ -32,6 +32,7 @@
 #define _NETWORK_H
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #include <sys/types.h>
@@ -51,7 +52,10 @@ int makesocket (char *szAddr, unsigned short port, int TTL, char *iface, struct
 int makeTCPclientsocket (char *szAddr, unsigned short port, struct sockaddr_in *sSockAddr);
 int makeclientsocket6 (char *szAddr, unsigned short port, int TTL, char *iface, struct sockaddr_in6 *sSockAddr);
 void sendudp6 (int fd, struct sockaddr_in6 *sSockAddr, unsigned char *data, int len);
+void sendudp_iov (int fd, struct sockaddr_in *sSockAddr, struct iovec *iov, int iovcnt);
+void sendudp6_iov (int fd, struct sockaddr_in6 *sSockAddr, struct iovec *iov, int iovcnt);
 int makesocket6 (char *szAddr, unsigned short port, int TTL, char *iface, struct sockaddr_in6 *sSockAddr);
+int get_path_mtu (struct sockaddr *sAddr, socklen_t addrlen, char *iface);
 
 #endif
 
@@ -0,0 +1,564 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the output pacing
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Output pacing of the multicast datagrams
+ *
+ * The card gives the packets by bursts (one read), without pacing the datagrams are sent
+ * at the same rhythm. When a channel is paced, each datagram gets a departure time from
+ * the PCR of the channel (or from its measured bitrate) delayed by the latency budget
+ * pacing_delay, the datagrams wait in the pacer of the channel and a thread sends them
+ * at their time (timer wheel with a PACING_TICK_US resolution).
+ * With pacing_txtime the departure time is given to the kernel (SO_TXTIME), the ETF
+ * queuing discipline has to be configured on the interface.
+ *
+ * Only the multicast is paced, the unicast clients have their own TCP flow control.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#ifdef SO_TXTIME
+#include <linux/net_tstamp.h>
+#endif
+
+#include "pacing.h"
+#include "network.h"
+#include "rtp.h"
+#include "errors.h"
+#include "log.h"
+
+static char *log_module="Pacing: ";
+
+/** The pacing parameters, used when the channels send their datagrams */
+static pacing_p_t *pacing_vars=NULL;
+
+/** The PCR wraps around after 2^33 periods of 90kHz (in us) */
+#define PCR_WRAP_US ((((uint64_t)1)<<33)*100/9)
+
+/** Initialize the pacing variables*/
+void init_pacing_v(pacing_p_t *pacing_p)
+{
+	memset(pacing_p, 0, sizeof(pacing_p_t));
+	pacing_p->default_mode=PACING_OFF;
+	pacing_p->delay=PACING_DEFAULT_DELAY;
+	pacing_p->txtime=0;
+	pthread_mutex_init(&pacing_p->lock,NULL);
+}
+
+/** @brief Read a line of the configuration file to check if there is a pacing parameter
+ *
+ * pacing is for the current channel if a channel is started, otherwise it is the default
+ * @param pacing_p the pacing parameters
+ * @param substring The currrent line
+ */
+int read_pacing_configuration(pacing_p_t *pacing_p, mumudvb_channel_t *current_channel, int channel_start, char *substring)
+{
+	char delimiteurs[] = CONFIG_FILE_SEPARATOR;
+	pacing_mode_t mode;
+	if (!strcmp (substring, "pacing"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		if(!strcmp (substring, "pcr") || !strcmp (substring, "1"))
+			mode=PACING_PCR;
+		else if(!strcmp (substring, "bitrate"))
+			mode=PACING_BITRATE;
+		else if(!strcmp (substring, "off") || !strcmp (substring, "0"))
+			mode=PACING_OFF;
+		else
+		{
+			log_message( log_module,  MSG_ERROR,
+					"Config issue : pacing, unknown value %s (pcr, bitrate or off)\n", substring);
+			return -1;
+		}
+		if(channel_start)
+			current_channel->pacing_mode=mode;
+		else
+			pacing_p->default_mode=mode;
+	}
+	else if (!strcmp (substring, "pacing_delay"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		pacing_p->delay = atoi (substring);
+		if(pacing_p->delay<=0)
+		{
+			log_message( log_module,  MSG_WARN,"pacing_delay must be positive, we use %dms\n",PACING_DEFAULT_DELAY);
+			pacing_p->delay=PACING_DEFAULT_DELAY;
+		}
+	}
+	else if (!strcmp (substring, "pacing_txtime"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		pacing_p->txtime = atoi (substring);
+#ifndef SO_TXTIME
+		if(pacing_p->txtime)
+		{
+			log_message( log_module,  MSG_WARN,"SO_TXTIME is not supported by this build, pacing_txtime is ignored\n");
+			pacing_p->txtime=0;
+		}
+#endif
+	}
+	else
+		return 0; //Nothing concerning pacing, we return 0 to explore the other possibilities
+
+	return 1;//We found something for pacing, we tell main to go for the next line
+}
+
+
+/** @brief Get the PCR of a TS packet in us
+ * @return 1 if the packet carries a PCR
+ */
+static int pacing_get_pcr(unsigned char *ts_packet, uint64_t *pcr)
+{
+	uint64_t base;
+	int ext;
+	if(!(ts_packet[3] & 0x20)) //no adaptation field
+		return 0;
+	if(ts_packet[4]<7 || !(ts_packet[5] & 0x10)) //no PCR
+		return 0;
+	base=((uint64_t)ts_packet[6]<<25) | (ts_packet[7]<<17) | (ts_packet[8]<<9) | (ts_packet[9]<<1) | (ts_packet[10]>>7);
+	ext=((ts_packet[10] & 0x01)<<8) | ts_packet[11];
+	*pcr=(base*300+ext)/27;
+	return 1;
+}
+
+/** @brief Put a pacer in the timer wheel at the departure of its first datagram */
+static void pacing_wheel_insert(pacing_p_t *pacing_p, channel_pacer_t *pacer)
+{
+	uint64_t tick;
+	int slot;
+	tick=pacer->queue[pacer->queue_head].departure/PACING_TICK_US;
+	if(tick<pacing_p->wheel_tick)
+		tick=pacing_p->wheel_tick;
+	slot=tick%PACING_WHEEL_SLOTS;
+	pacer->wheel_next=pacing_p->wheel[slot];
+	pacing_p->wheel[slot]=pacer;
+}
+
+/** @brief Send a datagram of the pacer, with its departure time if the kernel does the pacing */
+static void pacing_send_dgram(pacing_p_t *pacing_p, mumudvb_channel_t *channel, unsigned char *data, int len, uint64_t departure, int txtime)
+{
+	struct iovec iov;
+	iov.iov_base=data;
+	iov.iov_len=len;
+#ifdef SO_TXTIME
+	if(txtime)
+	{
+		struct msghdr msg;
+		char control[CMSG_SPACE(sizeof(uint64_t))];
+		struct cmsghdr *cmsg;
+		struct timespec tai,mono;
+		uint64_t txtime_ns;
+		//The ETF qdisc uses the TAI clock
+		clock_gettime(CLOCK_TAI, &tai);
+		clock_gettime(CLOCK_MONOTONIC, &mono);
+		txtime_ns=tai.tv_sec*1000000000ull+tai.tv_nsec+(departure*1000-(mono.tv_sec*1000000000ull+mono.tv_nsec));
+		memset(&msg, 0, sizeof(msg));
+		memset(control, 0, sizeof(control));
+		msg.msg_iov=&iov;
+		msg.msg_iovlen=1;
+		msg.msg_control=control;
+		msg.msg_controllen=sizeof(control);
+		cmsg=CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level=SOL_SOCKET;
+		cmsg->cmsg_type=SCM_TXTIME;
+		cmsg->cmsg_len=CMSG_LEN(sizeof(uint64_t));
+		memcpy(CMSG_DATA(cmsg), &txtime_ns, sizeof(uint64_t));
+		if(pacing_p->multi_p->multicast_ipv4)
+		{
+			msg.msg_name=&channel->sOut4;
+			msg.msg_namelen=sizeof(channel->sOut4);
+			if(sendmsg(channel->socketOut4, &msg, 0)<0)
+				log_message( log_module,  MSG_WARN,"sendmsg failed : %s\n", strerror(errno));
+		}
+		if(pacing_p->multi_p->multicast_ipv6)
+		{
+			msg.msg_name=&channel->sOut6;
+			msg.msg_namelen=sizeof(channel->sOut6);
+			if(sendmsg(channel->socketOut6, &msg, 0)<0)
+				log_message( log_module,  MSG_WARN,"sendmsg failed : %s\n", strerror(errno));
+		}
+		return;
+	}
+#else
+	(void) departure;
+	(void) txtime;
+#endif
+	if(pacing_p->multi_p->multicast_ipv4)
+		sendudp_iov (channel->socketOut4, &channel->sOut4, &iov, 1);
+	if(pacing_p->multi_p->multicast_ipv6)
+		sendudp6_iov (channel->socketOut6, &channel->sOut6, &iov, 1);
+}
+
+/** @brief Send the first datagram waiting in the pacer and update the jitter statistics */
+static void pacing_send_first(pacing_p_t *pacing_p, channel_pacer_t *pacer, uint64_t now)
+{
+	pacer_dgram_t *dgram;
+	int64_t jitter;
+	dgram=&pacer->queue[pacer->queue_head];
+	pacing_send_dgram(pacing_p, pacer->channel, dgram->data, dgram->len, dgram->departure, 0);
+	if(pacer->last_sent)
+	{
+		jitter=(int64_t)(now-pacer->last_sent)-(int64_t)(dgram->departure-pacer->last_sent_departure);
+		if(jitter<0)
+			jitter=-jitter;
+		pacer->jitter_avg=(pacer->jitter_avg*15+jitter)/16;
+		if(jitter>pacer->jitter_max)
+			pacer->jitter_max=jitter;
+	}
+	pacer->last_sent=now;
+	pacer->last_sent_departure=dgram->departure;
+	pacer->queue_head=(pacer->queue_head+1)%PACING_QUEUE_LEN;
+	pacer->queue_count--;
+}
+
+/** @brief The pacing thread : sends the datagrams at their departure time */
+static void *pacing_thread_func(void* arg)
+{
+	pacing_p_t *pacing_p=(pacing_p_t *) arg;
+	channel_pacer_t *list,*pacer,*next;
+	struct timespec ts;
+	uint64_t now,tick;
+	int slot;
+
+	tick=get_time()/PACING_TICK_US;
+	while(!pacing_p->threadshutdown)
+	{
+		tick++;
+		ts.tv_sec=(tick*PACING_TICK_US)/1000000;
+		ts.tv_nsec=((tick*PACING_TICK_US)%1000000)*1000;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+		pthread_mutex_lock(&pacing_p->lock);
+		now=get_time();
+		//we process all the slots until now (several if we were late)
+		while(pacing_p->wheel_tick<=now/PACING_TICK_US)
+		{
+			slot=pacing_p->wheel_tick%PACING_WHEEL_SLOTS;
+			list=pacing_p->wheel[slot];
+			pacing_p->wheel[slot]=NULL;
+			pacing_p->wheel_tick++;
+			for(pacer=list;pacer!=NULL;pacer=next)
+			{
+				next=pacer->wheel_next;
+				while(pacer->queue_count && pacer->queue[pacer->queue_head].departure<=now)
+					pacing_send_first(pacing_p, pacer, now);
+				//Not yet (or more than a turn of the wheel), the pacer waits for its next datagram
+				if(pacer->queue_count)
+					pacing_wheel_insert(pacing_p, pacer);
+			}
+		}
+		pthread_mutex_unlock(&pacing_p->lock);
+		if(tick<now/PACING_TICK_US)
+			tick=now/PACING_TICK_US;
+	}
+	return NULL;
+}
+
+/** @brief Start the pacing
+ * The thread is started only if a channel can be paced
+ */
+int pacing_start(pacing_p_t *pacing_p, multi_p_t *multi_p, mumu_chan_p_t *chan_p)
+{
+	int ichan,paced=(pacing_p->default_mode!=PACING_OFF);
+
+	pacing_p->multi_p=multi_p;
+	for (ichan = 0; ichan < chan_p->number_of_channels; ichan++)
+		if(chan_p->channels[ichan]->pacing_mode!=PACING_UNDEFINED && chan_p->channels[ichan]->pacing_mode!=PACING_OFF)
+			paced=1;
+	if(!paced || !multi_p->multicast)
+		return 0;
+
+	pacing_p->wheel_tick=get_time()/PACING_TICK_US;
+	pacing_p->threadshutdown=0;
+	if(pthread_create(&pacing_p->thread, NULL, pacing_thread_func, pacing_p))
+	{
+		log_message( log_module,  MSG_ERROR,"Cannot start the pacing thread : %s\n", strerror(errno));
+		return -1;
+	}
+	pacing_p->thread_started=1;
+	pacing_vars=pacing_p;
+	log_message( log_module,  MSG_INFO,"Output pacing started, latency budget %dms%s\n", pacing_p->delay, pacing_p->txtime?", departure times given to the kernel (SO_TXTIME)":"");
+	return 0;
+}
+
+/** @brief Create the pacer of a channel
+ * @return the pacer or NULL if the channel is not paced
+ */
+static channel_pacer_t *pacing_new_pacer(pacing_p_t *pacing_p, mumudvb_channel_t *channel)
+{
+	channel_pacer_t *pacer;
+	int i,dgram_size;
+	if(channel->pacing_mode==PACING_UNDEFINED)
+		channel->pacing_mode=pacing_p->default_mode;
+	if(channel->pacing_mode==PACING_OFF)
+		return NULL;
+	dgram_size=RTP_HEADER_LEN+(channel->udp_size_max?channel->udp_size_max:MAX_UDP_SIZE);
+	pacer=calloc(1,sizeof(channel_pacer_t));
+	if(pacer!=NULL)
+	{
+		pacer->queue=malloc(sizeof(pacer_dgram_t)*PACING_QUEUE_LEN);
+		pacer->queue_data=malloc(dgram_size*PACING_QUEUE_LEN);
+	}
+	if(pacer==NULL || pacer->queue==NULL || pacer->queue_data==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		if(pacer)
+		{
+			free(pacer->queue);
+			free(pacer->queue_data);
+			free(pacer);
+		}
+		channel->pacing_mode=PACING_OFF;
+		return NULL;
+	}
+	for(i=0;i<PACING_QUEUE_LEN;i++)
+		pacer->queue[i].data=pacer->queue_data+i*dgram_size;
+	pacer->channel=channel;
+	pacer->mode=channel->pacing_mode;
+#ifdef SO_TXTIME
+	if(pacing_p->txtime)
+	{
+		struct sock_txtime sk_txtime;
+		int ret=0;
+		sk_txtime.clockid=CLOCK_TAI;
+		sk_txtime.flags=0;
+		if(pacing_p->multi_p->multicast_ipv4)
+			ret|=setsockopt(channel->socketOut4, SOL_SOCKET, SO_TXTIME, &sk_txtime, sizeof(sk_txtime));
+		if(pacing_p->multi_p->multicast_ipv6)
+			ret|=setsockopt(channel->socketOut6, SOL_SOCKET, SO_TXTIME, &sk_txtime, sizeof(sk_txtime));
+		if(ret)
+			log_message( log_module,  MSG_WARN,"Channel \"%s\" : SO_TXTIME not available (%s), the pacing is done by MuMuDVB\n", channel->name, strerror(errno));
+		channel->pacing_txtime=!ret;
+	}
+#endif
+	log_message( log_module,  MSG_DETAIL,"Channel \"%s\" : output paced from the %s\n", channel->name, pacer->mode==PACING_PCR?"PCR":"bitrate");
+	return pacer;
+}
+
+/** @brief Follow the PCR of a paced channel, called for each packet sent to the channel */
+void pacing_new_packet(mumudvb_channel_t *channel, unsigned char *ts_packet)
+{
+	channel_pacer_t *pacer=channel->pacer;
+	uint64_t pcr,delta;
+	int pid;
+
+	pacer->bytes_since_pcr+=TS_PACKET_SIZE;
+	if(pacer->mode!=PACING_PCR || !channel->pcr_pid)
+		return;
+	pid = ((ts_packet[1] & 0x1f) << 8) | (ts_packet[2]);
+	if(pid!=channel->pcr_pid || !pacing_get_pcr(ts_packet, &pcr))
+		return;
+	if(pacer->last_pcr)
+	{
+		delta=(pcr+PCR_WRAP_US-pacer->last_pcr)%PCR_WRAP_US;
+		if(delta>0 && delta<PACING_PCR_MAX_GAP)
+		{
+			double rate=(double)pacer->bytes_since_pcr/delta;
+			pacer->pcr_rate=pacer->pcr_rate?(pacer->pcr_rate*7+rate)/8:rate;
+			//The PCR clock continues
+			pacer->pcr_offset+=(int64_t)(pacer->last_pcr+delta)-(int64_t)pcr;
+		}
+		else
+		{
+			log_message( log_module,  MSG_DEBUG,"Channel \"%s\" : PCR discontinuity, resynchronisation\n", channel->name);
+			pacer->pcr_synced=0;
+		}
+	}
+	pacer->last_pcr=pcr;
+	pacer->bytes_since_pcr=0;
+}
+
+/** @brief Compute the departure time of the datagram which is completed */
+static uint64_t pacing_departure(pacing_p_t *pacing_p, channel_pacer_t *pacer, uint64_t now, int len)
+{
+	uint64_t delay=pacing_p->delay*1000ull;
+	uint64_t departure=now;
+	int64_t pcr_pos;
+
+	//Measured bitrate
+	if(!pacer->rate_start)
+		pacer->rate_start=now;
+	pacer->rate_bytes+=len;
+	if(now-pacer->rate_start>=PACING_RATE_INTERVAL)
+	{
+		double rate=(double)pacer->rate_bytes/(now-pacer->rate_start);
+		pacer->rate=pacer->rate?(pacer->rate*3+rate)/4:rate;
+		pacer->rate_start=now;
+		pacer->rate_bytes=0;
+	}
+
+	if(pacer->mode==PACING_PCR && pacer->last_pcr && pacer->pcr_rate>0)
+	{
+		//Position of the end of the datagram on the PCR clock
+		pcr_pos=(int64_t)pacer->last_pcr+(int64_t)(pacer->bytes_since_pcr/pacer->pcr_rate);
+		if(!pacer->pcr_synced)
+		{
+			pacer->pcr_offset=(int64_t)(now+delay)-pcr_pos;
+			pacer->pcr_synced=1;
+		}
+		departure=pcr_pos+pacer->pcr_offset;
+		//Too far from the input : the stream and the PCR don't agree anymore
+		if(departure>now+2*delay || departure+delay<now)
+		{
+			log_message( log_module,  MSG_DEBUG,"Channel \"%s\" : the PCR clock drifted, resynchronisation\n", pacer->channel->name);
+			pacer->pcr_offset=(int64_t)(now+delay)-pcr_pos;
+			departure=now+delay;
+		}
+	}
+	else if(pacer->rate>0)
+	{
+		//The datagrams are spaced at the measured bitrate, the bursts are smoothed within the latency budget
+		departure=pacer->last_departure+(uint64_t)(len/pacer->rate);
+		if(departure>now+delay)
+			departure=now+delay;
+	}
+	if(departure<now)
+		departure=now;
+	if(departure<pacer->last_departure)
+		departure=pacer->last_departure;
+	pacer->last_departure=departure;
+	return departure;
+}
+
+/** @brief Give the datagram of the channel to its pacer
+ * The datagram (the channel buffer or its parts, see channel_add_packet) is copied in the pacer
+ * @return 1 if the datagram is paced (the multicast must not be sent by the caller)
+ */
+int pacing_send(mumudvb_channel_t *channel, uint64_t now)
+{
+	pacing_p_t *pacing_p=pacing_vars;
+	channel_pacer_t *pacer;
+	pacer_dgram_t *dgram;
+	unsigned char *data;
+	uint64_t departure;
+	int i;
+
+	if(pacing_p==NULL)
+	{
+		channel->pacing_mode=PACING_OFF;
+		return 0;
+	}
+	if(channel->pacer==NULL)
+	{
+		channel->pacer=pacing_new_pacer(pacing_p, channel);
+		if(channel->pacer==NULL)
+			return 0;
+	}
+	pacer=channel->pacer;
+
+	pthread_mutex_lock(&pacing_p->lock);
+	departure=pacing_departure(pacing_p, pacer, now, channel->nb_bytes);
+	//The queue is full : the first datagram leaves before its time
+	if(pacer->queue_count==PACING_QUEUE_LEN)
+	{
+		pacing_send_first(pacing_p, pacer, now);
+		pacer->overflows++;
+		if(pacer->overflows==1)
+			log_message( log_module,  MSG_WARN,"Channel \"%s\" : the pacing queue is full, the latency budget is too big for this bitrate\n", channel->name);
+	}
+	dgram=&pacer->queue[(pacer->queue_head+pacer->queue_count)%PACING_QUEUE_LEN];
+	dgram->departure=departure;
+	data=dgram->data;
+	if(pacing_p->multi_p->rtp_header)
+	{
+		//The RTP timestamp is the departure time
+		rtp_update_sequence_number(channel,departure);
+		memcpy(data, channel->datagram->buf_with_rtp_header, RTP_HEADER_LEN);
+		data+=RTP_HEADER_LEN;
+	}
+	if(channel->iovcnt)
+		for(i=1;i<=channel->iovcnt;i++)
+		{
+			memcpy(data, channel->datagram->iov[i].iov_base, channel->datagram->iov[i].iov_len);
+			data+=channel->datagram->iov[i].iov_len;
+		}
+	else
+	{
+		memcpy(data, channel->datagram->buf, channel->nb_bytes);
+		data+=channel->nb_bytes;
+	}
+	dgram->len=data-dgram->data;
+	if(channel->pacing_txtime)
+	{
+		//The kernel keeps the datagram until its departure time
+		pacing_send_dgram(pacing_p, channel, dgram->data, dgram->len, departure, 1);
+		pthread_mutex_unlock(&pacing_p->lock);
+		return 1;
+	}
+	pacer->queue_count++;
+	if(pacer->queue_count==1)
+		pacing_wheel_insert(pacing_p, pacer);
+	pthread_mutex_unlock(&pacing_p->lock);
+	return 1;
+}
+
+/** @brief Get the jitter statistics of a channel (0 if it is not paced) */
+void pacing_get_stats(mumudvb_channel_t *channel, int *jitter_avg, int *jitter_max)
+{
+	*jitter_avg=0;
+	*jitter_max=0;
+	if(pacing_vars==NULL || channel->pacer==NULL)
+		return;
+	pthread_mutex_lock(&pacing_vars->lock);
+	*jitter_avg=channel->pacer->jitter_avg;
+	*jitter_max=channel->pacer->jitter_max;
+	pthread_mutex_unlock(&pacing_vars->lock);
+}
+
+/** @brief Stop the pacing thread and free the pacers
+ * The datagrams still waiting are sent
+ */
+void pacing_stop(mumu_chan_p_t *chan_p)
+{
+	pacing_p_t *pacing_p=pacing_vars;
+	channel_pacer_t *pacer;
+	int ichan;
+
+	if(pacing_p==NULL)
+		return;
+	pacing_p->threadshutdown=1;
+	if(pacing_p->thread_started)
+		pthread_join(pacing_p->thread, NULL);
+	pacing_p->thread_started=0;
+	for (ichan = 0; ichan < chan_p->number_of_channels; ichan++)
+	{
+		pacer=chan_p->channels[ichan]->pacer;
+		if(pacer==NULL)
+			continue;
+		while(pacer->queue_count)
+			pacing_send_first(pacing_p, pacer, get_time());
+		if(pacer->last_sent)
+			log_message( log_module,  MSG_DETAIL,"Channel \"%s\" : pacing jitter average %dus max %dus, %ld datagrams sent early (queue full)\n",
+					chan_p->channels[ichan]->name, pacer->jitter_avg, pacer->jitter_max, pacer->overflows);
+		free(pacer->queue);
+		free(pacer->queue_data);
+		free(pacer);
+		chan_p->channels[ichan]->pacer=NULL;
+	}
+	pacing_vars=NULL;
+}
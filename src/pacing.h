@@ -0,0 +1,134 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the output pacing
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Header file for the output pacing of the multicast datagrams
+ */
+
+#ifndef _PACING_H
+#define _PACING_H
+
+#include "mumudvb.h"
+
+/** Default latency budget used to smooth the bursts (ms) */
+#define PACING_DEFAULT_DELAY 100
+/** Number of datagrams waiting in the pacer of a channel */
+#define PACING_QUEUE_LEN 256
+/** Resolution of the timer wheel (us) */
+#define PACING_TICK_US 250
+/** Number of slots of the timer wheel (a turn is 256ms) */
+#define PACING_WHEEL_SLOTS 1024
+/** Above this gap between two PCRs the PCR clock is resynchronised (us) */
+#define PACING_PCR_MAX_GAP 1000000
+/** Interval for the bitrate measurement (us) */
+#define PACING_RATE_INTERVAL 500000
+
+/** The pacing modes */
+typedef enum pacing_mode_t {
+	PACING_UNDEFINED, //the channel uses the default mode
+	PACING_OFF,
+	PACING_PCR,
+	PACING_BITRATE,
+} pacing_mode_t;
+
+/** @brief A datagram waiting for its departure time */
+typedef struct pacer_dgram_t{
+	/** Departure time (us, get_time clock) */
+	uint64_t departure;
+	int len;
+	/** In the data block of the pacer, room for the biggest datagram of the channel */
+	unsigned char *data;
+}pacer_dgram_t;
+
+/** @brief The pacer of a channel, allocated when the channel sends its first datagram */
+typedef struct channel_pacer_t{
+	mumudvb_channel_t *channel;
+	/** The clock used to schedule the datagrams */
+	pacing_mode_t mode;
+
+	/** PCR clock : departure = PCR (us) + offset */
+	int pcr_synced;
+	int64_t pcr_offset;
+	/** The last PCR (us) */
+	uint64_t last_pcr;
+	/** Bytes sent since the last PCR */
+	int64_t bytes_since_pcr;
+	/** Bitrate given by the PCRs (bytes per us) */
+	double pcr_rate;
+
+	/** Measured bitrate (bytes per us) */
+	double rate;
+	uint64_t rate_start;
+	int64_t rate_bytes;
+
+	/** Departure of the last datagram scheduled */
+	uint64_t last_departure;
+
+	/** The datagrams waiting */
+	pacer_dgram_t *queue;
+	unsigned char *queue_data;
+	int queue_head;
+	int queue_count;
+
+	/** Timer wheel : the pacer is in the slot of its first datagram when it has datagrams waiting */
+	struct channel_pacer_t *wheel_next;
+
+	/** Statistics : difference between the real and the scheduled interval between two datagrams (us) */
+	uint64_t last_sent;
+	uint64_t last_sent_departure;
+	int jitter_avg;
+	int jitter_max;
+	/** Datagrams sent before their time because the queue was full */
+	long overflows;
+}channel_pacer_t;
+
+/** @brief The pacing parameters */
+typedef struct pacing_p_t{
+	/** The mode of the channels without pacing option */
+	pacing_mode_t default_mode;
+	/** Latency budget (ms) */
+	int delay;
+	/** Give the departure times to the kernel (SO_TXTIME, needs the ETF qdisc) */
+	int txtime;
+	/** Protects the pacers and the timer wheel */
+	pthread_mutex_t lock;
+	channel_pacer_t *wheel[PACING_WHEEL_SLOTS];
+	/** The next tick of the wheel to process */
+	uint64_t wheel_tick;
+	multi_p_t *multi_p;
+	pthread_t thread;
+	int thread_started;
+	volatile int threadshutdown;
+}pacing_p_t;
+
+void init_pacing_v(pacing_p_t *pacing_p);
+int read_pacing_configuration(pacing_p_t *pacing_p, mumudvb_channel_t *current_channel, int channel_start, char *substring);
+int pacing_start(pacing_p_t *pacing_p, multi_p_t *multi_p, mumu_chan_p_t *chan_p);
+void pacing_new_packet(mumudvb_channel_t *channel, unsigned char *ts_packet);
+int pacing_send(mumudvb_channel_t *channel, uint64_t now);
+void pacing_get_stats(mumudvb_channel_t *channel, int *jitter_avg, int *jitter_max);
+void pacing_stop(mumu_chan_p_t *chan_p);
+
+#endif
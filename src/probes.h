@@ -0,0 +1,80 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the static tracepoints
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Static tracepoints (USDT) of the provider mumudvb
+ *
+ * When sys/sdt.h is found by configure, each probe is a nop instruction and a note in the ELF file.
+ * bpftrace, perf or systemtap can attach to it on a running process (see scripts/bpftrace). When
+ * nothing is attached, the cost is the nop and the computation of the arguments, so the arguments
+ * must stay cheap : integers and pointers to strings which already exist.
+ *
+ * The probes (arguments in order) :
+ *   dvr_read (bytes)                                           a read from the DVR
+ *   dvr_overflow ()                                            the DVR buffer overflowed
+ *   channel_send (name, service_id, bytes, latency_us)         a datagram of a channel is sent
+ *   client_accept (socket, ip, port)                           a HTTP connection (ip is in network order)
+ *   client_channel (socket, name, service_id)                  the client gets a channel
+ *   client_close (socket, ip, port, dropped_packets, drop_events)
+ *   queue_add (socket, bytes, queued_bytes)                    data put in the queue of a slow client
+ *   queue_full (socket, queued_bytes)                          the queue is full, the client loses packets
+ *   queue_drop (socket, pid)                                   a packet dropped for a client
+ *   queue_drain (socket, bytes, queued_bytes)                  data sent from the queue
+ *   descrambler_batch (name, even_packets, odd_packets)        a batch is descrambled
+ *   descrambler_batch_done (name)                              the batch is descrambled
+ *   key_received (name, parity)                                a control word received from oscam
+ *   key_loaded (name, parity)                                  a control word used by the descrambler
+ *   autoconf_phase (phase)                                     the autoconfiguration mode changes (AUTOCONF_MODE_*, 0 : done)
+ *   autoconf_channel (name, service_id, latency_ms)            a channel found by autoconfiguration
+ */
+
+#ifndef _PROBES_H
+#define _PROBES_H
+
+#include "config.h"
+
+#ifdef ENABLE_USDT
+
+#include <sys/sdt.h>
+
+#define MUMUDVB_PROBE0(name) DTRACE_PROBE(mumudvb, name)
+#define MUMUDVB_PROBE1(name,a) DTRACE_PROBE1(mumudvb, name, a)
+#define MUMUDVB_PROBE2(name,a,b) DTRACE_PROBE2(mumudvb, name, a, b)
+#define MUMUDVB_PROBE3(name,a,b,c) DTRACE_PROBE3(mumudvb, name, a, b, c)
+#define MUMUDVB_PROBE4(name,a,b,c,d) DTRACE_PROBE4(mumudvb, name, a, b, c, d)
+#define MUMUDVB_PROBE5(name,a,b,c,d,e) DTRACE_PROBE5(mumudvb, name, a, b, c, d, e)
+
+#else
+
+#define MUMUDVB_PROBE0(name) do {} while(0)
+#define MUMUDVB_PROBE1(name,a) do {} while(0)
+#define MUMUDVB_PROBE2(name,a,b) do {} while(0)
+#define MUMUDVB_PROBE3(name,a,b,c) do {} while(0)
+#define MUMUDVB_PROBE4(name,a,b,c,d) do {} while(0)
+#define MUMUDVB_PROBE5(name,a,b,c,d,e) do {} while(0)
+
+#endif
+
+#endif
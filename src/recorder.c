@@ -0,0 +1,470 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the recording of the streams
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Recording of the whole transponder and of the channels
+ *
+ * The thread receiving the stream only copies the data in the buffer of the recording
+ * (single producer, single consumer ring without lock). A writer thread empties the
+ * buffers by writes of RECORD_WRITE_SIZE, optionally with O_DIRECT. A slow disk never
+ * blocks the reception : when a buffer is full the new data is dropped and counted.
+ *
+ * The files are cut after record_max_size MB or record_max_time seconds, at a position
+ * which keeps whole packets (and the O_DIRECT alignment).
+ */
+
+#define _GNU_SOURCE		//for O_DIRECT
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "recorder.h"
+#include "errors.h"
+#include "log.h"
+
+static char *log_module="Recorder: ";
+
+/** The recording parameters, used when the channels send their datagrams */
+static record_p_t *record_vars=NULL;
+
+/** Initialize the recording variables*/
+void init_record_v(record_p_t *record_p)
+{
+	memset(record_p, 0, sizeof(record_p_t));
+	record_p->default_mode=OPTION_OFF;
+	record_p->buffer_size=RECORD_DEFAULT_BUFFER;
+	pthread_mutex_init(&record_p->lock,NULL);
+}
+
+/** @brief Read a line of the configuration file to check if there is a recording parameter
+ *
+ * record is for the current channel if a channel is started, otherwise it is the default
+ * @param record_p the recording parameters
+ * @param substring The currrent line
+ */
+int read_record_configuration(record_p_t *record_p, mumudvb_channel_t *current_channel, int channel_start, char *substring)
+{
+	char delimiteurs[] = CONFIG_FILE_SEPARATOR;
+	if (!strcmp (substring, "record"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		if(channel_start)
+			current_channel->record_mode=atoi(substring)?OPTION_ON:OPTION_OFF;
+		else
+			record_p->default_mode=atoi(substring)?OPTION_ON:OPTION_OFF;
+	}
+	else if (!strcmp (substring, "record_dir"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		if(strlen(substring)>=DEFAULT_PATH_LEN)
+		{
+			log_message( log_module,  MSG_ERROR,
+					"The record_dir is too long\n");
+			return -1;
+		}
+		sscanf (substring, "%s\n", record_p->dir);
+	}
+	else if (!strcmp (substring, "record_mux"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		record_p->mux = atoi (substring);
+	}
+	else if (!strcmp (substring, "record_max_size"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		record_p->max_size = atoi (substring);
+	}
+	else if (!strcmp (substring, "record_max_time"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		record_p->max_time = atoi (substring);
+	}
+	else if (!strcmp (substring, "record_direct"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		record_p->direct = atoi (substring);
+	}
+	else if (!strcmp (substring, "record_buffer"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		record_p->buffer_size = atoi (substring);
+		if(record_p->buffer_size<=0)
+		{
+			log_message( log_module,  MSG_WARN,"record_buffer must be positive, we use %dMB\n",RECORD_DEFAULT_BUFFER);
+			record_p->buffer_size=RECORD_DEFAULT_BUFFER;
+		}
+	}
+	else
+		return 0; //Nothing concerning recording, we return 0 to explore the other possibilities
+
+	return 1;//We found something for recording, we tell main to go for the next line
+}
+
+/** @brief Create a recording and give it to the writer thread
+ * The channels are sent by the main thread and by the SCAM send thread, the recordings are added under lock
+ * @param filename a fixed file, or NULL for the files in record_dir
+ */
+static recording_t *record_new(record_p_t *record_p, char *name, char *filename)
+{
+	recording_t *rec;
+	int i;
+
+	rec=calloc(1,sizeof(recording_t));
+	if(rec==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		return NULL;
+	}
+	rec->size=((uint64_t)record_p->buffer_size)*1024*1024;
+	//Aligned for O_DIRECT
+	if(posix_memalign((void **)&rec->buffer, RECORD_DIRECT_ALIGN, rec->size))
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		free(rec);
+		return NULL;
+	}
+	strncpy(rec->name, name, MAX_NAME_LEN-1);
+	//The name is used in the file names
+	for(i=0;rec->name[i];i++)
+		if(rec->name[i]=='/' || rec->name[i]==' ')
+			rec->name[i]='_';
+	rec->filename=filename;
+	rec->fd=-1;
+	pthread_mutex_lock(&record_p->lock);
+	if(record_p->num_recordings>=RECORD_MAX)
+	{
+		pthread_mutex_unlock(&record_p->lock);
+		log_message( log_module, MSG_WARN,"Too many recordings, \"%s\" is not recorded\n", name);
+		free(rec->buffer);
+		free(rec);
+		return NULL;
+	}
+	record_p->recordings[record_p->num_recordings]=rec;
+	//The writer thread sees the recording once it is complete
+	__atomic_store_n(&record_p->num_recordings, record_p->num_recordings+1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&record_p->lock);
+	log_message( log_module, MSG_INFO,"Recording of \"%s\" started\n", name);
+	return rec;
+}
+
+/** @brief Copy data in the buffer of a recording, the data is dropped if the buffer is full */
+static void record_push(recording_t *rec, unsigned char *data, int len)
+{
+	uint64_t head=rec->head;
+	uint64_t used=head-__atomic_load_n(&rec->tail, __ATOMIC_ACQUIRE);
+	uint64_t pos,part;
+	int fill;
+
+	if(used+len>rec->size)
+	{
+		__atomic_store_n(&rec->dropped_producer, rec->dropped_producer+len, __ATOMIC_RELAXED);
+		return;
+	}
+	pos=head%rec->size;
+	part=len;
+	if(pos+part>rec->size)
+		part=rec->size-pos;
+	memcpy(rec->buffer+pos, data, part);
+	if(part<(uint64_t)len)
+		memcpy(rec->buffer, data+part, len-part);
+	fill=(used+len)*100/rec->size;
+	if(fill>rec->buffer_max)
+		rec->buffer_max=fill;
+	__atomic_store_n(&rec->head, head+len, __ATOMIC_RELEASE);
+}
+
+/** @brief Record the data read from the card (whole transponder) */
+void record_mux(record_p_t *record_p, unsigned char *data, int len)
+{
+	if(record_p->mux_recording)
+		record_push(record_p->mux_recording, data, len);
+}
+
+/** @brief Record the datagram of a channel
+ * Called for each datagram sent, the recording is created with the first datagram
+ */
+void record_channel(mumudvb_channel_t *channel)
+{
+	if(record_vars==NULL || channel->record_mode==OPTION_OFF || channel->full_ts)
+		return;
+	if(channel->recording==NULL)
+	{
+		if(channel->record_mode==OPTION_UNDEFINED)
+			channel->record_mode=record_vars->default_mode;
+		if(channel->record_mode!=OPTION_ON)
+			return;
+		channel->recording=record_new(record_vars, channel->name, NULL);
+		if(channel->recording==NULL)
+		{
+			channel->record_mode=OPTION_OFF;
+			return;
+		}
+	}
+	//The recording needs the data in one piece
+	if(channel->iovcnt)
+		channel_keep_data(channel);
+	record_push(channel->recording, channel->datagram->buf, channel->nb_bytes);
+}
+
+/** @brief Open a file, with O_DIRECT if asked and supported */
+static int record_open(record_p_t *record_p, char *path, int flags)
+{
+	int fd;
+	if(record_p->direct)
+	{
+		fd=open(path, flags|O_DIRECT, 0644);
+		//Some file systems do not support O_DIRECT
+		if(fd>=0 || errno!=EINVAL)
+			return fd;
+		log_message( log_module, MSG_WARN,"O_DIRECT is not supported for %s\n", path);
+		record_p->direct=0;
+	}
+	return open(path, flags, 0644);
+}
+
+/** @brief Open the next file of a recording
+ * The files are named after the recording and the date, with a number if several files start in the same second
+ */
+static int record_open_file(record_p_t *record_p, recording_t *rec)
+{
+	char date[20];
+	int part;
+
+	rec->file_start=time(NULL);
+	if(rec->filename)
+	{
+		snprintf(rec->current_file, sizeof(rec->current_file), "%s", rec->filename);
+		rec->fd=record_open(record_p, rec->current_file, O_WRONLY|O_CREAT|O_TRUNC);
+	}
+	else
+	{
+		strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime(&rec->file_start));
+		rec->fd=-1;
+		errno=EEXIST;
+		for(part=0;rec->fd<0 && errno==EEXIST && part<100;part++)
+		{
+			if(part)
+				snprintf(rec->current_file, sizeof(rec->current_file), "%s/%s_%s_%d.ts", record_p->dir, rec->name, date, part);
+			else
+				snprintf(rec->current_file, sizeof(rec->current_file), "%s/%s_%s.ts", record_p->dir, rec->name, date);
+			rec->fd=record_open(record_p, rec->current_file, O_WRONLY|O_CREAT|O_EXCL);
+		}
+	}
+	if(rec->fd<0)
+	{
+		log_message( log_module, MSG_ERROR,"Cannot open the recording file %s : %s\n", rec->current_file, strerror(errno));
+		return -1;
+	}
+	rec->file_bytes=0;
+	log_message( log_module, MSG_DETAIL,"Recording \"%s\" in %s\n", rec->name, rec->current_file);
+	return 0;
+}
+
+/** @brief Write data of the buffer of a recording and free its place
+ * The data which cannot be written is dropped
+ */
+static void record_write(recording_t *rec, uint64_t len)
+{
+	uint64_t pos,part,done=0;
+	ssize_t ret;
+
+	while(done<len && rec->fd>=0)
+	{
+		pos=(rec->tail+done)%rec->size;
+		part=len-done;
+		if(pos+part>rec->size)
+			part=rec->size-pos;
+		ret=write(rec->fd, rec->buffer+pos, part);
+		if(ret<=0)
+		{
+			if(ret<0 && errno==EINTR)
+				continue;
+			if(!rec->write_errors)
+				log_message( log_module, MSG_ERROR,"Error while writing the recording %s : %s\n", rec->current_file, strerror(errno));
+			rec->write_errors++;
+			break;
+		}
+		done+=ret;
+	}
+	rec->written+=done;
+	__atomic_store_n(&rec->dropped_writer, rec->dropped_writer+len-done, __ATOMIC_RELAXED);
+	rec->file_bytes+=done;
+	__atomic_store_n(&rec->tail, rec->tail+len, __ATOMIC_RELEASE);
+}
+
+/** @brief Write the data waiting in the buffer of a recording
+ * @param flush write all the data, even if it is less than RECORD_WRITE_SIZE
+ * @return the amount of data written
+ */
+static uint64_t record_service(record_p_t *record_p, recording_t *rec, uint64_t now, int flush)
+{
+	uint64_t avail,len,to_cut=0;
+	int cut=0;
+
+	avail=__atomic_load_n(&rec->head, __ATOMIC_ACQUIRE)-rec->tail;
+	if(!avail)
+		return 0;
+	if(rec->fd<0 && record_open_file(record_p, rec)<0)
+	{
+		//Nowhere to write
+		__atomic_store_n(&rec->dropped_writer, rec->dropped_writer+avail, __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->tail, rec->tail+avail, __ATOMIC_RELEASE);
+		return 0;
+	}
+	//Is it time for a new file ?
+	if(!rec->filename &&
+			((record_p->max_size && rec->file_bytes>=((uint64_t)record_p->max_size)*1024*1024) ||
+			 (record_p->max_time && time(NULL)-rec->file_start>=record_p->max_time)))
+	{
+		to_cut=(RECORD_CUT_ALIGN-rec->tail%RECORD_CUT_ALIGN)%RECORD_CUT_ALIGN;
+		if(!to_cut)
+		{
+			close(rec->fd);
+			rec->fd=-1;
+			if(record_open_file(record_p, rec)<0)
+				return 0;
+		}
+		else
+		{
+			cut=1;
+			if(avail>to_cut)
+				avail=to_cut;
+		}
+	}
+	if(avail>=RECORD_WRITE_SIZE)
+		len=RECORD_WRITE_SIZE;
+	else if(flush || (cut && avail==to_cut) || now-rec->last_write>=RECORD_FLUSH_DELAY)
+		len=avail;
+	else
+		return 0;
+	if(record_p->direct && !flush)
+		len-=len%RECORD_DIRECT_ALIGN;
+	if(!len)
+		return 0;
+	if(record_p->direct && flush && len%RECORD_DIRECT_ALIGN)
+	{
+		//The end of the recording is not aligned
+		fcntl(rec->fd, F_SETFL, fcntl(rec->fd, F_GETFL)&~O_DIRECT);
+	}
+	record_write(rec, len);
+	rec->last_write=now;
+	return len;
+}
+
+/** @brief The writer thread */
+static void *record_thread_func(void* arg)
+{
+	record_p_t *record_p=(record_p_t *)arg;
+	uint64_t now,written;
+	int i,num;
+
+	while(!record_p->threadshutdown)
+	{
+		written=0;
+		now=get_time();
+		num=__atomic_load_n(&record_p->num_recordings, __ATOMIC_ACQUIRE);
+		for(i=0;i<num;i++)
+			written+=record_service(record_p, record_p->recordings[i], now, 0);
+		if(!written)
+			usleep(RECORD_WRITER_SLEEP);
+	}
+	return NULL;
+}
+
+/** @brief Start the recordings
+ * @param dump_filename the file given with --dumpfile (whole transponder), or NULL
+ */
+int record_start(record_p_t *record_p, char *dump_filename)
+{
+	if(!strlen(record_p->dir))
+	{
+		if(record_p->mux || record_p->default_mode==OPTION_ON)
+			log_message( log_module, MSG_WARN,"No record_dir, the recordings are disabled\n");
+		record_p->mux=0;
+		record_p->default_mode=OPTION_OFF;
+		if(dump_filename==NULL)
+			return 0;
+	}
+	record_vars=record_p;
+	if(dump_filename || record_p->mux)
+		record_p->mux_recording=record_new(record_p, "mux", dump_filename);
+	record_p->threadshutdown=0;
+	if(pthread_create(&record_p->thread, NULL, record_thread_func, record_p))
+	{
+		log_message( log_module,  MSG_ERROR,"Cannot start the recording thread : %s\n", strerror(errno));
+		record_vars=NULL;
+		return -1;
+	}
+	record_p->thread_started=1;
+	return 0;
+}
+
+/** @brief The data dropped by a recording (buffer full or write error) */
+uint64_t record_dropped(recording_t *rec)
+{
+	return __atomic_load_n(&rec->dropped_producer, __ATOMIC_RELAXED)+__atomic_load_n(&rec->dropped_writer, __ATOMIC_RELAXED);
+}
+
+/** @brief A recording, for the monitoring
+ * @return NULL after the last one
+ */
+recording_t *record_get(int i)
+{
+	if(record_vars==NULL || i>=__atomic_load_n(&record_vars->num_recordings, __ATOMIC_ACQUIRE))
+		return NULL;
+	return record_vars->recordings[i];
+}
+
+/** @brief Stop the writer thread, write the data waiting and close the files */
+void record_stop(record_p_t *record_p)
+{
+	recording_t *rec;
+	int i;
+
+	if(!record_p->thread_started)
+		return;
+	record_p->threadshutdown=1;
+	pthread_join(record_p->thread, NULL);
+	record_p->thread_started=0;
+	record_vars=NULL;
+	for(i=0;i<record_p->num_recordings;i++)
+	{
+		rec=record_p->recordings[i];
+		while(record_service(record_p, rec, get_time(), 1));
+		if(rec->fd>=0)
+			close(rec->fd);
+		log_message( log_module, MSG_INFO,"Recording \"%s\" : %llu bytes written, %llu bytes dropped (buffer full or write error), buffer filled at %d%% at most\n",
+				rec->name, (unsigned long long)rec->written, (unsigned long long)record_dropped(rec), rec->buffer_max);
+		free(rec->buffer);
+		free(rec);
+		record_p->recordings[i]=NULL;
+	}
+	record_p->num_recordings=0;
+	record_p->mux_recording=NULL;
+}
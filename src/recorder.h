@@ -0,0 +1,111 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the recording of the streams
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Header file for the recording of the streams
+ */
+
+#ifndef _RECORDER_H
+#define _RECORDER_H
+
+#include "mumudvb.h"
+
+/** Default size of the buffer of a recording (MB) */
+#define RECORD_DEFAULT_BUFFER 8
+/** Size of the writes to the disk */
+#define RECORD_WRITE_SIZE (1024*1024)
+/** Alignment of the writes with O_DIRECT */
+#define RECORD_DIRECT_ALIGN 4096
+/** The files are cut at a multiple of this size : whole packets, aligned for O_DIRECT */
+#define RECORD_CUT_ALIGN (TS_PACKET_SIZE*RECORD_DIRECT_ALIGN/4)
+/** The data waiting less than RECORD_WRITE_SIZE is written after this delay (us) */
+#define RECORD_FLUSH_DELAY 1000000
+/** Sleep of the writer thread when there is nothing to write (us) */
+#define RECORD_WRITER_SLEEP 10000
+/** Maximum number of recordings (the whole transponder and the channels) */
+#define RECORD_MAX 256
+
+/** @brief A recording : a buffer filled by the thread receiving the stream and emptied by the writer thread */
+typedef struct recording_t{
+	/** Name for the files : the channel name or "mux" */
+	char name[MAX_NAME_LEN];
+	/** A fixed file (--dumpfile), no cut */
+	char *filename;
+	/** The buffer, only the receiving thread moves head and only the writer moves tail */
+	unsigned char *buffer;
+	uint64_t size;
+	uint64_t head;
+	uint64_t tail;
+	/** The current file */
+	int fd;
+	char current_file[DEFAULT_PATH_LEN+MAX_NAME_LEN+32];
+	uint64_t file_bytes;
+	time_t file_start;
+	uint64_t last_write;
+	/** Statistics */
+	uint64_t written;
+	/** Dropped data : buffer full (receiving thread) and write errors (writer thread), each counter has one writer */
+	uint64_t dropped_producer;
+	uint64_t dropped_writer;
+	int buffer_max;
+	int write_errors;
+}recording_t;
+
+/** @brief The recording parameters */
+typedef struct record_p_t{
+	/** The directory for the recordings */
+	char dir[DEFAULT_PATH_LEN];
+	/** Record the whole transponder */
+	int mux;
+	/** Recording of the channels without record option */
+	option_status_t default_mode;
+	/** The files are cut after this size (MB) or this duration (s), 0 : no cut */
+	int max_size;
+	int max_time;
+	/** Write with O_DIRECT (no page cache) */
+	int direct;
+	/** Size of the buffer of each recording (MB) */
+	int buffer_size;
+	/** The recordings, added by the receiving threads (under lock) and read by the writer */
+	recording_t *recordings[RECORD_MAX];
+	int num_recordings;
+	pthread_mutex_t lock;
+	/** The recording of the whole transponder */
+	recording_t *mux_recording;
+	pthread_t thread;
+	int thread_started;
+	volatile int threadshutdown;
+}record_p_t;
+
+void init_record_v(record_p_t *record_p);
+uint64_t record_dropped(recording_t *rec);
+int read_record_configuration(record_p_t *record_p, mumudvb_channel_t *current_channel, int channel_start, char *substring);
+int record_start(record_p_t *record_p, char *dump_filename);
+void record_mux(record_p_t *record_p, unsigned char *data, int len);
+void record_channel(mumudvb_channel_t *channel);
+void record_stop(record_p_t *record_p);
+recording_t *record_get(int i);
+
+#endif
@@ -434,7 +434,7 @@ void eit_rewrite_new_channel_packet(unsigned char *ts_packet, rewrite_parameters
 			data_left_to_send=0;
 		}
 		//NOW we fill the channel buffer for sending
-		buffer_func(channel, send_buf, unicast_vars, multi_p, scam_vars_v, fds);
+		buffer_func(channel, send_buf, 0, unicast_vars, multi_p, scam_vars_v, fds);
 	}
 
 	//We update which section we want to send
@@ -32,14 +32,15 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include "mumudvb.h"
 #include "ts.h"
 #include "rewrite.h"
 #include "log.h"
+#include "crc32.h"
 #include <stdint.h>
 
-extern uint32_t       crc32_table[256];
 static char *log_module="PAT Rewrite: ";
 
 /** @brief, tell if the pat have a newer version than the one recorded actually
@@ -191,10 +192,7 @@ int pat_channel_rewrite(rewrite_parameters_t *rewrite_vars, mumudvb_channel_t *c
 	//CRC32 calculation inspired by the xine project
 	//Now we must adjust the CRC32
 	//we compute the CRC32
-	crc32=0xffffffff;
-	for(i = 0; i < new_section_length-1; i++) {
-		crc32 = (crc32 << 8) ^ crc32_table[((crc32 >> 24) ^ buf_dest[i+TS_HEADER_LEN])&0xff];
-	}
+	crc32=crc32_mpeg2(buf_dest+TS_HEADER_LEN, new_section_length-1);
 
 
 	//We write the CRC32 to the buffer
@@ -211,7 +209,16 @@ int pat_channel_rewrite(rewrite_parameters_t *rewrite_vars, mumudvb_channel_t *c
 	//Padding with 0xFF
 	memset(buf_dest+buf_dest_pos,0xFF,TS_PACKET_SIZE-buf_dest_pos);
 
-	//We copy the result to the intended buffer
+	//We copy the result to the intended buffer, allocated the first time only : most channels never need it
+	if(channel->generated_pat==NULL)
+	{
+		channel->generated_pat=malloc(TS_PACKET_SIZE);
+		if(channel->generated_pat==NULL)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			return 0;
+		}
+	}
 	memcpy(channel->generated_pat,buf_dest,TS_PACKET_SIZE);
 
 	//Everything is Ok ....
@@ -32,14 +32,15 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include "mumudvb.h"
 #include "ts.h"
 #include "rewrite.h"
 #include "log.h"
+#include "crc32.h"
 #include <stdint.h>
 
-extern uint32_t       crc32_table[256];
 
 static char *log_module="SDT rewrite: ";
 
@@ -278,11 +279,7 @@ int sdt_channel_rewrite(rewrite_parameters_t *rewrite_vars, mumudvb_channel_t *c
 	//CRC32 calculation inspired by the xine project
 	//Now we must adjust the CRC32
 	//we compute the CRC32
-	crc32=0xffffffff;
-	int i;
-	for(i = 0; i < new_section_length-1; i++) {
-		crc32 = (crc32 << 8) ^ crc32_table[((crc32 >> 24) ^ buf_dest[i+TS_HEADER_LEN])&0xff];
-	}
+	crc32=crc32_mpeg2(buf_dest+TS_HEADER_LEN, new_section_length-1);
 
 
 	//We write the CRC32 to the buffer
@@ -301,7 +298,16 @@ int sdt_channel_rewrite(rewrite_parameters_t *rewrite_vars, mumudvb_channel_t *c
 
 	if(found)
 	{
-		//We copy the result to the intended buffer
+		//We copy the result to the intended buffer, allocated the first time only : most channels never need it
+		if(channel->generated_sdt==NULL)
+		{
+			channel->generated_sdt=malloc(TS_PACKET_SIZE);
+			if(channel->generated_sdt==NULL)
+			{
+				log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+				return 0;
+			}
+		}
 		memcpy(channel->generated_sdt,buf_dest,TS_PACKET_SIZE);
 		channel->sdt_rewrite_skip=0;
 	}
@@ -40,18 +40,18 @@
 void init_rtp_header(mumudvb_channel_t *channel)
 {
 	// See RFC 1889
-	channel->buf_with_rtp_header[0]=128; //version=2 padding=0 extension=0 CSRC=0
-	channel->buf_with_rtp_header[1]=33;  // marker=0 payload type=33 (MP2T)
-	channel->buf_with_rtp_header[2]=0;   // sequence number
-	channel->buf_with_rtp_header[3]=0;   // sequence number
-	channel->buf_with_rtp_header[4]=0;   // timestamp
-	channel->buf_with_rtp_header[5]=0;   // timestamp
-	channel->buf_with_rtp_header[6]=0;   // timestamp
-	channel->buf_with_rtp_header[7]=0;   // timestamp
-	channel->buf_with_rtp_header[8]= (char)(rand() % 256); // synchronization source
-	channel->buf_with_rtp_header[9]= (char)(rand() % 256); // synchronization source
-	channel->buf_with_rtp_header[10]=(char)(rand() % 256); // synchronization source
-	channel->buf_with_rtp_header[11]=(char)(rand() % 256); // synchronization source
+	channel->datagram->buf_with_rtp_header[0]=128; //version=2 padding=0 extension=0 CSRC=0
+	channel->datagram->buf_with_rtp_header[1]=33;  // marker=0 payload type=33 (MP2T)
+	channel->datagram->buf_with_rtp_header[2]=0;   // sequence number
+	channel->datagram->buf_with_rtp_header[3]=0;   // sequence number
+	channel->datagram->buf_with_rtp_header[4]=0;   // timestamp
+	channel->datagram->buf_with_rtp_header[5]=0;   // timestamp
+	channel->datagram->buf_with_rtp_header[6]=0;   // timestamp
+	channel->datagram->buf_with_rtp_header[7]=0;   // timestamp
+	channel->datagram->buf_with_rtp_header[8]= (char)(rand() % 256); // synchronization source
+	channel->datagram->buf_with_rtp_header[9]= (char)(rand() % 256); // synchronization source
+	channel->datagram->buf_with_rtp_header[10]=(char)(rand() % 256); // synchronization source
+	channel->datagram->buf_with_rtp_header[11]=(char)(rand() % 256); // synchronization source
 
 }
 
@@ -75,12 +75,12 @@ void rtp_update_sequence_number(mumudvb_channel_t *channel, uint64_t time)
 	timestamp=(uint32_t) (90000 * (time/1000000ll))+(9*(time%1000000ll))/100;	// 90 kHz Clock
 
 	// Change the header (sequence number)
-	channel->buf_with_rtp_header[2]=(char)((channel->rtp_packet_num >> 8) & 0xff); // sequence number (high)
-	channel->buf_with_rtp_header[3]=(char)(channel->rtp_packet_num & 0xff);        // sequence number (low)
-	channel->buf_with_rtp_header[4]=(timestamp>>24)&0x0FF;   // timestamp
-	channel->buf_with_rtp_header[5]=(timestamp>>16)&0x0FF;   // timestamp
-	channel->buf_with_rtp_header[6]=(timestamp>>8)&0x0FF;   // timestamp
-	channel->buf_with_rtp_header[7]=(timestamp)&0x0FF;   // timestamp
+	channel->datagram->buf_with_rtp_header[2]=(char)((channel->rtp_packet_num >> 8) & 0xff); // sequence number (high)
+	channel->datagram->buf_with_rtp_header[3]=(char)(channel->rtp_packet_num & 0xff);        // sequence number (low)
+	channel->datagram->buf_with_rtp_header[4]=(timestamp>>24)&0x0FF;   // timestamp
+	channel->datagram->buf_with_rtp_header[5]=(timestamp>>16)&0x0FF;   // timestamp
+	channel->datagram->buf_with_rtp_header[6]=(timestamp>>8)&0x0FF;   // timestamp
+	channel->datagram->buf_with_rtp_header[7]=(timestamp)&0x0FF;   // timestamp
 	channel->rtp_packet_num++;
 	channel->rtp_packet_num &= 0xffff;
 }
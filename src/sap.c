@@ -34,8 +34,8 @@
 #include <errno.h>
 #include <stdlib.h>
 #include "log.h"
+#include "crc32.h"
 
-extern uint32_t       crc32_table[256];
 static char *log_module="SAP: ";
 
 int sap_add_program(mumudvb_channel_t *channel, sap_p_t *sap_p, mumudvb_sap_message_t *sap_message4, mumudvb_sap_message_t *sap_message6, multi_p_t multi_p);
@@ -47,6 +47,7 @@ void init_sap_v(sap_p_t *sap_p)
 	 *sap_p=(sap_p_t){
 			.sap_messages4=NULL,
 			.sap_messages6=NULL,
+			.sap_messages_allocated=0,
 			.sap=OPTION_UNDEFINED, //No sap by default
 			.sap_interval=SAP_DEFAULT_INTERVAL,
 			.sap_sending_ip4="0.0.0.0",
@@ -146,7 +147,7 @@ int read_sap_configuration(sap_p_t *sap_p, mumudvb_channel_t *current_channel, i
 					"The sap group is too long\n");
 			return -1;
 		}
-		strcpy (current_channel->sap_group, substring);
+		strcpy (current_channel->desc->sap_group, substring);
 	}
 	else if (!strcmp (substring, "sap_default_group"))
 	{
@@ -177,13 +178,12 @@ int init_sap(sap_p_t *sap_p, multi_p_t multi_p)
 		if(multi_p.multicast_ipv4)
 		{
 			log_message( log_module,  MSG_DETAIL,  "init sap v4\n");
-			sap_p->sap_messages4=malloc(sizeof(mumudvb_sap_message_t)*MAX_CHANNELS);
+			sap_p->sap_messages4=calloc(CHANNELS_ALLOC_STEP,sizeof(mumudvb_sap_message_t));
 			if(sap_p->sap_messages4==NULL)
 			{
 				log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
 				return -1;
 			}
-			memset (sap_p->sap_messages4, 0, sizeof( mumudvb_sap_message_t)*MAX_CHANNELS);//we clear it
 			//For sap announces, we open the socket
 			//See the README about multicast_auto_join
 			if(multi_p.auto_join)
@@ -194,13 +194,12 @@ int init_sap(sap_p_t *sap_p, multi_p_t multi_p)
 		if(multi_p.multicast_ipv6)
 		{
 			log_message( log_module,  MSG_DETAIL,  "init sap v6\n");
-			sap_p->sap_messages6=malloc(sizeof(mumudvb_sap_message_t)*MAX_CHANNELS);
+			sap_p->sap_messages6=calloc(CHANNELS_ALLOC_STEP,sizeof(mumudvb_sap_message_t));
 			if(sap_p->sap_messages6==NULL)
 			{
 				log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
 				return -1;
 			}
-			memset (sap_p->sap_messages6, 0, sizeof( mumudvb_sap_message_t)*MAX_CHANNELS);//we clear it
 			//For sap announces, we open the socket
 			//See the README about multicast_auto_join
 			if(multi_p.auto_join)
@@ -208,6 +207,7 @@ int init_sap(sap_p_t *sap_p, multi_p_t multi_p)
 			else
 				sap_p->sap_socketOut6 =  makesocket6 (SAP_IP6, SAP_PORT, sap_p->sap_ttl, multi_p.iface6, &sap_p->sap_sOut6);
 		}
+		sap_p->sap_messages_allocated=CHANNELS_ALLOC_STEP;
 		sap_p->sap_serial= 1 + (int) (424242.0 * (rand() / (RAND_MAX + 1.0)));
 		sap_p->sap_last_time_sent = 0;
 		/** @todo : loop to create the version*/
@@ -216,6 +216,43 @@ int init_sap(sap_p_t *sap_p, multi_p_t multi_p)
 }
 
 
+/** @brief Grow the sap messages arrays to follow the channel table
+ * The new messages are cleared
+ */
+static int sap_messages_reserve(sap_p_t *sap_p, int num_messages)
+{
+	mumudvb_sap_message_t *messages;
+	int new_allocated;
+	if(num_messages<=sap_p->sap_messages_allocated)
+		return 0;
+	new_allocated=((num_messages+CHANNELS_ALLOC_STEP-1)/CHANNELS_ALLOC_STEP)*CHANNELS_ALLOC_STEP;
+	if(sap_p->sap_messages4)
+	{
+		messages=realloc(sap_p->sap_messages4,sizeof(mumudvb_sap_message_t)*new_allocated);
+		if(messages==NULL)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with realloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			return -1;
+		}
+		memset(messages+sap_p->sap_messages_allocated, 0, sizeof(mumudvb_sap_message_t)*(new_allocated-sap_p->sap_messages_allocated));
+		sap_p->sap_messages4=messages;
+	}
+	if(sap_p->sap_messages6)
+	{
+		messages=realloc(sap_p->sap_messages6,sizeof(mumudvb_sap_message_t)*new_allocated);
+		if(messages==NULL)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with realloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			return -1;
+		}
+		memset(messages+sap_p->sap_messages_allocated, 0, sizeof(mumudvb_sap_message_t)*(new_allocated-sap_p->sap_messages_allocated));
+		sap_p->sap_messages6=messages;
+	}
+	sap_p->sap_messages_allocated=new_allocated;
+	return 0;
+}
+
+
 /** @brief Send the sap message
  * 
  * @param sap_p the sap variables
@@ -228,6 +265,8 @@ void sap_send(sap_p_t *sap_p, int num_messages)
 	mumudvb_sap_message_t *sap_messages6;
 	sap_messages4=sap_p->sap_messages4;
 	sap_messages6=sap_p->sap_messages6;
+	if(num_messages>sap_p->sap_messages_allocated)
+		num_messages=sap_p->sap_messages_allocated;
 
 	for( curr_message=0; curr_message<num_messages;curr_message++)
 	{
@@ -258,6 +297,16 @@ int sap_update(mumudvb_channel_t *channel, sap_p_t *sap_p, int curr_channel, mul
 	struct in6_addr ip6;
 	mumudvb_sap_message_t *sap_message4=NULL;
 	mumudvb_sap_message_t *sap_message6=NULL;
+	if(sap_messages_reserve(sap_p, curr_channel+1))
+		return -1;
+	//A stopped channel has no sockets anymore (see autoconf_cache_remove_channel), sap_add_program will not see its messages
+	if(!channel->streamed_channel)
+	{
+		if(sap_p->sap_messages4)
+			sap_p->sap_messages4[curr_channel].to_be_sent=0;
+		if(sap_p->sap_messages6)
+			sap_p->sap_messages6[curr_channel].to_be_sent=0;
+	}
 	if(channel->socketOut4)
 	{
 		sap_message4=&(sap_p->sap_messages4[curr_channel]);
@@ -340,24 +389,17 @@ int sap_update(mumudvb_channel_t *channel, sap_p_t *sap_p, int curr_channel, mul
 
 
 	//we compute the CRC32 of the message in order to generate a hash
-	unsigned long crc32;
-	int i;
-	crc32=0xffffffff;
+	uint32_t crc32;
 	if(channel->socketOut4)
 	{
-		for(i = 0; i < sap_message4->len-1; i++) {
-			crc32 = (crc32 << 8) ^ crc32_table[((crc32 >> 24) ^ sap_message4->buf[i])&0xff];
-		}
+		crc32=crc32_mpeg2(sap_message4->buf, sap_message4->len-1);
 		//Hash of SAP message : we use the CRC32 that we merge onto 16bits
 		sap_message4->buf[2]=(((crc32>>24) & 0xff)+((crc32>>16) & 0xff)) & 0xff;
 		sap_message4->buf[3]=(((crc32>>8) & 0xff)+(crc32 & 0xff)) & 0xff;
 	}
-	crc32=0xffffffff;
 	if(channel->socketOut6)
 	{
-		for(i = 0; i < sap_message6->len-1; i++) {
-			crc32 = (crc32 << 8) ^ crc32_table[((crc32 >> 24) ^ sap_message6->buf[i])&0xff];
-		}
+		crc32=crc32_mpeg2(sap_message6->buf, sap_message6->len-1);
 		//Hash of SAP message : we use the CRC32 that we merge onto 16bits
 		sap_message6->buf[2]=(((crc32>>24) & 0xff)+((crc32>>16) & 0xff)) & 0xff;
 		sap_message6->buf[3]=(((crc32>>8) & 0xff)+(crc32 & 0xff)) & 0xff;
@@ -407,12 +449,12 @@ int sap_add_program(mumudvb_channel_t *channel, sap_p_t *sap_p, mumudvb_sap_mess
 	if(channel->socketOut4)
 		mumu_string_append(&payload4,
 				"v=0\r\no=%s %d %d IN IP4 %s\r\ns=%s\r\n",
-				sap_p->sap_organisation, sap_p->sap_serial, sap_message4->version, channel->ip4Out,
+				sap_p->sap_organisation, sap_p->sap_serial, sap_message4->version, channel->desc->ip4Out,
 				channel->name);
 	if(channel->socketOut6)
 		mumu_string_append(&payload6,
 				"v=0\r\no=%s %d %d IN IP6 %s\r\ns=%s\r\n",
-				sap_p->sap_organisation, sap_p->sap_serial, sap_message6->version, channel->ip6Out,
+				sap_p->sap_organisation, sap_p->sap_serial, sap_message6->version, channel->desc->ip6Out,
 				channel->name);
 
 
@@ -454,11 +496,11 @@ int sap_add_program(mumudvb_channel_t *channel, sap_p_t *sap_p, mumudvb_sap_mess
 	if(channel->socketOut4)
 		mumu_string_append(&payload4,
 				"c=IN IP4 %s/%d\r\n",
-				channel->ip4Out, multi_p.ttl);
+				channel->desc->ip4Out, multi_p.ttl);
 	if(channel->socketOut6)
 		mumu_string_append(&payload6,
 				"c=IN IP6 %s\r\n",
-				channel->ip6Out);
+				channel->desc->ip6Out);
 
 
 	/**@subsection time session : tell when the session is active
@@ -494,7 +536,7 @@ int sap_add_program(mumudvb_channel_t *channel, sap_p_t *sap_p, mumudvb_sap_mess
 		struct in_addr ip_struct4;
 		if( inet_aton(sap_p->sap_sending_ip4, &ip_struct4) && ip_struct4.s_addr)
 			mumu_string_append(&payload4,
-					"a=source-filter: incl IN IP4 %s %s\r\n", channel->ip4Out, sap_p->sap_sending_ip4);
+					"a=source-filter: incl IN IP4 %s %s\r\n", channel->desc->ip4Out, sap_p->sap_sending_ip4);
 	}
 	if(channel->socketOut6)
 	{
@@ -506,7 +548,7 @@ int sap_add_program(mumudvb_channel_t *channel, sap_p_t *sap_p, mumudvb_sap_mess
 			s6=ip_struct6.sin6_addr.s6_addr;
 			if(s6[0]||s6[1]||s6[2]||s6[3]||s6[4]||s6[5]||s6[6]||s6[7]||s6[8]||s6[9]||s6[10]||s6[11]||s6[12]||s6[13]||s6[14]||s6[15])
 				mumu_string_append(&payload6,
-						"a=source-filter: incl IP6 %s %s\r\n", channel->ip6Out, sap_p->sap_sending_ip6);
+						"a=source-filter: incl IP6 %s %s\r\n", channel->desc->ip6Out, sap_p->sap_sending_ip6);
 		}
 	}
 
@@ -514,22 +556,22 @@ int sap_add_program(mumudvb_channel_t *channel, sap_p_t *sap_p, mumudvb_sap_mess
     a=cat channel's group
     a=x-plgroup backward compatibility
 	 */
-	if(strlen(channel->sap_group)||strlen(sap_p->sap_default_group))
+	if(strlen(channel->desc->sap_group)||strlen(sap_p->sap_default_group))
 	{
-		if(!strlen(channel->sap_group))
+		if(!strlen(channel->desc->sap_group))
 		{
 			int len=SAP_GROUP_LENGTH;
-			strcpy(channel->sap_group,sap_p->sap_default_group);
-			mumu_string_replace(channel->sap_group,&len,0,"%type",simple_service_type_to_str(channel->channel_type) );
+			strcpy(channel->desc->sap_group,sap_p->sap_default_group);
+			mumu_string_replace(channel->desc->sap_group,&len,0,"%type",simple_service_type_to_str(channel->channel_type) );
 		}
 		if(channel->socketOut4)
-			mumu_string_append(&payload4,"a=cat:%s\r\n", channel->sap_group);
+			mumu_string_append(&payload4,"a=cat:%s\r\n", channel->desc->sap_group);
 		/* backward compatibility with VLC 0.7.3-2.0.0 senders */
-		mumu_string_append(&payload4,"a=x-plgroup:%s\r\n", channel->sap_group);
+		mumu_string_append(&payload4,"a=x-plgroup:%s\r\n", channel->desc->sap_group);
 		if(channel->socketOut6)
-			mumu_string_append(&payload6,"a=cat:%s\r\n", channel->sap_group);
+			mumu_string_append(&payload6,"a=cat:%s\r\n", channel->desc->sap_group);
 		/* backward compatibility with VLC 0.7.3-2.0.0 senders */
-		mumu_string_append(&payload6,"a=x-plgroup:%s\r\n", channel->sap_group);
+		mumu_string_append(&payload6,"a=x-plgroup:%s\r\n", channel->desc->sap_group);
 	}
 
 	/**  @subsection media name and transport address See RFC 1890
@@ -613,7 +655,7 @@ int sap_add_program(mumudvb_channel_t *channel, sap_p_t *sap_p, mumudvb_sap_mess
  * @param multi_p the multicast variables
  * @param now the time
  */
-void sap_poll(sap_p_t *sap_p,int number_of_channels,mumudvb_channel_t  *channels, multi_p_t multi_p, long now)
+void sap_poll(sap_p_t *sap_p,int number_of_channels,mumudvb_channel_t  **channels, multi_p_t multi_p, long now)
 {
 	int curr_channel;
 	//we check if SAP is initialised
@@ -625,9 +667,16 @@ void sap_poll(sap_p_t *sap_p,int number_of_channels,mumudvb_channel_t  *channels
 		{
 			// it's the first time we are here, we initialize all the channels
 			for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
-				sap_update(&channels[curr_channel], sap_p, curr_channel, multi_p);
+				sap_update(channels[curr_channel], sap_p, curr_channel, multi_p);
 			sap_p->sap_last_time_sent=now-sap_p->sap_interval-1;
 		}
+		//channels added or modified while streaming
+		for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
+			if(channels[curr_channel]->sap_need_update)
+			{
+				sap_update(channels[curr_channel], sap_p, curr_channel, multi_p);
+				channels[curr_channel]->sap_need_update=0;
+			}
 		if((now-sap_p->sap_last_time_sent)>=sap_p->sap_interval)
 		{
 			sap_send(sap_p, number_of_channels);
@@ -75,6 +75,8 @@ typedef struct sap_p_t{
   mumudvb_sap_message_t *sap_messages4; 
   /**the sap messages array*/
   mumudvb_sap_message_t *sap_messages6; 
+  /**the number of messages allocated in the arrays (grows with the channels)*/
+  int sap_messages_allocated;
   /**do we send sap announces ?*/
   option_status_t sap; 
   /**Interval between two sap announces in second*/
@@ -111,6 +113,6 @@ int init_sap(sap_p_t *sap_vars, multi_p_t multi_p);
 void sap_send(sap_p_t *sap_vars, int num_messages);
 int sap_update(mumudvb_channel_t *channel, sap_p_t *sap_vars, int curr_channel, multi_p_t multi_p);
 int read_sap_configuration(sap_p_t *sap_vars, mumudvb_channel_t *current_channel, int ip_ok, char *substring);
-void sap_poll(sap_p_t *sap_vars,int number_of_channels,mumudvb_channel_t  *channels, multi_p_t multi_p, long now);
+void sap_poll(sap_p_t *sap_vars,int number_of_channels,mumudvb_channel_t  **channels, multi_p_t multi_p, long now);
 
 #endif
@@ -189,19 +189,19 @@ int read_scam_configuration(scam_parameters_t *scam_vars, mumudvb_channel_t *cur
 /** @brief initialize the pmt get for scam descrambled channels
  *
  */
-int scam_init_no_autoconf(scam_parameters_t *scam_vars, mumudvb_channel_t *channels,int number_of_channels)
+int scam_init_no_autoconf(scam_parameters_t *scam_vars, mumudvb_channel_t **channels,int number_of_channels)
 {
   int curr_channel;
 
   if (scam_vars->scam_support){
     for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
     {
-      if (channels[curr_channel].scam_support==1 && channels[curr_channel].num_pids>1) {
-        channels[curr_channel].pmt_pid=channels[curr_channel].pids[0];
-        channels[curr_channel].pids_type[0]=PID_PMT;
-        snprintf(channels[curr_channel].pids_language[0],4,"%s","---");
+      if (channels[curr_channel]->scam_support==1 && channels[curr_channel]->num_pids>1) {
+        channels[curr_channel]->pmt_pid=channels[curr_channel]->pids[0];
+        channels[curr_channel]->desc->pids_type[0]=PID_PMT;
+        snprintf(channels[curr_channel]->desc->pids_language[0],4,"%s","---");
         ++scam_vars->need_pmt_get;
-        channels[curr_channel].need_pmt_get=1;
+        channels[curr_channel]->need_pmt_get=1;
       }
     }
   }
@@ -213,27 +213,27 @@ int scam_init_no_autoconf(scam_parameters_t *scam_vars, mumudvb_channel_t *chann
 /** @brief pmt get for scam descrambled channels
  *
  */
-int scam_new_packet(int pid, unsigned char *ts_packet, scam_parameters_t *scam_vars, mumudvb_channel_t *channels)
+int scam_new_packet(int pid, unsigned char *ts_packet, scam_parameters_t *scam_vars, mumudvb_channel_t **channels, int number_of_channels)
 {
   int curr_channel;
 
   if(scam_vars->need_pmt_get) //We have the channels and their PMT, we search the other pids
   {
-    for(curr_channel=0;curr_channel<MAX_CHANNELS;curr_channel++)
+    for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
     {
-      if((channels[curr_channel].pmt_pid==pid)&& pid && channels[curr_channel].scam_support && channels[curr_channel].need_pmt_get )
+      if((channels[curr_channel]->pmt_pid==pid)&& pid && channels[curr_channel]->scam_support && channels[curr_channel]->need_pmt_get )
       {
-        if(get_ts_packet(ts_packet,channels[curr_channel].pmt_packet))
+        if(get_ts_packet(ts_packet,channels[curr_channel]->pmt_packet))
         {
-          if(check_pmt_service_id(channels[curr_channel].pmt_packet, &channels[curr_channel])) {
+          if(check_pmt_service_id(channels[curr_channel]->pmt_packet, channels[curr_channel])) {
             --scam_vars->need_pmt_get;
-            channels[curr_channel].need_pmt_get=0;
-            log_message(log_module,MSG_DEBUG,"Got pmt for channel %s\n", channels[curr_channel].name);
-            pthread_mutex_lock(&channels[curr_channel].scam_pmt_packet->packetmutex);
-            channels[curr_channel].scam_pmt_packet->len_full = channels[curr_channel].pmt_packet->len_full;
-            memcpy(channels[curr_channel].scam_pmt_packet->data_full, channels[curr_channel].pmt_packet->data_full, channels[curr_channel].pmt_packet->len_full);
-            pthread_mutex_unlock(&channels[curr_channel].scam_pmt_packet->packetmutex);
-          } else log_message(log_module,MSG_DEBUG,"pmt not for channel %s\n", channels[curr_channel].name);
+            channels[curr_channel]->need_pmt_get=0;
+            log_message(log_module,MSG_DEBUG,"Got pmt for channel %s\n", channels[curr_channel]->name);
+            pthread_mutex_lock(&channels[curr_channel]->scam_pmt_packet->packetmutex);
+            channels[curr_channel]->scam_pmt_packet->len_full = channels[curr_channel]->pmt_packet->len_full;
+            memcpy(channels[curr_channel]->scam_pmt_packet->data_full, channels[curr_channel]->pmt_packet->data_full, channels[curr_channel]->pmt_packet->len_full);
+            pthread_mutex_unlock(&channels[curr_channel]->scam_pmt_packet->packetmutex);
+          } else log_message(log_module,MSG_DEBUG,"pmt not for channel %s\n", channels[curr_channel]->name);
         }
       }
     }
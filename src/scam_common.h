@@ -59,6 +59,9 @@
 #define DECSA_DEFAULT_DELAY 500000
 #define SEND_DEFAULT_DELAY 1500000
 
+/**The maximum number of events read at once by the getcw thread*/
+#define SCAM_MAX_EVENTS 128
+
 /** @brief the parameters for the scam
  * This structure contain the parameters needed for the SCAM
  */
@@ -77,8 +80,8 @@ typedef struct scam_parameters_t{
 
 
 
-int scam_init_no_autoconf(scam_parameters_t *scam_vars, mumudvb_channel_t *channels, int number_of_channels);
-int scam_new_packet(int pid, unsigned char *ts_packet, scam_parameters_t *scam_vars, mumudvb_channel_t *channels);
+int scam_init_no_autoconf(scam_parameters_t *scam_vars, mumudvb_channel_t **channels, int number_of_channels);
+int scam_new_packet(int pid, unsigned char *ts_packet, scam_parameters_t *scam_vars, mumudvb_channel_t **channels, int number_of_channels);
 int read_scam_configuration(scam_parameters_t *scam_vars, mumudvb_channel_t *current_channel, int ip_ok, char *substring);
 int scam_channel_start(mumudvb_channel_t *channel);
 void scam_channel_stop(mumudvb_channel_t *channel);
@@ -44,6 +44,7 @@
 #include "mumudvb.h"
 #include "log.h"
 #include "scam_common.h"
+#include "probes.h"
 
 #include <dvbcsa/dvbcsa.h>
 
@@ -214,6 +215,7 @@ static void *decsathread_func(void* arg)
           log_message( log_module, MSG_DEBUG, "%016llx even key %02x %02x %02x %02x %02x %02x %02x %02x, channel %s\n", now_time, channel->even_cw[0], channel->even_cw[1], channel->even_cw[2], channel->even_cw[3], channel->even_cw[4], channel->even_cw[5], channel->even_cw[6], channel->even_cw[7],channel->name);
           channel->got_key_even = 0;
           got_first_even_key = 1;
+          MUMUDVB_PROBE2(key_loaded, channel->name, 0);
         }
         pthread_mutex_unlock(&channel->cw_lock);
       }
@@ -224,10 +226,12 @@ static void *decsathread_func(void* arg)
           log_message( log_module, MSG_DEBUG, " %016llx odd key %02x %02x %02x %02x %02x %02x %02x %02x, channel %s\n",now_time, channel->odd_cw[0], channel->odd_cw[1], channel->odd_cw[2], channel->odd_cw[3], channel->odd_cw[4], channel->odd_cw[5], channel->odd_cw[6], channel->odd_cw[7], channel->name);
           channel->got_key_odd = 0;
           got_first_odd_key = 1;
+          MUMUDVB_PROBE2(key_loaded, channel->name, 1);
         }
         pthread_mutex_unlock(&channel->cw_lock);
       }
       pthread_mutex_unlock(&channel->ring_buf->lock);
+      MUMUDVB_PROBE3(descrambler_batch, channel->name, even_batch_idx, odd_batch_idx);
       if (even_batch_idx) {
         dvbcsa_bs_decrypt(even_key, even_batch, 184);
 
@@ -244,9 +248,12 @@ static void *decsathread_func(void* arg)
           *odd_scnt_field[i] &= 0x3f;
         }
       }
+      MUMUDVB_PROBE1(descrambler_batch_done, channel->name);
+      pthread_mutex_lock(&channel->ring_buf->lock);
+      channel->ring_buf->batches++;
+      channel->ring_buf->batch_packets+=even_batch_idx+odd_batch_idx;
       even_batch_idx = 0;
       odd_batch_idx = 0;
-      pthread_mutex_lock(&channel->ring_buf->lock);
 
       channel->ring_buf->to_send+= scrambled  + nscrambled;
       nscrambled=0;
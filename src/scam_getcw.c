@@ -44,6 +44,7 @@
 #include "mumudvb.h"
 #include "log.h"
 #include "scam_common.h"
+#include "probes.h"
 
 /**@file
  * @brief scam support
@@ -99,13 +100,13 @@ static void *getcwthread_func(void* arg)
 #ifdef ENABLE_SCAM_DESCRAMBLER_SUPPORT
   int *request;
 #endif
-  struct epoll_event events[MAX_CHANNELS];
+  struct epoll_event events[SCAM_MAX_EVENTS];
   int num_of_events;
   int i;
 
   //Loop
   while(!scam_params->getcwthread_shutdown) {
-    num_of_events = epoll_wait (scam_params->epfd, events, MAX_CHANNELS, -1);
+    num_of_events = epoll_wait (scam_params->epfd, events, SCAM_MAX_EVENTS, -1);
     if (num_of_events < 0) {
       set_interrupted(ERROR_NETWORK<<8);
       break;
@@ -113,7 +114,7 @@ static void *getcwthread_func(void* arg)
     for (i = 0; i < num_of_events; i++) {
       pthread_mutex_lock(&chan_p->lock);
       for (curr_channel = 0; curr_channel < chan_p->number_of_channels; curr_channel++) {
-        mumudvb_channel_t *channel = &chan_p->channels[curr_channel];
+        mumudvb_channel_t *channel = chan_p->channels[curr_channel];
         if (events[i].data.fd == channel->camd_socket) {
           if (events[i].events & EPOLLERR || events[i].events & EPOLLHUP) {
             log_message(log_module, MSG_INFO,"channel %s socket not alive, will try to reconnect\n", channel->name);
@@ -159,6 +160,7 @@ static void *getcwthread_func(void* arg)
                   channel->got_key_even=1;
                 }
                 pthread_mutex_unlock(&channel->cw_lock);
+                MUMUDVB_PROBE2(key_received, channel->name, scam_params->ca_descr.parity);
               } else {
                 log_message( log_module,  MSG_DEBUG, "Got CA_SET_DESCR removal request, ignoring");
               }
@@ -41,6 +41,7 @@
 #include "mumudvb.h"
 #include "log.h"
 #include "scam_common.h"
+#include "metrics.h"
 
 
 /**@file
@@ -139,8 +140,14 @@ void *sendthread_func(void* arg)
       send_packet=0;
 
     if (send_packet) {
+      //The packet entered the ring send_delay before its sending time, it leaves it now
+      if (!channel->nb_bytes && metrics_enabled()) {
+        channel->datagram_start = send_time - channel->send_delay;
+        channel->datagram_process = now_time > send_time ? now_time : send_time;
+        metrics_stage(METRICS_STAGE_DESCRAMBLER, channel->datagram_start, channel->datagram_process);
+      }
       // we fill the channel buffer
-      memcpy(channel->buf + channel->nb_bytes, channel->ring_buf->data+TS_PACKET_SIZE*channel->ring_buf->read_send_idx, TS_PACKET_SIZE);
+      memcpy(channel->datagram->buf + channel->nb_bytes, channel->ring_buf->data+TS_PACKET_SIZE*channel->ring_buf->read_send_idx, TS_PACKET_SIZE);
       channel->nb_bytes += TS_PACKET_SIZE;
     }
     ++channel->ring_buf->read_send_idx;
@@ -150,8 +157,7 @@ void *sendthread_func(void* arg)
     pthread_mutex_unlock(&channel->ring_buf->lock);
 
     //The buffer is full, we send it
-    if ((!multi_p.rtp_header && ((channel->nb_bytes + TS_PACKET_SIZE) > MAX_UDP_SIZE))
-      ||(multi_p.rtp_header && ((channel->nb_bytes + RTP_HEADER_LEN + TS_PACKET_SIZE) > MAX_UDP_SIZE)))
+    if ((channel->nb_bytes + TS_PACKET_SIZE) > channel->udp_size)
     {
       send_func(channel, send_time, &unicast_vars, &multi_p, &fds);
     }
@@ -0,0 +1,330 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the statistics in shared memory
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Statistics in shared memory
+ *
+ * The data path writes its counters in the segment with plain stores, no system call and no lock
+ * (see stats_shm.h for the layout and the rules). The monitor thread writes the description of the
+ * channels every second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+
+#include "stats_shm.h"
+#include "analyzer.h"
+#include "mumudvb.h"
+#include "unicast_http.h"
+#include "errors.h"
+#include "log.h"
+
+static char *log_module="Stats shm: ";
+
+stats_shm_header_t *stats_shm_seg=NULL;
+stats_shm_pid_t *stats_shm_pids=NULL;
+static stats_shm_channel_t *stats_shm_channels=NULL;
+static stats_shm_client_t *stats_shm_clients=NULL;
+static char stats_shm_name[DEFAULT_PATH_LEN];
+
+/** @brief Start writing a group of values under a sequence lock */
+static inline void stats_shm_write_begin(uint64_t *seq)
+{
+	__atomic_store_n(seq, *seq+1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/** @brief The group of values is written */
+static inline void stats_shm_write_end(uint64_t *seq)
+{
+	__atomic_store_n(seq, *seq+1, __ATOMIC_RELEASE);
+}
+
+/** @brief Create the segment
+ *
+ * @param name the name of the segment (in /dev/shm), the templates %card, %tuner and %server are replaced
+ * @return 0 if ok, -1 on error
+ */
+int stats_shm_open(char *name, int card, int tuner, int server_id)
+{
+	stats_shm_header_t *seg;
+	char number[10];
+	int fd,len;
+	uint32_t size;
+
+	if(strlen(name)+2>=DEFAULT_PATH_LEN)
+	{
+		log_message( log_module, MSG_ERROR,"The name of the segment is too long\n");
+		return -1;
+	}
+	//shm_open wants a name starting with /
+	snprintf(stats_shm_name, sizeof(stats_shm_name), "%s%s", (name[0]=='/')?"":"/", name);
+	len=DEFAULT_PATH_LEN;
+	sprintf(number,"%d",card);
+	mumu_string_replace(stats_shm_name,&len,0,"%card",number);
+	sprintf(number,"%d",tuner);
+	mumu_string_replace(stats_shm_name,&len,0,"%tuner",number);
+	sprintf(number,"%d",server_id);
+	mumu_string_replace(stats_shm_name,&len,0,"%server",number);
+
+	size=sizeof(stats_shm_header_t)+STATS_SHM_PIDS*sizeof(stats_shm_pid_t)+
+			STATS_SHM_CHANNELS*sizeof(stats_shm_channel_t)+STATS_SHM_CLIENTS*sizeof(stats_shm_client_t);
+	fd=shm_open(stats_shm_name, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if(fd<0)
+	{
+		log_message( log_module, MSG_ERROR,"Cannot create the segment %s : %s\n", stats_shm_name, strerror(errno));
+		return -1;
+	}
+	if(ftruncate(fd, size))
+	{
+		log_message( log_module, MSG_ERROR,"Cannot size the segment %s : %s\n", stats_shm_name, strerror(errno));
+		close(fd);
+		shm_unlink(stats_shm_name);
+		return -1;
+	}
+	seg=mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(seg==MAP_FAILED)
+	{
+		log_message( log_module, MSG_ERROR,"Cannot map the segment %s : %s\n", stats_shm_name, strerror(errno));
+		shm_unlink(stats_shm_name);
+		return -1;
+	}
+	//The segment is new (truncated), it is filled with zeros
+	seg->version=STATS_SHM_VERSION;
+	seg->size=size;
+	seg->header_size=sizeof(stats_shm_header_t);
+	seg->channel_size=sizeof(stats_shm_channel_t);
+	seg->client_size=sizeof(stats_shm_client_t);
+	seg->pids_offset=sizeof(stats_shm_header_t);
+	seg->channels_offset=seg->pids_offset+STATS_SHM_PIDS*sizeof(stats_shm_pid_t);
+	seg->clients_offset=seg->channels_offset+STATS_SHM_CHANNELS*sizeof(stats_shm_channel_t);
+	seg->max_channels=STATS_SHM_CHANNELS;
+	seg->max_clients=STATS_SHM_CLIENTS;
+	seg->channel_pids=STATS_SHM_CHANNEL_PIDS;
+	seg->process_id=getpid();
+	seg->card=card;
+	seg->tuner=tuner;
+	seg->server_id=server_id;
+	seg->start_time=time(NULL);
+	seg->update_time=seg->start_time;
+	stats_shm_pids=(stats_shm_pid_t *)((char *)seg+seg->pids_offset);
+	stats_shm_channels=(stats_shm_channel_t *)((char *)seg+seg->channels_offset);
+	stats_shm_clients=(stats_shm_client_t *)((char *)seg+seg->clients_offset);
+	__atomic_store_n(&seg->magic, STATS_SHM_MAGIC, __ATOMIC_RELEASE);
+	stats_shm_seg=seg;
+	log_message( log_module, MSG_INFO,"Statistics in the shared memory segment %s (%u bytes)\n", stats_shm_name, size);
+	return 0;
+}
+
+/** @brief Remove the segment
+ * The mapping is kept : the thread reading the card is not joined and can still count a read
+ */
+void stats_shm_close(void)
+{
+	if(stats_shm_seg==NULL)
+		return;
+	shm_unlink(stats_shm_name);
+}
+
+/** @brief A read from the DVR, by the thread reading the card */
+void stats_shm_dvr_read(int bytes_read)
+{
+	if(stats_shm_seg==NULL)
+		return;
+	stats_shm_add(&stats_shm_seg->dvr_reads, 1);
+	stats_shm_add(&stats_shm_seg->dvr_bytes, bytes_read);
+}
+
+/** @brief The DVR buffer overflowed */
+void stats_shm_dvr_overflow(void)
+{
+	if(stats_shm_seg!=NULL)
+		stats_shm_add(&stats_shm_seg->dvr_overflows, 1);
+}
+
+/** @brief The buffer of the thread reading the card is full */
+void stats_shm_dvr_thread_full(void)
+{
+	if(stats_shm_seg!=NULL)
+		stats_shm_add(&stats_shm_seg->dvr_thread_full, 1);
+}
+
+/** @brief Write the description of the channels
+ * Called by the monitor thread every second, with the channels locked.
+ * The channels get their place in the segment here.
+ */
+void stats_shm_update(mumudvb_channel_t **channels, int number_of_channels)
+{
+	stats_shm_channel_t *rec;
+	int curr_channel,i;
+
+	if(stats_shm_seg==NULL)
+		return;
+	if(number_of_channels>STATS_SHM_CHANNELS)
+		number_of_channels=STATS_SHM_CHANNELS;
+	stats_shm_write_begin(&stats_shm_seg->seq);
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+	{
+		rec=&stats_shm_channels[curr_channel];
+		strncpy(rec->name, channels[curr_channel]->name, STATS_SHM_NAME_LEN-1);
+		rec->name[STATS_SHM_NAME_LEN-1]='\0';
+		rec->service_id=channels[curr_channel]->service_id;
+		rec->streamed=channels[curr_channel]->streamed_channel;
+		rec->scrambled_ratio=channels[curr_channel]->ratio_scrambled;
+		rec->traffic=channels[curr_channel]->traffic;
+		rec->num_pids=channels[curr_channel]->num_pids;
+		if(rec->num_pids>STATS_SHM_CHANNEL_PIDS)
+			rec->num_pids=STATS_SHM_CHANNEL_PIDS;
+		for(i=0;i<rec->num_pids;i++)
+			rec->pids[i]=channels[curr_channel]->pids[i];
+		if(channels[curr_channel]->stats_shm!=rec)
+			__atomic_store_n(&channels[curr_channel]->stats_shm, rec, __ATOMIC_RELEASE);
+	}
+	stats_shm_seg->num_channels=number_of_channels;
+	stats_shm_seg->update_time=time(NULL);
+	stats_shm_write_end(&stats_shm_seg->seq);
+}
+
+/** @brief Write the counters of the PIDs, the segment has no table of its own
+ * Called by the monitor thread every second, after analyzer_update
+ */
+void stats_shm_analyzer(analyzer_pid_t *pids, analyzer_pid_monitor_t *monitor, analyzer_ts_t *ts)
+{
+	stats_shm_pid_t *rec;
+	uint64_t ts_packets=0,cc_errors=0,packets;
+	int pid;
+
+	if(stats_shm_pids==NULL)
+		return;
+	__atomic_store_n(&stats_shm_seg->sync_errors, __atomic_load_n(&ts->sync_errors, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+	__atomic_store_n(&stats_shm_seg->pat_errors, __atomic_load_n(&ts->pat_errors, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+	for(pid=0;pid<ANALYZER_PIDS;pid++)
+	{
+		packets=__atomic_load_n(&pids[pid].packets, __ATOMIC_RELAXED);
+		if(!packets)
+			continue;
+		rec=&stats_shm_pids[pid];
+		ts_packets+=packets;
+		cc_errors+=__atomic_load_n(&pids[pid].cc_errors, __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->packets, packets, __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->scrambled, __atomic_load_n(&pids[pid].scrambled, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->cc_errors, __atomic_load_n(&pids[pid].cc_errors, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->tei_errors, __atomic_load_n(&pids[pid].tei_errors, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->bitrate, (uint64_t)monitor[pid].bitrate, __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->pcr_count, __atomic_load_n(&pids[pid].pcr_count, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->pcr_repetition_errors, __atomic_load_n(&pids[pid].pcr_repetition_errors, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->pcr_discontinuities, __atomic_load_n(&pids[pid].pcr_discontinuities, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->pcr_interval_max, monitor[pid].pcr_interval_shown, __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->pcr_jitter_max, monitor[pid].pcr_jitter_shown, __ATOMIC_RELAXED);
+		__atomic_store_n(&rec->scrambling, __atomic_load_n(&pids[pid].scrambling, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&stats_shm_seg->ts_packets, ts_packets, __ATOMIC_RELAXED);
+	__atomic_store_n(&stats_shm_seg->cc_errors, cc_errors, __ATOMIC_RELAXED);
+}
+
+/** @brief A datagram of the channel is sent, by the thread sending the channel */
+void stats_shm_channel_sent(mumudvb_channel_t *channel, int bytes)
+{
+	stats_shm_channel_t *rec;
+
+	rec=__atomic_load_n(&channel->stats_shm, __ATOMIC_ACQUIRE);
+	if(rec==NULL)
+		return;
+	stats_shm_write_begin(&rec->seq);
+	stats_shm_add(&rec->packets, bytes/TS_PACKET_SIZE);
+	stats_shm_add(&rec->bytes, bytes);
+	stats_shm_add(&rec->datagrams, 1);
+	__atomic_store_n(&rec->last_send, get_time(), __ATOMIC_RELAXED);
+	stats_shm_write_end(&rec->seq);
+}
+
+/** @brief A client starts getting a channel, it gets a slot if there is one free */
+void stats_shm_client_add(unicast_client_t *client, mumudvb_channel_t *channel)
+{
+	stats_shm_client_t *rec;
+	stats_shm_channel_t *chan_rec;
+	int slot;
+
+	client->stats_slot=-1;
+	if(stats_shm_seg==NULL)
+		return;
+	for(slot=0;slot<STATS_SHM_CLIENTS && stats_shm_clients[slot].used;slot++);
+	if(slot==STATS_SHM_CLIENTS)
+		return;
+	client->stats_slot=slot;
+	rec=&stats_shm_clients[slot];
+	chan_rec=__atomic_load_n(&channel->stats_shm, __ATOMIC_ACQUIRE);
+	stats_shm_write_begin(&rec->seq);
+	rec->used=1;
+	rec->channel=chan_rec?(int)(chan_rec-stats_shm_channels):-1;
+	inet_ntop(AF_INET, &client->SocketAddr.sin_addr, rec->ip, sizeof(rec->ip));
+	rec->port=ntohs(client->SocketAddr.sin_port);
+	rec->queue_bytes=0;
+	rec->dropped=0;
+	rec->drop_events=0;
+	rec->start_time=time(NULL);
+	stats_shm_write_end(&rec->seq);
+}
+
+/** @brief Update the slot of a client, by the main thread when it sends data to the client */
+void stats_shm_client_update(unicast_client_t *client)
+{
+	stats_shm_client_t *rec;
+	stats_shm_channel_t *chan_rec;
+
+	if(stats_shm_seg==NULL || client->stats_slot<0)
+		return;
+	rec=&stats_shm_clients[client->stats_slot];
+	stats_shm_write_begin(&rec->seq);
+	rec->queue_bytes=client->queue.data_bytes_in_queue+client->pipe_bytes;
+	rec->dropped=client->queue.dropped_packets;
+	rec->drop_events=client->queue.drop_events;
+	stats_shm_write_end(&rec->seq);
+	//The drops of the channel are written by the main thread
+	if(client->chan_ptr && (chan_rec=__atomic_load_n(&client->chan_ptr->stats_shm, __ATOMIC_ACQUIRE))!=NULL)
+		__atomic_store_n(&chan_rec->dropped, client->chan_ptr->unicast_dropped_packets, __ATOMIC_RELAXED);
+}
+
+/** @brief The client is disconnected, its slot is freed */
+void stats_shm_client_del(unicast_client_t *client)
+{
+	stats_shm_client_t *rec;
+
+	if(stats_shm_seg==NULL || client->stats_slot<0)
+		return;
+	rec=&stats_shm_clients[client->stats_slot];
+	stats_shm_write_begin(&rec->seq);
+	rec->used=0;
+	stats_shm_write_end(&rec->seq);
+	client->stats_slot=-1;
+}
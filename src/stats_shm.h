@@ -0,0 +1,207 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the statistics in shared memory
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Layout of the statistics segment in shared memory
+ *
+ * With the option stats_shm=name, MuMuDVB creates /dev/shm/name and updates the counters directly
+ * in it. Local agents map the segment read only (see mumudvb_stats.c) and read it as often as they
+ * want, MuMuDVB is not woken up.
+ *
+ * The segment is :
+ *   stats_shm_header_t                   at 0
+ *   stats_shm_pid_t [STATS_SHM_PIDS]     at header.pids_offset
+ *   stats_shm_channel_t [max_channels]   at header.channels_offset
+ *   stats_shm_client_t [max_clients]     at header.clients_offset
+ * All the fields are in the byte order of the host. A reader checks magic, version and the sizes
+ * of the header before using the segment. The segment is valid once magic is set.
+ *
+ * Each counter has one writer : the single counters (uint64_t) are read as they are. The groups of
+ * values which go together are protected by a sequence lock (seq) : the writer makes seq odd,
+ * writes the values and makes seq even again. A reader copies the values between two reads of
+ * seq, and starts again if seq was odd or changed.
+ */
+
+#ifndef _STATS_SHM_H
+#define _STATS_SHM_H
+
+#include <stdint.h>
+
+#define STATS_SHM_MAGIC 0x54534d4d /* "MMST" */
+#define STATS_SHM_VERSION 3
+
+/** Number of PIDs (8192 : the PIDs 0 to 8191 and one unused entry) */
+#define STATS_SHM_PIDS 8193
+/** Size of the tables, the channels and the clients beyond them are not in the segment */
+#define STATS_SHM_CHANNELS 256
+#define STATS_SHM_CLIENTS 256
+/** PIDs listed per channel */
+#define STATS_SHM_CHANNEL_PIDS 32
+#define STATS_SHM_NAME_LEN 64
+
+/** @brief Start of the segment : layout and global counters */
+typedef struct stats_shm_header_t{
+	uint32_t magic;
+	uint32_t version;
+	/** Layout : size of the segment and of its structures, offsets of the tables */
+	uint32_t size;
+	uint32_t header_size;
+	uint32_t channel_size;
+	uint32_t client_size;
+	uint32_t pids_offset;
+	uint32_t channels_offset;
+	uint32_t clients_offset;
+	uint32_t max_channels;
+	uint32_t max_clients;
+	uint32_t channel_pids;
+	/** The MuMuDVB process */
+	int32_t process_id;
+	int32_t card;
+	int32_t tuner;
+	int32_t server_id;
+	/** Start of the process (s, unix time) */
+	uint64_t start_time;
+
+	/** Sequence lock of the description of the channels (name, pids, state), written by the monitor thread every second */
+	uint64_t seq;
+	/** Last update of the descriptions (s, unix time), tells MuMuDVB is alive */
+	uint64_t update_time;
+	uint32_t num_channels;
+	uint32_t reserved;
+
+	/** Global counters, written by the thread reading the card */
+	uint64_t dvr_reads;
+	uint64_t dvr_bytes;
+	uint64_t dvr_overflows;
+	uint64_t dvr_thread_full;
+	/** Packets with the transport error indicator, written by the main thread */
+	uint64_t ts_errors;
+	/** Sums of the PIDs and global checks of the analyzer, written by the monitor thread every second */
+	uint64_t ts_packets;
+	uint64_t cc_errors;
+	uint64_t sync_errors;
+	uint64_t pat_errors;
+}stats_shm_header_t;
+
+/** @brief Counters of a PID, copied from the analyzer by the monitor thread every second */
+typedef struct stats_shm_pid_t{
+	uint64_t packets;
+	uint64_t scrambled;
+	/** Continuity errors, a packet can be repeated once, the discontinuity indicator is respected */
+	uint64_t cc_errors;
+	uint64_t tei_errors;
+	/** Bitrate (bit/s), moving average */
+	uint64_t bitrate;
+	uint64_t pcr_count;
+	uint64_t pcr_repetition_errors;
+	uint64_t pcr_discontinuities;
+	/** Longest PCR interval and biggest PCR jitter during the last second (us) */
+	uint32_t pcr_interval_max;
+	uint32_t pcr_jitter_max;
+	/** Last scrambling control (0 clear, 2 even, 3 odd) */
+	uint32_t scrambling;
+	uint32_t reserved;
+}stats_shm_pid_t;
+
+/** @brief A channel */
+typedef struct stats_shm_channel_t{
+	/** Description, under the sequence lock of the header */
+	char name[STATS_SHM_NAME_LEN];
+	int32_t service_id;
+	int32_t streamed;
+	/** Percentage of scrambled packets */
+	int32_t scrambled_ratio;
+	/** Traffic (kB/s) as computed by MuMuDVB */
+	float traffic;
+	int32_t num_pids;
+	int32_t pids[STATS_SHM_CHANNEL_PIDS];
+
+	/** Sequence lock of the counters, written by the thread sending the channel */
+	uint64_t seq;
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t datagrams;
+	/** Last datagram sent (us, monotonic clock) */
+	uint64_t last_send;
+
+	/** Packets dropped by the queues of the clients, written by the main thread */
+	uint64_t dropped;
+}stats_shm_channel_t;
+
+/** @brief A HTTP client, the slots are written by the main thread under their sequence lock */
+typedef struct stats_shm_client_t{
+	uint64_t seq;
+	/** The slot is used */
+	int32_t used;
+	/** Index of the channel in the table of the channels (-1 if beyond it) */
+	int32_t channel;
+	char ip[16];
+	int32_t port;
+	/** Data waiting in the queue of the client (bytes) */
+	int32_t queue_bytes;
+	uint64_t dropped;
+	uint64_t drop_events;
+	/** Connection to the channel (s, unix time) */
+	uint64_t start_time;
+}stats_shm_client_t;
+
+
+/* Writer side, in MuMuDVB */
+
+extern stats_shm_header_t *stats_shm_seg;
+extern stats_shm_pid_t *stats_shm_pids;
+
+/** @brief Add to a counter which has only one writer, the readers can read it at any time */
+static inline void stats_shm_add(uint64_t *counter, uint64_t value)
+{
+	__atomic_store_n(counter, *counter+value, __ATOMIC_RELAXED);
+}
+
+/** @brief A TS packet with the transport error indicator, called by the main thread */
+static inline void stats_shm_ts_error(void)
+{
+	if(stats_shm_seg!=NULL)
+		stats_shm_add(&stats_shm_seg->ts_errors, 1);
+}
+
+struct mumudvb_channel_t;
+struct unicast_client_t;
+struct analyzer_pid_t;
+struct analyzer_pid_monitor_t;
+struct analyzer_ts_t;
+
+int stats_shm_open(char *name, int card, int tuner, int server_id);
+void stats_shm_close(void);
+void stats_shm_dvr_read(int bytes_read);
+void stats_shm_dvr_overflow(void);
+void stats_shm_dvr_thread_full(void);
+void stats_shm_update(struct mumudvb_channel_t **channels, int number_of_channels);
+void stats_shm_channel_sent(struct mumudvb_channel_t *channel, int bytes);
+void stats_shm_client_add(struct unicast_client_t *client, struct mumudvb_channel_t *channel);
+void stats_shm_client_update(struct unicast_client_t *client);
+void stats_shm_client_del(struct unicast_client_t *client);
+void stats_shm_analyzer(struct analyzer_pid_t *pids, struct analyzer_pid_monitor_t *monitor, struct analyzer_ts_t *ts);
+
+#endif
@@ -0,0 +1,389 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the timeshift of the HTTP unicast
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Timeshift ring of the channels, for the HTTP unicast
+ *
+ * The datagrams of a channel with timeshift are also written in a ring : a file of
+ * timeshift_size MB in timeshift_dir, mapped in memory. The file is removed once opened,
+ * it disappears with MuMuDVB. A time index gives the position of the random access points
+ * of the video every TIMESHIFT_INDEX_INTERVAL.
+ *
+ * A client asking /bysid/sid?offset=-300 gets the channel from the random access point
+ * 5 minutes ago : the data is sent from the ring (sendfile) each time the channel sends a
+ * datagram, until the client reaches the live stream and gets the datagrams as the others.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+#include "timeshift.h"
+#include "errors.h"
+#include "log.h"
+
+static char *log_module="Timeshift: ";
+
+/** The timeshift parameters, used when the channels send their datagrams */
+static timeshift_p_t *timeshift_vars=NULL;
+
+/** Initialize the timeshift variables*/
+void init_timeshift_v(timeshift_p_t *timeshift_p)
+{
+	memset(timeshift_p, 0, sizeof(timeshift_p_t));
+	timeshift_p->size=TIMESHIFT_DEFAULT_SIZE;
+	timeshift_p->default_mode=OPTION_OFF;
+}
+
+/** @brief Read a line of the configuration file to check if there is a timeshift parameter
+ *
+ * timeshift is for the current channel if a channel is started, otherwise it is the default
+ * @param timeshift_p the timeshift parameters
+ * @param substring The currrent line
+ */
+int read_timeshift_configuration(timeshift_p_t *timeshift_p, mumudvb_channel_t *current_channel, int channel_start, char *substring)
+{
+	char delimiteurs[] = CONFIG_FILE_SEPARATOR;
+	if (!strcmp (substring, "timeshift"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		if(channel_start)
+			current_channel->timeshift_mode=atoi(substring)?OPTION_ON:OPTION_OFF;
+		else
+			timeshift_p->default_mode=atoi(substring)?OPTION_ON:OPTION_OFF;
+	}
+	else if (!strcmp (substring, "timeshift_dir"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		if(strlen(substring)>=DEFAULT_PATH_LEN)
+		{
+			log_message( log_module,  MSG_ERROR,
+					"The timeshift_dir is too long\n");
+			return -1;
+		}
+		sscanf (substring, "%s\n", timeshift_p->dir);
+	}
+	else if (!strcmp (substring, "timeshift_size"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		timeshift_p->size = atoi (substring);
+		if(timeshift_p->size<=0)
+		{
+			log_message( log_module,  MSG_WARN,"timeshift_size must be positive, we use %dMB\n",TIMESHIFT_DEFAULT_SIZE);
+			timeshift_p->size=TIMESHIFT_DEFAULT_SIZE;
+		}
+	}
+	else
+		return 0; //Nothing concerning timeshift, we return 0 to explore the other possibilities
+
+	return 1;//We found something for timeshift, we tell main to go for the next line
+}
+
+/** @brief Start the timeshift, the rings are created with the first datagram of the channels */
+void timeshift_start(timeshift_p_t *timeshift_p)
+{
+	if(!strlen(timeshift_p->dir))
+		return;
+	timeshift_vars=timeshift_p;
+	log_message( log_module,  MSG_INFO,"Timeshift enabled in %s, %dMB per channel\n", timeshift_p->dir, timeshift_p->size);
+}
+
+/** @brief Create the ring of a channel
+ * @return the ring or NULL if the channel has no timeshift
+ */
+static channel_timeshift_t *timeshift_new_ring(timeshift_p_t *timeshift_p, mumudvb_channel_t *channel)
+{
+	channel_timeshift_t *ring;
+	char filename[DEFAULT_PATH_LEN+64];
+
+	if(channel->timeshift_mode==OPTION_UNDEFINED)
+		channel->timeshift_mode=timeshift_p->default_mode;
+	if(channel->timeshift_mode!=OPTION_ON)
+		return NULL;
+	ring=calloc(1,sizeof(channel_timeshift_t));
+	if(ring==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		channel->timeshift_mode=OPTION_OFF;
+		return NULL;
+	}
+	ring->size=((uint64_t)timeshift_p->size)*1024*1024;
+	ring->index=malloc(TIMESHIFT_INDEX_LEN*sizeof(timeshift_index_t));
+	snprintf(filename, sizeof(filename), "%s/mumudvb_timeshift_%d_%d.ts", timeshift_p->dir, (int)getpid(), channel->service_id);
+	ring->fd=open(filename, O_RDWR|O_CREAT|O_TRUNC, 0600);
+	if(ring->index==NULL || ring->fd<0)
+	{
+		log_message( log_module, MSG_ERROR,"Cannot create the timeshift ring of the channel \"%s\" (%s) : %s\n", channel->name, filename, strerror(errno));
+		goto error;
+	}
+	//The file is only used through its descriptor
+	unlink(filename);
+	if(ftruncate(ring->fd, ring->size)<0)
+	{
+		log_message( log_module, MSG_ERROR,"Cannot size the timeshift ring of the channel \"%s\" : %s\n", channel->name, strerror(errno));
+		goto error;
+	}
+	ring->map=mmap(NULL, ring->size, PROT_READ|PROT_WRITE, MAP_SHARED, ring->fd, 0);
+	if(ring->map==MAP_FAILED)
+	{
+		log_message( log_module, MSG_ERROR,"Cannot map the timeshift ring of the channel \"%s\" : %s\n", channel->name, strerror(errno));
+		ring->map=NULL;
+		goto error;
+	}
+	log_message( log_module, MSG_DETAIL,"Timeshift ring of the channel \"%s\" created\n", channel->name);
+	return ring;
+
+error:
+	if(ring->fd>=0)
+		close(ring->fd);
+	free(ring->index);
+	free(ring);
+	channel->timeshift_mode=OPTION_OFF;
+	return NULL;
+}
+
+/** @brief Tell if a packet is a random access point of the channel
+ * Without autoconfiguration the type of the PIDs is unknown, all the PIDs are used
+ */
+static int timeshift_packet_is_rap(mumudvb_channel_t *channel, unsigned char *ts_packet)
+{
+	int i,pid,video_known=0,video=0;
+	if(!((ts_packet[3]&0x20) && ts_packet[4] && (ts_packet[5]&0x40)))
+		return 0;
+	pid=((ts_packet[1] & 0x1f) << 8) | (ts_packet[2]);
+	for(i=0;i<channel->num_pids;i++)
+		if(channel->desc->pids_type[i]>=PID_VIDEO_MPEG1 && channel->desc->pids_type[i]<=PID_VIDEO_MPEG4_AVC)
+		{
+			video_known=1;
+			if(channel->pids[i]==pid)
+				video=1;
+		}
+	return video || !video_known;
+}
+
+/** @brief Add an entry to the time index of the ring */
+static void timeshift_index_add(channel_timeshift_t *ring, uint64_t now, uint64_t offset)
+{
+	int pos=(ring->index_head+ring->index_count)%TIMESHIFT_INDEX_LEN;
+	ring->index[pos].time=now;
+	ring->index[pos].offset=offset;
+	if(ring->index_count<TIMESHIFT_INDEX_LEN)
+		ring->index_count++;
+	else
+		ring->index_head=(ring->index_head+1)%TIMESHIFT_INDEX_LEN;
+	ring->last_index_time=now;
+}
+
+/** @brief Write the datagram of the channel in its ring
+ * Called for each datagram sent, before the unicast clients get it
+ */
+void timeshift_add(mumudvb_channel_t *channel)
+{
+	channel_timeshift_t *ring=channel->timeshift;
+	uint64_t now,pos;
+	int part,i;
+
+	if(timeshift_vars==NULL || channel->timeshift_mode==OPTION_OFF || channel->full_ts)
+		return;
+	if(ring==NULL)
+	{
+		ring=channel->timeshift=timeshift_new_ring(timeshift_vars, channel);
+		if(ring==NULL)
+			return;
+	}
+	//The ring needs the data in one piece
+	if(channel->iovcnt)
+		channel_keep_data(channel);
+
+	now=get_time();
+	if(now-ring->last_index_time>=TIMESHIFT_INDEX_INTERVAL)
+	{
+		for(i=0;i<channel->nb_bytes;i+=TS_PACKET_SIZE)
+			if(timeshift_packet_is_rap(channel, channel->datagram->buf+i))
+			{
+				timeshift_index_add(ring, now, ring->written+i);
+				break;
+			}
+		if(now-ring->last_index_time>=TIMESHIFT_INDEX_FALLBACK)
+			timeshift_index_add(ring, now, ring->written);
+	}
+
+	pos=ring->written%ring->size;
+	part=channel->nb_bytes;
+	if(pos+part>ring->size)
+		part=ring->size-pos;
+	memcpy(ring->map+pos, channel->datagram->buf, part);
+	if(part<channel->nb_bytes)
+		memcpy(ring->map, channel->datagram->buf+part, channel->nb_bytes-part);
+	ring->written+=channel->nb_bytes;
+}
+
+/** @brief The oldest position which can still be read in the ring */
+static uint64_t timeshift_oldest(channel_timeshift_t *ring)
+{
+	if(ring->written+TIMESHIFT_GUARD<=ring->size)
+		return 0;
+	return ring->written+TIMESHIFT_GUARD-ring->size;
+}
+
+/** @brief Find the first entry of the index at or after a time, still in the ring
+ * @return the position in the stream, or the live position if there is no such entry
+ */
+static uint64_t timeshift_seek(channel_timeshift_t *ring, uint64_t time)
+{
+	int low=0,high=ring->index_count,mid;
+	uint64_t oldest=timeshift_oldest(ring);
+	timeshift_index_t *entry;
+
+	//The index is ordered by time : binary search of the first entry at or after time
+	while(low<high)
+	{
+		mid=(low+high)/2;
+		if(ring->index[(ring->index_head+mid)%TIMESHIFT_INDEX_LEN].time<time)
+			low=mid+1;
+		else
+			high=mid;
+	}
+	//The entries whose data was overwritten are skipped
+	for(;low<ring->index_count;low++)
+	{
+		entry=&ring->index[(ring->index_head+low)%TIMESHIFT_INDEX_LEN];
+		if(entry->offset>=oldest)
+			return entry->offset;
+	}
+	return ring->written;
+}
+
+/** @brief Start sending a channel to a client from the past
+ * @param delay how far in the past (s)
+ * @return 0 if the client gets the channel from the ring
+ */
+int timeshift_client_start(unicast_client_t *client, mumudvb_channel_t *channel, int delay)
+{
+	channel_timeshift_t *ring=channel->timeshift;
+	uint64_t now=get_time();
+	uint64_t target;
+
+	if(ring==NULL || delay<=0)
+		return -1;
+	target=((uint64_t)delay*1000000<now)?now-(uint64_t)delay*1000000:0;
+	client->timeshift_pos=timeshift_seek(ring, target);
+	client->timeshifting=(client->timeshift_pos<ring->written);
+	log_message( log_module, MSG_INFO,"Client %s:%d gets the channel \"%s\" %ds in the past (%llu bytes)\n",
+			inet_ntoa(client->SocketAddr.sin_addr), client->SocketAddr.sin_port,
+			channel->name, delay, (unsigned long long)(ring->written-client->timeshift_pos));
+	return 0;
+}
+
+/** @brief Send the data of the ring to a client
+ * client->timeshifting is cleared when the client reaches the live stream
+ * @return the number of bytes sent, -1 if the connection is broken
+ */
+int timeshift_client_send(unicast_client_t *client, mumudvb_channel_t *channel)
+{
+	channel_timeshift_t *ring=channel->timeshift;
+	uint64_t oldest,len;
+	off_t offset;
+	ssize_t ret;
+	int sent=0;
+
+	if(ring==NULL)
+	{
+		client->timeshifting=0;
+		return 0;
+	}
+	//The data of the client was overwritten, it goes to the next random access point
+	oldest=timeshift_oldest(ring);
+	if(client->timeshift_pos<oldest)
+	{
+		log_message( log_module, MSG_DETAIL,"Client %s:%d too slow for the timeshift ring, we skip data\n",
+				inet_ntoa(client->SocketAddr.sin_addr), client->SocketAddr.sin_port);
+		client->timeshift_pos=timeshift_seek(ring, 0);
+	}
+	while(client->timeshift_pos<ring->written && sent<TIMESHIFT_SEND_MAX)
+	{
+		offset=client->timeshift_pos%ring->size;
+		len=ring->written-client->timeshift_pos;
+		if(offset+len>ring->size)
+			len=ring->size-offset;
+		if(len>TIMESHIFT_SEND_MAX)
+			len=TIMESHIFT_SEND_MAX;
+		ret=sendfile(client->Socket, ring->fd, &offset, len);
+		if(ret<0 && errno!=EAGAIN)
+			return -1;
+		if(ret<=0)
+			break;
+		client->timeshift_pos+=ret;
+		sent+=ret;
+	}
+	if(client->timeshift_pos<ring->written)
+		return sent;
+	log_message( log_module, MSG_DEBUG,"Client %s:%d reached the live stream\n",
+			inet_ntoa(client->SocketAddr.sin_addr), client->SocketAddr.sin_port);
+	client->timeshifting=0;
+	return sent;
+}
+
+/** @brief The time of stream available in the ring of a channel (s), 0 without timeshift */
+int timeshift_get_duration(mumudvb_channel_t *channel)
+{
+	channel_timeshift_t *ring=channel->timeshift;
+	uint64_t oldest;
+	int i;
+	if(ring==NULL)
+		return 0;
+	oldest=timeshift_oldest(ring);
+	for(i=0;i<ring->index_count;i++)
+		if(ring->index[(ring->index_head+i)%TIMESHIFT_INDEX_LEN].offset>=oldest)
+			return (get_time()-ring->index[(ring->index_head+i)%TIMESHIFT_INDEX_LEN].time)/1000000;
+	return 0;
+}
+
+/** @brief Free the rings of the channels */
+void timeshift_stop(mumu_chan_p_t *chan_p)
+{
+	channel_timeshift_t *ring;
+	int ichan;
+
+	for (ichan = 0; ichan < chan_p->number_of_channels; ichan++)
+	{
+		ring=chan_p->channels[ichan]->timeshift;
+		if(ring==NULL)
+			continue;
+		munmap(ring->map, ring->size);
+		close(ring->fd);
+		free(ring->index);
+		free(ring);
+		chan_p->channels[ichan]->timeshift=NULL;
+	}
+	timeshift_vars=NULL;
+}
@@ -0,0 +1,90 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the timeshift of the HTTP unicast
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Header file for the timeshift ring of the channels
+ */
+
+#ifndef _TIMESHIFT_H
+#define _TIMESHIFT_H
+
+#include "mumudvb.h"
+#include "unicast_http.h"
+
+/** Default size of the ring of a channel (MB) */
+#define TIMESHIFT_DEFAULT_SIZE 256
+/** Interval between two entries of the time index (us) */
+#define TIMESHIFT_INDEX_INTERVAL 500000
+/** Without random access point during this time, the index takes any packet (us) */
+#define TIMESHIFT_INDEX_FALLBACK 5000000
+/** Number of entries of the time index (about two hours with TIMESHIFT_INDEX_INTERVAL) */
+#define TIMESHIFT_INDEX_LEN 16384
+/** Data which is not read anymore near the write position, it can be changed by the next writes */
+#define TIMESHIFT_GUARD (1024*1024)
+/** Maximum data sent to a client per datagram of the channel */
+#define TIMESHIFT_SEND_MAX (1024*1024)
+
+/** @brief An entry of the time index : the position of a random access point */
+typedef struct timeshift_index_t{
+	/** Time of arrival (us, get_time clock) */
+	uint64_t time;
+	/** Position in the stream */
+	uint64_t offset;
+}timeshift_index_t;
+
+/** @brief The ring of a channel : a file mapped in memory, and its time index */
+typedef struct channel_timeshift_t{
+	int fd;
+	unsigned char *map;
+	uint64_t size;
+	/** Bytes written since the start, the position of the data is written % size */
+	uint64_t written;
+	/** The index, ordered by time (circular) */
+	timeshift_index_t *index;
+	int index_head;
+	int index_count;
+	uint64_t last_index_time;
+}channel_timeshift_t;
+
+/** @brief The timeshift parameters */
+typedef struct timeshift_p_t{
+	/** The directory for the rings, the timeshift is disabled without it */
+	char dir[DEFAULT_PATH_LEN];
+	/** Size of the ring of a channel (MB) */
+	int size;
+	/** Timeshift of the channels without timeshift option */
+	option_status_t default_mode;
+}timeshift_p_t;
+
+void init_timeshift_v(timeshift_p_t *timeshift_p);
+int read_timeshift_configuration(timeshift_p_t *timeshift_p, mumudvb_channel_t *current_channel, int channel_start, char *substring);
+void timeshift_start(timeshift_p_t *timeshift_p);
+void timeshift_add(mumudvb_channel_t *channel);
+int timeshift_client_start(unicast_client_t *client, mumudvb_channel_t *channel, int delay);
+int timeshift_client_send(unicast_client_t *client, mumudvb_channel_t *channel);
+int timeshift_get_duration(mumudvb_channel_t *channel);
+void timeshift_stop(mumu_chan_p_t *chan_p);
+
+#endif
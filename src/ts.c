@@ -31,9 +31,10 @@
 #include "ts.h"
 #include "mumudvb.h"
 #include "log.h"
+#include "crc32.h"
 
 #include <stdint.h>
-extern uint32_t       crc32_table[256];
+
 static char *log_module="TS: ";
 
 
@@ -239,6 +240,8 @@ void add_ts_packet_data(unsigned char *buf, mumudvb_ts_packet_t *pkt, int data_l
 		pkt->len_partial=copy_len;
 		//The real copy
 		memcpy(pkt->data_partial,buf,pkt->len_partial);
+		//The CRC32 is computed while the section is received
+		pkt->crc32_partial=crc32_mpeg2_update(CRC32_MPEG2_INIT,pkt->data_partial,pkt->len_partial);
 		//we update the amount of data left
 		data_left-=copy_len;
 		//lot of debugging information
@@ -312,6 +315,7 @@ void add_ts_packet_data(unsigned char *buf, mumudvb_ts_packet_t *pkt, int data_l
 			data_left=0;
 
 			memcpy(pkt->data_partial+pkt->len_partial,buf,copy_len);//we add the packet to the buffer
+			pkt->crc32_partial=crc32_mpeg2_update(pkt->crc32_partial,pkt->data_partial+pkt->len_partial,copy_len);
 			pkt->len_partial+=copy_len;
 			pkt->cc=cc; //update cc
 			log_message(log_module, MSG_FLOOD, "Continuing a packet PID %d cc %d len %d expected %d\n",pkt->pid,pkt->cc,pkt->len_partial,pkt->expected_len_partial);
@@ -364,40 +368,15 @@ void ts_move_part_to_full(mumudvb_ts_packet_t *pkt)
 
 
 
-/**@brief Checking of the CRC32 of a raw buffer
- * return 1 if crc32 is ok, 0 otherwise
- * @param packet : the packet to be checked
- */
-int ts_check_raw_crc32(unsigned char *data)
-{
-	int i,len;
-	uint32_t crc32;
-	tbl_h_t *tbl_struct;
-	tbl_struct=(tbl_h_t *)data;
-
-	//the real length (it cannot overflow due to the way tbl_h_t is made)
-	len=HILO(tbl_struct->section_length)+BYTES_BFR_SEC_LEN;
-
-	//CRC32 calculation
-	//Test of the crc32
-	crc32=0xffffffff;
-	//we compute the CRC32
-	//we have two ways: either we compute until the end and it should be 0
-	//either we exclude the 4 last bits and in should be equal to the 4 last bits
-	for(i = 0; i < len; i++) {
-		crc32 = (crc32 << 8) ^ crc32_table[((crc32 >> 24) ^ data[i])&0xff];
-	}
-	return (crc32 == 0);
-}
-
 /**@brief Checking of the CRC32
  * return 1 if crc32 is ok, 0 otherwise
+ * The CRC32 was computed while the data was added (see add_ts_packet_data)
  * @param packet : the packet to be checked
  */
 int ts_check_crc32( mumudvb_ts_packet_t *packet)
 {
 
-	if(ts_check_raw_crc32(packet->data_partial)==0)
+	if(packet->crc32_partial!=0)
 	{
 		log_message( log_module,  MSG_DETAIL,"\tpacket BAD CRC32 PID : %d\n", packet->pid);
 		//Bad CRC32
@@ -751,6 +751,8 @@ typedef struct {
   int len_partial;
   /** the expected length of the data contained in data_partial */
   int expected_len_partial;
+  /** the CRC32 register of the data contained in data_partial, updated when data is added */
+  uint32_t crc32_partial;
   /** The packet status*/
   packet_status_t status_partial;
   /**The PID of the packet*/
@@ -50,6 +50,8 @@
 
 #include "unicast_http.h"
 #include "unicast_queue.h"
+#include "stats_shm.h"
+#include "probes.h"
 #include "mumudvb.h"
 #include "errors.h"
 #include "log.h"
@@ -71,6 +73,8 @@ unicast_client_t *unicast_add_client(unicast_parameters_t *unicast_vars, struct
 	unicast_client_t *client;
 	unicast_client_t *prev_client;
 	log_message( log_module, MSG_FLOOD,"We create a client associated with the socket %d\n",Socket);
+	//The monitor thread reads the list
+	pthread_mutex_lock(&unicast_vars->clients_lock);
 	//We allocate a new client
 	if(unicast_vars->clients==NULL)
 	{
@@ -91,9 +95,11 @@ unicast_client_t *unicast_add_client(unicast_parameters_t *unicast_vars, struct
 	if(client==NULL)
 	{
 		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		pthread_mutex_unlock(&unicast_vars->clients_lock);
 		close(Socket);
 		return NULL;
 	}
+	MUMUDVB_PROBE3(client_accept, Socket, SocketAddr.sin_addr.s_addr, ntohs(SocketAddr.sin_port));
 
 
 	// Disable the Nagle (TCP No Delay) algorithm
@@ -137,9 +143,8 @@ unicast_client_t *unicast_add_client(unicast_parameters_t *unicast_vars, struct
 	//We fill the client data
 	client->SocketAddr=SocketAddr;
 	client->Socket=Socket;
-	client->buffer=NULL;
-	client->buffersize=0;
-	client->bufferpos=0;
+	unicast_request_reset(&client->request);
+	client->reply=NULL;
 	client->chan_ptr=NULL;
 	client->askedChannel=-1;
 	client->consecutive_errors=0;
@@ -152,14 +157,86 @@ unicast_client_t *unicast_add_client(unicast_parameters_t *unicast_vars, struct
 	client->queue.packets_in_queue=0;
 	client->queue.first=NULL;
 	client->queue.last=NULL;
+	client->queue.drop_state=UNICAST_DROP_NONE;
+	client->queue.dropped_packets=0;
+	client->queue.drop_events=0;
+	client->pipe[0]=client->pipe[1]=-1;
+	client->pipe_bytes=0;
+	client->tuned_traffic=0;
+	client->timeshifting=0;
+	client->stats_slot=-1;
+	client->events=0;
+	client->events_seq=0;
+	client->events_blocked=0;
+	client->events_next=client->events_prev=NULL;
+	client->events_buffer=NULL;
+	client->events_len=0;
+	client->events_sent=0;
 
 	unicast_vars->client_number++;
+	pthread_mutex_unlock(&unicast_vars->clients_lock);
 
 	return client;
 }
 
 
 
+/** @brief Tune the TCP socket of a client from the bitrate of its channel
+ * Called for each data sent, the socket is tuned again only when the bitrate changed a lot.
+ * The kernel paces the data a bit faster than the channel (to catch up after losses), the send
+ * buffer holds UNICAST_SNDBUF_TIME of the stream and at most UNICAST_NOTSENT_TIME of it is
+ * waiting in the kernel, the rest waits in the queue of the client.
+ *
+ * @param unicast_vars the unicast parameters
+ * @param client the client
+ * @param channel the channel of the client
+ */
+void unicast_client_tcp_tune(unicast_parameters_t *unicast_vars, unicast_client_t *client, mumudvb_channel_t *channel)
+{
+	int iRet;
+	int value;
+	unsigned int rate; //bytes per second
+	float traffic=channel->traffic;
+
+	if(traffic<=0)
+		return;
+	if(client->tuned_traffic>0 &&
+			traffic<client->tuned_traffic*(100+UNICAST_TUNING_HYSTERESIS)/100 &&
+			traffic>client->tuned_traffic*(100-UNICAST_TUNING_HYSTERESIS)/100)
+		return;
+	client->tuned_traffic=traffic;
+	rate=(unsigned int)(traffic*1000); //the traffic is in kB/s
+
+#ifdef SO_MAX_PACING_RATE
+	{
+		unsigned int pacing_rate=rate/100*UNICAST_PACING_HEADROOM;
+		iRet=setsockopt(client->Socket, SOL_SOCKET, SO_MAX_PACING_RATE, &pacing_rate, sizeof(pacing_rate));
+		if (iRet < 0)
+			log_message( log_module,  MSG_DEBUG,"setsockopt SO_MAX_PACING_RATE failed : %s\n", strerror(errno));
+	}
+#endif
+	//The size given with socket_sendbuf_size has the priority
+	if(!unicast_vars->socket_sendbuf_size)
+	{
+		value=rate/1000*UNICAST_SNDBUF_TIME;
+		if(value<UNICAST_SNDBUF_MIN)
+			value=UNICAST_SNDBUF_MIN;
+		iRet=setsockopt(client->Socket, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value));
+		if (iRet < 0)
+			log_message( log_module,  MSG_DEBUG,"setsockopt SO_SNDBUF failed : %s\n", strerror(errno));
+	}
+#ifdef TCP_NOTSENT_LOWAT
+	value=rate/1000*UNICAST_NOTSENT_TIME;
+	if(value<UNICAST_SNDBUF_MIN/2)
+		value=UNICAST_SNDBUF_MIN/2;
+	iRet=setsockopt(client->Socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &value, sizeof(value));
+	if (iRet < 0)
+		log_message( log_module,  MSG_DEBUG,"setsockopt TCP_NOTSENT_LOWAT failed : %s\n", strerror(errno));
+#endif
+	log_message( log_module, MSG_DEBUG,"TCP tuning of client %s:%d for %.0fkB/s\n",
+			inet_ntoa(client->SocketAddr.sin_addr), client->SocketAddr.sin_port, traffic);
+}
+
 /** @brief Delete a client to the chained list of clients and in the associated channel
  * This function close the socket of the client
  * remove it from the associated channel if there is one
@@ -173,12 +250,21 @@ int unicast_del_client(unicast_parameters_t *unicast_vars, unicast_client_t *cli
 	unicast_client_t *prev_client,*next_client;
 
 	log_message( log_module, MSG_FLOOD,"We delete the client %s:%d, socket %d\n",inet_ntoa(client->SocketAddr.sin_addr), client->SocketAddr.sin_port, client->Socket);
+	if(client->queue.drop_events)
+		log_message( log_module, MSG_INFO,"Client %s:%d was too slow %d times, %ld packets dropped\n",
+				inet_ntoa(client->SocketAddr.sin_addr), client->SocketAddr.sin_port,
+				client->queue.drop_events, client->queue.dropped_packets);
+	MUMUDVB_PROBE5(client_close, client->Socket, client->SocketAddr.sin_addr.s_addr, ntohs(client->SocketAddr.sin_port),
+			client->queue.dropped_packets, client->queue.drop_events);
 
 	if (client->Socket >= 0)
 	{
 		close(client->Socket);
 	}
+	stats_shm_client_del(client);
+	unicast_events_del_client(client);
 
+	pthread_mutex_lock(&unicast_vars->clients_lock);
 	prev_client=client->prev;
 	next_client=client->next;
 	if(prev_client==NULL)
@@ -210,15 +296,20 @@ int unicast_del_client(unicast_parameters_t *unicast_vars, unicast_client_t *cli
 				client->chan_next->chan_prev=client->chan_prev;
 		}
 	}
+	unicast_vars->client_number--;
+	pthread_mutex_unlock(&unicast_vars->clients_lock);
 
 
-	if(client->buffer)
-		free(client->buffer);
+	if(client->reply)
+		unicast_reply_free(client->reply);
+	if(client->pipe[0]>=0)
+	{
+		close(client->pipe[0]);
+		close(client->pipe[1]);
+	}
 	unicast_queue_clear(&client->queue);
 	free(client);
 
-	unicast_vars->client_number--;
-
 
 	return 0;
 }
@@ -243,6 +334,7 @@ int channel_add_unicast_client(unicast_client_t *client,mumudvb_channel_t *chann
 		log_message( log_module, MSG_INFO,"Error when sending the HTTP reply\n");
 		return -1;
 	}
+	MUMUDVB_PROBE3(client_channel, client->Socket, channel->name, channel->service_id);
 
 	client->chan_next=NULL;
 
@@ -259,6 +351,8 @@ int channel_add_unicast_client(unicast_client_t *client,mumudvb_channel_t *chann
 		last_client->chan_next=client;
 		client->chan_prev=last_client;
 	}
+	stats_shm_client_add(client, channel);
+	unicast_events_client(client, channel, 1);
 	return 0;
 }
 
@@ -277,5 +371,6 @@ void unicast_freeing(unicast_parameters_t *unicast_vars)
 		next_client= actual_client->next;
 		unicast_del_client(unicast_vars, actual_client);
 	}
+	unicast_channel_index_free(&unicast_vars->channel_index);
 }
 
@@ -0,0 +1,491 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the live events sent to the HTTP clients
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Live events (Server-Sent Events) on /monitor/events
+ *
+ * Instead of polling the monitoring pages, a client keeps the connection open and gets
+ * the changes as they happen :
+ *  - state : the full state (signal, channels), sent first
+ *  - signal : the signal strength, SNR, BER or uncorrected blocks changed
+ *  - traffic : the traffic of some channels changed (only these channels)
+ *  - channel : a channel is up or down
+ *  - client : a client started or stopped getting a channel
+ *
+ * The monitor thread compares the state with the one it sent before and publishes the
+ * differences, the signal and the traffic at most every unicast_events_interval seconds.
+ * The events are kept in a ring of UNICAST_EVENTS_RING events, the main thread sends them
+ * to the subscribers without blocking. A subscriber which is too late to get all of them is
+ * disconnected, it reconnects and gets the full state again.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "unicast_http.h"
+#include "mumudvb.h"
+#include "dvb.h"
+#include "errors.h"
+#include "log.h"
+
+static char *log_module="Unicast : ";
+
+/** @brief A published event, in the SSE format */
+typedef struct unicast_event_t{
+	char *data;
+	int len;
+}unicast_event_t;
+
+/** The last events, the event number seq is at seq%UNICAST_EVENTS_RING */
+static unicast_event_t unicast_events_ring[UNICAST_EVENTS_RING];
+/** Number of events published */
+static uint64_t unicast_events_seq;
+/** The full state, the events published after it, starting at unicast_events_state_seq, are the changes */
+static char *unicast_events_state;
+static int unicast_events_state_len;
+static uint64_t unicast_events_state_seq;
+/** Protects the ring and the state */
+static pthread_mutex_t unicast_events_lock=PTHREAD_MUTEX_INITIALIZER;
+
+/** The values of the last events, used by the monitor thread */
+static int unicast_events_last_ber,unicast_events_last_strength,unicast_events_last_snr,unicast_events_last_ub;
+static float *unicast_events_last_traffic;
+static int *unicast_events_last_streamed;
+static int unicast_events_last_number;
+static uint64_t unicast_events_last_time;
+
+/** The subscribers, used by the main thread */
+static int unicast_events_subscribers;
+/** The subscribers which got the events before unicast_events_delivered, and the ones waiting for their socket */
+static unicast_client_t *unicast_events_ready;
+static unicast_client_t *unicast_events_waiting;
+static uint64_t unicast_events_delivered;
+
+
+/** @brief Start a new event */
+static struct unicast_reply *unicast_event_start(const char *type)
+{
+	struct unicast_reply *reply;
+	reply=unicast_reply_init();
+	if(reply==NULL)
+		return NULL;
+	unicast_reply_write(reply, "event: %s\ndata: ", type);
+	return reply;
+}
+
+/** @brief Publish an event, the reply is freed */
+static void unicast_event_publish(struct unicast_reply *reply)
+{
+	unicast_event_t *event;
+
+	unicast_reply_write(reply, "\n\n");
+	pthread_mutex_lock(&unicast_events_lock);
+	event=&unicast_events_ring[unicast_events_seq%UNICAST_EVENTS_RING];
+	free(event->data);
+	event->data=reply->buffer_body;
+	event->len=reply->used_body;
+	__atomic_store_n(&unicast_events_seq, unicast_events_seq+1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&unicast_events_lock);
+	reply->buffer_body=NULL;
+	unicast_reply_free(reply);
+}
+
+/** @brief Write the signal */
+static void unicast_events_write_signal(struct unicast_reply *reply)
+{
+	unicast_reply_write(reply, "{\"ber\":%d, \"strength\":%d, \"snr\":%d, \"ub\":%d}",
+			unicast_events_last_ber, unicast_events_last_strength, unicast_events_last_snr, unicast_events_last_ub);
+}
+
+/** @brief Publish the changes since the last call and the new full state, called by the monitor thread
+ *
+ * @param unicast_vars the unicast parameters
+ * @param number_of_channels the number of channels
+ * @param channels the channels array
+ * @param strengthparams the signal
+ */
+void unicast_events_update(unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels, strength_parameters_t *strengthparams)
+{
+	struct unicast_reply *reply;
+	uint64_t now;
+	int curr_channel,changed,first;
+	void *temp;
+
+	changed=(unicast_events_state==NULL);
+	//The channels can be added by the autoconfiguration, they are taken as they are
+	if(number_of_channels>unicast_events_last_number)
+	{
+		temp=realloc(unicast_events_last_traffic, number_of_channels*sizeof(float));
+		if(temp==NULL)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with realloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			return;
+		}
+		unicast_events_last_traffic=temp;
+		temp=realloc(unicast_events_last_streamed, number_of_channels*sizeof(int));
+		if(temp==NULL)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with realloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			return;
+		}
+		unicast_events_last_streamed=temp;
+		for(curr_channel=unicast_events_last_number;curr_channel<number_of_channels;curr_channel++)
+		{
+			unicast_events_last_traffic[curr_channel]=channels[curr_channel]->traffic;
+			unicast_events_last_streamed[curr_channel]=channels[curr_channel]->streamed_channel;
+		}
+		changed=1;
+	}
+	if(number_of_channels!=unicast_events_last_number)
+		changed=1;
+	unicast_events_last_number=number_of_channels;
+
+	//Up and down, as they happen
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+	{
+		if(channels[curr_channel]->streamed_channel==unicast_events_last_streamed[curr_channel])
+			continue;
+		unicast_events_last_streamed[curr_channel]=channels[curr_channel]->streamed_channel;
+		changed=1;
+		reply=unicast_event_start("channel");
+		if(reply==NULL)
+			continue;
+		unicast_reply_write(reply, "{\"number\":%d, \"name\":\"%s\", \"sid\":%d, \"streamed\":%d}",
+				curr_channel+1, channels[curr_channel]->name, channels[curr_channel]->service_id, channels[curr_channel]->streamed_channel);
+		unicast_event_publish(reply);
+	}
+
+	//The signal and the traffic, at most every events_interval
+	now=get_time();
+	if(now-unicast_events_last_time>=(uint64_t)unicast_vars->events_interval*1000000)
+	{
+		unicast_events_last_time=now;
+		if(strengthparams->ber!=unicast_events_last_ber || strengthparams->strength!=unicast_events_last_strength ||
+				strengthparams->snr!=unicast_events_last_snr || strengthparams->ub!=unicast_events_last_ub)
+		{
+			unicast_events_last_ber=strengthparams->ber;
+			unicast_events_last_strength=strengthparams->strength;
+			unicast_events_last_snr=strengthparams->snr;
+			unicast_events_last_ub=strengthparams->ub;
+			changed=1;
+			reply=unicast_event_start("signal");
+			if(reply)
+			{
+				unicast_events_write_signal(reply);
+				unicast_event_publish(reply);
+			}
+		}
+		reply=NULL;
+		first=1;
+		for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		{
+			if(channels[curr_channel]->traffic==unicast_events_last_traffic[curr_channel])
+				continue;
+			unicast_events_last_traffic[curr_channel]=channels[curr_channel]->traffic;
+			changed=1;
+			if(reply==NULL)
+			{
+				reply=unicast_event_start("traffic");
+				if(reply==NULL)
+					continue;
+				unicast_reply_write(reply, "[");
+			}
+			unicast_reply_write(reply, "%s{\"number\":%d, \"name\":\"%s\", \"traffic\":%.2f}", first?"":", ",
+					curr_channel+1, channels[curr_channel]->name, channels[curr_channel]->traffic);
+			first=0;
+		}
+		if(reply)
+		{
+			unicast_reply_write(reply, "]");
+			unicast_event_publish(reply);
+		}
+	}
+
+	//The full state for the new subscribers, made of the values sent in the events
+	if(!changed)
+		return;
+	reply=unicast_event_start("state");
+	if(reply==NULL)
+		return;
+	unicast_reply_write(reply, "{\"signal\":");
+	unicast_events_write_signal(reply);
+	unicast_reply_write(reply, ", \"channels\":[");
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+		unicast_reply_write(reply, "%s{\"number\":%d, \"name\":\"%s\", \"sid\":%d, \"streamed\":%d, \"traffic\":%.2f}", curr_channel?", ":"",
+				curr_channel+1, channels[curr_channel]->name, channels[curr_channel]->service_id,
+				unicast_events_last_streamed[curr_channel], unicast_events_last_traffic[curr_channel]);
+	unicast_reply_write(reply, "]}\n\n");
+	pthread_mutex_lock(&unicast_events_lock);
+	free(unicast_events_state);
+	unicast_events_state=reply->buffer_body;
+	unicast_events_state_len=reply->used_body;
+	unicast_events_state_seq=unicast_events_seq;
+	pthread_mutex_unlock(&unicast_events_lock);
+	reply->buffer_body=NULL;
+	unicast_reply_free(reply);
+}
+
+/** @brief A client starts or stops getting a channel, called by the main thread
+ *
+ * @param client the client
+ * @param channel its channel
+ * @param connected 1 if it starts, 0 if it stops
+ */
+void unicast_events_client(unicast_client_t *client, mumudvb_channel_t *channel, int connected)
+{
+	struct unicast_reply *reply;
+
+	if(!unicast_events_subscribers)
+		return;
+	reply=unicast_event_start("client");
+	if(reply==NULL)
+		return;
+	unicast_reply_write(reply, "{\"action\":\"%s\", \"ip\":\"%s\", \"port\":%d, \"channel\":\"%s\", \"sid\":%d}",
+			connected?"connect":"disconnect", inet_ntoa(client->SocketAddr.sin_addr), ntohs(client->SocketAddr.sin_port),
+			channel->name, channel->service_id);
+	unicast_event_publish(reply);
+}
+
+/** @brief Add data to the buffer of a subscriber
+ * @return 0 if ok, -1 on error
+ */
+static int unicast_events_buffer_add(unicast_client_t *client, const char *data, int len)
+{
+	char *temp;
+	temp=realloc(client->events_buffer, client->events_len+len);
+	if(temp==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with realloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		return -1;
+	}
+	client->events_buffer=temp;
+	memcpy(client->events_buffer+client->events_len, data, len);
+	client->events_len+=len;
+	return 0;
+}
+
+/** @brief Send the waiting events to a subscriber, without blocking
+ * @return 0 if the subscriber has all the events, 1 if its socket is full, -1 if it has to be disconnected
+ */
+static int unicast_events_client_send(unicast_client_t *client)
+{
+	ssize_t written;
+	uint64_t seq;
+	int iRet;
+
+	while(1)
+	{
+		while(client->events_sent<client->events_len)
+		{
+			written=send(client->Socket, client->events_buffer+client->events_sent, client->events_len-client->events_sent, MSG_NOSIGNAL|MSG_DONTWAIT);
+			if(written<0)
+			{
+				if(errno==EINTR)
+					continue;
+				if(errno==EAGAIN || errno==EWOULDBLOCK)
+					return 1;
+				log_message( log_module, MSG_DEBUG,"Error when sending the events : %s\n",strerror(errno));
+				return -1;
+			}
+			client->events_sent+=written;
+		}
+		client->events_sent=client->events_len=0;
+
+		seq=__atomic_load_n(&unicast_events_seq, __ATOMIC_ACQUIRE);
+		if(client->events_seq==seq)
+			return 0;
+		iRet=0;
+		pthread_mutex_lock(&unicast_events_lock);
+		seq=unicast_events_seq;
+		if(seq-client->events_seq>UNICAST_EVENTS_RING)
+			iRet=-1;
+		for(;!iRet && client->events_seq<seq;client->events_seq++)
+			iRet=unicast_events_buffer_add(client, unicast_events_ring[client->events_seq%UNICAST_EVENTS_RING].data,
+					unicast_events_ring[client->events_seq%UNICAST_EVENTS_RING].len);
+		pthread_mutex_unlock(&unicast_events_lock);
+		if(iRet)
+			return -1;
+	}
+}
+
+/** @brief Put a subscriber in the list of the ones waiting for their socket, or of the others */
+static void unicast_events_link(unicast_client_t *client, int blocked)
+{
+	unicast_client_t **list=blocked?&unicast_events_waiting:&unicast_events_ready;
+	client->events_blocked=blocked;
+	client->events_prev=NULL;
+	client->events_next=*list;
+	if(*list!=NULL)
+		(*list)->events_prev=client;
+	*list=client;
+}
+
+/** @brief Remove a subscriber from its list */
+static void unicast_events_unlink(unicast_client_t *client)
+{
+	if(client->events_prev!=NULL)
+		client->events_prev->events_next=client->events_next;
+	else if(client->events_blocked)
+		unicast_events_waiting=client->events_next;
+	else
+		unicast_events_ready=client->events_next;
+	if(client->events_next!=NULL)
+		client->events_next->events_prev=client->events_prev;
+	client->events_next=client->events_prev=NULL;
+}
+
+/** @brief Send the waiting events to the subscribers of a list, they are moved to the list of their new state */
+static void unicast_events_send_list(unicast_client_t *list)
+{
+	unicast_client_t *client,*next;
+	int iRet;
+
+	for(client=list;client!=NULL;client=next)
+	{
+		next=client->events_next;
+		iRet=unicast_events_client_send(client);
+		if(iRet<0)
+		{
+			//The event loop closes the connection
+			log_message( log_module, MSG_INFO,"The events for %s:%d are late, we disconnect it\n",
+					inet_ntoa(client->SocketAddr.sin_addr), ntohs(client->SocketAddr.sin_port));
+			shutdown(client->Socket, SHUT_RDWR);
+			unicast_events_unlink(client);
+			client->events=0;
+			unicast_events_subscribers--;
+		}
+		else if(iRet!=client->events_blocked)
+		{
+			unicast_events_unlink(client);
+			unicast_events_link(client, iRet);
+		}
+	}
+}
+
+/** @brief A client asks for the events : GET /monitor/events
+ *
+ * The connection stays open, the client gets the full state then the changes.
+ *
+ * @return 0 to keep the connection, -2 to close it
+ */
+int unicast_events_subscribe(unicast_parameters_t *unicast_vars, unicast_client_t *client)
+{
+	static const char header[]="HTTP/1.0 200 OK\r\n"
+			"Server: mumudvb/" VERSION "\r\n"
+			"Content-type: text/event-stream\r\n"
+			"Cache-Control: no-cache\r\n"
+			"\r\n";
+	char retry[32];
+	int iRet;
+
+	if(client->events || client->chan_ptr!=NULL)
+		return -2;
+	unicast_request_reset(&client->request);
+	iRet=unicast_events_buffer_add(client, header, sizeof(header)-1);
+	//The client reconnects after this time if the connection is lost
+	snprintf(retry, sizeof(retry), "retry: %d\n\n", unicast_vars->events_interval*1000+1000);
+	if(!iRet)
+		iRet=unicast_events_buffer_add(client, retry, strlen(retry));
+	pthread_mutex_lock(&unicast_events_lock);
+	if(unicast_events_state)
+	{
+		if(!iRet)
+			iRet=unicast_events_buffer_add(client, unicast_events_state, unicast_events_state_len);
+		client->events_seq=unicast_events_state_seq;
+	}
+	else
+		client->events_seq=unicast_events_seq;
+	pthread_mutex_unlock(&unicast_events_lock);
+	if(iRet)
+		return -2;
+	log_message( log_module, MSG_DEBUG,"New subscriber to the events : %s:%d\n", inet_ntoa(client->SocketAddr.sin_addr), ntohs(client->SocketAddr.sin_port));
+	iRet=unicast_events_client_send(client);
+	if(iRet<0)
+		return -2;
+	client->events=1;
+	unicast_events_subscribers++;
+	unicast_events_link(client, iRet);
+	return 0;
+}
+
+/** @brief Send the new events to the subscribers, called by the main thread at each loop
+ *
+ * Only the subscribers waiting for their socket are tried again, the others only when
+ * there is a new event. The other clients are not looked at.
+ *
+ * @param unicast_vars the unicast parameters
+ */
+void unicast_events_send(unicast_parameters_t *unicast_vars)
+{
+	uint64_t seq;
+
+	(void) unicast_vars;
+	if(!unicast_events_subscribers)
+		return;
+	if(unicast_events_waiting!=NULL)
+		unicast_events_send_list(unicast_events_waiting);
+	seq=__atomic_load_n(&unicast_events_seq, __ATOMIC_ACQUIRE);
+	if(seq==unicast_events_delivered)
+		return;
+	unicast_events_delivered=seq;
+	unicast_events_send_list(unicast_events_ready);
+}
+
+/** @brief A client is deleted, called by the main thread */
+void unicast_events_del_client(unicast_client_t *client)
+{
+	if(client->events)
+	{
+		unicast_events_unlink(client);
+		client->events=0;
+		unicast_events_subscribers--;
+	}
+	else if(client->chan_ptr!=NULL)
+		unicast_events_client(client, client->chan_ptr, 0);
+	free(client->events_buffer);
+	client->events_buffer=NULL;
+}
+
+/** @brief Free the events, once the monitor thread is stopped */
+void unicast_events_free(void)
+{
+	int i;
+	for(i=0;i<UNICAST_EVENTS_RING;i++)
+	{
+		free(unicast_events_ring[i].data);
+		unicast_events_ring[i].data=NULL;
+	}
+	free(unicast_events_state);
+	unicast_events_state=NULL;
+	free(unicast_events_last_traffic);
+	unicast_events_last_traffic=NULL;
+	free(unicast_events_last_streamed);
+	unicast_events_last_streamed=NULL;
+	unicast_events_last_number=0;
+}
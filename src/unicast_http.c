@@ -43,6 +43,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <string.h>
 #include <stdarg.h>
 #include <time.h>
@@ -50,6 +51,7 @@
 
 #include "unicast_http.h"
 #include "unicast_queue.h"
+#include "timeshift.h"
 #include "mumudvb.h"
 #include "errors.h"
 #include "log.h"
@@ -73,25 +75,29 @@ unicast_client_t *unicast_accept_connection(unicast_parameters_t *unicast_vars,
 void unicast_close_connection(unicast_parameters_t *unicast_vars, fds_t *fds, int Socket);
 
 int
-unicast_send_streamed_channels_list (int number_of_channels, mumudvb_channel_t *channels, int Socket, char *host);
+unicast_send_streamed_channels_list (int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client, char *host);
 int
-unicast_send_play_list_unicast (int number_of_channels, mumudvb_channel_t *channels, int Socket, int unicast_portOut, int perport);
+unicast_send_play_list_unicast (int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client, int unicast_portOut, int perport);
 int
-unicast_send_play_list_multicast (int number_of_channels, mumudvb_channel_t* channels, int Socket, int vlc);
+unicast_send_play_list_multicast (int number_of_channels, mumudvb_channel_t** channels, unicast_client_t *client, int vlc);
 int
-unicast_send_streamed_channels_list_js (int number_of_channels, mumudvb_channel_t *channels, int Socket);
+unicast_send_streamed_channels_list_js (unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client);
 int
-unicast_send_signal_power_js (int Socket, strength_parameters_t *strengthparams);
+unicast_send_signal_power_js (unicast_client_t *client, strength_parameters_t *strengthparams);
 int
-unicast_send_channel_traffic_js (int number_of_channels, mumudvb_channel_t *channels, int Socket);
+unicast_send_channel_traffic_js (int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client);
 int
-unicast_send_xml_state (unicast_parameters_t* unicast_vars, int number_of_channels, mumudvb_channel_t* channels, int Socket, strength_parameters_t* strengthparams, auto_p_t* auto_p, void* cam_p_v, void* scam_vars_v);
+unicast_send_xml_state (unicast_parameters_t* unicast_vars, int number_of_channels, mumudvb_channel_t** channels, unicast_client_t *client, strength_parameters_t* strengthparams, auto_p_t* auto_p, void* cam_p_v, void* scam_vars_v);
 int
-unicast_send_cam_menu (int Socket, void *cam_p);
+unicast_send_metrics (unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client);
 int
-unicast_send_cam_action (int Socket, char *Key, void *cam_p);
+unicast_send_pids_js (int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client);
+int
+unicast_send_cam_menu (unicast_client_t *client, void *cam_p);
+int
+unicast_send_cam_action (unicast_client_t *client, char *Key, void *cam_p);
 
-int unicast_handle_message(unicast_parameters_t* unicast_vars, unicast_client_t* client, mumudvb_channel_t* channels, int number_of_channels, strength_parameters_t* strengthparams, auto_p_t* auto_p, void* cam_p, void* scam_vars);
+int unicast_handle_message(unicast_parameters_t* unicast_vars, unicast_client_t* client, mumudvb_channel_t** channels, int number_of_channels, strength_parameters_t* strengthparams, auto_p_t* auto_p, void* cam_p, void* scam_vars);
 
 #define REPLY_HEADER 0
 #define REPLY_BODY 1
@@ -155,6 +161,11 @@ int read_unicast_configuration(unicast_parameters_t *unicast_vars, mumudvb_chann
 		substring = strtok (NULL, delimiteurs);
 		unicast_vars->queue_max_size = atoi (substring);
 	}
+	else if (!strcmp (substring, "unicast_queue_max_time"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		unicast_vars->queue_max_time = atoi (substring);
+	}
 	else if (!strcmp (substring, "port_http"))
 	{
 		substring = strtok (NULL, "");
@@ -182,6 +193,38 @@ int read_unicast_configuration(unicast_parameters_t *unicast_vars, mumudvb_chann
 		substring = strtok (NULL, delimiteurs);
 		unicast_vars->socket_sendbuf_size = atoi (substring);
 	}
+	else if (!strcmp (substring, "unicast_zerocopy"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		unicast_vars->zerocopy = atoi (substring);
+	}
+	else if (!strcmp (substring, "unicast_tcp_tuning"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		unicast_vars->tcp_tuning = atoi (substring);
+	}
+	else if (!strcmp (substring, "unicast_fast_start"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		unicast_vars->fast_start = atoi (substring);
+	}
+	else if (!strcmp (substring, "unicast_reply_timeout"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		unicast_vars->reply_timeout = atoi (substring);
+	}
+	else if (!strcmp (substring, "unicast_events_interval"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		unicast_vars->events_interval = atoi (substring);
+		if(unicast_vars->events_interval<0)
+			unicast_vars->events_interval=0;
+	}
+	else if (!strcmp (substring, "unicast_tcp_cork"))
+	{
+		substring = strtok (NULL, delimiteurs);
+		unicast_vars->tcp_cork = atoi (substring);
+	}
 	else if (!strcmp (substring, "flush_on_eagain"))
 	{
 		substring = strtok (NULL, delimiteurs);
@@ -251,7 +294,7 @@ int unicast_create_listening_socket(int socket_type, int socket_channel, char *i
  * If the event is on a channel specific socket, it accepts the new connection and starts streaming
  *
  */
-int unicast_handle_fd_event(unicast_parameters_t *unicast_vars, fds_t *fds, mumudvb_channel_t *channels, int number_of_channels, strength_parameters_t *strengthparams, auto_p_t *auto_p, void *cam_p, void *scam_vars)
+int unicast_handle_fd_event(unicast_parameters_t *unicast_vars, fds_t *fds, mumudvb_channel_t **channels, int number_of_channels, strength_parameters_t *strengthparams, auto_p_t *auto_p, void *cam_p, void *scam_vars)
 {
 	int iRet;
 	//We look what happened for which connection
@@ -261,6 +304,27 @@ int unicast_handle_fd_event(unicast_parameters_t *unicast_vars, fds_t *fds, mumu
 	for(actual_fd=1;actual_fd<fds->pfdsnum;actual_fd++)
 	{
 		iRet=0;
+		if((unicast_vars->fd_info[actual_fd].type==UNICAST_CLIENT)&&(unicast_vars->fd_info[actual_fd].client->reply!=NULL))
+		{
+			//This client only waits for the end of its reply, the connection is closed once it is sent
+			unicast_client_t *client=unicast_vars->fd_info[actual_fd].client;
+			if(get_time()>client->reply_deadline)
+			{
+				log_message( log_module, MSG_INFO,"The reply to %s was not sent within %d ms, we close the connection\n", inet_ntoa(client->SocketAddr.sin_addr), unicast_vars->reply_timeout);
+				iRet=1;
+			}
+			else if(fds->pfds[actual_fd].revents&(POLLHUP|POLLERR))
+				iRet=1;
+			else if(fds->pfds[actual_fd].revents&POLLOUT)
+				iRet=unicast_reply_continue(client);
+			if(iRet)
+			{
+				unicast_close_connection(unicast_vars,fds,fds->pfds[actual_fd].fd);
+				//The last fd moved to the actual one, we look at it
+				actual_fd--;
+			}
+			continue;
+		}
 		if((fds->pfds[actual_fd].revents&POLLHUP)&&(unicast_vars->fd_info[actual_fd].type==UNICAST_CLIENT))
 		{
 			log_message( log_module, MSG_DEBUG,"We've got a POLLHUP. Actual_fd %d socket %d we close the connection \n", actual_fd, fds->pfds[actual_fd].fd );
@@ -331,7 +395,13 @@ int unicast_handle_fd_event(unicast_parameters_t *unicast_vars, fds_t *fds, mumu
 				//Event on a client connectio i.e. the client asked something
 				log_message( log_module, MSG_FLOOD,"New message for socket %d\n", fds->pfds[actual_fd].fd);
 				iRet=unicast_handle_message(unicast_vars,unicast_vars->fd_info[actual_fd].client, channels, number_of_channels, strengthparams, auto_p, cam_p, scam_vars);
-				if (iRet==-2 ) //iRet==-2 --> 0 received data or error, we close the connection
+				if ((iRet==-2)&&(unicast_vars->fd_info[actual_fd].client->reply!=NULL))
+				{
+					//The reply is not fully sent : we wait for the socket to be writable, with a time limit, before closing the connection
+					unicast_vars->fd_info[actual_fd].client->reply_deadline=get_time()+(uint64_t)unicast_vars->reply_timeout*1000;
+					fds->pfds[actual_fd].events = POLLOUT | POLLHUP;
+				}
+				else if (iRet==-2 ) //iRet==-2 --> 0 received data or error, we close the connection
 				{
 					unicast_close_connection(unicast_vars,fds,fds->pfds[actual_fd].fd);
 					//We check if we hage to parse fds->pfds[actual_fd].revents (the last fd moved to the actual one)
@@ -444,8 +514,11 @@ void unicast_close_connection(unicast_parameters_t *unicast_vars, fds_t *fds, in
 	}
 
 	log_message( log_module, MSG_FLOOD,"We close the connection\n");
-	//We delete the client
-	unicast_del_client(unicast_vars, unicast_vars->fd_info[actual_fd].client);
+	//We delete the client, the listening sockets of the channels have none
+	if(unicast_vars->fd_info[actual_fd].client)
+		unicast_del_client(unicast_vars, unicast_vars->fd_info[actual_fd].client);
+	else
+		close(Socket);
 	//We move the last fd to the actual/deleted one, and decrease the number of fds by one
 	fds->pfds[actual_fd].fd = fds->pfds[fds->pfdsnum-1].fd;
 	fds->pfds[actual_fd].events = fds->pfds[fds->pfdsnum-1].events;
@@ -476,44 +549,277 @@ void unicast_close_connection(unicast_parameters_t *unicast_vars, fds_t *fds, in
 
 
 
+/** @brief What a route needs to answer a request */
+typedef struct unicast_route_args_t{
+	unicast_parameters_t *unicast_vars;
+	unicast_client_t *client;
+	mumudvb_channel_t **channels;
+	int number_of_channels;
+	strength_parameters_t *strengthparams;
+	auto_p_t *auto_p;
+	void *cam_p;
+	void *scam_vars;
+	/** For the routes by prefix : the end of the path */
+	char *arg;
+}unicast_route_args_t;
+
+/** @brief A route of the HTTP server
+ *
+ * The channel routes return the asked channel number (starting at 1), 0 if not found.
+ * The other routes send their reply and return -2 to close the connection.
+ */
+typedef struct unicast_route_t{
+	const char *path;
+	int len;
+	/** The path is a prefix, the end of the path is the argument */
+	int prefix;
+	/** The route gives a channel to stream */
+	int channel;
+	int (*handler)(unicast_route_args_t *args);
+}unicast_route_t;
+
+/** @brief Channel by number : GET /bynumber/channelnumber */
+static int unicast_route_bynumber(unicast_route_args_t *args)
+{
+	int requested_channel;
+	requested_channel=atoi(args->arg);
+	if(requested_channel>0 && requested_channel<=args->number_of_channels)
+	{
+		log_message( log_module, MSG_DEBUG,"Channel by number, number %d\n",requested_channel);
+		return requested_channel;
+	}
+	log_message( log_module, MSG_INFO,"Channel by number, number %d out of range\n",requested_channel);
+	return 0;
+}
+
+/** @brief Channel by service id : GET /bysid/sid */
+static int unicast_route_bysid(unicast_route_args_t *args)
+{
+	int requested_sid,found;
+	requested_sid=atoi(args->arg);
+	found=unicast_channel_by_sid(&args->unicast_vars->channel_index, args->channels, args->number_of_channels, requested_sid);
+	if(found>=0)
+	{
+		log_message( log_module, MSG_DEBUG,"Channel by service id,  service_id %d number %d\n", requested_sid, found+1);
+		return found+1;
+	}
+	log_message( log_module, MSG_INFO,"Channel by service id, service_id  %d not found\n",requested_sid);
+	return 0;
+}
+
+/** @brief Channel by name : GET /byname/channelname (URL encoded) */
+static int unicast_route_byname(unicast_route_args_t *args)
+{
+	char name[MAX_NAME_LEN];
+	int found;
+	if(unicast_url_decode(args->arg, strlen(args->arg), name, MAX_NAME_LEN)<0)
+	{
+		log_message( log_module, MSG_INFO,"Channel by name, name too long\n");
+		return 0;
+	}
+	found=unicast_channel_by_name(&args->unicast_vars->channel_index, args->channels, args->number_of_channels, name);
+	if(found>=0)
+	{
+		log_message( log_module, MSG_DEBUG,"Channel by name, name %s number %d\n", name, found+1);
+		return found+1;
+	}
+	log_message( log_module, MSG_INFO,"Channel by name, name \"%s\" not found\n",name);
+	return 0;
+}
+
+/** @brief Channels list, html */
+static int unicast_route_channels_list(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"Channel list\n");
+	unicast_send_streamed_channels_list (args->number_of_channels, args->channels, args->client, args->client->request.host);
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Playlist, m3u */
+static int unicast_route_playlist(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"play list\n");
+	unicast_send_play_list_unicast (args->number_of_channels, args->channels, args->client, args->unicast_vars->portOut, 0 );
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Playlist with the single channel sockets, m3u */
+static int unicast_route_playlist_port(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"play list\n");
+	unicast_send_play_list_unicast (args->number_of_channels, args->channels, args->client, args->unicast_vars->portOut, 1 );
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Multicast playlist, m3u */
+static int unicast_route_playlist_multicast(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"play list\n");
+	unicast_send_play_list_multicast (args->number_of_channels, args->channels, args->client, 0 );
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Multicast playlist for VLC, m3u */
+static int unicast_route_playlist_multicast_vlc(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"play list\n");
+	unicast_send_play_list_multicast (args->number_of_channels, args->channels, args->client, 1 );
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Channels list, json */
+static int unicast_route_channels_list_js(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"Channel list Json\n");
+	unicast_send_streamed_channels_list_js (args->unicast_vars, args->number_of_channels, args->channels, args->client);
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Signal power, json */
+static int unicast_route_signal_power_js(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"Signal power json\n");
+	unicast_send_signal_power_js(args->client, args->strengthparams);
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Traffic of the channels, json */
+static int unicast_route_channels_traffic_js(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"Channel traffic json\n");
+	unicast_send_channel_traffic_js(args->number_of_channels, args->channels, args->client);
+	return -2; //We close the connection afterwards
+}
+
+/** @brief State of MuMuDVB, xml */
+static int unicast_route_state_xml(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"HTTP request for XML State\n");
+	unicast_send_xml_state(args->unicast_vars, args->number_of_channels, args->channels, args->client, args->strengthparams, args->auto_p, args->cam_p, args->scam_vars);
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Performance metrics, Prometheus text format */
+static int unicast_route_metrics(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DEBUG,"HTTP request for the metrics\n");
+	unicast_send_metrics(args->unicast_vars, args->number_of_channels, args->channels, args->client);
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Analysis of the PIDs of the transponder, json */
+static int unicast_route_pids_js(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"HTTP request for the PIDs analysis\n");
+	unicast_send_pids_js(args->number_of_channels, args->channels, args->client);
+	return -2; //We close the connection afterwards
+}
+
+/** @brief Live events, the connection stays open */
+static int unicast_route_events(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"HTTP request for the live events\n");
+	return unicast_events_subscribe(args->unicast_vars, args->client);
+}
+
+/** @brief CAM menu display, xml */
+static int unicast_route_cam_menu(unicast_route_args_t *args)
+{
+	log_message( log_module, MSG_DETAIL,"HTTP request for CAM menu display \n");
+	unicast_send_cam_menu(args->client, args->cam_p);
+	return -2; //We close the connection afterwards
+}
+
+/** @brief CAM menu action : GET /cam/action.xml?key=K */
+static int unicast_route_cam_action(unicast_route_args_t *args)
+{
+	char key[16];
+	log_message( log_module, MSG_DETAIL,"HTTP request for CAM menu action\n");
+	if(!unicast_request_param(&args->client->request, "key", key, sizeof(key)))
+		key[0]='\0';
+	unicast_send_cam_action(args->client, key, args->cam_p);
+	return -2; //We close the connection afterwards
+}
+
+#define UNICAST_ROUTE(path, prefix, channel, handler) {path, sizeof(path)-1, prefix, channel, handler}
+
+/** @brief The routes of the HTTP server, the path is compared without the query */
+static const unicast_route_t unicast_routes[]={
+	UNICAST_ROUTE("/bynumber/", 1, 1, unicast_route_bynumber),
+	UNICAST_ROUTE("/bysid/", 1, 1, unicast_route_bysid),
+	UNICAST_ROUTE("/byname/", 1, 1, unicast_route_byname),
+	UNICAST_ROUTE("/channels_list.html", 0, 0, unicast_route_channels_list),
+	UNICAST_ROUTE("/playlist.m3u", 0, 0, unicast_route_playlist),
+	UNICAST_ROUTE("/playlist_port.m3u", 0, 0, unicast_route_playlist_port),
+	UNICAST_ROUTE("/playlist_multicast.m3u", 0, 0, unicast_route_playlist_multicast),
+	UNICAST_ROUTE("/playlist_multicast_vlc.m3u", 0, 0, unicast_route_playlist_multicast_vlc),
+	UNICAST_ROUTE("/channels_list.json", 0, 0, unicast_route_channels_list_js),
+	UNICAST_ROUTE("/monitor/signal_power.json", 0, 0, unicast_route_signal_power_js),
+	UNICAST_ROUTE("/monitor/channels_traffic.json", 0, 0, unicast_route_channels_traffic_js),
+	UNICAST_ROUTE("/monitor/state.xml", 0, 0, unicast_route_state_xml),
+	UNICAST_ROUTE("/monitor/pids.json", 0, 0, unicast_route_pids_js),
+	UNICAST_ROUTE("/metrics", 0, 0, unicast_route_metrics),
+	UNICAST_ROUTE("/monitor/events", 0, 0, unicast_route_events),
+	UNICAST_ROUTE("/cam/menu.xml", 0, 0, unicast_route_cam_menu),
+	UNICAST_ROUTE("/cam/action.xml", 0, 0, unicast_route_cam_action),
+};
+
+/** @brief Find the route of a path
+ * The table is small and fixed, the lengths are compared first
+ */
+static const unicast_route_t *unicast_route_find(char *path)
+{
+	unsigned int i;
+	int path_len;
+
+	path_len=strlen(path);
+	for(i=0;i<sizeof(unicast_routes)/sizeof(unicast_routes[0]);i++)
+	{
+		if(unicast_routes[i].prefix ? path_len<unicast_routes[i].len : path_len!=unicast_routes[i].len)
+			continue;
+		if(!memcmp(path, unicast_routes[i].path, unicast_routes[i].len))
+			return &unicast_routes[i];
+	}
+	return NULL;
+}
+
+/** @brief Send an HTTP error code to a client
+ * The client is deleted afterwards, except if it already gets a channel
+ */
+static int unicast_send_error(unicast_client_t *client, const char *reply)
+{
+	int iRet;
+	iRet=write(client->Socket,reply, strlen(reply));
+	if(iRet<0)
+		log_message( log_module, MSG_INFO,"Error writing reply\n");
+	if(client->chan_ptr==NULL)
+		return -2; //to delete the client
+	unicast_request_reset(&client->request);
+	return 0;
+}
+
 /** @brief Deal with an incoming message on the unicast client connection
  * This function will store and answer the HTTP requests
  *
+ * The request is parsed as it arrives, in the fixed buffer of the client.
  *
  * @param unicast_vars the unicast parameters
  * @param client The client from which the message was received
  * @param channels the channel array
  * @param number_of_channels quite explicit ...
  */
-int unicast_handle_message(unicast_parameters_t *unicast_vars, unicast_client_t *client, mumudvb_channel_t *channels, int number_of_channels, strength_parameters_t *strengthparams, auto_p_t *auto_p, void *cam_p, void *scam_vars)
+int unicast_handle_message(unicast_parameters_t *unicast_vars, unicast_client_t *client, mumudvb_channel_t **channels, int number_of_channels, strength_parameters_t *strengthparams, auto_p_t *auto_p, void *cam_p, void *scam_vars)
 {
+	unicast_request_t *request=&client->request;
+	const unicast_route_t *route;
+	unicast_route_args_t args;
 	int received_len;
-	(void) unicast_vars;
-
-	/************ auto increasing buffer to receive the message **************/
-	if((client->buffersize-client->bufferpos)<RECV_BUFFER_MULTIPLE)
-	{
-		client->buffer=realloc(client->buffer,(client->buffersize + RECV_BUFFER_MULTIPLE+1)*sizeof(char)); //the +1 if for the \0 at the end
-		if(client->buffer==NULL)
-		{
-			log_message( log_module, MSG_ERROR,"Problem with realloc for the client buffer : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
-			client->buffersize=0;
-			client->bufferpos=0;
-			return -1;
-		}
-		memset (client->buffer+client->buffersize, 0, RECV_BUFFER_MULTIPLE*sizeof(char)); //We fill the buffer with zeros to be sure
-		client->buffersize += RECV_BUFFER_MULTIPLE;
-	}
-
-	received_len=recv(client->Socket, client->buffer+client->bufferpos, RECV_BUFFER_MULTIPLE, 0);
+	int requested_channel;
+	int timeshift_delay;
+	int iRet;
+	char value[16];
 
-	if(received_len>0)
-	{
-		if(client->bufferpos==0)
-			log_message( log_module, MSG_FLOOD,"beginning of buffer %c%c%c%c%c\n",client->buffer[0],client->buffer[1],client->buffer[2],client->buffer[3],client->buffer[4]);
-		client->bufferpos+=received_len;
-		log_message( log_module, MSG_FLOOD,"We received %d, buffer len %d new buffer pos %d\n",received_len,client->buffersize, client->bufferpos);
-	}
+	received_len=recv(client->Socket, request->buffer+request->len, UNICAST_REQUEST_MAX-request->len, 0);
 
 	if(received_len==-1)
 	{
@@ -523,260 +829,106 @@ int unicast_handle_message(unicast_parameters_t *unicast_vars, unicast_client_t
 	if(received_len==0)
 		return -2; //To say to the main program to close the connection
 
-	/***************** Now we parse the message to see if something was asked  *****************/
-	client->buffer[client->buffersize]='\0'; //For avoiding strlen to look too far (other option is to use the gnu extension strnlen)
-	//We search for the end of the HTTP request
-	if(strlen(client->buffer)>5 && strstr(client->buffer, "\n\r\n\0"))
-	{
-		int pos,err404;
-		char *substring=NULL;
-		int requested_channel;
-		int iRet;
-		requested_channel=0;
-		pos=0;
-		err404=0;
-		struct unicast_reply* reply=NULL;
-
-		log_message( log_module, MSG_FLOOD,"End of HTTP request, we parse it\n");
-
-		if(strstr(client->buffer,"GET ")==client->buffer)
-		{
-			//to implement :
-			//Information ???
-			//GET /monitor/???
-
-			pos=4;
+	request->len+=received_len;
+	request->buffer[request->len]='\0';
+	log_message( log_module, MSG_FLOOD,"We received %d, new buffer pos %d\n",received_len, request->len);
 
-			/* preselected channels via the port of the connection */
-			//if the client have already an asked channel we don't parse the GET
-			if(client->askedChannel!=-1)
-			{
-				requested_channel=client->askedChannel+1; //+1 because requested channel starts at 1 and asked channel starts at 0
-				log_message( log_module, MSG_DEBUG,"Channel by socket, number %d\n",requested_channel);
-				client->askedChannel=-1;
-			}
-			//Channel by number
-			//GET /bynumber/channelnumber
-			else if(strstr(client->buffer +pos ,"/bynumber/")==(client->buffer +pos))
-			{
-				if(client->chan_ptr!=NULL)
-				{
-					log_message( log_module, MSG_INFO,"A channel (%s) is already streamed to this client, it shouldn't ask for a new one without closing the connection, error 501\n",client->chan_ptr->name);
-					iRet=write(client->Socket,HTTP_501_REPLY, strlen(HTTP_501_REPLY));
-					if(iRet<0)
-						log_message( log_module, MSG_INFO,"Error writing reply\n");
-
-					return -2; //to delete the client
-				}
-
-				pos+=strlen("/bynumber/");
-				substring = strtok (client->buffer+pos, " ");
-				if(substring == NULL)
-					err404=1;
-				else
-				{
-					requested_channel=atoi(substring);
-					if(requested_channel && requested_channel<=number_of_channels)
-						log_message( log_module, MSG_DEBUG,"Channel by number, number %d\n",requested_channel);
-					else
-					{
-						log_message( log_module, MSG_INFO,"Channel by number, number %d out of range\n",requested_channel);
-						err404=1;
-						requested_channel=0;
-					}
-				}
-			}
-			//Channel by autoconf_sid_list
-			//GET /bysid/sid
-			else if(strstr(client->buffer +pos ,"/bysid/")==(client->buffer +pos))
-			{
-				if(client->chan_ptr!=NULL)
-				{
-					log_message( log_module, MSG_INFO,"A channel (%s) is already streamed to this client, it shouldn't ask for a new one without closing the connection, error 501\n",client->chan_ptr->name);
-					iRet=write(client->Socket,HTTP_501_REPLY, strlen(HTTP_501_REPLY)); //iRet is to make the copiler happy we will close the connection anyways
-					return -2; //to delete the client
-				}
-				pos+=strlen("/bysid/");
-				substring = strtok (client->buffer+pos, " ");
-				if(substring == NULL)
-					err404=1;
-				else
-				{
-					int requested_sid;
-					requested_sid=atoi(substring);
-					for(int current_channel=0; current_channel<number_of_channels;current_channel++)
-					{
-						if(channels[current_channel].service_id == requested_sid)
-							requested_channel=current_channel+1;
-					}
-					if(requested_channel)
-						log_message( log_module, MSG_DEBUG,"Channel by service id,  service_id %d number %d\n", requested_sid, requested_channel);
-					else
-					{
-						log_message( log_module, MSG_INFO,"Channel by service id, service_id  %d not found\n",requested_sid);
-						err404=1;
-						requested_channel=0;
-					}
-				}
-			}
-			//Channel by name
-			//GET /byname/channelname
-			else if(strstr(client->buffer +pos ,"/byname/")==(client->buffer +pos))
-			{
-				if(client->chan_ptr!=NULL)
-				{
-					log_message( log_module, MSG_INFO,"A channel (%s) is already streamed to this client, it shouldn't ask for a new one without closing the connection, error 501\n",client->chan_ptr->name);
-					iRet=write(client->Socket,HTTP_501_REPLY, strlen(HTTP_501_REPLY));//iRet is to make the copiler happy we will close the connection anyways
-					return -2; //to delete the client
-				}
-				pos+=strlen("/byname/");
-				log_message( log_module, MSG_DEBUG,"Channel by number\n");
-				substring = strtok (client->buffer+pos, " ");
-				if(substring == NULL)
-					err404=1;
-				else
-				{
-					log_message( log_module, MSG_DEBUG,"Channel by name, name %s\n",substring);
-					//search the channel
-					err404=1;//Temporary
-					/** @todo implement the search without the spaces*/
-				}
-			}
-			//Channels list
-			else if(strstr(client->buffer +pos ,"/channels_list.html ")==(client->buffer +pos))
-			{
-				//We get the host name if availaible
-				char *hoststr;
-				hoststr=strstr(client->buffer ,"Host: ");
-				if(hoststr)
-				{
-					substring = strtok (hoststr+6, "\r");
-				}
-				else
-					substring=NULL;
-				log_message( log_module, MSG_DETAIL,"Channel list\n");
-				unicast_send_streamed_channels_list (number_of_channels, channels, client->Socket, substring);
-				return -2; //We close the connection afterwards
-			}
-			//playlist, m3u
-			else if(strstr(client->buffer +pos ,"/playlist.m3u ")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"play list\n");
-				unicast_send_play_list_unicast (number_of_channels, channels, client->Socket, unicast_vars->portOut, 0 );
-				return -2; //We close the connection afterwards
-			}
-			//playlist, m3u
-			else if(strstr(client->buffer +pos ,"/playlist_port.m3u ")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"play list\n");
-				unicast_send_play_list_unicast (number_of_channels, channels, client->Socket, unicast_vars->portOut, 1 );
-				return -2; //We close the connection afterwards
-			}
-			else if(strstr(client->buffer +pos ,"/playlist_multicast.m3u ")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"play list\n");
-				unicast_send_play_list_multicast (number_of_channels, channels, client->Socket, 0 );
-				return -2; //We close the connection afterwards
-			}
-			else if(strstr(client->buffer +pos ,"/playlist_multicast_vlc.m3u ")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"play list\n");
-				unicast_send_play_list_multicast (number_of_channels, channels, client->Socket, 1 );
-				return -2; //We close the connection afterwards
-			}
-			//statistics, text version
-			else if(strstr(client->buffer +pos ,"/channels_list.json ")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"Channel list Json\n");
-				unicast_send_streamed_channels_list_js (number_of_channels, channels, client->Socket);
-				return -2; //We close the connection afterwards
-			}
-			else if(strstr(client->buffer +pos ,"/monitor/signal_power.json ")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"Signal power json\n");
-				unicast_send_signal_power_js(client->Socket, strengthparams);
-				return -2; //We close the connection afterwards
-			}
-			else if(strstr(client->buffer +pos ,"/monitor/channels_traffic.json ")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"Channel traffic json\n");
-				unicast_send_channel_traffic_js(number_of_channels, channels, client->Socket);
-				return -2; //We close the connection afterwards
-			}
-			else if(strstr(client->buffer +pos ,"/monitor/state.xml ")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"HTTP request for XML State\n");
-				unicast_send_xml_state(unicast_vars, number_of_channels, channels, client->Socket, strengthparams, auto_p, cam_p, scam_vars);
-				return -2; //We close the connection afterwards
-			}
-			else if(strstr(client->buffer +pos ,"/cam/menu.xml ")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"HTTP request for CAM menu display \n");
-				unicast_send_cam_menu(client->Socket, cam_p);
-				return -2; //We close the connection afterwards
-			}
-			else if(strstr(client->buffer +pos ,"/cam/action.xml?key=")==(client->buffer +pos))
-			{
-				log_message( log_module, MSG_DETAIL,"HTTP request for CAM menu action\n");
-				pos+=strlen("/cam/action.xml?key=");
-				unicast_send_cam_action(client->Socket,client->buffer+pos, cam_p);
-				return -2; //We close the connection afterwards
-			}
+	/***************** Now we parse the new data to see if something was asked  *****************/
+	iRet=unicast_request_parse(request);
+	if(iRet==0)
+		return 0;
+	if(iRet==-1)
+	{
+		log_message( log_module, MSG_INFO,"Malformed HTTP request, error 400\n");
+		return unicast_send_error(client, HTTP_400_REPLY);
+	}
+	if(iRet==-2)
+	{
+		log_message( log_module, MSG_INFO,"HTTP request larger than %d bytes, error 431\n", UNICAST_REQUEST_MAX);
+		return unicast_send_error(client, HTTP_431_REPLY);
+	}
 
-			//Not implemented path --> 404
-			else
-				err404=1;
+	log_message( log_module, MSG_FLOOD,"End of HTTP request, we parse it\n");
 
+	if(strcmp(request->method,"GET"))
+	{
+		//We don't implement this http method, but if the client is already connected, we keep the connection
+		log_message( log_module, MSG_INFO,"Unhandled HTTP method : \"%s\", error 501%s\n", request->method, client->chan_ptr?" but we keep the client connected":"");
+		return unicast_send_error(client, HTTP_501_REPLY);
+	}
 
-			if(err404)
-			{
-				log_message( log_module, MSG_INFO,"Path not found i.e. 404\n");
-				reply = unicast_reply_init();
-				if (NULL == reply) {
-					log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
-					return -2;
-				}
-				unicast_reply_write(reply, HTTP_404_REPLY_HTML, VERSION);
-				unicast_reply_send(reply, client->Socket, 404, "text/html");
-				if (0 != unicast_reply_free(reply)) {
-					log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
-					return -2;
-				}
-				return -2; //to delete the client
-			}
-			//We have found a channel, we add the client
-			if(requested_channel)
-			{
-				if(!channel_add_unicast_client(client,&channels[requested_channel-1]))
-					client->chan_ptr=&channels[requested_channel-1];
-				else
-					return -2;
-			}
+	requested_channel=0;
+	/* preselected channels via the port of the connection */
+	//if the client have already an asked channel we don't look at the path
+	if(client->askedChannel!=-1)
+	{
+		requested_channel=client->askedChannel+1; //+1 because requested channel starts at 1 and asked channel starts at 0
+		log_message( log_module, MSG_DEBUG,"Channel by socket, number %d\n",requested_channel);
+		client->askedChannel=-1;
+	}
+	else if((route=unicast_route_find(request->path))!=NULL)
+	{
+		if(route->channel && client->chan_ptr!=NULL)
+		{
+			log_message( log_module, MSG_INFO,"A channel (%s) is already streamed to this client, it shouldn't ask for a new one without closing the connection, error 501\n",client->chan_ptr->name);
+			iRet=write(client->Socket,HTTP_501_REPLY, strlen(HTTP_501_REPLY)); //iRet is to make the copiler happy we will close the connection anyways
+			return -2; //to delete the client
+		}
+		args.unicast_vars=unicast_vars;
+		args.client=client;
+		args.channels=channels;
+		args.number_of_channels=number_of_channels;
+		args.strengthparams=strengthparams;
+		args.auto_p=auto_p;
+		args.cam_p=cam_p;
+		args.scam_vars=scam_vars;
+		args.arg=request->path+route->len;
+		iRet=route->handler(&args);
+		if(!route->channel)
+			return iRet;
+		requested_channel=iRet;
+	}
 
+	//Not implemented path or channel not found --> 404
+	if(!requested_channel)
+	{
+		struct unicast_reply* reply=NULL;
+		log_message( log_module, MSG_INFO,"Path not found i.e. 404\n");
+		reply = unicast_reply_init();
+		if (NULL == reply) {
+			log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
+			return -2;
 		}
-		else
-		{
-			//We don't implement this http method, but if the client is already connected, we keep the connection
-			if(client->chan_ptr==NULL)
-			{
-				log_message( log_module, MSG_INFO,"Unhandled HTTP method : \"%s\", error 501\n",  strtok (client->buffer+pos, " "));
-				iRet=write(client->Socket,HTTP_501_REPLY, strlen(HTTP_501_REPLY));//iRet is to make the copiler happy we will close the connection anyways
-				return -2; //to delete the client
-			}
-			else
-			{
-				log_message( log_module, MSG_INFO,"Unhandled HTTP method : \"%s\", error 501 but we keep the client connected\n",  strtok (client->buffer+pos, " "));
-				iRet=write(client->Socket,HTTP_501_REPLY, strlen(HTTP_501_REPLY));//iRet is to make the copiler happy we will close the connection anyways
-				return 0;
-			}
+		unicast_reply_write(reply, HTTP_404_REPLY_HTML, VERSION);
+		unicast_reply_send(reply, client, 404, "text/html");
+		if (0 != unicast_reply_free(reply)) {
+			log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
+			return -2;
 		}
-		//We don't need the buffer anymore
-		free(client->buffer);
-		client->buffer=NULL;
-		client->bufferpos=0;
-		client->buffersize=0;
+		return -2; //to delete the client
 	}
 
+	//Timeshift : GET /bysid/sid?offset=-300 (s)
+	timeshift_delay=0;
+	if(unicast_request_param(request, "offset", value, sizeof(value)))
+		timeshift_delay=-atoi(value);
+
+	//We have found a channel, we add the client
+	pthread_mutex_lock(&unicast_vars->clients_lock);
+	iRet=channel_add_unicast_client(client,channels[requested_channel-1]);
+	pthread_mutex_unlock(&unicast_vars->clients_lock);
+	if(iRet)
+		return -2;
+	client->chan_ptr=channels[requested_channel-1];
+	iRet=-1;
+	if(timeshift_delay>0)
+		iRet=timeshift_client_start(client, client->chan_ptr, timeshift_delay);
+	//Live clients can get the fast start cache
+	if(iRet && unicast_vars->fast_start)
+		unicast_cache_send(client, client->chan_ptr, unicast_vars);
+
+	//We don't need the request anymore
+	unicast_request_reset(request);
 	return 0;
 }
 
@@ -818,6 +970,9 @@ struct unicast_reply* unicast_reply_init()
 	reply->length_body = REPLY_SIZE_STEP;
 	reply->used_body = 0;
 	reply->type = REPLY_BODY;
+	reply->snapshot = NULL;
+	reply->etag[0] = '\0';
+	reply->unhashed_start = reply->unhashed_end = 0;
 	return reply;
 }
 
@@ -828,11 +983,13 @@ int unicast_reply_free(struct unicast_reply *reply)
 {
 	if (NULL == reply)
 		return 1;
-	if ((NULL == reply->buffer_header)&&(NULL == reply->buffer_body))
-		return 1;
+	//The buffers are NULL if the reply was handed to the client to be sent later
 	if(reply->buffer_header != NULL)
 		free(reply->buffer_header);
-	if(reply->buffer_body != NULL)
+	//The body of a snapshot belongs to the snapshot
+	if(reply->snapshot != NULL)
+		unicast_snapshot_release(reply->snapshot);
+	else if(reply->buffer_body != NULL)
 		free(reply->buffer_body);
 	free(reply);
 	return 0;
@@ -894,12 +1051,58 @@ int unicast_reply_write(struct unicast_reply *reply, const char* msg, ...)
 	return 0;
 }
 
-/** @brief Dump the filled buffer on the socket adding HTTP header informations
+/** @brief Write the header and the body of a reply without blocking
+ * @return 1 if the reply is fully sent, 0 if the socket is full, -1 on error
+ */
+static int unicast_reply_write_out(struct unicast_reply *reply, int socket)
+{
+	struct iovec iov[2];
+	int iovcnt;
+	ssize_t written;
+
+	while (reply->sent < reply->used_header+reply->used_body)
+	{
+		iovcnt=0;
+		if(reply->sent < reply->used_header)
+		{
+			iov[iovcnt].iov_base=reply->buffer_header+reply->sent;
+			iov[iovcnt].iov_len=reply->used_header-reply->sent;
+			iovcnt++;
+			iov[iovcnt].iov_base=reply->buffer_body;
+			iov[iovcnt].iov_len=reply->used_body;
+			iovcnt++;
+		}
+		else
+		{
+			iov[iovcnt].iov_base=reply->buffer_body+(reply->sent-reply->used_header);
+			iov[iovcnt].iov_len=reply->used_header+reply->used_body-reply->sent;
+			iovcnt++;
+		}
+		written=writev(socket, iov, iovcnt);
+		if(written<0)
+		{
+			if(errno==EINTR)
+				continue;
+			if(errno==EAGAIN || errno==EWOULDBLOCK)
+				return 0;
+			log_message( log_module, MSG_DEBUG,"Error when sending the HTTP reply : %s\n",strerror(errno));
+			return -1;
+		}
+		reply->sent+=written;
+	}
+	return 1;
+}
+
+/** @brief Send the filled buffer to the client adding HTTP header informations
+ *
+ * The header and the body are written together, without blocking. If the client
+ * doesn't take everything, the reply is handed to the client (the buffers of reply are
+ * set to NULL) and the rest is sent by the event loop when the socket is writable.
  */
-int unicast_reply_send(struct unicast_reply *reply, int socket, int code, const char* content_type)
+int unicast_reply_send(struct unicast_reply *reply, unicast_client_t *client, int code, const char* content_type)
 {
-	int size=0;
-	int temp_size=0;
+	struct unicast_reply *pending;
+	int iRet;
 	//we add the header information
 	reply->type = REPLY_HEADER;
 	unicast_reply_write(reply, "HTTP/1.0 ");
@@ -908,6 +1111,9 @@ int unicast_reply_send(struct unicast_reply *reply, int socket, int code, const
 	case 200:
 		unicast_reply_write(reply, "200 OK\r\n");
 		break;
+	case 304:
+		unicast_reply_write(reply, "304 Not Modified\r\n");
+		break;
 	case 404:
 		unicast_reply_write(reply, "404 Not found\r\n");
 		break;
@@ -916,21 +1122,191 @@ int unicast_reply_send(struct unicast_reply *reply, int socket, int code, const
 		return 0;
 	}
 	unicast_reply_write(reply, "Server: mumudvb/" VERSION "\r\n");
-	unicast_reply_write(reply, "Content-type: %s\r\n", content_type);
-	unicast_reply_write(reply, "Content-length: %d\r\n", reply->used_body);
+	if(reply->etag[0])
+	{
+		unicast_reply_write(reply, "ETag: %s\r\n", reply->etag);
+		unicast_reply_write(reply, "Cache-Control: no-cache\r\n");
+	}
+	if(code != 304)
+	{
+		unicast_reply_write(reply, "Content-type: %s\r\n", content_type);
+		unicast_reply_write(reply, "Content-length: %d\r\n", reply->used_body);
+	}
 	unicast_reply_write(reply, "\r\n"); /* end header */
-	//we merge the header and the body
-	reply->buffer_header = realloc(reply->buffer_header, reply->used_header+reply->used_body);
-	memcpy(&reply->buffer_header[reply->used_header],reply->buffer_body,sizeof(char)*reply->used_body);
-	reply->used_header+=reply->used_body;
 
 	//now we write the data
-	while (size<reply->used_header){
-		temp_size = write(socket, reply->buffer_header+size, reply->used_header-size);
-		size += temp_size!=-1 ? temp_size : 0 ;
+	reply->sent=0;
+	iRet=unicast_reply_write_out(reply, client->Socket);
+	if(iRet<0)
+		return -1;
+	if(iRet==0)
+	{
+		if(client->reply!=NULL)
+		{
+			log_message( log_module, MSG_WARN,"A reply is already waiting for this client, the new one is dropped\n");
+			return -1;
+		}
+		//The client is slow, the rest will be sent by the event loop
+		pending=malloc(sizeof (struct unicast_reply));
+		if (NULL == pending)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			return -1;
+		}
+		*pending=*reply;
+		reply->buffer_header=NULL;
+		reply->buffer_body=NULL;
+		reply->snapshot=NULL;
+		client->reply=pending;
+		log_message( log_module, MSG_FLOOD,"Reply partially sent (%d of %d bytes), the rest will be sent later\n", pending->sent, pending->used_header+pending->used_body);
+	}
+	return reply->used_header+reply->used_body;
+}
+
+/** @brief Continue to send the reply of a client, the socket is writable
+ * @return 1 if the reply is over (sent or error), 0 if there is still data to send
+ */
+int unicast_reply_continue(unicast_client_t *client)
+{
+	if(client->reply==NULL)
+		return 1;
+	if(!unicast_reply_write_out(client->reply, client->Socket))
+		return 0;
+	unicast_reply_free(client->reply);
+	client->reply=NULL;
+	return 1;
+}
+
+
+/** The snapshots of the monitoring pages, replaced by the monitor thread */
+static unicast_snapshot_t *unicast_snapshots[UNICAST_SNAPSHOT_NUM];
+static const char *unicast_snapshot_types[UNICAST_SNAPSHOT_NUM]={
+		"application/xml; charset=UTF-8",
+		"application/json",
+		"application/json",
+		"text/plain; version=0.0.4; charset=utf-8",
+		"application/json",
+};
+/** Protects the table and the reference counts of the snapshots */
+static pthread_mutex_t unicast_snapshots_lock=PTHREAD_MUTEX_INITIALIZER;
+
+/** @brief Release a reference on a snapshot, it is freed with the last one */
+void unicast_snapshot_release(unicast_snapshot_t *snapshot)
+{
+	int refcount;
+	pthread_mutex_lock(&unicast_snapshots_lock);
+	refcount=--snapshot->refcount;
+	pthread_mutex_unlock(&unicast_snapshots_lock);
+	if(refcount)
+		return;
+	free(snapshot->data);
+	free(snapshot);
+}
+
+/** @brief Publish the body of a reply as the new snapshot of a page, the reply is freed
+ *
+ * The ETag is the hash of the body without its unhashed part, it stays the same while the
+ * content doesn't change.
+ *
+ * @param type the page (UNICAST_SNAPSHOT_*)
+ * @param reply the rendered page
+ */
+void unicast_snapshot_publish(int type, struct unicast_reply *reply)
+{
+	unicast_snapshot_t *snapshot,*old;
+	uint64_t hash=14695981039346656037ULL;
+	int i;
+
+	//FNV-1a
+	for(i=0;i<reply->used_body;i++)
+	{
+		if(i==reply->unhashed_start && reply->unhashed_end>i)
+			i=reply->unhashed_end;
+		if(i>=reply->used_body)
+			break;
+		hash^=(unsigned char)reply->buffer_body[i];
+		hash*=1099511628211ULL;
+	}
+	snapshot=malloc(sizeof(unicast_snapshot_t));
+	if(snapshot==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		unicast_reply_free(reply);
+		return;
+	}
+	snapshot->data=reply->buffer_body;
+	snapshot->len=reply->used_body;
+	snapshot->hash=hash;
+	snprintf(snapshot->etag, sizeof(snapshot->etag), "\"%016llx\"", (unsigned long long)hash);
+	snapshot->refcount=1;
+	reply->buffer_body=NULL;
+	unicast_reply_free(reply);
+
+	pthread_mutex_lock(&unicast_snapshots_lock);
+	old=unicast_snapshots[type];
+	unicast_snapshots[type]=snapshot;
+	pthread_mutex_unlock(&unicast_snapshots_lock);
+	if(old)
+		unicast_snapshot_release(old);
+}
 
+/** @brief Send the snapshot of a page to a client
+ *
+ * If the client already has this version (If-None-Match), the answer is 304 without body.
+ *
+ * @return 0 if the snapshot was sent, -1 if there is no snapshot of this page
+ */
+int unicast_snapshot_send(unicast_client_t *client, int type)
+{
+	unicast_snapshot_t *snapshot;
+	struct unicast_reply *reply;
+	char *if_none_match;
+	int code;
+
+	pthread_mutex_lock(&unicast_snapshots_lock);
+	snapshot=unicast_snapshots[type];
+	if(snapshot)
+		snapshot->refcount++;
+	pthread_mutex_unlock(&unicast_snapshots_lock);
+	if(snapshot==NULL)
+		return -1;
+	reply=unicast_reply_init();
+	if(reply==NULL)
+	{
+		log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
+		unicast_snapshot_release(snapshot);
+		return -1;
+	}
+	strcpy(reply->etag, snapshot->etag);
+	if_none_match=client->request.if_none_match;
+	if(if_none_match && (!strcmp(if_none_match,"*") || strstr(if_none_match, snapshot->etag)))
+	{
+		code=304;
+		unicast_snapshot_release(snapshot);
+	}
+	else
+	{
+		code=200;
+		free(reply->buffer_body);
+		reply->buffer_body=snapshot->data;
+		reply->length_body=reply->used_body=snapshot->len;
+		reply->snapshot=snapshot;
 	}
-	return size;
+	unicast_reply_send(reply, client, code, unicast_snapshot_types[type]);
+	unicast_reply_free(reply);
+	return 0;
+}
+
+/** @brief Free the snapshots, once the monitor thread is stopped */
+void unicast_snapshots_free(void)
+{
+	int type;
+	for(type=0;type<UNICAST_SNAPSHOT_NUM;type++)
+		if(unicast_snapshots[type])
+		{
+			unicast_snapshot_release(unicast_snapshots[type]);
+			unicast_snapshots[type]=NULL;
+		}
 }
 
 
@@ -944,11 +1320,11 @@ int unicast_reply_send(struct unicast_reply *reply, int socket, int code, const
  *
  * @param number_of_channels the number of channels
  * @param channels the channels array
- * @param Socket the socket on wich the information have to be sent
+ * @param client the client to which the information have to be sent
  * @param host The server ip address/name (got in the HTTP GET request)
  */
 int
-unicast_send_streamed_channels_list (int number_of_channels, mumudvb_channel_t *channels, int Socket, char *host)
+unicast_send_streamed_channels_list (int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client, char *host)
 {
 
 	struct unicast_reply* reply = unicast_reply_init();
@@ -960,21 +1336,21 @@ unicast_send_streamed_channels_list (int number_of_channels, mumudvb_channel_t *
 	unicast_reply_write(reply, HTTP_CHANNELS_REPLY_START);
 
 	for (int curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
-		if (channels[curr_channel].streamed_channel)
+		if (channels[curr_channel]->streamed_channel)
 		{
 			if(host)
 				unicast_reply_write(reply, "Channel number %d : %s<br>Unicast link : <a href=\"http://%s/bysid/%d\">http://%s/bysid/%d</a><br>Multicast ip : %s:%d<br><br>\r\n",
 						curr_channel+1,
-						channels[curr_channel].name,
-						host,channels[curr_channel].service_id,
-						host,channels[curr_channel].service_id,
-						channels[curr_channel].ip4Out,channels[curr_channel].portOut);
+						channels[curr_channel]->name,
+						host,channels[curr_channel]->service_id,
+						host,channels[curr_channel]->service_id,
+						channels[curr_channel]->desc->ip4Out,channels[curr_channel]->portOut);
 			else
-				unicast_reply_write(reply, "Channel number %d : \"%s\"<br>Multicast ip : %s:%d<br><br>\r\n",curr_channel+1,channels[curr_channel].name,channels[curr_channel].ip4Out,channels[curr_channel].portOut);
+				unicast_reply_write(reply, "Channel number %d : \"%s\"<br>Multicast ip : %s:%d<br><br>\r\n",curr_channel+1,channels[curr_channel]->name,channels[curr_channel]->desc->ip4Out,channels[curr_channel]->portOut);
 		}
 	unicast_reply_write(reply, HTTP_CHANNELS_REPLY_END);
 
-	unicast_reply_send(reply, Socket, 200, "text/html");
+	unicast_reply_send(reply, client, 200, "text/html");
 
 	if (0 != unicast_reply_free(reply)) {
 		log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
@@ -989,11 +1365,11 @@ unicast_send_streamed_channels_list (int number_of_channels, mumudvb_channel_t *
  *
  * @param number_of_channels the number of channels
  * @param channels the channels array
- * @param Socket the socket on wich the information have to be sent
+ * @param client the client to which the information have to be sent
  * @param perport says if the channel have to be given by the url /bysid or by their port
  */
 int
-unicast_send_play_list_unicast (int number_of_channels, mumudvb_channel_t *channels, int Socket, int unicast_portOut, int perport)
+unicast_send_play_list_unicast (int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client, int unicast_portOut, int perport)
 {
 	int curr_channel,iRet;
 
@@ -1007,7 +1383,7 @@ unicast_send_play_list_unicast (int number_of_channels, mumudvb_channel_t *chann
 	struct sockaddr_in tempSocketAddr;
 	unsigned int l;
 	l = sizeof(struct sockaddr);
-	iRet=getsockname(Socket, (struct sockaddr *) &tempSocketAddr, &l);
+	iRet=getsockname(client->Socket, (struct sockaddr *) &tempSocketAddr, &l);
 	if (iRet < 0)
 	{
 		log_message( log_module,  MSG_ERROR,"getsockname failed : %s while making HTTP reply", strerror(errno));
@@ -1019,26 +1395,26 @@ unicast_send_play_list_unicast (int number_of_channels, mumudvb_channel_t *chann
 
 	//"#EXTINF:0,title\r\nURL"
 	for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
-		if (channels[curr_channel].streamed_channel)
+		if (channels[curr_channel]->streamed_channel)
 		{
 			if(!perport)
 			{
 				unicast_reply_write(reply, "#EXTINF:0,%s\r\nhttp://%s:%d/bysid/%d\r\n",
-						channels[curr_channel].name,
+						channels[curr_channel]->name,
 						inet_ntoa(tempSocketAddr.sin_addr) ,
 						unicast_portOut ,
-						channels[curr_channel].service_id);
+						channels[curr_channel]->service_id);
 			}
-			else if(channels[curr_channel].unicast_port)
+			else if(channels[curr_channel]->unicast_port)
 			{
 				unicast_reply_write(reply, "#EXTINF:0,%s\r\nhttp://%s:%d/\r\n",
-						channels[curr_channel].name,
+						channels[curr_channel]->name,
 						inet_ntoa(tempSocketAddr.sin_addr) ,
-						channels[curr_channel].unicast_port);
+						channels[curr_channel]->unicast_port);
 			}
 		}
 
-	unicast_reply_send(reply, Socket, 200, "audio/x-mpegurl");
+	unicast_reply_send(reply, client, 200, "audio/x-mpegurl");
 
 	if (0 != unicast_reply_free(reply)) {
 		log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
@@ -1052,10 +1428,10 @@ unicast_send_play_list_unicast (int number_of_channels, mumudvb_channel_t *chann
  *
  * @param number_of_channels the number of channels
  * @param channels the channels array
- * @param Socket the socket on wich the information have to be sent
+ * @param client the client to which the information have to be sent
  */
 int
-unicast_send_play_list_multicast (int number_of_channels, mumudvb_channel_t *channels, int Socket, int vlc)
+unicast_send_play_list_multicast (int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client, int vlc)
 {
 	int curr_channel;
 	char urlheader[4];
@@ -1082,17 +1458,17 @@ unicast_send_play_list_multicast (int number_of_channels, mumudvb_channel_t *cha
 
 	//"#EXTINF:0,title\r\nURL"
 	for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
-		if (channels[curr_channel].streamed_channel)
+		if (channels[curr_channel]->streamed_channel)
 		{
 			unicast_reply_write(reply, "#EXTINF:0,%s\r\n%s://%s%s:%d\r\n",
-					channels[curr_channel].name,
+					channels[curr_channel]->name,
 					urlheader,
 					vlcchar,
-					channels[curr_channel].ip4Out,
-					channels[curr_channel].portOut);
+					channels[curr_channel]->desc->ip4Out,
+					channels[curr_channel]->portOut);
 		}
 
-	unicast_reply_send(reply, Socket, 200, "audio/x-mpegurl");
+	unicast_reply_send(reply, client, 200, "audio/x-mpegurl");
 
 	if (0 != unicast_reply_free(reply)) {
 		log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
@@ -87,6 +87,65 @@ enum
 #define HTTP_503_REPLY "HTTP/1.0 503 Too many clients\r\n"\
                       "\r\n"
 
+#define HTTP_400_REPLY "HTTP/1.0 400 Bad request\r\n"\
+                      "\r\n"
+
+#define HTTP_431_REPLY "HTTP/1.0 431 Request header fields too large\r\n"\
+                      "\r\n"
+
+/** Default maximum time to send a reply to a client (ms) */
+#define UNICAST_DEFAULT_REPLY_TIMEOUT 5000
+
+/** Default minimum time between two events of the signal or of the traffic (s) */
+#define UNICAST_DEFAULT_EVENTS_INTERVAL 1
+/** Number of live events kept for the subscribers which are late */
+#define UNICAST_EVENTS_RING 128
+
+/** Maximum size of an HTTP request, headers included */
+#define UNICAST_REQUEST_MAX 4096
+/** Without the asked channel in the indexes, they are rebuilt at most once during this time (us) */
+#define UNICAST_INDEX_REBUILD_DELAY 1000000
+
+/** @brief The HTTP request of a client, parsed as the data arrives
+ *
+ * Each received byte is looked at once, the lines are cut with \0 when they are complete
+ */
+typedef struct unicast_request_t{
+  /** The received data */
+  char buffer[UNICAST_REQUEST_MAX+1];
+  /** Number of bytes received */
+  int len;
+  /** Number of bytes parsed, start of the current line */
+  int parsed;
+  int line_start;
+  /** The request line is received */
+  int request_line;
+  /** The empty line at the end of the headers is received */
+  int complete;
+  /** Once complete : the method, the path, the query (after '?', NULL if none), the Host and If-None-Match headers (NULL if none) */
+  char *method;
+  char *path;
+  char *query;
+  char *host;
+  char *if_none_match;
+}unicast_request_t;
+
+/** @brief Hash indexes of the channels, to find the channel asked by a client without looking at all of them
+ *
+ * A slot contains the channel number +1, 0 if empty. Open addressing with linear probing.
+ */
+typedef struct unicast_channel_index_t{
+  /** Number of slots (power of 2) */
+  int size;
+  int *by_sid;
+  int *by_name;
+  /** The indexed channels */
+  mumudvb_channel_t **channels;
+  int number_of_channels;
+  /** Time of the last build (us, get_time clock) */
+  uint64_t build_time;
+}unicast_channel_index_t;
+
 
 /** @brief A client connected to the unicast connection.
  *
@@ -97,12 +156,12 @@ typedef struct unicast_client_t{
   struct sockaddr_in SocketAddr;
   /**HTTP socket*/
   int Socket;
-  /**Reception buffer*/
-  char *buffer;
-  /**Size of the buffer*/
-  int buffersize;
-  /**Position in the buffer*/
-  int bufferpos;
+  /**The HTTP request being received*/
+  unicast_request_t request;
+  /**The reply not fully sent yet, the rest is sent when the socket is writable (NULL if none)*/
+  struct unicast_reply *reply;
+  /**The connection is closed if the reply is not sent at this time (us, get_time clock)*/
+  uint64_t reply_deadline;
   /**Is there consecutive errors ?*/
   int consecutive_errors;
   /**When the first consecutive error happeard*/
@@ -123,6 +182,26 @@ typedef struct unicast_client_t{
   unicast_queue_header_t queue;
   /** The latest write error for this client*/
   int last_write_error;
+  /** Zero copy : the pipe between the channel pipe and the socket (-1 if not used) and the bytes in it*/
+  int pipe[2];
+  int pipe_bytes;
+  /** TCP tuning : the channel traffic used for the last tuning (kB/s)*/
+  float tuned_traffic;
+  /** Timeshift : the client gets the channel from the ring, at this position, until it reaches the live stream*/
+  int timeshifting;
+  uint64_t timeshift_pos;
+  /** Slot of the client in the statistics segment (-1 if none, see stats_shm.c)*/
+  int stats_slot;
+  /** Live events : the client gets them (/monitor/events), the next one and the data not sent yet (see unicast_events.c)*/
+  int events;
+  uint64_t events_seq;
+  char *events_buffer;
+  int events_len;
+  int events_sent;
+  /** Live events : the list of subscribers of the client, waiting for its socket or not*/
+  int events_blocked;
+  struct unicast_client_t *events_next;
+  struct unicast_client_t *events_prev;
 }unicast_client_t;
 
 
@@ -171,10 +250,30 @@ typedef struct unicast_parameters_t{
   unicast_fd_info_t *fd_info;
   /** The maximum size of the queue */
   int queue_max_size;
+  /** The maximum size of the queue in time of stream (ms, 0 : queue_max_size is used) */
+  int queue_max_time;
   /** The socket SO_SNDBUF size*/
   int socket_sendbuf_size;
   /** Debug : do we flush the queue when we get eagain errors ? */
   int flush_on_eagain;
+  /** Send the data to the clients without copying it for each of them (pipes, tee and splice) */
+  int zerocopy;
+  /** /dev/null, to empty the channel pipes */
+  int null_fd;
+  /** Tune the TCP sockets of the clients from the bitrate of their channel (pacing, buffers) */
+  int tcp_tuning;
+  /** The data sent at once to a client is corked (MSG_MORE), the end of each batch is pushed */
+  int tcp_cork;
+  /** Fast channel start : the new clients first get the last PAT, PMT and the stream since the last random access point */
+  int fast_start;
+  /** The indexes to find the channels asked by the clients */
+  unicast_channel_index_t channel_index;
+  /** Maximum time to send a reply (ms), a slow client is disconnected after */
+  int reply_timeout;
+  /** Minimum time between two live events of the signal or of the traffic (s) */
+  int events_interval;
+  /** Protects the lists of clients, read by the monitor thread for the snapshots */
+  pthread_mutex_t clients_lock;
 }unicast_parameters_t;
 
 
@@ -186,26 +285,88 @@ struct unicast_reply {
 	int used_header;
 	int used_body;
 	int type;
+	/** Bytes already sent, header and body */
+	int sent;
+	/** The body is the one of this snapshot (NULL if the body belongs to the reply) */
+	struct unicast_snapshot_t *snapshot;
+	/** ETag of the content, empty if none */
+	char etag[20];
+	/** Part of the body which changes all the time (uptime...), not taken in the ETag */
+	int unhashed_start;
+	int unhashed_end;
 };
  struct unicast_reply* unicast_reply_init();
  int unicast_reply_free(struct unicast_reply *reply);
  int unicast_reply_write(struct unicast_reply *reply, const char* msg, ...);
- int unicast_reply_send(struct unicast_reply *reply, int socket, int code, const char* content_type);
+ int unicast_reply_send(struct unicast_reply *reply, unicast_client_t *client, int code, const char* content_type);
+ int unicast_reply_continue(unicast_client_t *client);
+
+/** @brief The monitoring pages made by the monitor thread */
+enum
+  {
+    UNICAST_SNAPSHOT_STATE=0,
+    UNICAST_SNAPSHOT_CHANNELS_LIST,
+    UNICAST_SNAPSHOT_TRAFFIC,
+    UNICAST_SNAPSHOT_METRICS,
+    UNICAST_SNAPSHOT_PIDS,
+    UNICAST_SNAPSHOT_NUM,
+  };
+
+/** @brief A monitoring page rendered by the monitor thread, it is not modified once published
+ *
+ * The requests get the last one, it is freed once replaced and sent to everybody
+ */
+typedef struct unicast_snapshot_t{
+  char *data;
+  int len;
+  uint64_t hash;
+  /** The hash of the content, quoted */
+  char etag[20];
+  /** The table of the snapshots and the replies being sent */
+  int refcount;
+}unicast_snapshot_t;
+
+void unicast_snapshot_publish(int type, struct unicast_reply *reply);
+int unicast_snapshot_send(unicast_client_t *client, int type);
+void unicast_snapshot_release(unicast_snapshot_t *snapshot);
+void unicast_snapshots_free(void);
+struct auto_p_t;
+struct strength_parameters_t;
+void unicast_snapshots_update(unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels, struct strength_parameters_t *strengthparams, struct auto_p_t *auto_p, void *cam_p, void *scam_vars);
+
+void unicast_events_update(unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels, struct strength_parameters_t *strengthparams);
+void unicast_events_client(unicast_client_t *client, mumudvb_channel_t *channel, int connected);
+int unicast_events_subscribe(unicast_parameters_t *unicast_vars, unicast_client_t *client);
+void unicast_events_send(unicast_parameters_t *unicast_vars);
+void unicast_events_del_client(unicast_client_t *client);
+void unicast_events_free(void);
 
 int unicast_create_listening_socket(int socket_type, int socket_channel, char *ipOut, int port, struct sockaddr_in *sIn, int *socketIn, fds_t *fds, unicast_parameters_t *unicast_vars);
 
 struct strength_parameters_t; //just to avoid including dvb.h for one structure
-int unicast_handle_fd_event(unicast_parameters_t *unicast_vars, fds_t *fds, mumudvb_channel_t *channels, int number_of_channels, struct strength_parameters_t *strengthparams, struct auto_p_t *auto_p, void *cam_vars, void *scam_vars);
+int unicast_handle_fd_event(unicast_parameters_t *unicast_vars, fds_t *fds, mumudvb_channel_t **channels, int number_of_channels, struct strength_parameters_t *strengthparams, struct auto_p_t *auto_p, void *cam_vars, void *scam_vars);
 
 int unicast_del_client(unicast_parameters_t *unicast_vars, unicast_client_t *client);
 
 int channel_add_unicast_client(unicast_client_t *client,mumudvb_channel_t *channel);
+void unicast_client_tcp_tune(unicast_parameters_t *unicast_vars, unicast_client_t *client, mumudvb_channel_t *channel);
 
 void unicast_freeing(unicast_parameters_t *unicast_vars);
 
 int read_unicast_configuration(unicast_parameters_t *unicast_vars, mumudvb_channel_t *current_channel, int ip_ok, char *substring);
 
 void unicast_data_send(mumudvb_channel_t *actual_channel,  fds_t *fds, unicast_parameters_t *unicast_vars);
+void unicast_cache_add(mumudvb_channel_t *channel);
+void unicast_cache_send(unicast_client_t *client, mumudvb_channel_t *channel, unicast_parameters_t *unicast_vars);
+void unicast_cache_free(mumudvb_channel_t *channel);
+
+void unicast_request_reset(unicast_request_t *request);
+int unicast_request_parse(unicast_request_t *request);
+int unicast_request_param(unicast_request_t *request, const char *name, char *value, int value_len);
+int unicast_url_decode(const char *src, int src_len, char *dst, int dst_len);
+int unicast_channel_by_sid(unicast_channel_index_t *index, mumudvb_channel_t **channels, int number_of_channels, int sid);
+int unicast_channel_by_name(unicast_channel_index_t *index, mumudvb_channel_t **channels, int number_of_channels, char *name);
+void unicast_channel_index_free(unicast_channel_index_t *index);
 
 
 
@@ -37,6 +37,11 @@
 #include "dvb.h"
 #include "tune.h"
 #include "autoconf.h"
+#include "pacing.h"
+#include "timeshift.h"
+#include "recorder.h"
+#include "metrics.h"
+#include "analyzer.h"
 #ifdef ENABLE_CAM_SUPPORT
 #include "cam.h"
 #endif
@@ -47,58 +52,62 @@
 static char *log_module="Unicast : ";
 
 
-/** @brief Send a basic JSON file containig the list of streamed channels
+/** @brief Write a basic JSON file containig the list of streamed channels
  *
+ * @param reply the reply to fill
+ * @param unicast_vars the unicast parameters
  * @param number_of_channels the number of channels
  * @param channels the channels array
- * @param Socket the socket on wich the information have to be sent
  */
-int unicast_send_streamed_channels_list_js (int number_of_channels, mumudvb_channel_t *channels, int Socket)
+static void unicast_render_streamed_channels_list_js (struct unicast_reply *reply, unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels)
 {
 	int curr_channel;
 	unicast_client_t *unicast_client=NULL;
 	int clients=0;
-
-	struct unicast_reply* reply = unicast_reply_init();
-	if (NULL == reply) {
-		log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
-		return -1;
-	}
+	int jitter_avg,jitter_max;
 
 	unicast_reply_write(reply, "[");
 	for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
 	{
 		clients=0;
-		unicast_client=channels[curr_channel].clients;
+		//The list can be changed by the main thread when the monitor thread makes the snapshot
+		pthread_mutex_lock(&unicast_vars->clients_lock);
+		unicast_client=channels[curr_channel]->clients;
 		while(unicast_client!=NULL)
 		{
 			unicast_client=unicast_client->chan_next;
 			clients++;
 		}
+		pthread_mutex_unlock(&unicast_vars->clients_lock);
 		unicast_reply_write(reply, "{\"number\":%d, \"lcn\":%d, \"name\":\"%s\", \"sap_group\":\"%s\", \"ip_multicast\":\"%s\", \"port_multicast\":%d, \"num_clients\":%d, \"scrambling_ratio\":%d, \"is_up\":%d, \"pcr_pid\":%d, \"pmt_version\":%d, ",
 				curr_channel+1,
-				channels[curr_channel].logical_channel_number,
-				channels[curr_channel].name,
-				channels[curr_channel].sap_group,
-				channels[curr_channel].ip4Out,
-				channels[curr_channel].portOut,
+				channels[curr_channel]->logical_channel_number,
+				channels[curr_channel]->name,
+				channels[curr_channel]->desc->sap_group,
+				channels[curr_channel]->desc->ip4Out,
+				channels[curr_channel]->portOut,
 				clients,
-				channels[curr_channel].ratio_scrambled,
-				channels[curr_channel].streamed_channel,
-				channels[curr_channel].pcr_pid,
-				channels[curr_channel].pmt_version );
-
-		unicast_reply_write(reply, "\"unicast_port\":%d, \"service_id\":%d, \"service_type\":\"%s\", \"pids_num\":%d, \n",
-				channels[curr_channel].unicast_port,
-				channels[curr_channel].service_id,
-				service_type_to_str(channels[curr_channel].channel_type),
-				channels[curr_channel].num_pids);
+				channels[curr_channel]->ratio_scrambled,
+				channels[curr_channel]->streamed_channel,
+				channels[curr_channel]->pcr_pid,
+				channels[curr_channel]->pmt_version );
+
+		pacing_get_stats(channels[curr_channel], &jitter_avg, &jitter_max);
+		unicast_reply_write(reply, "\"unicast_port\":%d, \"service_id\":%d, \"service_type\":\"%s\", \"autoconf_latency\":%d, \"pacing_jitter\":%d, \"pacing_jitter_max\":%d, \"timeshift\":%d, \"pids_num\":%d, \n",
+				channels[curr_channel]->unicast_port,
+				channels[curr_channel]->service_id,
+				service_type_to_str(channels[curr_channel]->channel_type),
+				channels[curr_channel]->desc->autoconf_latency,
+				jitter_avg,
+				jitter_max,
+				timeshift_get_duration(channels[curr_channel]),
+				channels[curr_channel]->num_pids);
 		unicast_reply_write(reply, "\"pids\":[");
-		for(int i=0;i<channels[curr_channel].num_pids;i++)
+		for(int i=0;i<channels[curr_channel]->num_pids;i++)
 			unicast_reply_write(reply, "{\"number\":%d, \"type\":\"%s\", \"language\":\"%s\"},\n",
-					channels[curr_channel].pids[i],
-					pid_type_to_str(channels[curr_channel].pids_type[i]),
-					channels[curr_channel].pids_language[i]);
+					channels[curr_channel]->pids[i],
+					pid_type_to_str(channels[curr_channel]->desc->pids_type[i]),
+					channels[curr_channel]->desc->pids_language[i]);
 		reply->used_body -= 2; // dirty hack to erase the last comma
 		unicast_reply_write(reply, "]");
 		unicast_reply_write(reply, "},\n");
@@ -106,8 +115,29 @@ int unicast_send_streamed_channels_list_js (int number_of_channels, mumudvb_chan
 	}
 	reply->used_body -= 2; // dirty hack to erase the last comma
 	unicast_reply_write(reply, "]\n");
+}
 
-	unicast_reply_send(reply, Socket, 200, "application/json");
+/** @brief Send a basic JSON file containig the list of streamed channels
+ *
+ * @param unicast_vars the unicast parameters
+ * @param number_of_channels the number of channels
+ * @param channels the channels array
+ * @param client the client to which the information have to be sent
+ */
+int unicast_send_streamed_channels_list_js (unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client)
+{
+	//The snapshot made by the monitor thread, if any
+	if(!unicast_snapshot_send(client, UNICAST_SNAPSHOT_CHANNELS_LIST))
+		return 0;
+
+	struct unicast_reply* reply = unicast_reply_init();
+	if (NULL == reply) {
+		log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
+		return -1;
+	}
+	unicast_render_streamed_channels_list_js(reply, unicast_vars, number_of_channels, channels);
+
+	unicast_reply_send(reply, client, 200, "application/json");
 
 	if (0 != unicast_reply_free(reply)) {
 		log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
@@ -119,10 +149,10 @@ int unicast_send_streamed_channels_list_js (int number_of_channels, mumudvb_chan
 
 /** @brief Send a basic JSON file containig the reception power
  *
- * @param Socket the socket on wich the information have to be sent
+ * @param client the client to which the information have to be sent
  */
 int
-unicast_send_signal_power_js (int Socket, strength_parameters_t *strengthparams)
+unicast_send_signal_power_js (unicast_client_t *client, strength_parameters_t *strengthparams)
 {
 	struct unicast_reply* reply = unicast_reply_init();
 	if (NULL == reply)
@@ -133,7 +163,7 @@ unicast_send_signal_power_js (int Socket, strength_parameters_t *strengthparams)
 
 	unicast_reply_write(reply, "{\"ber\":%d, \"strength\":%d, \"snr\":%d, \"ub\":%d}\n", strengthparams->ber,strengthparams->strength,strengthparams->snr,strengthparams->ub);
 
-	unicast_reply_send(reply, Socket, 200, "application/json");
+	unicast_reply_send(reply, client, 200, "application/json");
 
 	if (0 != unicast_reply_free(reply)) {
 		log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
@@ -144,34 +174,48 @@ unicast_send_signal_power_js (int Socket, strength_parameters_t *strengthparams)
 
 
 
-/** @brief Send a basic JSON file containig the channel traffic
+/** @brief Write a basic JSON file containig the channel traffic
  *
+ * @param reply the reply to fill
  * @param number_of_channels the number of channels
  * @param channels the channels array
- * @param Socket the socket on wich the information have to be sent
  */
-int
-unicast_send_channel_traffic_js (int number_of_channels, mumudvb_channel_t *channels, int Socket)
+static void unicast_render_channel_traffic_js (struct unicast_reply *reply, int number_of_channels, mumudvb_channel_t **channels)
 {
 	int curr_channel;
 	extern long real_start_time;
 
-	struct unicast_reply* reply = unicast_reply_init();
-	if (NULL == reply) {
-		log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
-		return -1;
-	}
-
 	if ((time((time_t*)0L) - real_start_time) >= 10) //10 seconds for the traffic calculation to be done
 	{
 		unicast_reply_write(reply, "[");
 		for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
-			unicast_reply_write(reply, "{\"number\":%d, \"name\":\"%s\", \"traffic\":%.2f},\n", curr_channel+1, channels[curr_channel].name, channels[curr_channel].traffic);
+			unicast_reply_write(reply, "{\"number\":%d, \"name\":\"%s\", \"traffic\":%.2f},\n", curr_channel+1, channels[curr_channel]->name, channels[curr_channel]->traffic);
 		reply->used_body -= 2; // dirty hack to erase the last comma
 		unicast_reply_write(reply, "]\n");
 	}
+}
 
-	unicast_reply_send(reply, Socket, 200, "application/json");
+/** @brief Send a basic JSON file containig the channel traffic
+ *
+ * @param number_of_channels the number of channels
+ * @param channels the channels array
+ * @param client the client to which the information have to be sent
+ */
+int
+unicast_send_channel_traffic_js (int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client)
+{
+	//The snapshot made by the monitor thread, if any
+	if(!unicast_snapshot_send(client, UNICAST_SNAPSHOT_TRAFFIC))
+		return 0;
+
+	struct unicast_reply* reply = unicast_reply_init();
+	if (NULL == reply) {
+		log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
+		return -1;
+	}
+	unicast_render_channel_traffic_js(reply, number_of_channels, channels);
+
+	unicast_reply_send(reply, client, 200, "application/json");
 
 	if (0 != unicast_reply_free(reply)) {
 		log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
@@ -181,15 +225,14 @@ unicast_send_channel_traffic_js (int number_of_channels, mumudvb_channel_t *chan
 }
 
 
-/** @brief Send a full XML state of the mumudvb instance
+/** @brief Write a full XML state of the mumudvb instance
  *
+ * @param reply the reply to fill
  * @param number_of_channels the number of channels
  * @param channels the channels array
- * @param Socket the socket on wich the information have to be sent
- * @param fds the frontend device structure
  */
-int
-unicast_send_xml_state (unicast_parameters_t* unicast_vars, int number_of_channels, mumudvb_channel_t* channels, int Socket, strength_parameters_t* strengthparams, auto_p_t* auto_p, void* cam_p_v, void* scam_vars_v)
+static void
+unicast_render_xml_state (struct unicast_reply *reply, unicast_parameters_t* unicast_vars, int number_of_channels, mumudvb_channel_t** channels, strength_parameters_t* strengthparams, auto_p_t* auto_p, void* cam_p_v, void* scam_vars_v)
 {
 #ifndef ENABLE_CAM_SUPPORT
 	(void) cam_p_v; //to make compiler happy
@@ -202,12 +245,7 @@ unicast_send_xml_state (unicast_parameters_t* unicast_vars, int number_of_channe
 #else
 	scam_parameters_t *scam_vars=(scam_parameters_t *)scam_vars_v;
 #endif
-	// Prepare the HTTP reply
-	struct unicast_reply* reply = unicast_reply_init();
-	if (NULL == reply) {
-		log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
-		return -1;
-	}
+	int jitter_avg,jitter_max;
 
 	// Date time formatting
 	time_t rawtime;
@@ -229,7 +267,10 @@ unicast_send_xml_state (unicast_parameters_t* unicast_vars, int number_of_channe
 	extern long real_start_time;
 	struct timeval tv;
 	gettimeofday (&tv, (struct timezone *) NULL);
+	//The uptime changes every second, it is not taken in the ETag
+	reply->unhashed_start=reply->used_body;
 	unicast_reply_write(reply, "\t<global_uptime>%d</global_uptime>\n",(tv.tv_sec - real_start_time));
+	reply->unhashed_end=reply->used_body;
 
 	// Frontend setup
 	unicast_reply_write(reply, "\t<frontend_name><![CDATA[%s]]></frontend_name>\n",strengthparams->tune_p->fe_name);
@@ -341,39 +382,44 @@ unicast_send_xml_state (unicast_parameters_t* unicast_vars, int number_of_channe
 	int curr_channel;
 	for (curr_channel = 0; curr_channel < number_of_channels; curr_channel++)
 	{
-		unicast_reply_write(reply, "\t<channel number=\"%d\" is_up=\"%d\">\n",curr_channel+1,channels[curr_channel].streamed_channel);
-		unicast_reply_write(reply, "\t\t<lcn>%d</lcn>\n",channels[curr_channel].logical_channel_number);
-		unicast_reply_write(reply, "\t\t<name><![CDATA[%s]]></name>\n",channels[curr_channel].name);
-		unicast_reply_write(reply, "\t\t<service_type type=\"%d\"><![CDATA[%s]]></service_type>\n",channels[curr_channel].channel_type,service_type_to_str(channels[curr_channel].channel_type));
-		if (channels[curr_channel].portOut==0)
+		unicast_reply_write(reply, "\t<channel number=\"%d\" is_up=\"%d\">\n",curr_channel+1,channels[curr_channel]->streamed_channel);
+		unicast_reply_write(reply, "\t\t<lcn>%d</lcn>\n",channels[curr_channel]->logical_channel_number);
+		unicast_reply_write(reply, "\t\t<name><![CDATA[%s]]></name>\n",channels[curr_channel]->name);
+		unicast_reply_write(reply, "\t\t<service_type type=\"%d\"><![CDATA[%s]]></service_type>\n",channels[curr_channel]->channel_type,service_type_to_str(channels[curr_channel]->channel_type));
+		if (channels[curr_channel]->portOut==0)
 			unicast_reply_write(reply, "\t\t<ip_multicast><![CDATA[0.0.0.0]]></ip_multicast>\n");
 		else
-			unicast_reply_write(reply, "\t\t<ip_multicast><![CDATA[%s]]></ip_multicast>\n",channels[curr_channel].ip4Out);
-		unicast_reply_write(reply, "\t\t<port_multicast>%d</port_multicast>\n",channels[curr_channel].portOut);
-		unicast_reply_write(reply, "\t\t<traffic>%.0f</traffic>\n",channels[curr_channel].traffic);
-		unicast_reply_write(reply, "\t\t<ratio_scrambled>%d</ratio_scrambled>\n",channels[curr_channel].ratio_scrambled);
-		unicast_reply_write(reply, "\t\t<service_id>%d</service_id>\n",channels[curr_channel].service_id);
-		unicast_reply_write(reply, "\t\t<pmt_pid>%d</pmt_pid>\n",channels[curr_channel].pmt_pid);
-		unicast_reply_write(reply, "\t\t<pmt_version>%d</pmt_version>\n",channels[curr_channel].pmt_version);
-		unicast_reply_write(reply, "\t\t<pcr_pid>%d</pcr_pid>\n",channels[curr_channel].pcr_pid);
-		unicast_reply_write(reply, "\t\t<unicast_port>%d</unicast_port>\n",channels[curr_channel].unicast_port);
+			unicast_reply_write(reply, "\t\t<ip_multicast><![CDATA[%s]]></ip_multicast>\n",channels[curr_channel]->desc->ip4Out);
+		unicast_reply_write(reply, "\t\t<port_multicast>%d</port_multicast>\n",channels[curr_channel]->portOut);
+		unicast_reply_write(reply, "\t\t<traffic>%.0f</traffic>\n",channels[curr_channel]->traffic);
+		unicast_reply_write(reply, "\t\t<ratio_scrambled>%d</ratio_scrambled>\n",channels[curr_channel]->ratio_scrambled);
+		unicast_reply_write(reply, "\t\t<service_id>%d</service_id>\n",channels[curr_channel]->service_id);
+		unicast_reply_write(reply, "\t\t<pmt_pid>%d</pmt_pid>\n",channels[curr_channel]->pmt_pid);
+		unicast_reply_write(reply, "\t\t<pmt_version>%d</pmt_version>\n",channels[curr_channel]->pmt_version);
+		unicast_reply_write(reply, "\t\t<autoconf_latency>%d</autoconf_latency>\n",channels[curr_channel]->desc->autoconf_latency);
+		pacing_get_stats(channels[curr_channel], &jitter_avg, &jitter_max);
+		unicast_reply_write(reply, "\t\t<pacing_jitter>%d</pacing_jitter>\n",jitter_avg);
+		unicast_reply_write(reply, "\t\t<pacing_jitter_max>%d</pacing_jitter_max>\n",jitter_max);
+		unicast_reply_write(reply, "\t\t<timeshift>%d</timeshift>\n",timeshift_get_duration(channels[curr_channel]));
+		unicast_reply_write(reply, "\t\t<pcr_pid>%d</pcr_pid>\n",channels[curr_channel]->pcr_pid);
+		unicast_reply_write(reply, "\t\t<unicast_port>%d</unicast_port>\n",channels[curr_channel]->unicast_port);
 		// SCAM information
 #ifdef ENABLE_SCAM_SUPPORT
 		if (scam_vars->scam_support) {
-			unicast_reply_write(reply, "\t\t<scam descrambled=\"%d\">\n",channels[curr_channel].scam_support);
+			unicast_reply_write(reply, "\t\t<scam descrambled=\"%d\">\n",channels[curr_channel]->scam_support);
 #ifdef ENABLE_SCAM_DESCRAMBLER_SUPPORT
-			if (channels[curr_channel].scam_support) {
+			if (channels[curr_channel]->scam_support) {
 				unsigned int ring_buffer_num_packets = 0;
 
-				if (channels[curr_channel].ring_buf) {
-					pthread_mutex_lock(&channels[curr_channel].ring_buf->lock);
-					ring_buffer_num_packets = channels[curr_channel].ring_buf->to_descramble + channels[curr_channel].ring_buf->to_send;
-					pthread_mutex_unlock(&channels[curr_channel].ring_buf->lock);
+				if (channels[curr_channel]->ring_buf) {
+					pthread_mutex_lock(&channels[curr_channel]->ring_buf->lock);
+					ring_buffer_num_packets = channels[curr_channel]->ring_buf->to_descramble + channels[curr_channel]->ring_buf->to_send;
+					pthread_mutex_unlock(&channels[curr_channel]->ring_buf->lock);
 				}
 
-				unicast_reply_write(reply, "\t\t\t<ring_buffer_size>%u</ring_buffer_size>\n",channels[curr_channel].ring_buffer_size);
-				unicast_reply_write(reply, "\t\t\t<decsa_delay>%u</decsa_delay>\n",channels[curr_channel].decsa_delay);
-				unicast_reply_write(reply, "\t\t\t<send_delay>%u</send_delay>\n",channels[curr_channel].send_delay);
+				unicast_reply_write(reply, "\t\t\t<ring_buffer_size>%u</ring_buffer_size>\n",channels[curr_channel]->ring_buffer_size);
+				unicast_reply_write(reply, "\t\t\t<decsa_delay>%u</decsa_delay>\n",channels[curr_channel]->decsa_delay);
+				unicast_reply_write(reply, "\t\t\t<send_delay>%u</send_delay>\n",channels[curr_channel]->send_delay);
 				unicast_reply_write(reply, "\t\t\t<num_packets>%u</num_packets>\n",ring_buffer_num_packets);
 			}
 #endif
@@ -382,30 +428,64 @@ unicast_send_xml_state (unicast_parameters_t* unicast_vars, int number_of_channe
 #endif
 		unicast_reply_write(reply, "\t\t<ca_sys>\n");
 		for(int i=0;i<32;i++)
-			if(channels[curr_channel].ca_sys_id[i]!=0)
-				unicast_reply_write(reply, "\t\t\t<ca num=\"%d\"><![CDATA[%s]]></ca>\n",channels[curr_channel].ca_sys_id[i],ca_sys_id_to_str(channels[curr_channel].ca_sys_id[i]));
+			if(channels[curr_channel]->desc->ca_sys_id[i]!=0)
+				unicast_reply_write(reply, "\t\t\t<ca num=\"%d\"><![CDATA[%s]]></ca>\n",channels[curr_channel]->desc->ca_sys_id[i],ca_sys_id_to_str(channels[curr_channel]->desc->ca_sys_id[i]));
 		unicast_reply_write(reply, "\t\t</ca_sys>\n");
 		unicast_reply_write(reply, "\t\t<pids>\n");
-		for(int i=0;i<channels[curr_channel].num_pids;i++)
-			unicast_reply_write(reply, "\t\t\t<pid number=\"%d\" language=\"%s\" scrambled=\"%d\"><![CDATA[%s]]></pid>\n", channels[curr_channel].pids[i], channels[curr_channel].pids_language[i], channels[curr_channel].pids_scrambled[i], pid_type_to_str(channels[curr_channel].pids_type[i]));
+		for(int i=0;i<channels[curr_channel]->num_pids;i++)
+			unicast_reply_write(reply, "\t\t\t<pid number=\"%d\" language=\"%s\" scrambled=\"%d\"><![CDATA[%s]]></pid>\n", channels[curr_channel]->pids[i], channels[curr_channel]->desc->pids_language[i], channels[curr_channel]->desc->pids_scrambled[i], pid_type_to_str(channels[curr_channel]->desc->pids_type[i]));
 		unicast_reply_write(reply, "\t\t</pids>\n");
 		unicast_reply_write(reply, "\t</channel>\n");
 	}
 
 
+  //The list can be changed by the main thread when the monitor thread makes the snapshot
+  pthread_mutex_lock(&unicast_vars->clients_lock);
   unicast_reply_write(reply, "\t<users count=\"%d\">\n", (unicast_vars?unicast_vars->client_number:0));
-  unicast_client_t *client=unicast_vars->clients;
-  while(client!=NULL) {
-      unicast_reply_write(reply, "\t<user socket=\"%d\" ip=\"%s:%d\" asked_channel=\"%d\" sid=\"%d\" channel_name=\"%s\">\n", client->Socket, inet_ntoa(client->SocketAddr.sin_addr), client->SocketAddr.sin_port, client->askedChannel, (client->chan_ptr?client->chan_ptr->service_id:-1), (client->chan_ptr?client->chan_ptr->name:"NA"));
+  unicast_client_t *user=unicast_vars->clients;
+  while(user!=NULL) {
+      unicast_reply_write(reply, "\t<user socket=\"%d\" ip=\"%s:%d\" asked_channel=\"%d\" sid=\"%d\" channel_name=\"%s\" queue_bytes=\"%d\" dropped_packets=\"%ld\" drop_events=\"%d\">\n", user->Socket, inet_ntoa(user->SocketAddr.sin_addr), user->SocketAddr.sin_port, user->askedChannel, (user->chan_ptr?user->chan_ptr->service_id:-1), (user->chan_ptr?user->chan_ptr->name:"NA"), user->queue.data_bytes_in_queue, user->queue.dropped_packets, user->queue.drop_events);
       unicast_reply_write(reply, "\t</user>\n");
-      client=client->next;
+      user=user->next;
   }
   unicast_reply_write(reply, "\t</users>\n");
+  pthread_mutex_unlock(&unicast_vars->clients_lock);
+
+	// Recordings
+	unicast_reply_write(reply, "\t<recordings>\n");
+	recording_t *rec;
+	for(int i=0;(rec=record_get(i))!=NULL;i++)
+		unicast_reply_write(reply, "\t\t<recording name=\"%s\" file=\"%s\" written=\"%llu\" dropped=\"%llu\" buffer_max=\"%d\" write_errors=\"%d\" />\n",
+				rec->name, rec->current_file, (unsigned long long)rec->written, (unsigned long long)record_dropped(rec), rec->buffer_max, rec->write_errors);
+	unicast_reply_write(reply, "\t</recordings>\n");
 
 	// Ending XML content
 	unicast_reply_write(reply, "</mumudvb>\n");
+}
 
-	unicast_reply_send(reply, Socket, 200, "application/xml; charset=UTF-8");
+/** @brief Send a full XML state of the mumudvb instance
+ *
+ * @param number_of_channels the number of channels
+ * @param channels the channels array
+ * @param client the client to which the information have to be sent
+ * @param fds the frontend device structure
+ */
+int
+unicast_send_xml_state (unicast_parameters_t* unicast_vars, int number_of_channels, mumudvb_channel_t** channels, unicast_client_t *client, strength_parameters_t* strengthparams, auto_p_t* auto_p, void* cam_p_v, void* scam_vars_v)
+{
+	//The snapshot made by the monitor thread, if any
+	if(!unicast_snapshot_send(client, UNICAST_SNAPSHOT_STATE))
+		return 0;
+
+	// Prepare the HTTP reply
+	struct unicast_reply* reply = unicast_reply_init();
+	if (NULL == reply) {
+		log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
+		return -1;
+	}
+	unicast_render_xml_state(reply, unicast_vars, number_of_channels, channels, strengthparams, auto_p, cam_p_v, scam_vars_v);
+
+	unicast_reply_send(reply, client, 200, "application/xml; charset=UTF-8");
 
 	// End of HTTP reply
 	if (0 != unicast_reply_free(reply)) {
@@ -415,12 +495,113 @@ unicast_send_xml_state (unicast_parameters_t* unicast_vars, int number_of_channe
 	return 0;
 }
 
+/** @brief Make the snapshots of the monitoring pages
+ *
+ * Called by the monitor thread, without the channels lock : the table of the channels is a
+ * copy made under the lock, the fields are read as they are. The HTTP requests for these
+ * pages get the last snapshot instead of rendering the page.
+ */
+void unicast_snapshots_update(unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels, strength_parameters_t *strengthparams, auto_p_t *auto_p, void *cam_p, void *scam_vars)
+{
+	struct unicast_reply *reply;
+
+	reply=unicast_reply_init();
+	if(reply)
+	{
+		unicast_render_xml_state(reply, unicast_vars, number_of_channels, channels, strengthparams, auto_p, cam_p, scam_vars);
+		unicast_snapshot_publish(UNICAST_SNAPSHOT_STATE, reply);
+	}
+	reply=unicast_reply_init();
+	if(reply)
+	{
+		unicast_render_streamed_channels_list_js(reply, unicast_vars, number_of_channels, channels);
+		unicast_snapshot_publish(UNICAST_SNAPSHOT_CHANNELS_LIST, reply);
+	}
+	reply=unicast_reply_init();
+	if(reply)
+	{
+		unicast_render_channel_traffic_js(reply, number_of_channels, channels);
+		unicast_snapshot_publish(UNICAST_SNAPSHOT_TRAFFIC, reply);
+	}
+	reply=unicast_reply_init();
+	if(reply)
+	{
+		metrics_render(reply, unicast_vars, number_of_channels, channels);
+		unicast_snapshot_publish(UNICAST_SNAPSHOT_METRICS, reply);
+	}
+	reply=unicast_reply_init();
+	if(reply)
+	{
+		analyzer_render_json(reply, number_of_channels, channels);
+		unicast_snapshot_publish(UNICAST_SNAPSHOT_PIDS, reply);
+	}
+}
+
+/** @brief Send the performance metrics (Prometheus text format)
+ *
+ * @param unicast_vars the unicast parameters
+ * @param number_of_channels the number of channels
+ * @param channels the channels array
+ * @param client the client to which the information have to be sent
+ */
+int
+unicast_send_metrics (unicast_parameters_t *unicast_vars, int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client)
+{
+	//The snapshot made by the monitor thread, if any
+	if(!unicast_snapshot_send(client, UNICAST_SNAPSHOT_METRICS))
+		return 0;
+
+	struct unicast_reply* reply = unicast_reply_init();
+	if (NULL == reply) {
+		log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
+		return -1;
+	}
+	metrics_render(reply, unicast_vars, number_of_channels, channels);
+
+	unicast_reply_send(reply, client, 200, "text/plain; version=0.0.4; charset=utf-8");
+
+	if (0 != unicast_reply_free(reply)) {
+		log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
+		return -1;
+	}
+	return 0;
+}
+
+/** @brief Send the analysis of the PIDs of the transponder, json
+ *
+ * @param number_of_channels the number of channels
+ * @param channels the channels array
+ * @param client the client to which the information have to be sent
+ */
+int
+unicast_send_pids_js (int number_of_channels, mumudvb_channel_t **channels, unicast_client_t *client)
+{
+	//The snapshot made by the monitor thread, if any
+	if(!unicast_snapshot_send(client, UNICAST_SNAPSHOT_PIDS))
+		return 0;
+
+	struct unicast_reply* reply = unicast_reply_init();
+	if (NULL == reply) {
+		log_message( log_module, MSG_INFO,"Error when creating the HTTP reply\n");
+		return -1;
+	}
+	analyzer_render_json(reply, number_of_channels, channels);
+
+	unicast_reply_send(reply, client, 200, "application/json");
+
+	if (0 != unicast_reply_free(reply)) {
+		log_message( log_module, MSG_INFO,"Error when releasing the HTTP reply after sendinf it\n");
+		return -1;
+	}
+	return 0;
+}
+
 /** @brief Return the last MMI menu sent by CAM
  *
- * @param Socket the socket on wich the information have to be sent
+ * @param client the client to which the information have to be sent
  */
 int
-unicast_send_cam_menu (int Socket, void *cam_p_v)
+unicast_send_cam_menu (unicast_client_t *client, void *cam_p_v)
 {
 #ifndef ENABLE_CAM_SUPPORT
 	(void) cam_p_v; //to make compiler happy
@@ -489,7 +670,7 @@ unicast_send_cam_menu (int Socket, void *cam_p_v)
 		if ((c<32 || c>127) && c!=9 && c!=10 && c!=13)
 			reply->buffer_body[j]=32;
 	}
-	unicast_reply_send(reply, Socket, 200, "application/xml; charset=UTF-8");
+	unicast_reply_send(reply, client, 200, "application/xml; charset=UTF-8");
 
 	// End of HTTP reply
 	if (0 != unicast_reply_free(reply)) {
@@ -501,10 +682,10 @@ unicast_send_cam_menu (int Socket, void *cam_p_v)
 
 /** @brief Send an action to the CAM MMI menu
  *
- * @param Socket the socket on wich the information have to be sent
+ * @param client the client to which the information have to be sent
  */
 int
-unicast_send_cam_action (int Socket, char *Key, void *cam_p_v)
+unicast_send_cam_action (unicast_client_t *client, char *Key, void *cam_p_v)
 {
 #ifndef ENABLE_CAM_SUPPORT
 	(void) cam_p_v; //to make compiler happy
@@ -610,7 +791,7 @@ unicast_send_cam_action (int Socket, char *Key, void *cam_p_v)
 		if ((c<32 || c>127) && c!=9 && c!=10 && c!=13)
 			reply->buffer_body[j]=32;
 	}
-	unicast_reply_send(reply, Socket, 200, "application/xml; charset=UTF-8");
+	unicast_reply_send(reply, client, 200, "application/xml; charset=UTF-8");
 
 	// End of HTTP reply
 	if (0 != unicast_reply_free(reply)) {
@@ -28,13 +28,19 @@
  * @date 2009-2010
  */
 
+#define _GNU_SOURCE		//for splice and tee
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/time.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
 #include "unicast_http.h"
 #include "unicast_queue.h"
+#include "timeshift.h"
+#include "stats_shm.h"
+#include "metrics.h"
+#include "probes.h"
 #include "mumudvb.h"
 #include "errors.h"
 #include "log.h"
@@ -42,10 +48,490 @@
 static char *log_module="Unicast : ";
 
 int unicast_queue_remove_data(unicast_queue_header_t *header);
+void unicast_queue_consume_data(unicast_queue_header_t *header, int len);
 int unicast_queue_add_data(unicast_queue_header_t *header, unsigned char *data, int data_len);
 unsigned char *unicast_queue_get_data(unicast_queue_header_t* , int* );
 void unicast_close_connection(unicast_parameters_t *unicast_vars, fds_t *fds, int Socket);
 
+/* ================= OVERLOAD ======================*/
+/* The queue of a client is limited in bytes (queue_max_size) or in time of stream
+ * (unicast_queue_max_time, with the bitrate of the channel). When a client is too slow, whole
+ * TS packets are dropped so the stream stays aligned : first the packets which are not
+ * video, audio or PSI, then everything until the queue is short enough and the video reaches
+ * a random access point.
+ */
+
+/** @brief The size limit of the queue of a client (bytes) */
+static int unicast_queue_limit(mumudvb_channel_t *channel, unicast_parameters_t *unicast_vars)
+{
+	int limit;
+	if(unicast_vars->queue_max_time<=0 || channel->traffic<=0)
+		return unicast_vars->queue_max_size;
+	limit=(int)(channel->traffic*unicast_vars->queue_max_time); //kB/s * ms = bytes
+	if(limit<UNICAST_QUEUE_MIN_SIZE)
+		limit=UNICAST_QUEUE_MIN_SIZE;
+	return limit;
+}
+
+static int unicast_pid_is_video(int type)
+{
+	return type>=PID_VIDEO_MPEG1 && type<=PID_VIDEO_MPEG4_AVC;
+}
+
+/** @brief The type of a PID of the channel, -1 if the PID is not in the channel */
+static int unicast_pid_type(mumudvb_channel_t *channel, int pid)
+{
+	int i;
+	for(i=0;i<channel->num_pids;i++)
+		if(channel->pids[i]==pid)
+			return channel->desc->pids_type[i];
+	return -1;
+}
+
+/** @brief Tell if the random_access_indicator of the adaptation field is set */
+static int unicast_packet_rai(unsigned char *ts_packet)
+{
+	return (ts_packet[3]&0x20) && ts_packet[4] && (ts_packet[5]&0x40);
+}
+
+/** @brief Tell if the channel has a PID known as video (autoconfiguration) */
+static int unicast_channel_video_known(mumudvb_channel_t *channel)
+{
+	int i;
+	for(i=0;i<channel->num_pids;i++)
+		if(unicast_pid_is_video(channel->desc->pids_type[i]))
+			return 1;
+	return 0;
+}
+
+/** @brief Tell if a packet is still sent to a client whose queue is getting long */
+static int unicast_packet_is_essential(mumudvb_channel_t *channel, int pid, int type)
+{
+	if(pid==0 || pid==channel->pmt_pid || pid==channel->pcr_pid)
+		return 1;
+	//Without autoconfiguration the type of the PIDs is unknown, they are kept
+	return type==PID_UNKNOW || type==PID_PMT || type==PID_PCR ||
+			unicast_pid_is_video(type) ||
+			(type>=PID_AUDIO_MPEG1 && type<=PID_AUDIO_AAC);
+}
+
+/** @brief Queue data for a client, whole packets are dropped when the queue is too long
+ * Not static for the testing program
+ *
+ * @param client the client
+ * @param channel the channel of the client
+ * @param unicast_vars the unicast parameters
+ * @param data the data, whole TS packets, after the end of a packet partly written if any
+ * @param data_len the length of the data
+ */
+void unicast_client_queue_data(unicast_client_t *client, mumudvb_channel_t *channel, unicast_parameters_t *unicast_vars, unsigned char *data, int data_len)
+{
+	unicast_queue_header_t *queue=&client->queue;
+	unsigned char kept[MAX_UDP_SIZE_JUMBO];
+	int kept_len=0;
+	int limit,queued,pos,pid,type,partial;
+	int video_known=0;
+	int resync_timeout=0;
+	unsigned char *ts_packet;
+
+	//The client got the beginning of this packet, its end is always queued
+	partial=data_len%TS_PACKET_SIZE;
+	if(partial)
+	{
+		unicast_queue_add_data(queue, data, partial);
+		data+=partial;
+		data_len-=partial;
+		if(!data_len)
+			return;
+	}
+	limit=unicast_queue_limit(channel, unicast_vars);
+	queued=queue->data_bytes_in_queue;
+	//Usual case, everything is queued
+	if(queue->drop_state==UNICAST_DROP_NONE && queued+data_len<=limit*UNICAST_QUEUE_SOFT_LIMIT/100)
+	{
+		unicast_queue_add_data(queue, data, data_len);
+		MUMUDVB_PROBE3(queue_add, client->Socket, data_len, queue->data_bytes_in_queue);
+		return;
+	}
+	if(queue->drop_state==UNICAST_DROP_FULL && queued<=limit*UNICAST_QUEUE_RESUME/100)
+		queue->drop_state=UNICAST_DROP_WAIT_RAP;
+	if(queue->drop_state==UNICAST_DROP_WAIT_RAP)
+	{
+		video_known=unicast_channel_video_known(channel);
+		resync_timeout=(get_time()-queue->drop_start)>UNICAST_RESYNC_TIMEOUT*1000ULL;
+	}
+
+	for(pos=0;pos<data_len;pos+=TS_PACKET_SIZE)
+	{
+		//The packets kept are queued by blocks
+		if(kept_len+TS_PACKET_SIZE>(int)sizeof(kept))
+		{
+			unicast_queue_add_data(queue, kept, kept_len);
+			MUMUDVB_PROBE3(queue_add, client->Socket, kept_len, queue->data_bytes_in_queue);
+			queued+=kept_len;
+			kept_len=0;
+		}
+		ts_packet=data+pos;
+		pid=((ts_packet[1] & 0x1f) << 8) | (ts_packet[2]);
+		type=unicast_pid_type(channel, pid);
+		if(queue->drop_state==UNICAST_DROP_WAIT_RAP && (unicast_pid_is_video(type) || !video_known))
+		{
+			//random_access_indicator in the adaptation field, or a payload unit start if the stream does not set it
+			if(unicast_packet_rai(ts_packet) ||
+					(resync_timeout && (ts_packet[1]&0x40)))
+			{
+				queue->drop_state=UNICAST_DROP_NONE;
+				log_message( log_module, MSG_DETAIL,"Client %s:%d : the stream starts again, %ld packets dropped\n",
+						inet_ntoa(client->SocketAddr.sin_addr),
+						client->SocketAddr.sin_port,
+						queue->dropped_packets);
+			}
+		}
+		if(queue->drop_state==UNICAST_DROP_NONE)
+		{
+			if(queued+kept_len+TS_PACKET_SIZE>limit)
+			{
+				queue->drop_state=UNICAST_DROP_FULL;
+				queue->drop_start=get_time();
+				queue->drop_events++;
+				MUMUDVB_PROBE2(queue_full, client->Socket, queued+kept_len);
+				log_message( log_module, MSG_DETAIL,"The queue is full, we now throw away new packets for client %s:%d\n",
+						inet_ntoa(client->SocketAddr.sin_addr),
+						client->SocketAddr.sin_port);
+			}
+			else if(queued+kept_len+TS_PACKET_SIZE<=limit*UNICAST_QUEUE_SOFT_LIMIT/100 ||
+					unicast_packet_is_essential(channel, pid, type))
+			{
+				memcpy(kept+kept_len, ts_packet, TS_PACKET_SIZE);
+				kept_len+=TS_PACKET_SIZE;
+				continue;
+			}
+		}
+		queue->dropped_packets++;
+		channel->unicast_dropped_packets++;
+		MUMUDVB_PROBE2(queue_drop, client->Socket, pid);
+	}
+	if(kept_len)
+	{
+		unicast_queue_add_data(queue, kept, kept_len);
+		MUMUDVB_PROBE3(queue_add, client->Socket, kept_len, queue->data_bytes_in_queue);
+	}
+}
+
+/* ================= FAST START ======================*/
+/* With the option unicast_fast_start each channel keeps its last PAT, its last PMT and the
+ * stream since the last random access point of the video. A new client gets them before the
+ * live stream so its player can start without waiting for the next tables and keyframe.
+ */
+
+/** @brief Keep the packets of a PSI table from its last payload unit start */
+static void unicast_cache_psi_add(unicast_cache_psi_t *psi, unsigned char *ts_packet)
+{
+	int b=psi->building;
+	if(ts_packet[1]&0x40)
+	{
+		//New table, the one being filled is complete
+		if(psi->len[b])
+		{
+			b=psi->building=!b;
+			psi->len[b]=0;
+		}
+	}
+	else if(!psi->len[b])
+		return; //we wait for the beginning of the table
+	if(psi->len[b]+TS_PACKET_SIZE>UNICAST_CACHE_PSI_LEN)
+		return;
+	memcpy(psi->data[b]+psi->len[b], ts_packet, TS_PACKET_SIZE);
+	psi->len[b]+=TS_PACKET_SIZE;
+}
+
+/** @brief Keep a packet of the stream since the last random access point
+ * @return -1 if the stream since the random access point is too long to be kept
+ */
+static int unicast_cache_gop_add(unicast_cache_t *cache, unsigned char *ts_packet)
+{
+	unsigned char *gop;
+	int size;
+	if(cache->gop_len<0)
+		cache->gop_len=0;
+	if(cache->gop_len+TS_PACKET_SIZE>cache->gop_size)
+	{
+		size=cache->gop_size?cache->gop_size*2:UNICAST_CACHE_GOP_MIN;
+		if(size>UNICAST_CACHE_GOP_MAX)
+			return -1;
+		gop=realloc(cache->gop, size);
+		if(gop==NULL)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			return -1;
+		}
+		cache->gop=gop;
+		cache->gop_size=size;
+	}
+	memcpy(cache->gop+cache->gop_len, ts_packet, TS_PACKET_SIZE);
+	cache->gop_len+=TS_PACKET_SIZE;
+	return 0;
+}
+
+/** @brief Add the datagram of the channel to its fast start cache
+ * Called for each datagram sent, by the thread sending the channel, the data of the channel is in channel->datagram->buf
+ */
+void unicast_cache_add(mumudvb_channel_t *channel)
+{
+	unicast_cache_t *cache=channel->unicast_cache;
+	unsigned char *ts_packet;
+	int pos,pid,type,video_known;
+
+	if(channel->full_ts)
+		return;
+	if(cache==NULL)
+	{
+		cache=calloc(1,sizeof(unicast_cache_t));
+		if(cache==NULL)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			return;
+		}
+		pthread_mutex_init(&cache->lock,NULL);
+		//The main thread reads the pointer for the new clients
+		__atomic_store_n(&channel->unicast_cache, cache, __ATOMIC_RELEASE);
+	}
+	video_known=unicast_channel_video_known(channel);
+	pthread_mutex_lock(&cache->lock);
+	for(pos=0;pos+TS_PACKET_SIZE<=channel->nb_bytes;pos+=TS_PACKET_SIZE)
+	{
+		ts_packet=channel->datagram->buf+pos;
+		pid=((ts_packet[1] & 0x1f) << 8) | (ts_packet[2]);
+		if(pid==0)
+			unicast_cache_psi_add(&cache->pat, ts_packet);
+		else if(pid==channel->pmt_pid)
+			unicast_cache_psi_add(&cache->pmt, ts_packet);
+		if(unicast_packet_rai(ts_packet))
+		{
+			type=unicast_pid_type(channel, pid);
+			//A new random access point, the cache starts again here
+			if(unicast_pid_is_video(type) || !video_known)
+				cache->gop_len=-1;
+		}
+		if(cache->gop_len && unicast_cache_gop_add(cache, ts_packet))
+			cache->gop_len=0;
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/** @brief Send the fast start cache of the channel to a new client
+ * What cannot be sent now is queued by parts of whole packets, the live stream will follow it.
+ * The stream since the random access point is sent only if it fits in the queue of the client
+ * with room left for the live stream (UNICAST_QUEUE_SOFT_LIMIT), the PAT and PMT are always sent.
+ * Called by the main thread
+ */
+void unicast_cache_send(unicast_client_t *client, mumudvb_channel_t *channel, unicast_parameters_t *unicast_vars)
+{
+	unicast_cache_t *cache=__atomic_load_n(&channel->unicast_cache, __ATOMIC_ACQUIRE);
+	unsigned char *parts[3];
+	int lens[3];
+	int i,ret,sent,len,budget;
+
+	if(cache==NULL)
+		return;
+	pthread_mutex_lock(&cache->lock);
+	parts[0]=cache->pat.data[!cache->pat.building];
+	lens[0]=cache->pat.len[!cache->pat.building];
+	parts[1]=cache->pmt.data[!cache->pmt.building];
+	lens[1]=cache->pmt.len[!cache->pmt.building];
+	parts[2]=cache->gop;
+	lens[2]=cache->gop_len>0?cache->gop_len:0;
+	budget=unicast_queue_limit(channel, unicast_vars)*UNICAST_QUEUE_SOFT_LIMIT/100-client->queue.data_bytes_in_queue-lens[0]-lens[1];
+	if(lens[2]>budget)
+	{
+		log_message( log_module, MSG_DEBUG,"Fast start : the stream since the last random access point (%d bytes) doesn't fit in the queue of the client, only the PSI is sent\n",
+				lens[2]);
+		lens[2]=0;
+	}
+	log_message( log_module, MSG_DEBUG,"Fast start for client %s:%d : %d bytes of PSI, %d bytes since the last random access point\n",
+			inet_ntoa(client->SocketAddr.sin_addr),
+			client->SocketAddr.sin_port,
+			lens[0]+lens[1], lens[2]);
+	for(i=0;i<3;i++)
+	{
+		if(!lens[i])
+			continue;
+		sent=0;
+		if(!client->queue.packets_in_queue)
+		{
+			ret=send(client->Socket, parts[i], lens[i], MSG_NOSIGNAL|MSG_DONTWAIT);
+			if(ret>0)
+				sent=ret;
+		}
+		//Queued by small parts, a partial send moves only the beginning of the first one
+		for(;sent<lens[i];sent+=len)
+		{
+			len=lens[i]-sent;
+			if(len>UNICAST_CACHE_CHUNK)
+				len=UNICAST_CACHE_CHUNK-sent%TS_PACKET_SIZE;
+			if(unicast_queue_add_data(&client->queue, parts[i]+sent, len))
+				break;
+		}
+	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/** @brief Free the fast start cache of a channel */
+void unicast_cache_free(mumudvb_channel_t *channel)
+{
+	if(channel->unicast_cache==NULL)
+		return;
+	if(channel->unicast_cache->gop)
+		free(channel->unicast_cache->gop);
+	pthread_mutex_destroy(&channel->unicast_cache->lock);
+	free(channel->unicast_cache);
+	channel->unicast_cache=NULL;
+}
+
+/* ================= ZERO COPY ======================*/
+/* With the option unicast_zerocopy the data of a channel is written once in a pipe,
+ * duplicated without copy (tee) in a pipe per client and moved to the client socket (splice).
+ * The client pipe is the first part of the queue of the client : when it is full, the data
+ * goes to the usual queue, which is sent when the pipe is empty again.
+ */
+
+/** @brief Write the data of the channel in its pipe
+ * The data is written by parts of whole packets fitting in a page, so a pipe buffer
+ * contains only whole packets (tee gives whole pipe buffers)
+ * @return 0 if the data is in the pipe
+ */
+static int unicast_channel_pipe_fill(mumudvb_channel_t *channel)
+{
+	int pos,len;
+	if(!channel->unicast_pipe_open)
+	{
+		if(pipe2(channel->unicast_pipe, O_NONBLOCK)<0)
+		{
+			log_message( log_module, MSG_WARN,"Cannot create the pipe of the channel \"%s\" : %s, the data is copied for each client\n", channel->name, strerror(errno));
+			return -1;
+		}
+		channel->unicast_pipe_open=1;
+	}
+	for(pos=0;pos<channel->nb_bytes;pos+=len)
+	{
+		len=channel->nb_bytes-pos;
+		if(len>UNICAST_PIPE_CHUNK)
+			len=UNICAST_PIPE_CHUNK;
+		if(write(channel->unicast_pipe[1], channel->datagram->buf+pos, len)!=len)
+		{
+			log_message( log_module, MSG_DEBUG,"Write to the pipe of the channel \"%s\" failed : %s\n", channel->name, strerror(errno));
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/** @brief Empty the pipe of the channel once all the clients have their copy */
+static void unicast_channel_pipe_drain(mumudvb_channel_t *channel, unicast_parameters_t *unicast_vars)
+{
+	int ret;
+	if(unicast_vars->null_fd<0)
+		unicast_vars->null_fd=open("/dev/null", O_WRONLY);
+	do
+		ret=splice(channel->unicast_pipe[0], NULL, unicast_vars->null_fd, NULL, MAX_UDP_SIZE_JUMBO, SPLICE_F_NONBLOCK|SPLICE_F_MOVE);
+	while(ret>0);
+}
+
+/** @brief Move the data waiting in the client pipe to the socket
+ * @return the number of bytes moved, -1 if the connection is broken
+ */
+static int unicast_client_pipe_flush(unicast_client_t *client)
+{
+	int ret;
+	int moved=0;
+	while(client->pipe_bytes)
+	{
+		ret=splice(client->pipe[0], NULL, client->Socket, NULL, client->pipe_bytes, SPLICE_F_NONBLOCK|SPLICE_F_MOVE);
+		if(ret<0 && errno!=EAGAIN)
+			return -1;
+		if(ret<=0)
+			break;
+		client->pipe_bytes-=ret;
+		moved+=ret;
+	}
+	return moved;
+}
+
+/** @brief Follow a client which is not served by the usual send path
+ *
+ * Like a send error on the usual path, a client whose data does not move starts the
+ * consecutive errors timer, the client is disconnected when it lasts more than unicast_consecutive_errors_timeout
+ *
+ * @param progress some data reached the socket of the client
+ * @return 1 if the client has to be disconnected
+ */
+static int unicast_client_stalled(unicast_client_t *client, unicast_parameters_t *unicast_vars, int progress)
+{
+	struct timeval tv;
+	if(progress)
+	{
+		client->consecutive_errors=0;
+		return 0;
+	}
+	gettimeofday (&tv, (struct timezone *) NULL);
+	if(!client->consecutive_errors)
+	{
+		client->first_error_time = tv.tv_sec;
+		client->consecutive_errors=1;
+		return 0;
+	}
+	return (unicast_vars->consecutive_errors_timeout > 0) && (tv.tv_sec - client->first_error_time) > unicast_vars->consecutive_errors_timeout;
+}
+
+/** @brief Give the data of the channel to a client without copying it
+ * @param channel_pipe_ok the data is in the channel pipe, otherwise it can only be queued
+ * @return 1 if the data was handled, 0 if the usual path has to send it (queue), -1 if the connection is broken, -2 if the client stalled
+ */
+static int unicast_client_splice(mumudvb_channel_t *channel, unicast_client_t *client, unicast_parameters_t *unicast_vars, int channel_pipe_ok)
+{
+	int ret;
+	int moved;
+	if(client->pipe[0]<0)
+	{
+		if(!channel_pipe_ok)
+			return 0;
+		if(pipe2(client->pipe, O_NONBLOCK)<0)
+		{
+			log_message( log_module, MSG_DEBUG,"Cannot create the pipe of the client : %s\n", strerror(errno));
+			client->pipe[0]=client->pipe[1]=-1;
+			return 0;
+		}
+		//The pipe is the first part of the queue, it is not a problem if it cannot be enlarged
+		fcntl(client->pipe[1], F_SETPIPE_SZ, unicast_vars->queue_max_size);
+	}
+	moved=unicast_client_pipe_flush(client);
+	if(moved<0)
+		return -1;
+	if(client->queue.packets_in_queue)
+	{
+		//The pipe is empty, the usual path sends the queue
+		if(!client->pipe_bytes)
+			return 0;
+		//The data follows the queue
+		unicast_client_queue_data(client, channel, unicast_vars, channel->datagram->buf, channel->nb_bytes);
+		return unicast_client_stalled(client, unicast_vars, moved) ? -2 : 1;
+	}
+	ret=0;
+	if(channel_pipe_ok)
+		ret=tee(channel->unicast_pipe[0], client->pipe[1], channel->nb_bytes, SPLICE_F_NONBLOCK);
+	if(ret<0)
+		ret=0;
+	client->pipe_bytes+=ret;
+	//The pipe is full : the rest is queued
+	if(ret<channel->nb_bytes)
+		unicast_client_queue_data(client, channel, unicast_vars, channel->datagram->buf+ret, channel->nb_bytes-ret);
+	ret=unicast_client_pipe_flush(client);
+	if(ret<0)
+		return -1;
+	//Nothing waiting for the socket is progress as well
+	return unicast_client_stalled(client, unicast_vars, moved+ret || !client->pipe_bytes) ? -2 : 1;
+}
+
 /** @brief Send the buffer for the channel
  *
  * This function is called when a buffer for a channel is full and have to be sent to the clients
@@ -62,31 +548,79 @@ void unicast_data_send(mumudvb_channel_t *actual_channel, fds_t *fds, unicast_pa
 		int buffer_len;
 		int data_from_queue;
 		int packets_left;
+		int flags;
 		struct timeval tv;
+		int zerocopy=0;
+		int iRet;
+
+		//Zero copy : the data is copied once in the pipe of the channel
+		if(unicast_vars->zerocopy && !unicast_channel_pipe_fill(actual_channel))
+			zerocopy=1;
 
 		actual_client=actual_channel->clients;
 		while(actual_client!=NULL)
 		{
-			buffer=actual_channel->buf;
-			buffer_len=actual_channel->nb_bytes;
-			data_from_queue=0;
-			if(actual_client->queue.packets_in_queue!=0)
+			stats_shm_client_update(actual_client);
+			if(unicast_vars->tcp_tuning)
+				unicast_client_tcp_tune(unicast_vars, actual_client, actual_channel);
+			//Timeshift : the client gets the data from the ring (it contains this datagram) until it reaches the live stream
+			if(actual_client->timeshifting)
 			{
-				//already some packets in the queue we enqueue the new one and try to send the queued ones
-				data_from_queue=1;
-				packets_left=UNICAST_MULTIPLE_QUEUE_SEND;
-				if((actual_client->queue.data_bytes_in_queue+buffer_len)< unicast_vars->queue_max_size)
-					unicast_queue_add_data(&actual_client->queue, buffer, buffer_len );
-				else
+				temp_client=actual_client->chan_next;
+				iRet=timeshift_client_send(actual_client, actual_channel);
+				if(iRet<0)
+				{
+					log_message( log_module, MSG_INFO,"Error when writing to client %s:%d : %s, we disconnect\n",
+							inet_ntoa(actual_client->SocketAddr.sin_addr),
+							actual_client->SocketAddr.sin_port,
+							strerror(errno));
+					unicast_close_connection(unicast_vars,fds,actual_client->Socket);
+				}
+				else if(unicast_client_stalled(actual_client, unicast_vars, iRet || !actual_client->timeshifting))
+				{
+					log_message( log_module, MSG_INFO,"Consecutive errors when writing to client %s:%d during too much time, we disconnect\n",
+							inet_ntoa(actual_client->SocketAddr.sin_addr),
+							actual_client->SocketAddr.sin_port);
+					unicast_close_connection(unicast_vars,fds,actual_client->Socket);
+				}
+				actual_client=temp_client;
+				continue;
+			}
+			//A client with a pipe stays on this path : its data has to follow the data in the pipe
+			if(zerocopy || actual_client->pipe[0]>=0)
+			{
+				iRet=unicast_client_splice(actual_channel, actual_client, unicast_vars, zerocopy);
+				if(iRet)
 				{
-					if(!actual_client->queue.full)
+					temp_client=actual_client->chan_next;
+					if(iRet==-2)
 					{
-						actual_client->queue.full=1;
-						log_message( log_module, MSG_DETAIL,"The queue is full, we now throw away new packets for client %s:%d\n",
+						log_message( log_module, MSG_INFO,"Consecutive errors when writing to client %s:%d during too much time, we disconnect\n",
 								inet_ntoa(actual_client->SocketAddr.sin_addr),
 								actual_client->SocketAddr.sin_port);
+						unicast_close_connection(unicast_vars,fds,actual_client->Socket);
+					}
+					else if(iRet<0)
+					{
+						log_message( log_module, MSG_INFO,"Error when writing to client %s:%d : %s, we disconnect\n",
+								inet_ntoa(actual_client->SocketAddr.sin_addr),
+								actual_client->SocketAddr.sin_port,
+								strerror(errno));
+						unicast_close_connection(unicast_vars,fds,actual_client->Socket);
 					}
+					actual_client=temp_client;
+					continue;
 				}
+			}
+			buffer=actual_channel->datagram->buf;
+			buffer_len=actual_channel->nb_bytes;
+			data_from_queue=0;
+			if(actual_client->queue.packets_in_queue!=0)
+			{
+				//already some packets in the queue we enqueue the new one and try to send the queued ones
+				data_from_queue=1;
+				packets_left=UNICAST_MULTIPLE_QUEUE_SEND;
+				unicast_client_queue_data(actual_client, actual_channel, unicast_vars, buffer, buffer_len);
 				buffer=unicast_queue_get_data(&actual_client->queue, &buffer_len);
 			}
 			else
@@ -94,8 +628,11 @@ void unicast_data_send(mumudvb_channel_t *actual_channel, fds_t *fds, unicast_pa
 
 			while(packets_left>0)
 			{
-				//we send the data
-				written_len=send(actual_client->Socket,buffer, buffer_len,MSG_NOSIGNAL);
+				//we send the data, corked while the queue gives more data in this batch : full segments and the end pushed by the last send
+				flags=MSG_NOSIGNAL;
+				if(unicast_vars->tcp_cork && data_from_queue && packets_left>1 && actual_client->queue.packets_in_queue>1)
+					flags|=MSG_MORE;
+				written_len=send(actual_client->Socket,buffer, buffer_len,flags);
 				//We check if all the data was successfully written
 				if(written_len<buffer_len)
 				{
@@ -110,8 +647,8 @@ void unicast_data_send(mumudvb_channel_t *actual_channel, fds_t *fds, unicast_pa
 									actual_client->SocketAddr.sin_port,
 									strerror(errno));
 							actual_client->last_write_error=errno;
-							written_len=0;
 						}
+						written_len=0;
 					}
 					else
 					{
@@ -126,17 +663,14 @@ void unicast_data_send(mumudvb_channel_t *actual_channel, fds_t *fds, unicast_pa
 						//No drop on eagain or no eagain
 						if(!data_from_queue)
 						{
-							//We store the non sent data in the queue
-							if((actual_client->queue.data_bytes_in_queue+buffer_len-written_len)< unicast_vars->queue_max_size)
-							{
-								unicast_queue_add_data(&actual_client->queue, buffer+written_len, buffer_len-written_len);
-								log_message( log_module, MSG_DEBUG,"We start queuing packets ... \n");
-							}
+							//We store the non sent data in the queue, the end of a partially sent packet is always kept
+							unicast_client_queue_data(actual_client, actual_channel, unicast_vars, buffer+written_len, buffer_len-written_len);
+							log_message( log_module, MSG_DEBUG,"We start queuing packets ... \n");
 						}
 						else if(written_len > 0)
 						{
-							unicast_queue_remove_data(&actual_client->queue);
-							unicast_queue_add_data(&actual_client->queue, buffer+written_len, buffer_len-written_len);
+							//The non sent data stays at the head of the queue
+							unicast_queue_consume_data(&actual_client->queue, written_len);
 							log_message( log_module, MSG_DEBUG,"We requeue the non sent data ... \n");
 						}
 					}else{
@@ -197,7 +731,10 @@ void unicast_data_send(mumudvb_channel_t *actual_channel, fds_t *fds, unicast_pa
 					if(data_from_queue)
 					{
 						//The data was successfully sent, we can dequeue it
+						if(actual_client->queue.first->queued_time)
+							metrics_stage(METRICS_STAGE_UNICAST_QUEUE, actual_client->queue.first->queued_time, get_time());
 						unicast_queue_remove_data(&actual_client->queue);
+						MUMUDVB_PROBE3(queue_drain, actual_client->Socket, buffer_len, actual_client->queue.data_bytes_in_queue);
 						if(actual_client->queue.packets_in_queue!=0)
 						{
 							//log_message( log_module, MSG_DEBUG,"Still packets in the queue,next one\n");
@@ -219,6 +756,8 @@ void unicast_data_send(mumudvb_channel_t *actual_channel, fds_t *fds, unicast_pa
 			if(actual_client) //Can be null if the client was destroyed
 				actual_client=actual_client->chan_next;
 		}
+		if(actual_channel->unicast_pipe_open)
+			unicast_channel_pipe_drain(actual_channel, unicast_vars);
 	}
 
 }
@@ -267,6 +806,7 @@ int unicast_queue_add_data(unicast_queue_header_t *header, unsigned char *data,
 	}
 	memcpy(dest->data,data,data_len);
 	dest->data_length=data_len;
+	dest->queued_time=metrics_enabled()?get_time():0;
 	header->packets_in_queue++;
 	header->data_bytes_in_queue+=data_len;
 	//log_message( log_module, MSG_DEBUG,"queuing new packet. Packets in queue: %d. Bytes in queue: %d\n",header->packets_in_queue,header->data_bytes_in_queue);
@@ -303,13 +843,28 @@ int unicast_queue_remove_data(unicast_queue_header_t *header)
 	tobedeleted=header->first;
 	header->first=header->first->next;
 	header->packets_in_queue--;
-	header->full=0;
 	header->data_bytes_in_queue-=tobedeleted->data_length;
 	free(tobedeleted->data);
 	free(tobedeleted);
 	return 0;
 }
 
+/** @brief Remove the beginning of the first packet of the queue (partially sent)
+ *
+ */
+void unicast_queue_consume_data(unicast_queue_header_t *header, int len)
+{
+	unicast_queue_data_t *first=header->first;
+	if(header->packets_in_queue == 0 || len>first->data_length)
+	{
+		log_message( log_module, MSG_ERROR,"BUG : Cannot remove more than the first packet of the queue\n");
+		return;
+	}
+	memmove(first->data, first->data+len, first->data_length-len);
+	first->data_length-=len;
+	header->data_bytes_in_queue-=len;
+}
+
 /** @brief Clear the queue
  *
  */
@@ -28,9 +28,68 @@
 #ifndef _UNICAST_QUEUE_H
 #define _UNICAST_QUEUE_H
 
+#include <stdint.h>
+#include <pthread.h>
+
 #define UNICAST_DEFAULT_QUEUE_MAX 1024*512
+/**Overload : percentages of the queue limit above which the packets which are not video, audio or PSI are dropped,
+ * and below which a client who lost data gets the stream again (at the next random access point)*/
+#define UNICAST_QUEUE_SOFT_LIMIT 75
+#define UNICAST_QUEUE_RESUME 50
+/**Overload : smallest queue limit when it is given in time (bytes)*/
+#define UNICAST_QUEUE_MIN_SIZE (64*1024)
+/**Overload : without random access point after this time (ms), the stream starts again at a payload unit start*/
+#define UNICAST_RESYNC_TIMEOUT 3000
 /**How many packets we try to send from the queue per new packet. This value MUST be at least 2*/
 #define UNICAST_MULTIPLE_QUEUE_SEND 3
+/**Zero copy : the data is written in the channel pipe by parts of whole packets fitting in a page*/
+#define UNICAST_PIPE_CHUNK ((4096/TS_PACKET_SIZE)*TS_PACKET_SIZE)
+/**TCP tuning : the kernel paces the data at this percentage of the channel bitrate*/
+#define UNICAST_PACING_HEADROOM 150
+/**TCP tuning : duration of stream held by the send buffer and waiting in the kernel (ms)*/
+#define UNICAST_SNDBUF_TIME 2000
+#define UNICAST_NOTSENT_TIME 1000
+#define UNICAST_SNDBUF_MIN (64*1024)
+/**TCP tuning : the socket is tuned again when the bitrate changed more than this percentage*/
+#define UNICAST_TUNING_HYSTERESIS 25
+
+/**Fast channel start : size of the cached PAT and PMT, and biggest stream kept since the last random access point*/
+#define UNICAST_CACHE_PSI_LEN (8*TS_PACKET_SIZE)
+#define UNICAST_CACHE_GOP_MAX (4*1024*1024)
+#define UNICAST_CACHE_GOP_MIN (256*1024)
+/**Fast channel start : the stream since the random access point is queued by parts of this size*/
+#define UNICAST_CACHE_CHUNK (64*TS_PACKET_SIZE)
+
+/** @brief Fast channel start : the packets of a PSI table since its last payload unit start */
+typedef struct unicast_cache_psi_t{
+  /** data[building] is filled, the other one holds the last complete table */
+  unsigned char data[2][UNICAST_CACHE_PSI_LEN];
+  int len[2];
+  int building;
+}unicast_cache_psi_t;
+
+/** @brief Fast channel start : what a new client of the channel receives before the live stream
+ * Filled by the thread sending the channel, read by the main thread for the new clients
+ */
+typedef struct unicast_cache_t{
+  pthread_mutex_t lock;
+  unicast_cache_psi_t pat;
+  unicast_cache_psi_t pmt;
+  /** The stream since the last random access point (gop_len 0 : no random access point yet, or too far, -1 : a random access point is starting) */
+  unsigned char *gop;
+  int gop_len;
+  int gop_size;
+}unicast_cache_t;
+
+/** The overload states of a queue */
+enum
+{
+	UNICAST_DROP_NONE=0,
+	/** The queue was full, everything is dropped until it is back to UNICAST_QUEUE_RESUME percent */
+	UNICAST_DROP_FULL,
+	/** The queue is short enough, we wait for a random access point */
+	UNICAST_DROP_WAIT_RAP,
+};
 
 /** @brief A data packet in queue.
  *
@@ -38,6 +97,8 @@
 typedef struct unicast_queue_data_t{
   int data_length;
   unsigned char *data;
+  /** Metrics : when the data was queued (us, 0 if not measured) */
+  uint64_t queued_time;
   struct unicast_queue_data_t *next;
 }unicast_queue_data_t;
 
@@ -47,7 +108,11 @@ typedef struct unicast_queue_data_t{
 typedef struct unicast_queue_header_t{
   int packets_in_queue;
   int data_bytes_in_queue;
-  int full;
+  /** Overload : the drop state (UNICAST_DROP_*), since when the data is dropped (us) and the statistics */
+  int drop_state;
+  uint64_t drop_start;
+  long dropped_packets;
+  int drop_events;
   unicast_queue_data_t *first;
   unicast_queue_data_t *last;
 }unicast_queue_header_t;
@@ -0,0 +1,380 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the parsing of the HTTP requests
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Parsing of the HTTP requests and indexes of the channels
+ *
+ * The request of a client is received in a fixed buffer of UNICAST_REQUEST_MAX bytes.
+ * Each time data arrives, only the new bytes are parsed : the request line and the Host
+ * header are kept, the request is complete with the empty line ending the headers.
+ *
+ * The channels asked by service id or by name are found with hash indexes. The indexes
+ * are rebuilt when the channels change (autoconfiguration) : when the list of channels
+ * is not the same, or when a channel is not found (at most once per UNICAST_INDEX_REBUILD_DELAY).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#include "unicast_http.h"
+#include "errors.h"
+#include "log.h"
+
+static char *log_module="Unicast : ";
+
+
+/** @brief Prepare the request of a client for a new request */
+void unicast_request_reset(unicast_request_t *request)
+{
+	request->len=0;
+	request->parsed=0;
+	request->line_start=0;
+	request->request_line=0;
+	request->complete=0;
+	request->method=NULL;
+	request->path=NULL;
+	request->query=NULL;
+	request->host=NULL;
+	request->if_none_match=NULL;
+	request->buffer[0]='\0';
+}
+
+/** @brief Cut the request line : method, path, query and version
+ * @return 0 if ok, -1 if the line is malformed
+ */
+static int unicast_request_line(unicast_request_t *request, char *line)
+{
+	char *pos;
+
+	request->method=line;
+	pos=strchr(line,' ');
+	if(pos==NULL)
+		return -1;
+	*pos++='\0';
+	while(*pos==' ')
+		pos++;
+	if(*pos!='/')
+		return -1;
+	request->path=pos;
+	//The version is not used, HTTP/0.9 requests have none
+	pos=strchr(pos,' ');
+	if(pos!=NULL)
+		*pos='\0';
+	pos=strchr(request->path,'?');
+	if(pos!=NULL)
+	{
+		*pos++='\0';
+		request->query=pos;
+	}
+	return 0;
+}
+
+/** @brief Value of a header line if it is this header, NULL otherwise */
+static char *unicast_header_value(char *line, const char *name)
+{
+	int len=strlen(name);
+	if(strncasecmp(line,name,len) || line[len]!=':')
+		return NULL;
+	line+=len+1;
+	while(*line==' ' || *line=='\t')
+		line++;
+	return line;
+}
+
+/** @brief Parse the data received since the last call
+ *
+ * @param request the request of the client, request->len contains the received bytes
+ * @return 1 if the request is complete, 0 if more data is needed, -1 if the request is malformed, -2 if it is too large
+ */
+int unicast_request_parse(unicast_request_t *request)
+{
+	char *line,*value;
+	int line_len;
+
+	if(request->complete)
+		return 1;
+	for(;request->parsed<request->len;request->parsed++)
+	{
+		if(request->buffer[request->parsed]!='\n')
+			continue;
+		line=request->buffer+request->line_start;
+		line_len=request->parsed-request->line_start;
+		if(line_len && line[line_len-1]=='\r')
+			line_len--;
+		line[line_len]='\0';
+		request->line_start=request->parsed+1;
+		if(!request->request_line)
+		{
+			//Empty lines before the request line are ignored
+			if(!line_len)
+				continue;
+			request->request_line=1;
+			if(unicast_request_line(request, line))
+				return -1;
+		}
+		else if(!line_len)
+		{
+			request->parsed++;
+			request->complete=1;
+			return 1;
+		}
+		else if((value=unicast_header_value(line,"Host"))!=NULL)
+			request->host=value;
+		else if((value=unicast_header_value(line,"If-None-Match"))!=NULL)
+			request->if_none_match=value;
+	}
+	if(request->len>=UNICAST_REQUEST_MAX)
+		return -2;
+	return 0;
+}
+
+/** @brief Value of an hex digit, -1 if it is not one */
+static int unicast_hex(char c)
+{
+	if(c>='0' && c<='9')
+		return c-'0';
+	if(c>='a' && c<='f')
+		return c-'a'+10;
+	if(c>='A' && c<='F')
+		return c-'A'+10;
+	return -1;
+}
+
+/** @brief Decode a part of an URL (%xx escapes, + for spaces)
+ *
+ * @param src the data to decode
+ * @param src_len its length
+ * @param dst the decoded string
+ * @param dst_len the size of dst
+ * @return the length of the decoded string, -1 if it doesn't fit in dst
+ */
+int unicast_url_decode(const char *src, int src_len, char *dst, int dst_len)
+{
+	int i,len;
+
+	len=0;
+	for(i=0;i<src_len;i++)
+	{
+		if(len>=dst_len-1)
+			return -1;
+		if(src[i]=='%' && i+2<src_len && unicast_hex(src[i+1])>=0 && unicast_hex(src[i+2])>=0)
+		{
+			dst[len++]=(char)(unicast_hex(src[i+1])*16+unicast_hex(src[i+2]));
+			i+=2;
+		}
+		else if(src[i]=='+')
+			dst[len++]=' ';
+		else
+			dst[len++]=src[i];
+	}
+	dst[len]='\0';
+	return len;
+}
+
+/** @brief Get a parameter of the query of a complete request (?name=value&...)
+ *
+ * @param request the request
+ * @param name the name of the parameter
+ * @param value the decoded value
+ * @param value_len the size of value
+ * @return 1 if the parameter was found, 0 otherwise
+ */
+int unicast_request_param(unicast_request_t *request, const char *name, char *value, int value_len)
+{
+	char *param,*end;
+	int name_len;
+
+	name_len=strlen(name);
+	for(param=request->query;param!=NULL;param=(*end)?end+1:NULL)
+	{
+		end=strchr(param,'&');
+		if(end==NULL)
+			end=param+strlen(param);
+		if(!strncmp(param,name,name_len) && param[name_len]=='=')
+		{
+			param+=name_len+1;
+			return unicast_url_decode(param, end-param, value, value_len)>=0;
+		}
+	}
+	return 0;
+}
+
+
+/** @brief Hash of a service id */
+static unsigned int unicast_hash_sid(int sid)
+{
+	return (unsigned int)sid*2654435761u;
+}
+
+/** @brief Hash of a channel name (FNV-1a) */
+static unsigned int unicast_hash_name(const char *name)
+{
+	unsigned int hash=2166136261u;
+	while(*name)
+	{
+		hash^=(unsigned char)*name++;
+		hash*=16777619u;
+	}
+	return hash;
+}
+
+/** @brief Find a channel in the index by service id, the slots are checked against the channels
+ * @return the channel index, -1 if not found
+ */
+static int unicast_index_find_sid(unicast_channel_index_t *index, mumudvb_channel_t **channels, int sid)
+{
+	unsigned int slot;
+	int mask;
+
+	mask=index->size-1;
+	for(slot=unicast_hash_sid(sid)&mask;index->by_sid[slot];slot=(slot+1)&mask)
+		if(channels[index->by_sid[slot]-1]->service_id==sid)
+			return index->by_sid[slot]-1;
+	return -1;
+}
+
+/** @brief Find a channel in the index by name, the slots are checked against the channels
+ * @return the channel index, -1 if not found
+ */
+static int unicast_index_find_name(unicast_channel_index_t *index, mumudvb_channel_t **channels, char *name)
+{
+	unsigned int slot;
+	int mask;
+
+	mask=index->size-1;
+	for(slot=unicast_hash_name(name)&mask;index->by_name[slot];slot=(slot+1)&mask)
+		if(!strcmp(channels[index->by_name[slot]-1]->name,name))
+			return index->by_name[slot]-1;
+	return -1;
+}
+
+/** @brief Build the indexes of the channels
+ * With several channels having the same service id or name, the last one is kept
+ * @return 0 if ok, -1 on error
+ */
+static int unicast_channel_index_build(unicast_channel_index_t *index, mumudvb_channel_t **channels, int number_of_channels)
+{
+	unsigned int slot;
+	int size,mask,curr_channel;
+
+	size=16;
+	while(size<2*number_of_channels)
+		size<<=1;
+	if(size!=index->size)
+	{
+		unicast_channel_index_free(index);
+		index->by_sid=calloc(size,sizeof(int));
+		index->by_name=calloc(size,sizeof(int));
+		if(index->by_sid==NULL || index->by_name==NULL)
+		{
+			log_message( log_module, MSG_ERROR,"Problem with calloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+			unicast_channel_index_free(index);
+			return -1;
+		}
+		index->size=size;
+	}
+	else
+	{
+		memset(index->by_sid,0,size*sizeof(int));
+		memset(index->by_name,0,size*sizeof(int));
+	}
+	mask=size-1;
+	for(curr_channel=0;curr_channel<number_of_channels;curr_channel++)
+	{
+		for(slot=unicast_hash_sid(channels[curr_channel]->service_id)&mask;index->by_sid[slot];slot=(slot+1)&mask)
+			if(channels[index->by_sid[slot]-1]->service_id==channels[curr_channel]->service_id)
+				break;
+		index->by_sid[slot]=curr_channel+1;
+		for(slot=unicast_hash_name(channels[curr_channel]->name)&mask;index->by_name[slot];slot=(slot+1)&mask)
+			if(!strcmp(channels[index->by_name[slot]-1]->name,channels[curr_channel]->name))
+				break;
+		index->by_name[slot]=curr_channel+1;
+	}
+	index->channels=channels;
+	index->number_of_channels=number_of_channels;
+	index->build_time=get_time();
+	log_message( log_module, MSG_DEBUG,"Channel indexes built for %d channels\n",number_of_channels);
+	return 0;
+}
+
+/** @brief Tell if the indexes have to be rebuilt before a search, or after a search which found nothing */
+static int unicast_channel_index_stale(unicast_channel_index_t *index, mumudvb_channel_t **channels, int number_of_channels, int not_found)
+{
+	if(!index->size || index->channels!=channels || index->number_of_channels!=number_of_channels)
+		return 1;
+	return not_found && (get_time()-index->build_time)>=UNICAST_INDEX_REBUILD_DELAY;
+}
+
+/** @brief Find the channel with this service id
+ * @return the channel index, -1 if not found
+ */
+int unicast_channel_by_sid(unicast_channel_index_t *index, mumudvb_channel_t **channels, int number_of_channels, int sid)
+{
+	int found;
+
+	if(unicast_channel_index_stale(index, channels, number_of_channels, 0))
+		if(unicast_channel_index_build(index, channels, number_of_channels))
+			return -1;
+	found=unicast_index_find_sid(index, channels, sid);
+	if(found<0 && unicast_channel_index_stale(index, channels, number_of_channels, 1))
+	{
+		if(unicast_channel_index_build(index, channels, number_of_channels))
+			return -1;
+		found=unicast_index_find_sid(index, channels, sid);
+	}
+	return found;
+}
+
+/** @brief Find the channel with this name
+ * @return the channel index, -1 if not found
+ */
+int unicast_channel_by_name(unicast_channel_index_t *index, mumudvb_channel_t **channels, int number_of_channels, char *name)
+{
+	int found;
+
+	if(unicast_channel_index_stale(index, channels, number_of_channels, 0))
+		if(unicast_channel_index_build(index, channels, number_of_channels))
+			return -1;
+	found=unicast_index_find_name(index, channels, name);
+	if(found<0 && unicast_channel_index_stale(index, channels, number_of_channels, 1))
+	{
+		if(unicast_channel_index_build(index, channels, number_of_channels))
+			return -1;
+		found=unicast_index_find_name(index, channels, name);
+	}
+	return found;
+}
+
+/** @brief Free the indexes of the channels */
+void unicast_channel_index_free(unicast_channel_index_t *index)
+{
+	free(index->by_sid);
+	free(index->by_name);
+	index->by_sid=NULL;
+	index->by_name=NULL;
+	index->size=0;
+}
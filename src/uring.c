@@ -0,0 +1,520 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the io_uring output backend
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief io_uring output backend of the multicast (option io_uring)
+ *
+ * The datagrams built while processing a read buffer are queued in the submission ring
+ * (sendmsg on the registered sockets) and sent with one io_uring_enter at the end of the
+ * read buffer (uring_flush), which also waits for their completion.
+ * The packets referenced in the read buffer are not copied (the read buffer is not reused
+ * before the flush), the other parts (RTP header, channel buffer) are copied in the copy area.
+ *
+ * Only the main thread uses the ring, the datagrams sent by the other threads (pacing, SCAM)
+ * and the HTTP clients (their queues need the result of each write) keep the direct path.
+ * If the kernel has no io_uring (or no sendmsg support in it), the direct path is used.
+ */
+
+#include "uring.h"
+#include "network.h"
+#include "log.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+static char *log_module="io_uring: ";
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/** @brief A datagram waiting in the ring */
+typedef struct uring_dgram_t{
+	struct msghdr msg4;
+	struct msghdr msg6;
+	struct iovec iov[CHANNEL_IOV_MAX];
+	int iovcnt;
+	/** the sockets, for the direct path if the ring fails */
+	int fd4;
+	int fd6;
+}uring_dgram_t;
+
+/** @brief The ring and the datagrams waiting */
+typedef struct uring_t{
+	int fd;
+	/** Submission ring */
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned sq_entries;
+	/** Completion ring (the same mapping as the submission ring with IORING_FEAT_SINGLE_MMAP) */
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/** Entries queued since the last flush */
+	unsigned tail;
+	unsigned to_submit;
+	uring_dgram_t dgrams[URING_ENTRIES/2];
+	int num_dgrams;
+	unsigned char copy[URING_COPY_SIZE];
+	int copy_len;
+
+	/** Registered sockets (fixed files), 0 if the kernel refused the registration */
+	int files_registered;
+	int num_files;
+
+	/** The thread allowed to use the ring */
+	pthread_t owner;
+
+	/** Statistics */
+	long sent;
+	long enters;
+	long errors;
+	int last_error;
+}uring_t;
+
+static uring_t *uring=NULL;
+
+static int uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/** @brief Check that the kernel supports sendmsg in io_uring (probe available since Linux 5.6) */
+static int uring_probe_sendmsg(int fd)
+{
+	struct io_uring_probe *probe;
+	size_t len;
+	int ret=0;
+	len=sizeof(struct io_uring_probe)+256*sizeof(struct io_uring_probe_op);
+	probe=calloc(1,len);
+	if(probe==NULL)
+		return 0;
+	if(uring_register(fd, IORING_REGISTER_PROBE, probe, 256)==0 &&
+			probe->last_op>=IORING_OP_SENDMSG &&
+			(probe->ops[IORING_OP_SENDMSG].flags & IO_URING_OP_SUPPORTED))
+		ret=1;
+	free(probe);
+	return ret;
+}
+
+static void uring_free(uring_t *ring)
+{
+	if(ring->sqes && ring->sqes!=MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_size);
+	if(ring->cq_ring && ring->cq_ring!=MAP_FAILED && ring->cq_ring!=ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if(ring->sq_ring && ring->sq_ring!=MAP_FAILED)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	if(ring->fd>=0)
+		close(ring->fd);
+	free(ring);
+}
+
+/** @brief Create the ring
+ * If it is not possible, the option is disabled and the direct path is used
+ * @return 0 if the ring is ready
+ */
+int uring_init(multi_p_t *multi_p)
+{
+	struct io_uring_params params;
+	uring_t *ring;
+	int *files;
+	int i;
+
+	if(!multi_p->io_uring)
+		return 0;
+	ring=calloc(1,sizeof(uring_t));
+	if(ring==NULL)
+	{
+		log_message( log_module, MSG_ERROR,"Problem with malloc : %s file : %s line %d\n",strerror(errno),__FILE__,__LINE__);
+		multi_p->io_uring=0;
+		return -1;
+	}
+	memset(&params, 0, sizeof(params));
+#if defined(IORING_SETUP_SINGLE_ISSUER) && defined(IORING_SETUP_COOP_TASKRUN)
+	//Only the main thread submits, the kernel can skip the cross thread work (Linux 6.0)
+	params.flags=IORING_SETUP_SINGLE_ISSUER|IORING_SETUP_COOP_TASKRUN;
+	ring->fd=syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	if(ring->fd<0 && errno==EINVAL)
+	{
+		memset(&params, 0, sizeof(params));
+		ring->fd=syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	}
+#else
+	ring->fd=syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+#endif
+	if(ring->fd<0)
+	{
+		log_message( log_module, MSG_WARN,"io_uring not available (%s), the datagrams are sent directly\n", strerror(errno));
+		goto uring_fallback;
+	}
+	if(!uring_probe_sendmsg(ring->fd))
+	{
+		log_message( log_module, MSG_WARN,"This kernel doesn't support sendmsg with io_uring, the datagrams are sent directly\n");
+		goto uring_fallback;
+	}
+
+	ring->sq_ring_size=params.sq_off.array+params.sq_entries*sizeof(unsigned);
+	ring->cq_ring_size=params.cq_off.cqes+params.cq_entries*sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(ring->cq_ring_size>ring->sq_ring_size)
+			ring->sq_ring_size=ring->cq_ring_size;
+		ring->cq_ring_size=ring->sq_ring_size;
+	}
+	ring->sq_ring=mmap(NULL, ring->sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if(ring->sq_ring==MAP_FAILED)
+		goto uring_mmap_error;
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cq_ring=ring->sq_ring;
+	else
+	{
+		ring->cq_ring=mmap(NULL, ring->cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if(ring->cq_ring==MAP_FAILED)
+			goto uring_mmap_error;
+	}
+	ring->sqes_size=params.sq_entries*sizeof(struct io_uring_sqe);
+	ring->sqes=mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if(ring->sqes==MAP_FAILED)
+		goto uring_mmap_error;
+
+	ring->sq_tail=(unsigned *)((char *)ring->sq_ring+params.sq_off.tail);
+	ring->sq_mask=(unsigned *)((char *)ring->sq_ring+params.sq_off.ring_mask);
+	ring->sq_array=(unsigned *)((char *)ring->sq_ring+params.sq_off.array);
+	ring->sq_entries=params.sq_entries;
+	ring->cq_head=(unsigned *)((char *)ring->cq_ring+params.cq_off.head);
+	ring->cq_tail=(unsigned *)((char *)ring->cq_ring+params.cq_off.tail);
+	ring->cq_mask=(unsigned *)((char *)ring->cq_ring+params.cq_off.ring_mask);
+	ring->cqes=(struct io_uring_cqe *)((char *)ring->cq_ring+params.cq_off.cqes);
+	ring->tail=*ring->sq_tail;
+
+	//Empty table of registered sockets, the sockets are added when the channels send their first datagram
+	files=malloc(URING_MAX_FILES*sizeof(int));
+	if(files!=NULL)
+	{
+		for(i=0;i<URING_MAX_FILES;i++)
+			files[i]=-1;
+		if(uring_register(ring->fd, IORING_REGISTER_FILES, files, URING_MAX_FILES)==0)
+			ring->files_registered=1;
+		else
+			log_message( log_module, MSG_DETAIL,"Cannot register the sockets (%s), they are given at each send\n", strerror(errno));
+		free(files);
+	}
+
+	ring->owner=pthread_self();
+	uring=ring;
+	log_message( log_module, MSG_INFO,"The multicast datagrams are sent with io_uring\n");
+	return 0;
+
+uring_mmap_error:
+	log_message( log_module, MSG_WARN,"Cannot map the io_uring rings (%s), the datagrams are sent directly\n", strerror(errno));
+uring_fallback:
+	uring_free(ring);
+	multi_p->io_uring=0;
+	return -1;
+}
+
+/** @brief Get the registered index of a socket
+ * @param index the index+1 stored in the channel (0 : not registered yet)
+ * @return the index or -1 if the socket is used directly
+ */
+static int uring_file_index(int fd, int *index)
+{
+	struct io_uring_files_update update;
+	if(!uring->files_registered || fd<0)
+		return -1;
+	if(*index)
+		return *index-1;
+	if(uring->num_files>=URING_MAX_FILES)
+		return -1;
+	memset(&update, 0, sizeof(update));
+	update.offset=uring->num_files;
+	update.fds=(unsigned long)&fd;
+	if(uring_register(uring->fd, IORING_REGISTER_FILES_UPDATE, &update, 1)!=1)
+		return -1;
+	*index=++uring->num_files;
+	return *index-1;
+}
+
+static void uring_prep_sendmsg(int fd, int index, struct msghdr *msg)
+{
+	struct io_uring_sqe *sqe;
+	unsigned idx;
+	idx=uring->tail & *uring->sq_mask;
+	sqe=&uring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode=IORING_OP_SENDMSG;
+	if(index>=0)
+	{
+		sqe->fd=index;
+		sqe->flags=IOSQE_FIXED_FILE;
+	}
+	else
+		sqe->fd=fd;
+	sqe->addr=(unsigned long)msg;
+	sqe->len=1;
+	sqe->user_data=(unsigned long)msg;
+	uring->sq_array[idx]=idx;
+	uring->tail++;
+	uring->to_submit++;
+}
+
+/** @brief Copy a part of the datagram in the copy area, merged with the previous part if they follow */
+static void uring_copy_part(uring_dgram_t *dgram, unsigned char *data, int len)
+{
+	unsigned char *dest=uring->copy+uring->copy_len;
+	memcpy(dest, data, len);
+	uring->copy_len+=len;
+	if(dgram->iovcnt && (unsigned char *)dgram->iov[dgram->iovcnt-1].iov_base+dgram->iov[dgram->iovcnt-1].iov_len==dest)
+		dgram->iov[dgram->iovcnt-1].iov_len+=len;
+	else
+	{
+		dgram->iov[dgram->iovcnt].iov_base=dest;
+		dgram->iov[dgram->iovcnt].iov_len=len;
+		dgram->iovcnt++;
+	}
+}
+
+/** @brief Queue the datagram of the channel (the RTP header is already updated)
+ * @return 1 if the datagram is queued, 0 if it has to be sent directly
+ */
+int uring_queue_send(mumudvb_channel_t *channel, multi_p_t *multi_p)
+{
+	uring_dgram_t *dgram;
+	unsigned char *part;
+	int i;
+
+	if(uring==NULL || !pthread_equal(uring->owner, pthread_self()))
+		return 0;
+	//No room for another datagram : the previous ones are sent now
+	if(uring->num_dgrams==URING_ENTRIES/2 ||
+			uring->copy_len+RTP_HEADER_LEN+MAX_UDP_SIZE_JUMBO>URING_COPY_SIZE ||
+			uring->to_submit+2>uring->sq_entries)
+		uring_flush();
+
+	dgram=&uring->dgrams[uring->num_dgrams];
+	dgram->iovcnt=0;
+	if(multi_p->rtp_header)
+		uring_copy_part(dgram, channel->datagram->buf_with_rtp_header, RTP_HEADER_LEN);
+	if(channel->iovcnt)
+		for(i=1;i<=channel->iovcnt;i++)
+		{
+			part=channel->datagram->iov[i].iov_base;
+			//The channel buffer is reused for the next datagram, the read buffer stays until the flush
+			if(part>=channel->datagram->buf && part<channel->datagram->buf+sizeof(channel->datagram->buf))
+				uring_copy_part(dgram, part, channel->datagram->iov[i].iov_len);
+			else
+			{
+				dgram->iov[dgram->iovcnt]=channel->datagram->iov[i];
+				dgram->iovcnt++;
+			}
+		}
+	else
+		uring_copy_part(dgram, channel->datagram->buf, channel->nb_bytes);
+
+	dgram->fd4=dgram->fd6=-1;
+	if(multi_p->multicast_ipv4)
+	{
+		memset(&dgram->msg4, 0, sizeof(dgram->msg4));
+		dgram->msg4.msg_name=&channel->sOut4;
+		dgram->msg4.msg_namelen=sizeof(channel->sOut4);
+		dgram->msg4.msg_iov=dgram->iov;
+		dgram->msg4.msg_iovlen=dgram->iovcnt;
+		dgram->fd4=channel->socketOut4;
+		uring_prep_sendmsg(channel->socketOut4, uring_file_index(channel->socketOut4, &channel->uring_file4), &dgram->msg4);
+	}
+	if(multi_p->multicast_ipv6)
+	{
+		memset(&dgram->msg6, 0, sizeof(dgram->msg6));
+		dgram->msg6.msg_name=&channel->sOut6;
+		dgram->msg6.msg_namelen=sizeof(channel->sOut6);
+		dgram->msg6.msg_iov=dgram->iov;
+		dgram->msg6.msg_iovlen=dgram->iovcnt;
+		dgram->fd6=channel->socketOut6;
+		uring_prep_sendmsg(channel->socketOut6, uring_file_index(channel->socketOut6, &channel->uring_file6), &dgram->msg6);
+	}
+	uring->num_dgrams++;
+	return 1;
+}
+
+/** @brief The kernel doesn't take the entries waiting : they are sent directly and the ring is not used anymore
+ * @param from the number of entries of this flush already taken by the kernel, they are not sent again
+ */
+static void uring_send_direct(unsigned from)
+{
+	unsigned entry;
+	struct msghdr *msg;
+	uring_dgram_t *dgram;
+	int fd;
+	for(entry=from;entry<uring->to_submit;entry++)
+	{
+		//The entries not taken are untouched, they give the message and its datagram
+		msg=(struct msghdr *)(unsigned long)uring->sqes[(uring->tail-uring->to_submit+entry) & *uring->sq_mask].user_data;
+		dgram=&uring->dgrams[((char *)msg-(char *)uring->dgrams)/sizeof(uring_dgram_t)];
+		fd=(msg==&dgram->msg4)?dgram->fd4:dgram->fd6;
+		if(sendmsg(fd, msg, 0)<0)
+		{
+			uring->errors++;
+			if(errno!=uring->last_error)
+				log_message( log_module,  MSG_WARN,"sendmsg failed : %s\n", strerror(errno));
+			uring->last_error=errno;
+		}
+		else
+		{
+			uring->sent++;
+			uring->last_error=0;
+		}
+	}
+}
+
+/** @brief Send the datagrams waiting and wait for their completion
+ * Has to be called before the read buffer is reused
+ */
+void uring_flush(void)
+{
+	unsigned head,tail,submitted,completed;
+	struct io_uring_cqe *cqe;
+	int ret,retries,direct;
+
+	if(uring==NULL || !uring->to_submit || !pthread_equal(uring->owner, pthread_self()))
+		return;
+	__atomic_store_n(uring->sq_tail, uring->tail, __ATOMIC_RELEASE);
+	submitted=0;
+	completed=0;
+	retries=0;
+	direct=0;
+	//The kernel can take only a part of the entries (it stops at the first one it can't prepare,
+	//or lacks memory), it doesn't wait in this case and the remaining entries are submitted again
+	while(completed<uring->to_submit)
+	{
+		ret=syscall(__NR_io_uring_enter, uring->fd, uring->to_submit-submitted, uring->to_submit-completed, IORING_ENTER_GETEVENTS, NULL, 0);
+		uring->enters++;
+		if(ret>0)
+		{
+			submitted+=ret;
+			retries=0;
+		}
+		else if(ret<0 && errno!=EINTR && errno!=EAGAIN && errno!=EBUSY)
+		{
+			//We can't wait anymore for the ones in the kernel
+			log_message( log_module, MSG_ERROR,"io_uring_enter failed : %s, we go back to the direct sends\n", strerror(errno));
+			uring_send_direct(submitted);
+			direct=1;
+			break;
+		}
+		else if(submitted<uring->to_submit && ++retries>URING_SUBMIT_RETRIES)
+		{
+			//The entries not taken are sent directly, we only wait for the ones in the kernel
+			log_message( log_module, MSG_ERROR,"io_uring doesn't take the datagrams, we go back to the direct sends\n");
+			uring_send_direct(submitted);
+			uring->to_submit=submitted;
+			direct=1;
+		}
+		head=*uring->cq_head;
+		tail=__atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+		while(head!=tail)
+		{
+			cqe=&uring->cqes[head & *uring->cq_mask];
+			if(cqe->res<0)
+			{
+				uring->errors++;
+				if(-cqe->res!=uring->last_error)
+					log_message( log_module,  MSG_WARN,"sendmsg failed : %s\n", strerror(-cqe->res));
+				uring->last_error=-cqe->res;
+			}
+			else
+			{
+				uring->sent++;
+				uring->last_error=0;
+			}
+			head++;
+			completed++;
+		}
+		__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+	}
+	uring->to_submit=0;
+	uring->num_dgrams=0;
+	uring->copy_len=0;
+	//The entries not taken are still in the submission ring, it can't be used anymore
+	if(direct)
+		uring_stop();
+}
+
+/** @brief Send the datagrams waiting and free the ring */
+void uring_stop(void)
+{
+	uring_t *ring=uring;
+	if(ring==NULL)
+		return;
+	uring_flush();
+	if(uring==NULL) //the flush failed and already stopped the ring
+		return;
+	log_message( log_module, MSG_DETAIL,"%ld datagrams sent with %ld system calls, %ld errors\n", ring->sent, ring->enters, ring->errors);
+	uring=NULL;
+	uring_free(ring);
+}
+
+#else
+
+/** @brief io_uring was not available at compile time, the direct path is used */
+int uring_init(multi_p_t *multi_p)
+{
+	if(!multi_p->io_uring)
+		return 0;
+	log_message( log_module, MSG_WARN,"MuMuDVB was compiled without io_uring support, the datagrams are sent directly\n");
+	multi_p->io_uring=0;
+	return -1;
+}
+
+int uring_queue_send(mumudvb_channel_t *channel, multi_p_t *multi_p)
+{
+	(void) channel;
+	(void) multi_p;
+	return 0;
+}
+
+void uring_flush(void)
+{
+}
+
+void uring_stop(void)
+{
+}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * MuMuDVB - Stream a DVB transport stream.
+ * File for the io_uring output backend
+ *
+ * (C) 2004-2014 Brice DUBOST <mumudvb@braice.net>
+ *
+ * The latest version can be found at http://mumudvb.braice.net
+ *
+ * Copyright notice:
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/** @file
+ * @brief Header file for the io_uring output backend of the multicast
+ */
+
+#ifndef _URING_H
+#define _URING_H
+
+#include "mumudvb.h"
+
+/** Number of submission entries of the ring (two per datagram with IPv4 and IPv6) */
+#define URING_ENTRIES 256
+/** Size of the area for the parts of the datagrams which are not in the read buffer */
+#define URING_COPY_SIZE (128*1024)
+/** Number of registered sockets (fixed files) */
+#define URING_MAX_FILES 1024
+/** Number of io_uring_enter in a row which take none of the remaining entries, before they are sent directly */
+#define URING_SUBMIT_RETRIES 4
+
+int uring_init(multi_p_t *multi_p);
+int uring_queue_send(mumudvb_channel_t *channel, multi_p_t *multi_p);
+void uring_flush(void);
+void uring_stop(void);
+
+#endif